@@ -1,49 +1,58 @@
 #include "Application.h"
+#include "ParticleSystem.h"
+#include "SpriteBatch.h"
+#include "ObjectRenderer.h"
+#include "SceneRenderer.h"
+#include "LodRenderer.h"
+#include "MeshletRenderer.h"
+#include "TextureAtlas.h"
+#include "TextureResidency.h"
+#include "OffscreenRenderer.h"
+#include "FrameCapture.h"
+#include "PerformanceHud.h"
+#include "DynamicResolution.h"
+#include "DepthPyramid.h"
+#include "GeometryPool.h"
+#include "PipelineCache.h"
+#include "ShaderVariant.h"
+#include "DebugLog.h"
+#include "MemoryTracker.h"
+#include "TaskGraph.h"
 
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb_image_write.h>
 
 const uint32_t WINDOW_WIDTH = 800;
 const uint32_t WINDOW_HEIGHT = 600;
 
-struct Vertex
+// The feature toggles of shader.frag.
+struct MainShaderVariant
 {
-	glm::vec2 pos;
-	glm::vec3 color;
-	glm::vec2 texCoord;
-
-	static VkVertexInputBindingDescription GetBindingDescription()
-	{
-		VkVertexInputBindingDescription bindingDescription{};
-		bindingDescription.binding = 0;
-		bindingDescription.stride = sizeof(Vertex);
-		bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-		return bindingDescription;
-	}
-
-	static std::array<VkVertexInputAttributeDescription, 3> GetAttributeDescriptions()
-	{
-		std::array<VkVertexInputAttributeDescription, 3> attributeDescriptions{};
-
-		attributeDescriptions[0].binding = 0;
-		attributeDescriptions[0].location = 0;
-		attributeDescriptions[0].format = VK_FORMAT_R32G32_SFLOAT;
-		attributeDescriptions[0].offset = offsetof(Vertex, pos);
-
-		attributeDescriptions[1].binding = 0;
-		attributeDescriptions[1].location = 1;
-		attributeDescriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-		attributeDescriptions[1].offset = offsetof(Vertex, color);
-
-		attributeDescriptions[2].binding = 0;
-		attributeDescriptions[2].location = 2;
-		attributeDescriptions[2].format = VK_FORMAT_R32G32_SFLOAT;
-		attributeDescriptions[2].offset = offsetof(Vertex, texCoord);
-
-		return attributeDescriptions;
-	}
+	bool useTexture = true;
+	bool useVertexColor = false;
+	bool alphaTest = false;
+	float alphaCutoff = 0.5f;
+
+	using Constants = SpecializationConstants<
+		SpecializationConstant<0, &MainShaderVariant::useTexture>,
+		SpecializationConstant<1, &MainShaderVariant::useVertexColor>,
+		SpecializationConstant<2, &MainShaderVariant::alphaTest>,
+		SpecializationConstant<3, &MainShaderVariant::alphaCutoff>>;
 };
 
+const uint32_t SPRITE_ATLAS_IMAGE_COUNT = 512;
+const uint32_t SPRITE_ATLAS_LAYER_SIZE = 1024;
+const uint32_t SPRITE_ATLAS_PADDING = 4;
+const uint32_t SPRITE_ATLAS_MIP_LEVELS = 4;
+const uint32_t SPRITE_RESIDENT_TEXTURE_SIZE = 512;
+const uint32_t RENDER_BATCH_REPORT_INTERVAL = 100;
+const uint32_t SPRITE_RESIDENT_WINDOW = 8;				// How many of the resident textures are on screen at once.
+const uint32_t SPRITE_RESIDENT_WINDOW_FRAMES = 180;		// How often the window slides along by one.
+const VkDeviceSize GEOMETRY_POOL_VERTEX_BYTES = 32 * 1024 * 1024;
+const VkDeviceSize GEOMETRY_POOL_INDEX_BYTES = 16 * 1024 * 1024;
+
 const std::vector<Vertex> vertices = {
 	{{-0.5f, -0.5f}, {1.0f, 0.0f, 0.0f}, {1.0f, 0.0f}},
 	{{0.5f, -0.5f}, {0.0f, 1.0f, 0.0f}, {0.0f, 0.0f}},
@@ -51,7 +60,7 @@ const std::vector<Vertex> vertices = {
 	{{-0.5f, 0.5f}, {1.0f, 1.0f, 1.0f}, {1.0f, 1.0f}}
 };
 
-const std::vector<uint16_t> indices = {
+const std::vector<uint32_t> indices = {
 	0, 1, 2, 2, 3, 0
 };
 
@@ -64,14 +73,12 @@ const std::vector<const char*> desiredDeviceExtensionsArray = {
 };
 
 #ifdef NDEBUG
-const bool enbaleValidationLayers = false;
+const bool enableValidationLayers = false;
 #else
 const bool enableValidationLayers = true;
 #endif
 
-const int MAX_FRAMES_IN_FLIGHT = 2;
-
-static std::vector<char> ReadFile(const std::string& filename)
+/*static*/ std::vector<char> Application::ReadFile(const std::string& filename)
 {
 	std::ifstream file(filename, std::ios::ate | std::ios::binary);
 	if (!file.is_open())
@@ -86,6 +93,23 @@ static std::vector<char> ReadFile(const std::string& filename)
 	return buffer;
 }
 
+/*static*/ std::string Application::ReadEnvironmentSetting(const char* name, const std::string& defaultValue)
+{
+#if defined(_MSC_VER)
+	char* value = nullptr;
+	size_t length = 0;
+	if (0 != _dupenv_s(&value, &length, name) || value == nullptr)
+		return defaultValue;
+
+	std::string result(value);
+	free(value);
+	return result;
+#else
+	const char* value = std::getenv(name);
+	return value ? std::string(value) : defaultValue;
+#endif
+}
+
 static VKAPI_ATTR VkBool32 VKAPI_CALL DebugCallback(
 	VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity,
 	VkDebugUtilsMessageTypeFlagsEXT messageType,
@@ -102,6 +126,27 @@ static void FrameBufferResizeCallback(GLFWwindow* window, int width, int height)
 	app->frameBufferResized = true;
 }
 
+static void KeyCallback(GLFWwindow* window, int key, int scancode, int action, int mods)
+{
+	// F1 shows or hides the performance HUD, F12 takes a screenshot, and F11 starts or stops capturing every frame.
+	auto app = reinterpret_cast<Application*>(glfwGetWindowUserPointer(window));
+	if (action != GLFW_PRESS)
+		return;
+
+	if (key == GLFW_KEY_F1 && app->performanceHud)
+		app->performanceHud->ToggleVisible();
+
+	if (!app->frameCapture)
+		return;
+
+	if (key == GLFW_KEY_F12)
+		app->frameCapture->RequestScreenshot();
+	else if (key == GLFW_KEY_F11 && app->frameCapture->IsSequenceRunning())
+		app->frameCapture->StopSequence();
+	else if (key == GLFW_KEY_F11)
+		app->frameCapture->StartSequence(0);
+}
+
 Application::Application()
 {
 	this->window = nullptr;
@@ -112,6 +157,7 @@ Application::Application()
 	this->graphicsQueue = VK_NULL_HANDLE;
 	this->presentQueue = VK_NULL_HANDLE;
 	this->transferQueue = VK_NULL_HANDLE;
+	this->computeQueue = VK_NULL_HANDLE;
 	this->surface = VK_NULL_HANDLE;
 	this->swapChain = VK_NULL_HANDLE;
 	this->pipelineLayout = VK_NULL_HANDLE;
@@ -120,17 +166,47 @@ Application::Application()
 	this->graphicsPipeline = VK_NULL_HANDLE;
 	this->graphicsCommandPool = VK_NULL_HANDLE;
 	this->transferCommandPool = VK_NULL_HANDLE;
+	this->computeCommandPool = VK_NULL_HANDLE;
 	this->frameCount = 0;
 	this->frameBufferResized = false;
-	this->vertexBuffer = VK_NULL_HANDLE;
-	this->vertexBufferMemory = nullptr;
-	this->indexBuffer = VK_NULL_HANDLE;
-	this->indexBufferMemory = nullptr;
+	this->swapChainCaptureSupported = false;
+	this->geometryPool = nullptr;
+	this->quadMeshId = 0;
 	this->descriptorPool = VK_NULL_HANDLE;
 	this->textureImage = VK_NULL_HANDLE;
 	this->textureImageMemory = nullptr;
 	this->textureImageView = VK_NULL_HANDLE;
 	this->textureSampler = VK_NULL_HANDLE;
+	this->dynamicRenderingEnabled = false;
+	this->dynamicRenderingExtensionRequired = false;
+	this->pfnCmdBeginRendering = nullptr;
+	this->pfnCmdEndRendering = nullptr;
+	this->timelineSemaphoreEnabled = false;
+	this->timelineSemaphoreExtensionRequired = false;
+	this->pfnWaitSemaphores = nullptr;
+	this->pfnGetSemaphoreCounterValue = nullptr;
+	this->meshShaderEnabled = false;
+	this->pfnCmdDrawMeshTasks = nullptr;
+	this->frameTimelineSemaphore = VK_NULL_HANDLE;
+	this->particleSystem = nullptr;
+	this->spriteBatch = nullptr;
+	this->objectRenderer = nullptr;
+	this->sceneRenderer = nullptr;
+	this->lodRenderer = nullptr;
+	this->meshletRenderer = nullptr;
+	this->spriteAtlas = nullptr;
+	this->spriteResidency = nullptr;
+	this->frameCapture = nullptr;
+	this->performanceHud = nullptr;
+	this->dynamicResolution = nullptr;
+	this->pipelineCache = nullptr;
+	this->debugLog = nullptr;
+	this->memoryTracker = nullptr;
+	this->threadPool = nullptr;
+	this->texturePixels = nullptr;
+	this->textureWidth = 0;
+	this->textureHeight = 0;
+	this->swapChainSurfaceFormat = VkSurfaceFormatKHR{};
 
 	::memset(&this->debugUtilsMessengerCreateInfo, 0, sizeof(VkDebugUtilsMessengerCreateInfoEXT));
 	this->debugUtilsMessengerCreateInfo.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_MESSENGER_CREATE_INFO_EXT;
@@ -148,7 +224,13 @@ void Application::Run()
 {
 	this->InitWindow();
 	this->InitVulkan();
-	this->MainLoop();
+
+	// VULKAN_TUTORIAL_RENDER_BATCH=1000 renders that many images offscreen and exits, rather than running interactively.
+	if (ReadEnvironmentSetting("VULKAN_TUTORIAL_RENDER_BATCH", "0") != "0")
+		this->RenderBatch();
+	else
+		this->MainLoop();
+
 	this->Cleanup();
 }
 
@@ -160,32 +242,372 @@ void Application::InitWindow()
 	this->window = glfwCreateWindow(WINDOW_WIDTH, WINDOW_HEIGHT, "Vulkan Tutorial", nullptr, nullptr);
 	glfwSetWindowUserPointer(this->window, this);
 	glfwSetFramebufferSizeCallback(this->window, &FrameBufferResizeCallback);
+	glfwSetKeyCallback(this->window, &KeyCallback);
 }
 
 void Application::InitVulkan()
 {
-	this->CreateInstance();
-	this->SetupDebugMessenger();
-	this->CreateSurface();	// Do this before selecting GPU, because the surface capabilities can influence our GPU choice.
-	this->PickPhsyicalDevice();
-	this->CreateLogicalDevice();
-	this->CreateSwapChain();
-	this->CreateImageViews();
-	this->CreateRenderPass();
-	this->CreateDescriptorSetLayout();
-	this->CreateGraphicsPipeline();
-	this->CreateFramebuffers();
-	this->CreateCommandPools();
-	this->CreateTextureImage();
-	this->CreateTextureImageView();
-	this->CreateTextureSampler();
-	this->CreateVertexBuffer();
-	this->CreateIndexBuffer();
-	this->CreateUniformBuffer();
-	this->CreateDescriptorPool();
-	this->CreateDescriptorSets();
-	this->CreateCommandBuffers();
-	this->CreateSyncObjects();
+	// Before the instance, since the messenger is chained into its creation too.
+	if (enableValidationLayers)
+		this->StartDebugLog();
+
+	// VULKAN_TUTORIAL_CALL_COUNTERS=1 counts the Vulkan calls we make, per frame.
+	VulkanCounters::SetEnabled(ReadEnvironmentSetting("VULKAN_TUTORIAL_CALL_COUNTERS", "0") != "0");
+
+	this->threadPool = new ThreadPool(ThreadPool::DefaultThreadCount());
+
+	// Startup is expressed as a dependency graph rather than a fixed sequence, so that things like decoding the texture
+	// and reading SPIR-V off disk can start before we even have a device, and pipeline creation can happen while the
+	// swap-chain is being set up.  Beyond the obvious data dependencies, note that tasks sharing a command pool or queue
+	// (the single-time-command uploads) must be chained, since those are externally synchronized objects, and that
+	// anything calling into GLFW has to stay on the main thread.
+	TaskGraph taskGraph;
+
+	auto loadTextureImage = taskGraph.AddTask("LoadTextureImage", [this]() { this->LoadTextureImage(); });
+	auto loadShaderFiles = taskGraph.AddTask("LoadShaderFiles", [this]() { this->LoadShaderFiles(); });
+	auto createInstance = taskGraph.AddTask("CreateInstance", [this]() { this->CreateInstance(); }, {}, true);
+	auto setupDebugMessenger = taskGraph.AddTask("SetupDebugMessenger", [this]() { this->SetupDebugMessenger(); }, { createInstance });
+	auto createSurface = taskGraph.AddTask("CreateSurface", [this]() { this->CreateSurface(); }, { createInstance }, true);
+	// Do this after creating the surface, because the surface capabilities can influence our GPU choice.
+	auto pickPhysicalDevice = taskGraph.AddTask("PickPhysicalDevice", [this]() { this->PickPhsyicalDevice(); }, { createSurface, setupDebugMessenger });
+	auto createLogicalDevice = taskGraph.AddTask("CreateLogicalDevice", [this]() { this->CreateLogicalDevice(); }, { pickPhysicalDevice });
+	auto chooseSurfaceFormat = taskGraph.AddTask("ChooseSwapChainSurfaceFormat", [this]() { this->ChooseSwapChainSurfaceFormat(); }, { pickPhysicalDevice });
+	auto createSwapChain = taskGraph.AddTask("CreateSwapChain", [this]() { this->CreateSwapChain(); }, { createLogicalDevice, chooseSurfaceFormat }, true);
+	auto createImageViews = taskGraph.AddTask("CreateImageViews", [this]() { this->CreateImageViews(); }, { createSwapChain });
+	auto createRenderPass = taskGraph.AddTask("CreateRenderPass", [this]() { if (!this->dynamicRenderingEnabled) this->CreateRenderPass(); }, { createLogicalDevice, chooseSurfaceFormat });
+	taskGraph.AddTask("CreateFramebuffers", [this]() { if (!this->dynamicRenderingEnabled) this->CreateFramebuffers(); }, { createImageViews, createRenderPass });
+	auto createDescriptorSetLayout = taskGraph.AddTask("CreateDescriptorSetLayout", [this]() { this->CreateDescriptorSetLayout(); }, { createLogicalDevice });
+	auto createPipelineCache = taskGraph.AddTask("CreatePipelineCache", [this]() { this->CreatePipelineCache(); }, { createLogicalDevice });
+	taskGraph.AddTask("CreateGraphicsPipeline", [this]() { this->CreateGraphicsPipeline(); }, { loadShaderFiles, createRenderPass, createDescriptorSetLayout, createPipelineCache });
+	auto createCommandPools = taskGraph.AddTask("CreateCommandPools", [this]() { this->CreateCommandPools(); }, { createLogicalDevice });
+	auto createTextureImage = taskGraph.AddTask("CreateTextureImage", [this]() { this->CreateTextureImage(); }, { loadTextureImage, createCommandPools });
+	auto createTextureImageView = taskGraph.AddTask("CreateTextureImageView", [this]() { this->CreateTextureImageView(); }, { createTextureImage });
+	auto createTextureSampler = taskGraph.AddTask("CreateTextureSampler", [this]() { this->CreateTextureSampler(); }, { createLogicalDevice });
+	auto createGeometryPool = taskGraph.AddTask("CreateGeometryPool", [this]() { this->CreateGeometryPool(); }, { createCommandPools });
+	auto createUniformBuffer = taskGraph.AddTask("CreateUniformBuffer", [this]() { this->CreateUniformBuffer(); }, { createLogicalDevice });
+	auto createDescriptorPool = taskGraph.AddTask("CreateDescriptorPool", [this]() { this->CreateDescriptorPool(); }, { createLogicalDevice });
+	taskGraph.AddTask("CreateDescriptorSets", [this]() { this->CreateDescriptorSets(); }, { createDescriptorSetLayout, createTextureImageView, createTextureSampler, createUniformBuffer, createDescriptorPool });
+	auto createCommandBuffers = taskGraph.AddTask("CreateCommandBuffers", [this]() { this->CreateCommandBuffers(); }, { createTextureImage });		// Same graphics pool as the texture upload.
+	taskGraph.AddTask("CreateSyncObjects", [this]() { this->CreateSyncObjects(); }, { createLogicalDevice });
+	taskGraph.AddTask("CreateParticleSystem", [this]() { this->CreateParticleSystem(); }, { createRenderPass, createCommandPools });
+	taskGraph.AddTask("CreateObjectRenderer", [this]() { this->CreateObjectRenderer(); }, { loadShaderFiles, createRenderPass, createTextureImageView, createTextureSampler });
+	taskGraph.AddTask("CreateSceneRenderer", [this]() { this->CreateSceneRenderer(); }, { loadShaderFiles, createRenderPass, createTextureImageView, createTextureSampler, createGeometryPool, createPipelineCache });		// The quad goes into its indirect draw.
+	auto createSpriteBatch = taskGraph.AddTask("CreateSpriteBatch", [this]() { this->CreateSpriteBatch(); }, { createRenderPass, createGeometryPool, createTextureImageView, createTextureSampler, createCommandBuffers, createPipelineCache });		// Same transfer pool and queue as the geometry pool, and the atlas uses the graphics pool.
+	auto createLodRenderer = taskGraph.AddTask("CreateLodRenderer", [this]() { this->CreateLodRenderer(); }, { createRenderPass, createSpriteBatch });		// Same transfer pool and queue again, and its mesh goes into the geometry pool.
+	taskGraph.AddTask("CreateMeshletRenderer", [this]() { this->CreateMeshletRenderer(); }, { createRenderPass, createLodRenderer, createPipelineCache });		// And again.
+	taskGraph.AddTask("CreatePerformanceHud", [this]() { this->CreatePerformanceHud(); }, { createRenderPass, createSpriteBatch });		// Same graphics pool as the sprite atlas.
+	taskGraph.AddTask("CreateDynamicResolution", [this]() { this->CreateDynamicResolution(); }, { createRenderPass, createImageViews, createPipelineCache });
+
+	// VULKAN_TUTORIAL_SERIAL_STARTUP=1 runs the same graph on this thread alone, for comparison.
+	bool serialStartup = ReadEnvironmentSetting("VULKAN_TUTORIAL_SERIAL_STARTUP", "0") != "0";
+	taskGraph.Run(serialStartup ? nullptr : this->threadPool);
+	taskGraph.PrintTimings(std::cout);
+
+	// Whatever pipelines were asked for during startup but not needed yet get compiled now, all together, rather than
+	// one at a time the first time each is drawn with.  VULKAN_TUTORIAL_PIPELINE_PREWARM=0 leaves them to compile lazily.
+	if (ReadEnvironmentSetting("VULKAN_TUTORIAL_PIPELINE_PREWARM", "1") != "0")
+		this->pipelineCache->Prewarm(serialStartup ? nullptr : this->threadPool);
+
+	this->CreateFrameCapture();
+
+	VulkanCounters::EndStartup(std::cout);
+}
+
+void Application::CreateFrameCapture()
+{
+	if (!this->swapChainCaptureSupported)
+	{
+		std::cout << "Swap-chain images can't be copied from on this device, so there's no frame capture." << std::endl;
+		return;
+	}
+
+	// Captures are written as <prefix><frame number>.png.  VULKAN_TUTORIAL_CAPTURE_SEQUENCE=300 captures that many
+	// frames from the start, without having to press anything.
+	this->frameCapture = new FrameCapture(this, ReadEnvironmentSetting("VULKAN_TUTORIAL_CAPTURE_PATH", "capture_"));
+	this->frameCapture->Create();
+
+	uint32_t sequenceFrames = (uint32_t)std::strtoul(ReadEnvironmentSetting("VULKAN_TUTORIAL_CAPTURE_SEQUENCE", "0").c_str(), nullptr, 10);
+	if (sequenceFrames > 0)
+		this->frameCapture->StartSequence(sequenceFrames);
+}
+
+void Application::CreatePerformanceHud()
+{
+	// Off unless asked for with VULKAN_TUTORIAL_HUD=1, in which case it costs whatever it says it does.
+	if (ReadEnvironmentSetting("VULKAN_TUTORIAL_HUD", "0") == "0")
+		return;
+
+	// It shows the call counters, so they have to be counting.
+	VulkanCounters::SetEnabled(true);
+
+	this->performanceHud = new PerformanceHud(this);
+	this->performanceHud->Create();
+}
+
+void Application::CreateDynamicResolution()
+{
+	// Off unless given a GPU budget for the scene in milliseconds, e.g. VULKAN_TUTORIAL_DYNAMIC_RESOLUTION=8.
+	float targetMilliseconds = (float)std::strtod(ReadEnvironmentSetting("VULKAN_TUTORIAL_DYNAMIC_RESOLUTION", "0").c_str(), nullptr);
+	if (targetMilliseconds <= 0.0f)
+		return;
+
+	// It's steered by timestamps, so without them there's nothing to go on.
+	uint32_t queueFamilyCount = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(this->physicalDevice, &queueFamilyCount, nullptr);
+	std::vector<VkQueueFamilyProperties> queueFamiliesArray(queueFamilyCount);
+	vkGetPhysicalDeviceQueueFamilyProperties(this->physicalDevice, &queueFamilyCount, queueFamiliesArray.data());
+
+	QueueFamilyIndices indices = this->FindQueueFamilies(this->physicalDevice);
+	if (queueFamiliesArray[indices.graphicsFamily.value()].timestampValidBits == 0)
+	{
+		std::cout << "The graphics queue has no timestamps, so there's no dynamic resolution." << std::endl;
+		return;
+	}
+
+	this->dynamicResolution = new DynamicResolution(this, targetMilliseconds);
+	this->dynamicResolution->Create();
+}
+
+void Application::CreateParticleSystem()
+{
+	// Off unless asked for, e.g. VULKAN_TUTORIAL_PARTICLE_COUNT=2000000.
+	uint32_t particleCount = (uint32_t)std::strtoul(ReadEnvironmentSetting("VULKAN_TUTORIAL_PARTICLE_COUNT", "0").c_str(), nullptr, 10);
+	if (particleCount == 0)
+		return;
+
+	this->particleSystem = new ParticleSystem(this, particleCount);
+	this->particleSystem->Create();
+}
+
+void Application::CreateObjectRenderer()
+{
+	// Off unless asked for, e.g. VULKAN_TUTORIAL_OBJECT_COUNT=100000.
+	uint32_t objectCount = (uint32_t)std::strtoul(ReadEnvironmentSetting("VULKAN_TUTORIAL_OBJECT_COUNT", "0").c_str(), nullptr, 10);
+	if (objectCount == 0)
+		return;
+
+	this->objectRenderer = new ObjectRenderer(this, objectCount);
+	this->objectRenderer->Create();
+}
+
+void Application::CreateSceneRenderer()
+{
+	// Off unless asked for, e.g. VULKAN_TUTORIAL_SCENE_NODES=200000.  VULKAN_TUTORIAL_SCENE_ANIMATED is the percentage
+	// of subtrees that move every frame; the rest stay put and cost nothing after the first frame.
+	uint32_t nodeCount = (uint32_t)std::strtoul(ReadEnvironmentSetting("VULKAN_TUTORIAL_SCENE_NODES", "0").c_str(), nullptr, 10);
+	if (nodeCount == 0)
+		return;
+
+	uint32_t animatedPercent = (uint32_t)std::strtoul(ReadEnvironmentSetting("VULKAN_TUTORIAL_SCENE_ANIMATED", "10").c_str(), nullptr, 10);
+
+	// CPU frustum culling of the scene nodes is on by default; VULKAN_TUTORIAL_SCENE_CULLING=0 draws everything.
+	bool cullingEnabled = ReadEnvironmentSetting("VULKAN_TUTORIAL_SCENE_CULLING", "1") != "0";
+
+	// GPU occlusion culling on top of that is off unless asked for with VULKAN_TUTORIAL_SCENE_OCCLUSION=1.  It only has
+	// something to do when things are in front of each other, which VULKAN_TUTORIAL_SCENE_LAYERS=8 (say) arranges.
+	bool occlusionEnabled = ReadEnvironmentSetting("VULKAN_TUTORIAL_SCENE_OCCLUSION", "0") != "0";
+	uint32_t layerCount = (uint32_t)std::strtoul(ReadEnvironmentSetting("VULKAN_TUTORIAL_SCENE_LAYERS", "1").c_str(), nullptr, 10);
+
+	if (occlusionEnabled && !DepthPyramid::IsSupported(this))
+	{
+		std::cout << "The depth format for occlusion culling isn't supported, so there's no occlusion culling." << std::endl;
+		occlusionEnabled = false;
+	}
+
+	this->sceneRenderer = new SceneRenderer(this, nodeCount, animatedPercent, layerCount, cullingEnabled, occlusionEnabled);
+	this->sceneRenderer->Create();
+}
+
+void Application::CreateLodRenderer()
+{
+	// Off unless asked for, e.g. VULKAN_TUTORIAL_LOD_OBJECTS=20000.
+	uint32_t objectCount = (uint32_t)std::strtoul(ReadEnvironmentSetting("VULKAN_TUTORIAL_LOD_OBJECTS", "0").c_str(), nullptr, 10);
+	if (objectCount == 0)
+		return;
+
+	this->lodRenderer = new LodRenderer(this, objectCount);
+	this->lodRenderer->Create();
+}
+
+void Application::CreateMeshletRenderer()
+{
+	// Off unless asked for, e.g. VULKAN_TUTORIAL_MESHLET_OBJECTS=16.  VULKAN_TUTORIAL_MESHLET_CULLING=0 draws every
+	// cluster, for comparison, and VULKAN_TUTORIAL_MESH_SHADERS=0 takes the compute path even where mesh shaders work.
+	uint32_t objectCount = (uint32_t)std::strtoul(ReadEnvironmentSetting("VULKAN_TUTORIAL_MESHLET_OBJECTS", "0").c_str(), nullptr, 10);
+	if (objectCount == 0)
+		return;
+
+	bool cullingEnabled = ReadEnvironmentSetting("VULKAN_TUTORIAL_MESHLET_CULLING", "1") != "0";
+	bool meshShadersEnabled = this->meshShaderEnabled && ReadEnvironmentSetting("VULKAN_TUTORIAL_MESH_SHADERS", "1") != "0";
+
+	this->meshletRenderer = new MeshletRenderer(this, objectCount, cullingEnabled, meshShadersEnabled);
+	this->meshletRenderer->Create();
+}
+
+void Application::CreateSpriteBatch()
+{
+	// Off unless asked for, e.g. VULKAN_TUTORIAL_SPRITE_COUNT=500000.
+	uint32_t spriteCount = (uint32_t)std::strtoul(ReadEnvironmentSetting("VULKAN_TUTORIAL_SPRITE_COUNT", "0").c_str(), nullptr, 10);
+	if (spriteCount == 0)
+		return;
+
+	this->spriteBatch = new SpriteBatch(this, spriteCount);
+	this->spriteBatch->Create();
+	this->spriteBatch->RegisterTexture(this->textureImageView, this->textureSampler);
+
+	// VULKAN_TUTORIAL_SPRITE_ATLAS=1 has the sprites draw from an atlas of lots of little images instead.
+	if (ReadEnvironmentSetting("VULKAN_TUTORIAL_SPRITE_ATLAS", "0") != "0")
+		this->CreateSpriteAtlas();
+
+	// VULKAN_TUTORIAL_RESIDENT_TEXTURES=32 has them cycle through that many big textures, more than might fit, instead.
+	if (ReadEnvironmentSetting("VULKAN_TUTORIAL_RESIDENT_TEXTURES", "0") != "0")
+		this->CreateSpriteResidency();
+
+	// Scatter the sprites across the window with random velocities (in pixels per second).
+	this->spriteMotionArray.resize(spriteCount);
+	uint32_t seed = 0x9E3779B9;
+	auto random = [&seed]() { seed = seed * 1664525 + 1013904223; return float(seed >> 8) / float(1 << 24); };
+	for (glm::vec4& motion : this->spriteMotionArray)
+		motion = glm::vec4(random() * WINDOW_WIDTH, random() * WINDOW_HEIGHT, (random() - 0.5f) * 200.0f, (random() - 0.5f) * 200.0f);
+}
+
+void Application::CreateSpriteAtlas()
+{
+	// Make up a few hundred small images of all sizes: discs with soft edges, some of them checkered.
+	this->spriteAtlas = new TextureAtlas(this, SPRITE_ATLAS_LAYER_SIZE, SPRITE_ATLAS_PADDING, SPRITE_ATLAS_MIP_LEVELS);
+
+	uint32_t seed = 0x2545F491;
+	auto random = [&seed]() { seed = seed * 1664525 + 1013904223; return seed >> 8; };
+	std::vector<uint8_t> pixels;
+	for (uint32_t j = 0; j < SPRITE_ATLAS_IMAGE_COUNT; j++)
+	{
+		uint32_t width = 8 + random() % 41;
+		uint32_t height = 8 + random() % 41;
+		uint32_t color = random();
+		bool checkered = (j % 3 == 0);
+
+		pixels.resize(4 * width * height);
+		for (uint32_t y = 0; y < height; y++)
+		{
+			for (uint32_t x = 0; x < width; x++)
+			{
+				float dx = (float(x) + 0.5f) / float(width) * 2.0f - 1.0f;
+				float dy = (float(y) + 0.5f) / float(height) * 2.0f - 1.0f;
+				float alpha = glm::clamp((1.0f - std::sqrt(dx * dx + dy * dy)) * 8.0f, 0.0f, 1.0f);
+				float shade = (checkered && ((x / 4 + y / 4) & 1)) ? 0.5f : 1.0f;
+
+				uint8_t* pixel = &pixels[4 * (y * width + x)];
+				pixel[0] = uint8_t(float(color & 0xFF) * shade);
+				pixel[1] = uint8_t(float((color >> 8) & 0xFF) * shade);
+				pixel[2] = uint8_t(float((color >> 16) & 0xFF) * shade);
+				pixel[3] = uint8_t(alpha * 255.0f);
+			}
+		}
+
+		this->spriteAtlas->AddImage(pixels.data(), width, height);
+	}
+
+	this->spriteAtlas->Build();
+
+	// Each layer is a texture of its own as far as the sprite batch is concerned, so sprites only break batches when
+	// they come from different layers, rather than from different images.
+	for (uint32_t layer = 0; layer < this->spriteAtlas->GetLayerCount(); layer++)
+		this->spriteAtlasTextureIds.push_back(this->spriteBatch->RegisterTexture(this->spriteAtlas->GetLayerView(layer), this->spriteAtlas->GetSampler()));
+}
+
+void Application::CreateSpriteResidency()
+{
+	// The budget is worked out from the device's own unless given, e.g. VULKAN_TUTORIAL_TEXTURE_BUDGET_MB=16.
+	uint32_t textureCount = (uint32_t)std::strtoul(ReadEnvironmentSetting("VULKAN_TUTORIAL_RESIDENT_TEXTURES", "0").c_str(), nullptr, 10);
+	VkDeviceSize budgetBytes = VkDeviceSize(std::strtoul(ReadEnvironmentSetting("VULKAN_TUTORIAL_TEXTURE_BUDGET_MB", "0").c_str(), nullptr, 10)) << 20;
+
+	this->spriteResidency = new TextureResidency(this, budgetBytes);
+	this->spriteResidency->Create(this->spriteBatch->GetDescriptorSetLayout(), textureCount);
+
+	// Stand-ins for textures off disk: each one is generated again, from its seed, whenever it's reloaded.
+	for (uint32_t j = 0; j < textureCount; j++)
+	{
+		uint32_t residentId = this->spriteResidency->AddTexture([j](uint32_t& width, uint32_t& height, std::vector<uint8_t>& pixels)
+		{
+			width = SPRITE_RESIDENT_TEXTURE_SIZE;
+			height = SPRITE_RESIDENT_TEXTURE_SIZE;
+			pixels.resize(4 * width * height);
+
+			uint32_t color = (j + 1) * 0x9E3779B9;
+			uint32_t stripe = 8 + (j % 5) * 8;
+			for (uint32_t y = 0; y < height; y++)
+			{
+				for (uint32_t x = 0; x < width; x++)
+				{
+					float shade = (((x + y) / stripe) & 1) ? 0.4f : 1.0f;
+					uint8_t* pixel = &pixels[4 * (y * width + x)];
+					pixel[0] = uint8_t(float(color & 0xFF) * shade);
+					pixel[1] = uint8_t(float((color >> 8) & 0xFF) * shade);
+					pixel[2] = uint8_t(float((color >> 16) & 0xFF) * shade);
+					pixel[3] = 255;
+				}
+			}
+		});
+
+		this->spriteResidentTextureIds.push_back(this->spriteBatch->RegisterResidentTexture(this->spriteResidency, residentId));
+	}
+}
+
+void Application::UpdateSprites(float deltaTime, uint32_t i)
+{
+	float width = float(this->swapChainExtent.width);
+	float height = float(this->swapChainExtent.height);
+
+	this->spriteBatch->Begin(i);
+
+	for (uint32_t j = 0; j < (uint32_t)this->spriteMotionArray.size(); j++)
+	{
+		glm::vec4& motion = this->spriteMotionArray[j];
+
+		motion.x += motion.z * deltaTime;
+		motion.y += motion.w * deltaTime;
+		if (motion.x < 0.0f || motion.x > width)
+			motion.z = -motion.z;
+		if (motion.y < 0.0f || motion.y > height)
+			motion.w = -motion.w;
+
+		// Each sprite shows one quarter of the texture, and every eighth one is additive, just to exercise the sorting.
+		float u = float(j & 1) * 0.5f;
+		float v = float((j >> 1) & 1) * 0.5f;
+
+		SpriteBatch::Sprite sprite;
+		sprite.position = glm::vec2(motion.x, motion.y);
+		sprite.size = glm::vec2(8.0f, 8.0f);
+		sprite.rotation = (j % 3 == 0) ? motion.x * 0.01f : 0.0f;
+		sprite.uvRect = glm::vec4(u, v, u + 0.5f, v + 0.5f);
+		sprite.color = 0xFF000000 | (j * 0x9E3779B9 >> 8);
+		sprite.textureId = 0;
+
+		if (this->spriteAtlas)
+		{
+			const TextureAtlas::Region& region = this->spriteAtlas->GetRegion(j % this->spriteAtlas->GetImageCount());
+			sprite.size = glm::vec2(float(region.width), float(region.height));
+			sprite.uvRect = region.uvRect;
+			sprite.color = 0xFFFFFFFF;
+			sprite.textureId = this->spriteAtlasTextureIds[region.layer];
+		}
+
+		// Only a window of the resident textures is in use at any time, and it slides along, so that the ones left
+		// behind go cold and get trimmed or evicted, and come back when the window wraps around to them again.
+		if (!this->spriteResidentTextureIds.empty())
+		{
+			uint32_t textureCount = (uint32_t)this->spriteResidentTextureIds.size();
+			uint32_t windowStart = this->frameCount / SPRITE_RESIDENT_WINDOW_FRAMES;
+			sprite.size = glm::vec2(24.0f, 24.0f);
+			sprite.uvRect = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+			sprite.textureId = this->spriteResidentTextureIds[(windowStart + j % SPRITE_RESIDENT_WINDOW) % textureCount];
+		}
+
+		sprite.blendMode = (j % 8 == 0) ? SpriteBatch::BLEND_ADDITIVE : SpriteBatch::BLEND_ALPHA;
+		this->spriteBatch->Draw(sprite);
+	}
+
+	this->spriteBatch->End();
 }
 
 void Application::MainLoop()
@@ -199,38 +621,183 @@ void Application::MainLoop()
 	vkDeviceWaitIdle(this->logicalDevice);
 }
 
+void Application::RenderBatch()
+{
+	// An orbit of the scene, one image per step.  VULKAN_TUTORIAL_RENDER_TARGETS says how many images are in flight at
+	// once, VULKAN_TUTORIAL_RENDER_SIZE how big they are, and VULKAN_TUTORIAL_RENDER_PNG, if set, is a path prefix to write
+	// them out as PNGs under; without it, the pixels are read back and then just dropped.
+	uint32_t imageCount = (uint32_t)std::strtoul(ReadEnvironmentSetting("VULKAN_TUTORIAL_RENDER_BATCH", "0").c_str(), nullptr, 10);
+	uint32_t targetCount = (uint32_t)std::strtoul(ReadEnvironmentSetting("VULKAN_TUTORIAL_RENDER_TARGETS", "4").c_str(), nullptr, 10);
+	uint32_t imageSize = (uint32_t)std::strtoul(ReadEnvironmentSetting("VULKAN_TUTORIAL_RENDER_SIZE", "256").c_str(), nullptr, 10);
+	std::string pngPrefix = ReadEnvironmentSetting("VULKAN_TUTORIAL_RENDER_PNG", "");
+
+	OffscreenRenderer offscreenRenderer(this, targetCount);
+	offscreenRenderer.Create();
+
+	auto startTime = std::chrono::high_resolution_clock::now();
+
+	for (uint32_t j = 0; j < imageCount; j++)
+	{
+		float angle = 2.0f * glm::pi<float>() * float(j) / float(imageCount);
+		glm::vec3 eye(2.5f * std::cos(angle), 2.5f * std::sin(angle), 2.0f);
+
+		OffscreenRenderer::Job job;
+		job.camera.model = glm::mat4(1.0f);
+		job.camera.view = glm::lookAt(eye, glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+		job.camera.proj = glm::perspective(glm::radians(45.0f), 1.0f, 0.1f, 10.0f);
+		job.camera.proj[1][1] *= -1.0f;
+		job.width = imageSize;
+		job.height = imageSize;
+		if (!pngPrefix.empty())
+			job.pngPath = pngPrefix + std::to_string(j) + ".png";
+
+		offscreenRenderer.Submit(job);
+
+		// Keep the targets busy as we go, rather than queuing everything up first.
+		offscreenRenderer.Update();
+
+		if ((j + 1) % RENDER_BATCH_REPORT_INTERVAL == 0)
+			std::cout << "Render batch: " << offscreenRenderer.GetStatistics().completedCount << " of " << imageCount << " images done" << std::endl;
+	}
+
+	offscreenRenderer.Flush();
+
+	double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - startTime).count();
+	const OffscreenRenderer::Statistics& stats = offscreenRenderer.GetStatistics();
+	std::cout << "Render batch: " << stats.completedCount << " images of " << imageSize << "x" << imageSize << " in " << seconds << " s (" << double(stats.completedCount) / seconds << " images/s), " << stats.peakInFlight << " of " << targetCount << " targets in flight at peak" << std::endl;
+
+	offscreenRenderer.Destroy();
+	vkDeviceWaitIdle(this->logicalDevice);
+}
+
 void Application::Cleanup()
 {
-	vkDestroyBuffer(this->logicalDevice, this->vertexBuffer, nullptr);
-	vkFreeMemory(this->logicalDevice, this->vertexBufferMemory, nullptr);		// Now we can free the memory since it is no longer bound.
+	delete this->threadPool;
+	this->threadPool = nullptr;
+
+	if (this->particleSystem)
+	{
+		this->particleSystem->Destroy();
+		delete this->particleSystem;
+		this->particleSystem = nullptr;
+	}
+
+	if (this->objectRenderer)
+	{
+		this->objectRenderer->Destroy();
+		delete this->objectRenderer;
+		this->objectRenderer = nullptr;
+	}
+
+	if (this->sceneRenderer)
+	{
+		this->sceneRenderer->Destroy();
+		delete this->sceneRenderer;
+		this->sceneRenderer = nullptr;
+	}
+
+	if (this->lodRenderer)
+	{
+		this->lodRenderer->Destroy();
+		delete this->lodRenderer;
+		this->lodRenderer = nullptr;
+	}
+
+	if (this->meshletRenderer)
+	{
+		this->meshletRenderer->Destroy();
+		delete this->meshletRenderer;
+		this->meshletRenderer = nullptr;
+	}
+
+	if (this->spriteBatch)
+	{
+		this->spriteBatch->Destroy();
+		delete this->spriteBatch;
+		this->spriteBatch = nullptr;
+	}
+
+	if (this->spriteResidency)
+	{
+		this->spriteResidency->Destroy();
+		delete this->spriteResidency;
+		this->spriteResidency = nullptr;
+	}
+
+	if (this->spriteAtlas)
+	{
+		this->spriteAtlas->Destroy();
+		delete this->spriteAtlas;
+		this->spriteAtlas = nullptr;
+	}
+
+	if (this->frameCapture)
+	{
+		this->frameCapture->Destroy();
+		delete this->frameCapture;
+		this->frameCapture = nullptr;
+	}
+
+	if (this->performanceHud)
+	{
+		this->performanceHud->Destroy();
+		delete this->performanceHud;
+		this->performanceHud = nullptr;
+	}
 
-	vkDestroyBuffer(this->logicalDevice, this->indexBuffer, nullptr);
-	vkFreeMemory(this->logicalDevice, this->indexBufferMemory, nullptr);
+	if (this->dynamicResolution)
+	{
+		this->dynamicResolution->Destroy();
+		delete this->dynamicResolution;
+		this->dynamicResolution = nullptr;
+	}
+
+	if (this->geometryPool)
+	{
+		this->geometryPool->RemoveMesh(this->quadMeshId);
+		this->geometryPool->Destroy();
+		delete this->geometryPool;
+		this->geometryPool = nullptr;
+	}
 
 	for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
 	{
 		vkDestroySemaphore(this->logicalDevice, this->imageAvailableSemaphore[i], nullptr);
 		vkDestroySemaphore(this->logicalDevice, this->renderFinishedSemaphore[i], nullptr);
-		vkDestroyFence(this->logicalDevice, this->inFlightFence[i], nullptr);
 		vkDestroyBuffer(this->logicalDevice, this->uniformBuffers[i], nullptr);
-		vkFreeMemory(this->logicalDevice, this->uniformBuffersMemory[i], nullptr);
+		this->memoryTracker->Free(this->uniformBuffersMemory[i]);
 	}
 
+	for (VkFence fence : this->inFlightFence)
+		vkDestroyFence(this->logicalDevice, fence, nullptr);
+
+	vkDestroySemaphore(this->logicalDevice, this->frameTimelineSemaphore, nullptr);
+
 	vkDestroyCommandPool(this->logicalDevice, this->graphicsCommandPool, nullptr);
 	vkDestroyCommandPool(this->logicalDevice, this->transferCommandPool, nullptr);
+	vkDestroyCommandPool(this->logicalDevice, this->computeCommandPool, nullptr);
 
 	this->CleanupSwapChain();
 
 	vkDestroySampler(this->logicalDevice, this->textureSampler, nullptr);
 	vkDestroyImageView(this->logicalDevice, this->textureImageView, nullptr);
 	vkDestroyImage(this->logicalDevice, this->textureImage, nullptr);
-	vkFreeMemory(this->logicalDevice, this->textureImageMemory, nullptr);
+	this->memoryTracker->Free(this->textureImageMemory);
 	vkDestroyDescriptorPool(this->logicalDevice, this->descriptorPool, nullptr);
 	vkDestroyDescriptorSetLayout(this->logicalDevice, this->descriptorSetLayout, nullptr);
-	vkDestroyPipeline(this->logicalDevice, this->graphicsPipeline, nullptr);
+	// The pipelines themselves, the main one included, belong to the cache.
+	this->pipelineCache->Destroy();
+	delete this->pipelineCache;
+	this->pipelineCache = nullptr;
+
 	vkDestroyPipelineLayout(this->logicalDevice, this->pipelineLayout, nullptr);
 	vkDestroyRenderPass(this->logicalDevice, this->renderPass, nullptr);
 
+	// Anything still showing up here by now was leaked.
+	this->memoryTracker->Report(std::cout);
+	delete this->memoryTracker;
+	this->memoryTracker = nullptr;
+
 	vkDestroyDevice(this->logicalDevice, nullptr);
 
 	if (enableValidationLayers)
@@ -243,6 +810,14 @@ void Application::Cleanup()
 	vkDestroySurfaceKHR(this->instance, this->surface, nullptr);
 	vkDestroyInstance(this->instance, nullptr);
 
+	// Nothing can call back into it after the instance is gone.
+	if (this->debugLog)
+	{
+		this->debugLog->Stop();
+		delete this->debugLog;
+		this->debugLog = nullptr;
+	}
+
 	glfwDestroyWindow(this->window);
 	glfwTerminate();
 }
@@ -334,12 +909,25 @@ VkImageView Application::CreateImageView(VkImage image, VkFormat format)
 	return imageView;
 }
 
-void Application::CreateTextureImage()
+void Application::LoadTextureImage()
 {
-	int texWidth = 0, texHeight = 0, texChannels = 0;
-	stbi_uc* pixels = stbi_load("texture.jpg", &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
-	if (!pixels)
+	// Just the file I/O and decode, which doesn't need a device and so can get going right away.
+	int texChannels = 0;
+	this->texturePixels = stbi_load("texture.jpg", &this->textureWidth, &this->textureHeight, &texChannels, STBI_rgb_alpha);
+	if (!this->texturePixels)
 		throw new std::runtime_error("Failed to load texture image!");
+}
+
+void Application::LoadShaderFiles()
+{
+	this->vertShaderCode = ReadFile("vert.spv");
+	this->fragShaderCode = ReadFile("frag.spv");
+}
+
+void Application::CreateTextureImage()
+{
+	int texWidth = this->textureWidth, texHeight = this->textureHeight;
+	stbi_uc* pixels = this->texturePixels;
 
 	VkDeviceSize imageSize = texWidth * texHeight * 4;
 
@@ -354,6 +942,7 @@ void Application::CreateTextureImage()
 	vkUnmapMemory(this->logicalDevice, stagingBufferMemory);
 
 	stbi_image_free(pixels);
+	this->texturePixels = nullptr;
 
 	this->CreateImage(texWidth, texHeight, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, this->textureImage, this->textureImageMemory);
 
@@ -367,7 +956,7 @@ void Application::CreateTextureImage()
 	this->TransitionImageLayout(this->textureImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 
 	vkDestroyBuffer(this->logicalDevice, stagingBuffer, nullptr);
-	vkFreeMemory(this->logicalDevice, stagingBufferMemory, nullptr);
+	this->memoryTracker->Free(stagingBufferMemory);
 }
 
 void Application::CreateImage(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory)
@@ -399,7 +988,7 @@ void Application::CreateImage(uint32_t width, uint32_t height, VkFormat format,
 	allocInfo.allocationSize = memRequirements.size;
 	allocInfo.memoryTypeIndex = this->FindMemoryType(memRequirements.memoryTypeBits, properties);
 
-	if (VK_SUCCESS != vkAllocateMemory(this->logicalDevice, &allocInfo, nullptr, &imageMemory))
+	if (VK_SUCCESS != this->memoryTracker->Allocate(allocInfo, "image", imageMemory))
 		throw new std::runtime_error("Failed to allocate image memory!");
 
 	vkBindImageMemory(this->logicalDevice, image, imageMemory, 0);
@@ -469,7 +1058,7 @@ void Application::CreateLogicalDevice()
 	float queuePriority = 1.0f;
 
 	std::vector<VkDeviceQueueCreateInfo> queueCreateInfosArray;
-	std::set<uint32_t> uniqueQueueFamiliesIndexSet = { indices.graphicsFamily.value(), indices.presentFamily.value(), indices.transferFamily.value() };
+	std::set<uint32_t> uniqueQueueFamiliesIndexSet = { indices.graphicsFamily.value(), indices.presentFamily.value(), indices.transferFamily.value(), indices.computeFamily.value() };
 
 	for (uint32_t queueFamilyIndex : uniqueQueueFamiliesIndexSet)
 	{
@@ -484,27 +1073,246 @@ void Application::CreateLogicalDevice()
 	VkPhysicalDeviceFeatures deviceFeatures{};
 	deviceFeatures.samplerAnisotropy = VK_TRUE;
 
+	std::vector<const char*> enabledExtensionsArray(desiredDeviceExtensionsArray.begin(), desiredDeviceExtensionsArray.end());
+
+	// Optional, but it's the only way to find out how much memory we can use before the driver starts paging.
+	bool memoryBudgetEnabled = MemoryTracker::CheckBudgetSupport(this->physicalDevice);
+	if (memoryBudgetEnabled)
+		enabledExtensionsArray.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+
+	this->dynamicRenderingEnabled = this->CheckDynamicRenderingSupport(this->physicalDevice, this->dynamicRenderingExtensionRequired);
+	if (this->dynamicRenderingEnabled && this->dynamicRenderingExtensionRequired)
+		enabledExtensionsArray.push_back(VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME);
+
+	this->timelineSemaphoreEnabled = this->CheckTimelineSemaphoreSupport(this->physicalDevice, this->timelineSemaphoreExtensionRequired);
+	if (this->timelineSemaphoreEnabled && this->timelineSemaphoreExtensionRequired)
+		enabledExtensionsArray.push_back(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+
+	VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timelineSemaphoreFeatures{};
+	timelineSemaphoreFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR;
+	timelineSemaphoreFeatures.timelineSemaphore = VK_TRUE;
+
+	VkPhysicalDeviceDynamicRenderingFeaturesKHR dynamicRenderingFeatures{};
+	dynamicRenderingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR;
+	dynamicRenderingFeatures.dynamicRendering = VK_TRUE;
+
+	// Only ever an extension, and only the meshlet renderer uses it.
+	this->meshShaderEnabled = this->CheckMeshShaderSupport(this->physicalDevice);
+	if (this->meshShaderEnabled)
+		enabledExtensionsArray.push_back(VK_NV_MESH_SHADER_EXTENSION_NAME);
+
+	VkPhysicalDeviceMeshShaderFeaturesNV meshShaderFeatures{};
+	meshShaderFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_FEATURES_NV;
+	meshShaderFeatures.taskShader = VK_TRUE;
+	meshShaderFeatures.meshShader = VK_TRUE;
+
+	// Chain in whichever of the optional features we're using.
+	void* featuresChain = nullptr;
+	if (this->timelineSemaphoreEnabled)
+	{
+		timelineSemaphoreFeatures.pNext = featuresChain;
+		featuresChain = &timelineSemaphoreFeatures;
+	}
+
+	if (this->dynamicRenderingEnabled)
+	{
+		dynamicRenderingFeatures.pNext = featuresChain;
+		featuresChain = &dynamicRenderingFeatures;
+	}
+
+	if (this->meshShaderEnabled)
+	{
+		meshShaderFeatures.pNext = featuresChain;
+		featuresChain = &meshShaderFeatures;
+	}
+
 	VkDeviceCreateInfo createInfo{};
 	createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+	createInfo.pNext = featuresChain;
 	createInfo.pQueueCreateInfos = queueCreateInfosArray.data();
 	createInfo.queueCreateInfoCount = (uint32_t)queueCreateInfosArray.size();
 	createInfo.pEnabledFeatures = &deviceFeatures;
-	createInfo.enabledExtensionCount = (uint32_t)desiredDeviceExtensionsArray.size();
-	createInfo.ppEnabledExtensionNames = desiredDeviceExtensionsArray.data();
+	createInfo.enabledExtensionCount = (uint32_t)enabledExtensionsArray.size();
+	createInfo.ppEnabledExtensionNames = enabledExtensionsArray.data();
+
+	if (enableValidationLayers)
+	{
+		// Not really necessary for newest versions of VK.
+		createInfo.enabledLayerCount = (uint32_t)desiredValidationLayersArray.size();
+		createInfo.ppEnabledLayerNames = desiredValidationLayersArray.data();
+	}
+
+	if (VK_SUCCESS != vkCreateDevice(this->physicalDevice, &createInfo, nullptr, &this->logicalDevice))
+		throw new std::runtime_error("Failed to create logical device!");
+
+	vkGetDeviceQueue(this->logicalDevice, indices.graphicsFamily.value(), 0, &this->graphicsQueue);
+	vkGetDeviceQueue(this->logicalDevice, indices.presentFamily.value(), 0, &this->presentQueue);
+	vkGetDeviceQueue(this->logicalDevice, indices.transferFamily.value(), 0, &this->transferQueue);
+	vkGetDeviceQueue(this->logicalDevice, indices.computeFamily.value(), 0, &this->computeQueue);
+
+	this->memoryTracker = new MemoryTracker(this);
+	this->memoryTracker->Initialize(memoryBudgetEnabled);
+
+	if (this->dynamicRenderingEnabled)
+	{
+		// The KHR entry points are only exposed if we enabled the extension.  Otherwise the functionality is core (1.3) and we use the core names.
+		const char* beginName = this->dynamicRenderingExtensionRequired ? "vkCmdBeginRenderingKHR" : "vkCmdBeginRendering";
+		const char* endName = this->dynamicRenderingExtensionRequired ? "vkCmdEndRenderingKHR" : "vkCmdEndRendering";
+		this->pfnCmdBeginRendering = (PFN_vkCmdBeginRenderingKHR)vkGetDeviceProcAddr(this->logicalDevice, beginName);
+		this->pfnCmdEndRendering = (PFN_vkCmdEndRenderingKHR)vkGetDeviceProcAddr(this->logicalDevice, endName);
+		if (this->pfnCmdBeginRendering == nullptr || this->pfnCmdEndRendering == nullptr)
+			throw new std::runtime_error("Failed to load dynamic rendering entry points!");
+	}
+
+	if (this->timelineSemaphoreEnabled)
+	{
+		// Same deal as above: the KHR names with the extension, the core ones (1.2) without.
+		const char* waitName = this->timelineSemaphoreExtensionRequired ? "vkWaitSemaphoresKHR" : "vkWaitSemaphores";
+		const char* counterName = this->timelineSemaphoreExtensionRequired ? "vkGetSemaphoreCounterValueKHR" : "vkGetSemaphoreCounterValue";
+		this->pfnWaitSemaphores = (PFN_vkWaitSemaphoresKHR)vkGetDeviceProcAddr(this->logicalDevice, waitName);
+		this->pfnGetSemaphoreCounterValue = (PFN_vkGetSemaphoreCounterValueKHR)vkGetDeviceProcAddr(this->logicalDevice, counterName);
+		if (this->pfnWaitSemaphores == nullptr || this->pfnGetSemaphoreCounterValue == nullptr)
+			throw new std::runtime_error("Failed to load timeline semaphore entry points!");
+	}
+
+	if (this->meshShaderEnabled)
+	{
+		this->pfnCmdDrawMeshTasks = (PFN_vkCmdDrawMeshTasksNV)vkGetDeviceProcAddr(this->logicalDevice, "vkCmdDrawMeshTasksNV");
+		if (this->pfnCmdDrawMeshTasks == nullptr)
+			throw new std::runtime_error("Failed to load mesh shader entry points!");
+	}
+
+	std::cout << "Rendering path: " << (this->dynamicRenderingEnabled ? "dynamic rendering" : "render pass + framebuffers") << std::endl;
+	std::cout << "Frame pacing: " << (this->timelineSemaphoreEnabled ? "timeline semaphore" : "fence per frame slot") << std::endl;
+}
+
+bool Application::CheckDynamicRenderingSupport(VkPhysicalDevice device, bool& extensionRequired)
+{
+	extensionRequired = false;
+
+	VkPhysicalDeviceProperties properties{};
+	vkGetPhysicalDeviceProperties(device, &properties);
+
+	// We need vkGetPhysicalDeviceFeatures2 to ask about the feature, and the extension's own dependencies
+	// (depth-stencil resolve, create-render-pass-2, etc.) are all core in 1.2, so don't bother below that.
+	if (properties.apiVersion < VK_API_VERSION_1_2)
+		return false;
+
+	if (properties.apiVersion < VK_API_VERSION_1_3)
+	{
+		uint32_t extensionCount = 0;
+		vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+		std::vector<VkExtensionProperties> availableExtensionsArray(extensionCount);
+		vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensionsArray.data());
+
+		bool extensionFound = false;
+		for (const auto& extension : availableExtensionsArray)
+		{
+			if (0 == ::strcmp(extension.extensionName, VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME))
+			{
+				extensionFound = true;
+				break;
+			}
+		}
+
+		if (!extensionFound)
+			return false;
+
+		extensionRequired = true;
+	}
+
+	VkPhysicalDeviceDynamicRenderingFeaturesKHR dynamicRenderingFeatures{};
+	dynamicRenderingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR;
+
+	VkPhysicalDeviceFeatures2 features2{};
+	features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	features2.pNext = &dynamicRenderingFeatures;
+	vkGetPhysicalDeviceFeatures2(device, &features2);
+
+	return dynamicRenderingFeatures.dynamicRendering == VK_TRUE;
+}
+
+bool Application::CheckTimelineSemaphoreSupport(VkPhysicalDevice device, bool& extensionRequired)
+{
+	extensionRequired = false;
+
+	VkPhysicalDeviceProperties properties{};
+	vkGetPhysicalDeviceProperties(device, &properties);
+
+	// Core in 1.2; before that it's an extension, and we need 1.1 for vkGetPhysicalDeviceFeatures2 to ask about it.
+	if (properties.apiVersion < VK_API_VERSION_1_1)
+		return false;
+
+	if (properties.apiVersion < VK_API_VERSION_1_2)
+	{
+		uint32_t extensionCount = 0;
+		vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+		std::vector<VkExtensionProperties> availableExtensionsArray(extensionCount);
+		vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensionsArray.data());
+
+		bool extensionFound = false;
+		for (const auto& extension : availableExtensionsArray)
+		{
+			if (0 == ::strcmp(extension.extensionName, VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME))
+			{
+				extensionFound = true;
+				break;
+			}
+		}
+
+		if (!extensionFound)
+			return false;
+
+		extensionRequired = true;
+	}
+
+	VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timelineSemaphoreFeatures{};
+	timelineSemaphoreFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR;
+
+	VkPhysicalDeviceFeatures2 features2{};
+	features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	features2.pNext = &timelineSemaphoreFeatures;
+	vkGetPhysicalDeviceFeatures2(device, &features2);
+
+	return timelineSemaphoreFeatures.timelineSemaphore == VK_TRUE;
+}
+
+bool Application::CheckMeshShaderSupport(VkPhysicalDevice device)
+{
+	VkPhysicalDeviceProperties properties{};
+	vkGetPhysicalDeviceProperties(device, &properties);
+
+	// Again, 1.1 for vkGetPhysicalDeviceFeatures2.
+	if (properties.apiVersion < VK_API_VERSION_1_1)
+		return false;
 
-	if (enableValidationLayers)
+	uint32_t extensionCount = 0;
+	vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+	std::vector<VkExtensionProperties> availableExtensionsArray(extensionCount);
+	vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensionsArray.data());
+
+	bool extensionFound = false;
+	for (const auto& extension : availableExtensionsArray)
 	{
-		// Not really necessary for newest versions of VK.
-		createInfo.enabledLayerCount = (uint32_t)desiredValidationLayersArray.size();
-		createInfo.ppEnabledLayerNames = desiredValidationLayersArray.data();
+		if (0 == ::strcmp(extension.extensionName, VK_NV_MESH_SHADER_EXTENSION_NAME))
+		{
+			extensionFound = true;
+			break;
+		}
 	}
 
-	if (VK_SUCCESS != vkCreateDevice(this->physicalDevice, &createInfo, nullptr, &this->logicalDevice))
-		throw new std::runtime_error("Failed to create logical device!");
+	if (!extensionFound)
+		return false;
 
-	vkGetDeviceQueue(this->logicalDevice, indices.graphicsFamily.value(), 0, &this->graphicsQueue);
-	vkGetDeviceQueue(this->logicalDevice, indices.presentFamily.value(), 0, &this->presentQueue);
-	vkGetDeviceQueue(this->logicalDevice, indices.transferFamily.value(), 0, &this->transferQueue);
+	VkPhysicalDeviceMeshShaderFeaturesNV meshShaderFeatures{};
+	meshShaderFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_FEATURES_NV;
+
+	VkPhysicalDeviceFeatures2 features2{};
+	features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	features2.pNext = &meshShaderFeatures;
+	vkGetPhysicalDeviceFeatures2(device, &features2);
+
+	return meshShaderFeatures.taskShader == VK_TRUE && meshShaderFeatures.meshShader == VK_TRUE;
 }
 
 void Application::PickPhsyicalDevice()
@@ -517,20 +1325,77 @@ void Application::PickPhsyicalDevice()
 	std::vector<VkPhysicalDevice> devicesArray(deviceCount);
 	vkEnumeratePhysicalDevices(this->instance, &deviceCount, devicesArray.data());
 
-	VkPhysicalDevice chosenDevice = VK_NULL_HANDLE;
+	// Don't just take the first device that works.  On a machine with an integrated and a discrete GPU (or a software
+	// rasterizer installed) that can easily be the slow one, so rank them all.  See DeviceSelector.cpp for the scoring.
+	std::vector<DeviceProfile> profilesArray;
 	for (const auto& candidateDevice : devicesArray)
+		profilesArray.push_back(this->BuildDeviceProfile(candidateDevice));
+
+	// Recording the profiles lets us replay the choice against the scoring code later without the hardware.
+	std::string dumpFile = ReadEnvironmentSetting("VULKAN_TUTORIAL_DEVICE_DUMP");
+	if (!dumpFile.empty())
 	{
-		if (this->IsDeviceSuitable(candidateDevice))
-		{
-			chosenDevice = candidateDevice;
-			break;
-		}
+		std::ofstream dumpStream(dumpFile);
+		for (const auto& profile : profilesArray)
+			WriteDeviceProfile(dumpStream, profile);
 	}
 
-	if (chosenDevice == VK_NULL_HANDLE)
+	// E.g., VULKAN_TUTORIAL_DEVICE=1 or VULKAN_TUTORIAL_DEVICE=nvidia.
+	int chosenIndex = SelectDevice(profilesArray, ReadEnvironmentSetting("VULKAN_TUTORIAL_DEVICE"), std::cout);
+	if (chosenIndex < 0)
 		throw new std::runtime_error("Failed to find a suitable GPU!");
 
-	this->physicalDevice = chosenDevice;
+	this->physicalDevice = devicesArray[chosenIndex];
+}
+
+DeviceProfile Application::BuildDeviceProfile(VkPhysicalDevice device)
+{
+	DeviceProfile profile;
+
+	VkPhysicalDeviceProperties properties{};
+	vkGetPhysicalDeviceProperties(device, &properties);
+
+	profile.name = properties.deviceName;
+	profile.vendorId = properties.vendorID;
+	profile.deviceId = properties.deviceID;
+	profile.apiVersion = properties.apiVersion;
+	profile.deviceType = (uint32_t)properties.deviceType;
+	profile.maxImageDimension2D = properties.limits.maxImageDimension2D;
+	profile.maxComputeWorkGroupInvocations = properties.limits.maxComputeWorkGroupInvocations;
+	profile.maxPerStageDescriptorSamplers = properties.limits.maxPerStageDescriptorSamplers;
+	profile.timestamps = properties.limits.timestampComputeAndGraphics == VK_TRUE;
+
+	VkPhysicalDeviceMemoryProperties memProperties{};
+	vkGetPhysicalDeviceMemoryProperties(device, &memProperties);
+	for (uint32_t i = 0; i < memProperties.memoryHeapCount; i++)
+		if (0 != (memProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT))
+			profile.deviceLocalHeapBytes = std::max<uint64_t>(profile.deviceLocalHeapBytes, memProperties.memoryHeaps[i].size);
+
+	// Descriptor indexing is core from 1.2, and that's the only place we bother to look for it.
+	if (properties.apiVersion >= VK_API_VERSION_1_2)
+	{
+		VkPhysicalDeviceVulkan12Features vulkan12Features{};
+		vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+
+		VkPhysicalDeviceFeatures2 features2{};
+		features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		features2.pNext = &vulkan12Features;
+		vkGetPhysicalDeviceFeatures2(device, &features2);
+
+		profile.descriptorIndexing = vulkan12Features.descriptorIndexing == VK_TRUE;
+	}
+
+	QueueFamilyIndices indices = this->FindQueueFamilies(device);
+	profile.asyncCompute = indices.computeFamily.has_value() && indices.graphicsFamily.has_value() && indices.computeFamily.value() != indices.graphicsFamily.value();
+
+	bool extensionRequired = false;
+	profile.dynamicRendering = this->CheckDynamicRenderingSupport(device, extensionRequired);
+
+	profile.suitable = this->IsDeviceSuitable(device);
+	if (!profile.suitable)
+		profile.unsuitableReason = "missing queue families, swap-chain support, anisotropic filtering or linear sampling";
+
+	return profile;
 }
 
 bool Application::IsDeviceSuitable(VkPhysicalDevice device)
@@ -572,6 +1437,15 @@ bool Application::CheckDeviceExtensionsSupport(VkPhysicalDevice device)
 	return desiredExtensions.empty();
 }
 
+void Application::ChooseSwapChainSurfaceFormat()
+{
+	// Chosen once, up front, so that the render pass and pipelines can be created without waiting for the swap-chain
+	// and so that recreating the swap-chain can never change the format out from under them.
+	SwapChainSupportDetails swapChainSupport = this->QuerySwapChainSupport(this->physicalDevice);
+	this->swapChainSurfaceFormat = this->ChooseSwapSurfaceFormat(swapChainSupport.formatsArray);
+	this->swapChainImageFormat = this->swapChainSurfaceFormat.format;
+}
+
 VkSurfaceFormatKHR Application::ChooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& availableFormats)
 {
 	for (const auto& availableFormat : availableFormats)
@@ -625,7 +1499,16 @@ void Application::RecreateSwapChain()
 
 	this->CreateSwapChain();
 	this->CreateImageViews();
-	this->CreateFramebuffers();
+
+	// With dynamic rendering we begin rendering directly on the image views, so there are no framebuffers to rebuild here.
+	if (!this->dynamicRenderingEnabled)
+		this->CreateFramebuffers();
+
+	if (this->dynamicResolution)
+		this->dynamicResolution->Resize();
+
+	if (this->sceneRenderer)
+		this->sceneRenderer->Resize();
 }
 
 void Application::CleanupSwapChain()
@@ -649,7 +1532,7 @@ void Application::CreateSwapChain()
 {
 	SwapChainSupportDetails swapChainSupport = this->QuerySwapChainSupport(this->physicalDevice);
 
-	VkSurfaceFormatKHR surfaceFormat = this->ChooseSwapSurfaceFormat(swapChainSupport.formatsArray);
+	VkSurfaceFormatKHR surfaceFormat = this->swapChainSurfaceFormat;
 	VkPresentModeKHR presentMode = this->ChooseSwapPresentMode(swapChainSupport.presentModesArray);
 	this->swapChainExtent = this->ChooseSwapExtent(swapChainSupport.capabilities);
 
@@ -669,6 +1552,11 @@ void Application::CreateSwapChain()
 	createInfo.imageArrayLayers = 1;
 	createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
 
+	// We also copy out of the images for frame capture, where that's allowed.
+	this->swapChainCaptureSupported = 0 != (swapChainSupport.capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
+	if (this->swapChainCaptureSupported)
+		createInfo.imageUsage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+
 	QueueFamilyIndices indices = this->FindQueueFamilies(this->physicalDevice);
 	std::vector<uint32_t> queueFamilyIndices;
 	std::set<uint32_t> uniqueQueueFamiliesIndexSet = { indices.graphicsFamily.value(), indices.presentFamily.value(), indices.transferFamily.value() };
@@ -700,8 +1588,6 @@ void Application::CreateSwapChain()
 	vkGetSwapchainImagesKHR(this->logicalDevice, this->swapChain, &imageCount, nullptr);
 	this->swapChainImages.resize(imageCount);
 	vkGetSwapchainImagesKHR(this->logicalDevice, this->swapChain, &imageCount, swapChainImages.data());
-
-	this->swapChainImageFormat = surfaceFormat.format;
 }
 
 void Application::CreateImageViews()
@@ -711,14 +1597,13 @@ void Application::CreateImageViews()
 		this->swapChainImageViews[i] = this->CreateImageView(this->swapChainImages[i], this->swapChainImageFormat);
 }
 
-void Application::CreateIndexBuffer()
+void Application::CreateGeometryPool()
 {
-	this->CreateGeneralBuffer(indices.data(), sizeof(indices[0]) * indices.size(), VK_BUFFER_USAGE_INDEX_BUFFER_BIT, this->indexBuffer, this->indexBufferMemory);
-}
+	// Every static mesh goes in here, starting with the tutorial quad, rather than into buffers of its own.
+	this->geometryPool = new GeometryPool(this, GEOMETRY_POOL_VERTEX_BYTES, GEOMETRY_POOL_INDEX_BYTES);
+	this->geometryPool->Create();
 
-void Application::CreateVertexBuffer()
-{
-	this->CreateGeneralBuffer(vertices.data(), sizeof(vertices[0]) * vertices.size(), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, this->vertexBuffer, this->vertexBufferMemory);
+	this->quadMeshId = this->geometryPool->AddMesh(vertices.data(), (uint32_t)vertices.size(), sizeof(Vertex), indices.data(), (uint32_t)indices.size());
 }
 
 void Application::CreateGeneralBuffer(const void* bufferData, VkDeviceSize bufferSize, VkBufferUsageFlags usageFlags, VkBuffer& targetBuffer, VkDeviceMemory& targetBufferMemory)
@@ -738,7 +1623,7 @@ void Application::CreateGeneralBuffer(const void* bufferData, VkDeviceSize buffe
 	this->CopyBuffer(stagingBuffer, targetBuffer, bufferSize);
 
 	vkDestroyBuffer(this->logicalDevice, stagingBuffer, nullptr);
-	vkFreeMemory(this->logicalDevice, stagingBufferMemory, nullptr);
+	this->memoryTracker->Free(stagingBufferMemory);
 }
 
 VkCommandBuffer Application::BeginSingleTimeCommands(VkCommandPool commandPool)
@@ -788,13 +1673,25 @@ void Application::CopyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSiz
 	this->EndSingleTimeCommands(commandBuffer, this->transferCommandPool, this->transferQueue);
 }
 
-void Application::CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory)
+void Application::CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory, const std::vector<uint32_t>& concurrentQueueFamilies /*= {}*/)
 {
 	VkBufferCreateInfo bufferInfo{};
 	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
 	bufferInfo.size = size;
 	bufferInfo.usage = usage;
-	bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	// Buffers touched by more than one queue family can either be shared concurrently or have their ownership transferred.
+	// We only ever do the former.
+	if (concurrentQueueFamilies.size() > 1)
+	{
+		bufferInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+		bufferInfo.queueFamilyIndexCount = (uint32_t)concurrentQueueFamilies.size();
+		bufferInfo.pQueueFamilyIndices = concurrentQueueFamilies.data();
+	}
+	else
+	{
+		bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	}
 
 	if (VK_SUCCESS != vkCreateBuffer(this->logicalDevice, &bufferInfo, nullptr, &buffer))
 		throw new std::runtime_error("Failed to create buffer!");
@@ -811,7 +1708,7 @@ void Application::CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMe
 	// single resource (e.g., buffer), because it can only be called a limited number of times.
 	// Rather, you should allocate a big huge chunk up front, and then manage the memory yourself
 	// as you create buffers and other things.  Look at VulkanMemoryAllocator for help doing this.
-	if (VK_SUCCESS != vkAllocateMemory(this->logicalDevice, &allocInfo, nullptr, &bufferMemory))
+	if (VK_SUCCESS != this->memoryTracker->Allocate(allocInfo, BufferUsageTag(usage, properties), bufferMemory))
 		throw new std::runtime_error("Failed to allocate buffer memory!");
 
 	vkBindBufferMemory(this->logicalDevice, buffer, bufferMemory, 0);
@@ -819,141 +1716,29 @@ void Application::CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMe
 
 uint32_t Application::FindMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties)
 {
-	VkPhysicalDeviceMemoryProperties memProperties;
-	vkGetPhysicalDeviceMemoryProperties(this->physicalDevice, &memProperties);
-
-	for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++)
-		if (0 != (typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties)
-			return i;
+	// The memory properties were queried once, when the device was created.
+	return this->memoryTracker->FindMemoryType(typeFilter, properties);
+}
 
-	throw std::runtime_error("failed to find suitable memory type!");
+/*static*/ const char* Application::BufferUsageTag(VkBufferUsageFlags usage, VkMemoryPropertyFlags properties)
+{
+	// Roughly what a buffer is for, going by the most telling of its usage flags.
+	if (usage & VK_BUFFER_USAGE_VERTEX_BUFFER_BIT)
+		return (usage & VK_BUFFER_USAGE_STORAGE_BUFFER_BIT) ? "vertex+storage" : "vertex";
+	if (usage & VK_BUFFER_USAGE_INDEX_BUFFER_BIT)
+		return "index";
+	if (usage & VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT)
+		return "uniform";
+	if (usage & VK_BUFFER_USAGE_STORAGE_BUFFER_BIT)
+		return (properties & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) ? "storage (host)" : "storage";
+	if (usage & VK_BUFFER_USAGE_TRANSFER_SRC_BIT)
+		return "staging";
+
+	return "other";
 }
 
 void Application::CreateGraphicsPipeline()
 {
-	auto vertShaderCode = ReadFile("vert.spv");
-	auto fragShaderCode = ReadFile("frag.spv");
-
-	VkShaderModule vertShaderModule = this->CreateShaderModule(vertShaderCode);
-	VkShaderModule fragShaderModule = this->CreateShaderModule(fragShaderCode);
-
-	VkPipelineShaderStageCreateInfo vertShaderStageInfo{};
-	vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-	vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
-	vertShaderStageInfo.module = vertShaderModule;
-	vertShaderStageInfo.pName = "main";
-
-	VkPipelineShaderStageCreateInfo fragShaderStageInfo{};
-	fragShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-	fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-	fragShaderStageInfo.module = fragShaderModule;
-	fragShaderStageInfo.pName = "main";
-
-	VkPipelineShaderStageCreateInfo shaderStages[] = { vertShaderStageInfo, fragShaderStageInfo };
-
-	std::vector<VkDynamicState> dynamicStatesArray =
-	{
-			VK_DYNAMIC_STATE_VIEWPORT,
-			VK_DYNAMIC_STATE_SCISSOR
-	};
-
-	VkPipelineDynamicStateCreateInfo dynamicState{};
-	dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-	dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStatesArray.size());
-	dynamicState.pDynamicStates = dynamicStatesArray.data();
-
-	VkPipelineViewportStateCreateInfo viewportState{};
-	viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-	viewportState.viewportCount = 1;
-	viewportState.scissorCount = 1;
-
-	/*VkPipelineViewportStateCreateInfo viewportState{};
-	viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-	viewportState.viewportCount = 1;
-	viewportState.pViewports = &viewport;
-	viewportState.scissorCount = 1;
-	viewportState.pScissors = &scissor;*/
-
-	auto bindingDescription = Vertex::GetBindingDescription();
-	auto attributeDescriptions = Vertex::GetAttributeDescriptions();
-
-	VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
-	vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-	vertexInputInfo.vertexBindingDescriptionCount = 1;
-	vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
-	vertexInputInfo.vertexAttributeDescriptionCount = (uint32_t)attributeDescriptions.size();
-	vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
-
-	VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
-	inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-	inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-	inputAssembly.primitiveRestartEnable = VK_FALSE;
-
-	VkViewport viewport{};
-	viewport.x = 0.0f;
-	viewport.y = 0.0f;
-	viewport.width = (float)this->swapChainExtent.width;
-	viewport.height = (float)this->swapChainExtent.height;
-	viewport.minDepth = 0.0f;
-	viewport.maxDepth = 1.0f;
-
-	VkRect2D scissor{};
-	scissor.offset = { 0, 0 };
-	scissor.extent = swapChainExtent;
-
-	VkPipelineRasterizationStateCreateInfo rasterizer{};
-	rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-	rasterizer.depthClampEnable = VK_FALSE;
-	rasterizer.rasterizerDiscardEnable = VK_FALSE;
-	rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
-	rasterizer.lineWidth = 1.0f;
-	rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
-	rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
-	rasterizer.depthBiasEnable = VK_FALSE;
-	rasterizer.depthBiasConstantFactor = 0.0f; // Optional
-	rasterizer.depthBiasClamp = 0.0f; // Optional
-	rasterizer.depthBiasSlopeFactor = 0.0f; // Optional
-
-	VkPipelineMultisampleStateCreateInfo multisampling{};
-	multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-	multisampling.sampleShadingEnable = VK_FALSE;
-	multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
-	multisampling.minSampleShading = 1.0f; // Optional
-	multisampling.pSampleMask = nullptr; // Optional
-	multisampling.alphaToCoverageEnable = VK_FALSE; // Optional
-	multisampling.alphaToOneEnable = VK_FALSE; // Optional
-
-	VkPipelineColorBlendAttachmentState colorBlendAttachment{};
-	colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-	colorBlendAttachment.blendEnable = VK_FALSE;
-	colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_ONE; // Optional
-	colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ZERO; // Optional
-	colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD; // Optional
-	colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE; // Optional
-	colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO; // Optional
-	colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD; // Optional
-
-	/*	PSUEDO CODE for blending...
-	* if (blendEnable) {
-		finalColor.rgb = (srcColorBlendFactor * newColor.rgb) <colorBlendOp> (dstColorBlendFactor * oldColor.rgb);
-		finalColor.a = (srcAlphaBlendFactor * newColor.a) <alphaBlendOp> (dstAlphaBlendFactor * oldColor.a);
-	} else {
-		finalColor = newColor;
-	}
-	finalColor = finalColor & colorWriteMask;
-	*/
-
-	VkPipelineColorBlendStateCreateInfo colorBlending{};
-	colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-	colorBlending.logicOpEnable = VK_FALSE;
-	colorBlending.logicOp = VK_LOGIC_OP_COPY; // Optional
-	colorBlending.attachmentCount = 1;
-	colorBlending.pAttachments = &colorBlendAttachment;
-	colorBlending.blendConstants[0] = 0.0f; // Optional
-	colorBlending.blendConstants[1] = 0.0f; // Optional
-	colorBlending.blendConstants[2] = 0.0f; // Optional
-	colorBlending.blendConstants[3] = 0.0f; // Optional
-
 	// This is for shader uniforms -- variables that can be set dynamically at run-time to change
 	// the behavior of vertex or pixel shaders, such as setting a transform matrix or texture sampler, etc.
 	VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
@@ -965,30 +1750,58 @@ void Application::CreateGraphicsPipeline()
 	if (VK_SUCCESS != vkCreatePipelineLayout(this->logicalDevice, &pipelineLayoutInfo, nullptr, &pipelineLayout))
 		throw new std::runtime_error("Failed to create pipeline!");
 
-	VkGraphicsPipelineCreateInfo pipelineInfo{};
-	pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-	pipelineInfo.stageCount = 2;
-	pipelineInfo.pStages = shaderStages;
-	pipelineInfo.pVertexInputState = &vertexInputInfo;
-	pipelineInfo.pInputAssemblyState = &inputAssembly;
-	pipelineInfo.pViewportState = &viewportState;
-	pipelineInfo.pRasterizationState = &rasterizer;
-	pipelineInfo.pMultisampleState = &multisampling;
-	pipelineInfo.pDepthStencilState = nullptr; // Optional
-	pipelineInfo.pColorBlendState = &colorBlending;
-	pipelineInfo.pDynamicState = &dynamicState;
-	pipelineInfo.layout = this->pipelineLayout;
-	pipelineInfo.renderPass = renderPass;
-	pipelineInfo.subpass = 0;
-	pipelineInfo.basePipelineHandle = VK_NULL_HANDLE; // Optional
-	pipelineInfo.basePipelineIndex = -1; // Optional
-
-	if (vkCreateGraphicsPipelines(this->logicalDevice, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &this->graphicsPipeline) != VK_SUCCESS)
-		throw new std::runtime_error("Failed to create graphics pipeline!");
-
-	// In pipeline creation, the shaders are taken to GPU-specific byte codes, I think.  In any case, we can remove these now.
-	vkDestroyShaderModule(this->logicalDevice, vertShaderModule, nullptr);
-	vkDestroyShaderModule(this->logicalDevice, fragShaderModule, nullptr);
+	// The SPIR-V was already read off disk by LoadShaderFiles.  Everything else about the pipeline is the defaults:
+	// no blending, no depth, back faces culled.  Viewport and scissor are dynamic state, so they're set in
+	// RecordCommandBuffer rather than here, which also means we don't read the swap-chain extent, which may still be
+	// in the middle of being set up on another thread.
+	PipelineState state;
+	state.layout = this->pipelineLayout;
+	state.vertexShader = this->pipelineCache->AddShader(this->vertShaderCode);
+	state.fragmentShader = this->pipelineCache->AddShader(this->fragShaderCode);
+	state.AddVertexBinding(Vertex::GetBindingDescription());
+	for (const VkVertexInputAttributeDescription& attribute : Vertex::GetAttributeDescriptions())
+		state.AddVertexAttribute(attribute);
+	state.colorFormat = this->swapChainImageFormat;
+
+	// Which features the fragment shader has on is picked with VULKAN_TUTORIAL_SHADER_FEATURES, a list of any of
+	// "texture", "color" and "alphatest"; the default is just the texture.
+	std::string features = ReadEnvironmentSetting("VULKAN_TUTORIAL_SHADER_FEATURES", "texture");
+	MainShaderVariant variant;
+	variant.useTexture = features.find("texture") != std::string::npos;
+	variant.useVertexColor = features.find("color") != std::string::npos;
+	variant.alphaTest = features.find("alphatest") != std::string::npos;
+	ApplyShaderVariant(state, variant);
+
+	// We need this one for the very first frame, so there's no point in leaving it for later.
+	this->graphicsPipeline = this->pipelineCache->GetPipeline(state);
+}
+
+void Application::CreatePipelineCache()
+{
+	this->pipelineCache = new PipelineCache(this);
+	this->pipelineCache->Create();
+}
+
+void Application::ConfigurePipelineRenderingInfo(VkGraphicsPipelineCreateInfo& pipelineInfo, VkPipelineRenderingCreateInfoKHR& renderingInfo)
+{
+	if (this->dynamicRenderingEnabled)
+	{
+		// No render pass object here; the pipeline only needs to know the attachment formats it will render into.
+		renderingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR;
+		renderingInfo.colorAttachmentCount = 1;
+		renderingInfo.pColorAttachmentFormats = &this->swapChainImageFormat;
+		renderingInfo.depthAttachmentFormat = VK_FORMAT_UNDEFINED;
+		renderingInfo.stencilAttachmentFormat = VK_FORMAT_UNDEFINED;
+
+		pipelineInfo.pNext = &renderingInfo;
+		pipelineInfo.renderPass = VK_NULL_HANDLE;
+		pipelineInfo.subpass = 0;
+	}
+	else
+	{
+		pipelineInfo.renderPass = this->renderPass;
+		pipelineInfo.subpass = 0;
+	}
 }
 
 void Application::CreateRenderPass()
@@ -1076,6 +1889,14 @@ void Application::CreateCommandPools()
 
 	if (VK_SUCCESS != vkCreateCommandPool(this->logicalDevice, &transferPoolInfo, nullptr, &this->transferCommandPool))
 		throw new std::runtime_error("Failed to create transfer command pool!");
+
+	VkCommandPoolCreateInfo computePoolInfo{};
+	computePoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	computePoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+	computePoolInfo.queueFamilyIndex = queueFamilyIndices.computeFamily.value();
+
+	if (VK_SUCCESS != vkCreateCommandPool(this->logicalDevice, &computePoolInfo, nullptr, &this->computeCommandPool))
+		throw new std::runtime_error("Failed to create compute command pool!");
 }
 
 void Application::CreateCommandBuffers()
@@ -1103,49 +1924,225 @@ void Application::RecordCommandBuffer(VkCommandBuffer givenCommandBuffer, uint32
 	if (VK_SUCCESS != vkBeginCommandBuffer(givenCommandBuffer, &beginInfo))
 		throw new std::runtime_error("Failed to begin recording command buffer!");
 
-	VkRenderPassBeginInfo renderPassInfo{};
-	renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-	renderPassInfo.renderPass = this->renderPass;
-	renderPassInfo.framebuffer = this->swapChainFramebuffers[imageIndex];
-	renderPassInfo.renderArea.offset = { 0, 0 };
-	renderPassInfo.renderArea.extent = this->swapChainExtent;
+	// Bound once for the whole frame.  Everything drawn out of the pool must come before anything that binds vertex or
+	// index buffers of its own (the particles, sprites and HUD), which is the order below anyway.
+	this->geometryPool->Bind(givenCommandBuffer);
 
-	VkClearValue clearColor = { {{0.0f, 0.0f, 0.0f, 1.0f}} };
-	renderPassInfo.clearValueCount = 1;
-	renderPassInfo.pClearValues = &clearColor;
+	if (this->particleSystem)
+		this->particleSystem->RecordGraphicsBegin(givenCommandBuffer, i);
 
-	vkCmdBeginRenderPass(givenCommandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+	if (this->sceneRenderer)
+		this->sceneRenderer->RecordTransfers(givenCommandBuffer, i);
 
-	vkCmdBindPipeline(givenCommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, this->graphicsPipeline);
+	if (this->meshletRenderer)
+		this->meshletRenderer->RecordCull(givenCommandBuffer, i);
+
+	if (this->performanceHud)
+		this->performanceHud->RecordFrameBegin(givenCommandBuffer, i);
+
+	// With dynamic resolution, the scene goes into its own smaller image first, and is scaled up onto the swap-chain
+	// afterwards.  Everything in the scene takes its viewport from RecordScene, so it all lands in the smaller area.
+	// The HUD's pass marks go either side of the scene, the particles and the upscale, so it can show each one.
+	if (this->performanceHud)
+		this->performanceHud->RecordPassBegin(givenCommandBuffer, i, PerformanceHud::PASS_SCENE);
+
+	VkExtent2D sceneExtent = this->swapChainExtent;
+	if (this->dynamicResolution)
+	{
+		this->dynamicResolution->BeginScene(givenCommandBuffer, i);
+		sceneExtent = this->dynamicResolution->GetRenderExtent();
+	}
+	else
+		this->BeginSwapChainRendering(givenCommandBuffer, imageIndex);
+
+	this->RecordScene(givenCommandBuffer, sceneExtent, this->descriptorSets[i]);
+
+	if (this->objectRenderer)
+		this->objectRenderer->RecordDraw(givenCommandBuffer, i);
+
+	if (this->sceneRenderer)
+		this->sceneRenderer->RecordDraw(givenCommandBuffer, i);
+
+	if (this->lodRenderer)
+		this->lodRenderer->RecordDraw(givenCommandBuffer, i);
+
+	if (this->meshletRenderer)
+		this->meshletRenderer->RecordDraw(givenCommandBuffer, i);
+
+	if (this->performanceHud)
+		this->performanceHud->RecordPassEnd(givenCommandBuffer, i, PerformanceHud::PASS_SCENE);
+
+	if (this->particleSystem)
+	{
+		if (this->performanceHud)
+			this->performanceHud->RecordPassBegin(givenCommandBuffer, i, PerformanceHud::PASS_PARTICLES);
+
+		this->particleSystem->RecordDraw(givenCommandBuffer, i);
+
+		if (this->performanceHud)
+			this->performanceHud->RecordPassEnd(givenCommandBuffer, i, PerformanceHud::PASS_PARTICLES);
+	}
+
+	if (this->spriteBatch)
+		this->spriteBatch->RecordDraw(givenCommandBuffer, i);
+
+	if (this->dynamicResolution)
+	{
+		if (this->performanceHud)
+			this->performanceHud->RecordPassBegin(givenCommandBuffer, i, PerformanceHud::PASS_UPSCALE);
+
+		this->dynamicResolution->EndScene(givenCommandBuffer, i);
+		this->BeginSwapChainRendering(givenCommandBuffer, imageIndex);
+		this->dynamicResolution->RecordUpscale(givenCommandBuffer);
 
-	VkBuffer vertexBuffersArray[] = { this->vertexBuffer };
-	VkDeviceSize offsetsArray[] = { 0 };
-	vkCmdBindVertexBuffers(givenCommandBuffer, 0, 1, vertexBuffersArray, offsetsArray);
+		if (this->performanceHud)
+			this->performanceHud->RecordPassEnd(givenCommandBuffer, i, PerformanceHud::PASS_UPSCALE);
+	}
+
+	// On top of everything else, and at full resolution.
+	if (this->performanceHud)
+		this->performanceHud->RecordDraw(givenCommandBuffer, i);
+
+	this->EndSwapChainRendering(givenCommandBuffer, imageIndex);
+
+	if (this->frameCapture)
+		this->frameCapture->RecordCopy(givenCommandBuffer, imageIndex);
+
+	if (this->particleSystem)
+		this->particleSystem->RecordGraphicsEnd(givenCommandBuffer, i);
+
+	if (VK_SUCCESS != vkEndCommandBuffer(givenCommandBuffer))
+		throw new std::runtime_error("Failed to record command buffer!");
+}
 
-	vkCmdBindIndexBuffer(givenCommandBuffer, this->indexBuffer, 0, VK_INDEX_TYPE_UINT16);
+void Application::RecordScene(VkCommandBuffer givenCommandBuffer, VkExtent2D extent, VkDescriptorSet descriptorSet)
+{
+	// Just the textured quad, into whatever we're currently rendering to; the offscreen renderer draws it too.  The
+	// caller has bound the geometry pool.
+	vkCmdBindPipeline(givenCommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, this->graphicsPipeline);
 
 	VkViewport viewport{};
 	viewport.x = 0.0f;
 	viewport.y = 0.0f;
-	viewport.width = static_cast<float>(this->swapChainExtent.width);
-	viewport.height = static_cast<float>(this->swapChainExtent.height);
+	viewport.width = static_cast<float>(extent.width);
+	viewport.height = static_cast<float>(extent.height);
 	viewport.minDepth = 0.0f;
 	viewport.maxDepth = 1.0f;
 	vkCmdSetViewport(givenCommandBuffer, 0, 1, &viewport);
 
 	VkRect2D scissor{};
 	scissor.offset = { 0, 0 };
-	scissor.extent = swapChainExtent;
+	scissor.extent = extent;
 	vkCmdSetScissor(givenCommandBuffer, 0, 1, &scissor);
 
-	vkCmdBindDescriptorSets(givenCommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, this->pipelineLayout, 0, 1, &this->descriptorSets[i], 0, nullptr);
+	vkCmdBindDescriptorSets(givenCommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, this->pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
 
-	vkCmdDrawIndexed(givenCommandBuffer, (uint32_t)indices.size(), 1, 0, 0, 0);
+	const GeometryPool::Mesh& quad = this->geometryPool->GetMesh(this->quadMeshId);
+	vkCmdDrawIndexed(givenCommandBuffer, quad.indexCount, 1, quad.firstIndex, quad.vertexOffset, 0);
+}
 
-	vkCmdEndRenderPass(givenCommandBuffer);
+void Application::BeginSwapChainRendering(VkCommandBuffer givenCommandBuffer, uint32_t imageIndex)
+{
+	VkClearValue clearColor = { {{0.0f, 0.0f, 0.0f, 1.0f}} };
 
-	if (VK_SUCCESS != vkEndCommandBuffer(givenCommandBuffer))
-		throw new std::runtime_error("Failed to record command buffer!");
+	if (this->dynamicRenderingEnabled)
+	{
+		// Without a render pass, nobody does the layout transitions for us, so we do them ourselves.
+		this->RecordSwapChainImageBarrier(givenCommandBuffer, imageIndex, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+
+		VkRenderingAttachmentInfoKHR colorAttachment{};
+		colorAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+		colorAttachment.imageView = this->swapChainImageViews[imageIndex];
+		colorAttachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		colorAttachment.resolveMode = VK_RESOLVE_MODE_NONE;
+		colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+		colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+		colorAttachment.clearValue = clearColor;
+
+		VkRenderingInfoKHR renderingInfo{};
+		renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO_KHR;
+		renderingInfo.renderArea.offset = { 0, 0 };
+		renderingInfo.renderArea.extent = this->swapChainExtent;
+		renderingInfo.layerCount = 1;
+		renderingInfo.colorAttachmentCount = 1;
+		renderingInfo.pColorAttachments = &colorAttachment;
+
+		this->pfnCmdBeginRendering(givenCommandBuffer, &renderingInfo);
+	}
+	else
+	{
+		VkRenderPassBeginInfo renderPassInfo{};
+		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+		renderPassInfo.renderPass = this->renderPass;
+		renderPassInfo.framebuffer = this->swapChainFramebuffers[imageIndex];
+		renderPassInfo.renderArea.offset = { 0, 0 };
+		renderPassInfo.renderArea.extent = this->swapChainExtent;
+		renderPassInfo.clearValueCount = 1;
+		renderPassInfo.pClearValues = &clearColor;
+
+		vkCmdBeginRenderPass(givenCommandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+	}
+}
+
+void Application::EndSwapChainRendering(VkCommandBuffer givenCommandBuffer, uint32_t imageIndex)
+{
+	if (this->dynamicRenderingEnabled)
+	{
+		this->pfnCmdEndRendering(givenCommandBuffer);
+		this->RecordSwapChainImageBarrier(givenCommandBuffer, imageIndex, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+	}
+	else
+	{
+		vkCmdEndRenderPass(givenCommandBuffer);
+	}
+}
+
+void Application::RecordSwapChainImageBarrier(VkCommandBuffer givenCommandBuffer, uint32_t imageIndex, VkImageLayout oldLayout, VkImageLayout newLayout)
+{
+	VkImageMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.oldLayout = oldLayout;
+	barrier.newLayout = newLayout;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = this->swapChainImages[imageIndex];
+	barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	barrier.subresourceRange.baseMipLevel = 0;
+	barrier.subresourceRange.levelCount = 1;
+	barrier.subresourceRange.baseArrayLayer = 0;
+	barrier.subresourceRange.layerCount = 1;
+
+	VkPipelineStageFlags sourceStage;
+	VkPipelineStageFlags destinationStage;
+
+	if (newLayout == VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL)
+	{
+		// The source stage matches the stage DrawFrame waits on the image-available semaphore at, so the transition happens after the acquire.
+		barrier.srcAccessMask = 0;
+		barrier.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+
+		sourceStage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		destinationStage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+	}
+	else if (newLayout == VK_IMAGE_LAYOUT_PRESENT_SRC_KHR)
+	{
+		barrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		barrier.dstAccessMask = 0;
+
+		sourceStage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		destinationStage = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+	}
+	else
+		throw new std::invalid_argument("Unsupported swap-chain layout transition!");
+
+	vkCmdPipelineBarrier(
+		givenCommandBuffer,
+		sourceStage, destinationStage,
+		0,
+		0, nullptr,
+		0, nullptr,
+		1, &barrier
+	);
 }
 
 void Application::CreateSyncObjects()
@@ -1159,17 +2156,102 @@ void Application::CreateSyncObjects()
 
 	this->imageAvailableSemaphore.resize(MAX_FRAMES_IN_FLIGHT);
 	this->renderFinishedSemaphore.resize(MAX_FRAMES_IN_FLIGHT);
-	this->inFlightFence.resize(MAX_FRAMES_IN_FLIGHT);
+	this->frameSlotNumbers.assign(MAX_FRAMES_IN_FLIGHT, 0);
 
+	// The binary semaphores stay either way, since presentation and acquisition only take those.
 	for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
 	{
 		if (vkCreateSemaphore(this->logicalDevice, &semaphoreInfo, nullptr, &this->imageAvailableSemaphore[i]) != VK_SUCCESS ||
-			vkCreateSemaphore(this->logicalDevice, &semaphoreInfo, nullptr, &this->renderFinishedSemaphore[i]) != VK_SUCCESS ||
-			vkCreateFence(this->logicalDevice, &fenceInfo, nullptr, &this->inFlightFence[i]) != VK_SUCCESS)
+			vkCreateSemaphore(this->logicalDevice, &semaphoreInfo, nullptr, &this->renderFinishedSemaphore[i]) != VK_SUCCESS)
 		{
 			throw new std::runtime_error("Failed to create semaphores!");
 		}
 	}
+
+	if (this->timelineSemaphoreEnabled)
+	{
+		// One counter for the whole render loop: every frame signals its own number on it when the GPU is done with it.
+		// It starts at zero, which no frame has, so waiting on a slot that's never been used returns straight away.
+		VkSemaphoreTypeCreateInfoKHR semaphoreTypeInfo{};
+		semaphoreTypeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO_KHR;
+		semaphoreTypeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE_KHR;
+		semaphoreTypeInfo.initialValue = 0;
+
+		VkSemaphoreCreateInfo timelineSemaphoreInfo{};
+		timelineSemaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+		timelineSemaphoreInfo.pNext = &semaphoreTypeInfo;
+
+		if (VK_SUCCESS != vkCreateSemaphore(this->logicalDevice, &timelineSemaphoreInfo, nullptr, &this->frameTimelineSemaphore))
+			throw new std::runtime_error("Failed to create frame timeline semaphore!");
+	}
+	else
+	{
+		this->inFlightFence.resize(MAX_FRAMES_IN_FLIGHT);
+		for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+			if (VK_SUCCESS != vkCreateFence(this->logicalDevice, &fenceInfo, nullptr, &this->inFlightFence[i]))
+				throw new std::runtime_error("Failed to create fences!");
+	}
+}
+
+void Application::WaitForFrameSlot(uint32_t i)
+{
+	// Once this returns, nothing the GPU did for the last frame submitted in slot i is still going on, so everything
+	// belonging to the slot (uniform buffer, command buffer, per-slot vertex buffers and so on) can be rewritten.
+	if (this->timelineSemaphoreEnabled)
+		this->WaitForFrame(this->frameSlotNumbers[i]);
+	else
+		vkWaitForFences(this->logicalDevice, 1, &this->inFlightFence[i], VK_TRUE, UINT64_MAX);
+}
+
+void Application::WaitForFrame(uint64_t frameNumber)
+{
+	if (frameNumber > this->frameCount)
+		throw new std::runtime_error("Can't wait on a frame that hasn't happened yet!");
+
+	if (this->timelineSemaphoreEnabled)
+	{
+		VkSemaphoreWaitInfoKHR waitInfo{};
+		waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO_KHR;
+		waitInfo.semaphoreCount = 1;
+		waitInfo.pSemaphores = &this->frameTimelineSemaphore;
+		waitInfo.pValues = &frameNumber;
+
+		if (VK_SUCCESS != this->pfnWaitSemaphores(this->logicalDevice, &waitInfo, UINT64_MAX))
+			throw new std::runtime_error("Failed to wait on frame timeline semaphore!");
+
+		return;
+	}
+
+	// Without a timeline, the frame is done once the earliest slot submitted at or after it is; frames that were skipped
+	// (the swap-chain being out of date, say) are covered by whichever comes next.  If no slot is that recent, the frame
+	// was waited on before its slot got reused.
+	int earliestSlot = -1;
+	for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+		if (this->frameSlotNumbers[i] >= frameNumber && (earliestSlot < 0 || this->frameSlotNumbers[i] < this->frameSlotNumbers[earliestSlot]))
+			earliestSlot = i;
+
+	if (earliestSlot >= 0)
+		vkWaitForFences(this->logicalDevice, 1, &this->inFlightFence[earliestSlot], VK_TRUE, UINT64_MAX);
+}
+
+uint64_t Application::GetCompletedFrame()
+{
+	// The number of the most recent frame the GPU has finished, without waiting on anything.
+	uint64_t completedFrame = 0;
+
+	if (this->timelineSemaphoreEnabled)
+	{
+		if (VK_SUCCESS != this->pfnGetSemaphoreCounterValue(this->logicalDevice, this->frameTimelineSemaphore, &completedFrame))
+			throw new std::runtime_error("Failed to read frame timeline semaphore!");
+
+		return completedFrame;
+	}
+
+	for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+		if (VK_SUCCESS == vkGetFenceStatus(this->logicalDevice, this->inFlightFence[i]))
+			completedFrame = std::max(completedFrame, this->frameSlotNumbers[i]);
+
+	return completedFrame;
 }
 
 void Application::CreateDescriptorSetLayout()
@@ -1232,38 +2314,41 @@ void Application::CreateDescriptorSets()
 	if (VK_SUCCESS != vkAllocateDescriptorSets(this->logicalDevice, &allocInfo, descriptorSets.data()))
 		throw new std::runtime_error("Failed to allocate descriptor sets!");
 
-	for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
-	{
-		VkDescriptorBufferInfo bufferInfo{};
-		bufferInfo.buffer = uniformBuffers[i];
-		bufferInfo.offset = 0;
-		bufferInfo.range = sizeof(UniformBufferObject);
-
-		VkDescriptorImageInfo imageInfo{};
-		imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-		imageInfo.imageView = this->textureImageView;
-		imageInfo.sampler = this->textureSampler;
-
-		std::array<VkWriteDescriptorSet, 2> descriptorWrites{};
-
-		descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-		descriptorWrites[0].dstSet = descriptorSets[i];
-		descriptorWrites[0].dstBinding = 0;
-		descriptorWrites[0].dstArrayElement = 0;
-		descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-		descriptorWrites[0].descriptorCount = 1;
-		descriptorWrites[0].pBufferInfo = &bufferInfo;
-
-		descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-		descriptorWrites[1].dstSet = descriptorSets[i];
-		descriptorWrites[1].dstBinding = 1;
-		descriptorWrites[1].dstArrayElement = 0;
-		descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-		descriptorWrites[1].descriptorCount = 1;
-		descriptorWrites[1].pImageInfo = &imageInfo;
+	for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+		this->WriteDescriptorSet(i);
+}
 
-		vkUpdateDescriptorSets(this->logicalDevice, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
-	}
+void Application::WriteDescriptorSet(uint32_t i)
+{
+	VkDescriptorBufferInfo bufferInfo{};
+	bufferInfo.buffer = uniformBuffers[i];
+	bufferInfo.offset = 0;
+	bufferInfo.range = sizeof(UniformBufferObject);
+
+	VkDescriptorImageInfo imageInfo{};
+	imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	imageInfo.imageView = this->textureImageView;
+	imageInfo.sampler = this->textureSampler;
+
+	std::array<VkWriteDescriptorSet, 2> descriptorWrites{};
+
+	descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	descriptorWrites[0].dstSet = descriptorSets[i];
+	descriptorWrites[0].dstBinding = 0;
+	descriptorWrites[0].dstArrayElement = 0;
+	descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	descriptorWrites[0].descriptorCount = 1;
+	descriptorWrites[0].pBufferInfo = &bufferInfo;
+
+	descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	descriptorWrites[1].dstSet = descriptorSets[i];
+	descriptorWrites[1].dstBinding = 1;
+	descriptorWrites[1].dstArrayElement = 0;
+	descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	descriptorWrites[1].descriptorCount = 1;
+	descriptorWrites[1].pImageInfo = &imageInfo;
+
+	vkUpdateDescriptorSets(this->logicalDevice, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
 }
 
 void Application::CreateUniformBuffer()
@@ -1285,9 +2370,7 @@ void Application::UpdateUniformBuffer(uint32_t i)
 
 	UniformBufferObject ubo{};
 	ubo.model = glm::rotate(glm::mat4(1.0f), time * glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-	ubo.view = glm::lookAt(glm::vec3(2.0f, 2.0f, 2.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-	ubo.proj = glm::perspective(glm::radians(45.0f), float(swapChainExtent.width) / float(swapChainExtent.height), 0.1f, 10.0f);
-	ubo.proj[1][1] *= -1.0f;		// Clip/projected space is up-side-down from the OpenGL standard.
+	this->GetCameraMatrices(ubo.view, ubo.proj);
 
 	void* data;
 	vkMapMemory(this->logicalDevice, this->uniformBuffersMemory[i], 0, sizeof(ubo), 0, &data);
@@ -1295,16 +2378,68 @@ void Application::UpdateUniformBuffer(uint32_t i)
 	vkUnmapMemory(this->logicalDevice, uniformBuffersMemory[i]);
 }
 
+void Application::GetCameraMatrices(glm::mat4& view, glm::mat4& proj)
+{
+	view = glm::lookAt(glm::vec3(2.0f, 2.0f, 2.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+	proj = glm::perspective(glm::radians(45.0f), float(swapChainExtent.width) / float(swapChainExtent.height), 0.1f, 10.0f);
+	proj[1][1] *= -1.0f;		// Clip/projected space is up-side-down from the OpenGL standard.
+}
+
 void Application::DrawFrame()
 {
 	this->frameCount++;
 
 	uint32_t i = this->frameCount % MAX_FRAMES_IN_FLIGHT;
 
+	auto currentTime = std::chrono::high_resolution_clock::now();
+	float deltaTime = (this->frameCount == 1) ? 0.0f : std::chrono::duration<float, std::chrono::seconds::period>(currentTime - this->lastFrameTime).count();
+	this->lastFrameTime = currentTime;
+
+	// Wait for the last frame in this slot to finish before touching anything of the slot's, its uniform buffer included.
+	this->WaitForFrameSlot(i);
+
 	this->UpdateUniformBuffer(i);
 
-	// Wait for previous frame to finish.  Note that the fence was created signaled, so we don't wait before doing the first ever frame.
-	vkWaitForFences(this->logicalDevice, 1, &this->inFlightFence[i], VK_TRUE, UINT64_MAX);
+	if (this->particleSystem)
+		this->particleSystem->CollectTimings(i);
+
+	if (this->frameCapture)
+		this->frameCapture->Service();
+
+	// The resident textures can rewrite this slot's descriptor sets now, before the sprites get drawn with them.
+	if (this->spriteResidency)
+		this->spriteResidency->Update(i);
+
+	// Safe now that the GPU is done reading this slot's sprite vertices, object matrices and scene staging.
+	if (this->spriteBatch)
+		this->UpdateSprites(deltaTime, i);
+
+	if (this->objectRenderer || this->sceneRenderer || this->lodRenderer || this->meshletRenderer)
+	{
+		glm::mat4 view, proj;
+		this->GetCameraMatrices(view, proj);
+
+		if (this->objectRenderer)
+			this->objectRenderer->Update(deltaTime, i, view, proj);
+
+		if (this->sceneRenderer)
+			this->sceneRenderer->Update(deltaTime, i, view, proj);
+
+		if (this->lodRenderer)
+			this->lodRenderer->Update(deltaTime, i, view, proj);
+
+		if (this->meshletRenderer)
+			this->meshletRenderer->Update(deltaTime, i, view, proj);
+	}
+
+	this->memoryTracker->Tick();
+
+	if (this->dynamicResolution)
+		this->dynamicResolution->Update(i);
+
+	// Last, so that what it shows about memory is current.
+	if (this->performanceHud)
+		this->performanceHud->Update(i, deltaTime);
 
 	// Passed in semaphore is signaled when the "presentation engine" is finished using the image.
 	// The returned image index is the image in the swap chain we created that is ready for us to render into.
@@ -1319,28 +2454,51 @@ void Application::DrawFrame()
 	else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR)
 		throw new std::runtime_error("Faield to acquire swap chain image!");
 
-	// Only reset if we know we're going to submit work that will signal the fence.
-	vkResetFences(this->logicalDevice, 1, &this->inFlightFence[i]);
+	// Only reset if we know we're going to submit work that will signal the fence.  A timeline has nothing to reset.
+	if (!this->timelineSemaphoreEnabled)
+		vkResetFences(this->logicalDevice, 1, &this->inFlightFence[i]);
+
+	// The particle update goes to the compute queue first, so it can run alongside whatever graphics work from the
+	// previous frame is still in flight.  We only make this frame's vertex input wait on it.
+	std::vector<VkSemaphore> waitSemaphores = { imageAvailableSemaphore[i] };
+	std::vector<VkPipelineStageFlags> waitStages = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
+	if (this->particleSystem)
+	{
+		waitSemaphores.push_back(this->particleSystem->SubmitCompute(i, deltaTime));
+		waitStages.push_back(VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
+	}
 
 	vkResetCommandBuffer(this->commandBuffer[i], 0);
 	this->RecordCommandBuffer(this->commandBuffer[i], imageIndex, i);
 
 	VkSubmitInfo submitInfo{};
 	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-	VkSemaphore waitSemaphores[] = { imageAvailableSemaphore[i] };
-	VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
-	submitInfo.waitSemaphoreCount = 1;
-	submitInfo.pWaitSemaphores = waitSemaphores;
-	submitInfo.pWaitDstStageMask = waitStages;
+	submitInfo.waitSemaphoreCount = (uint32_t)waitSemaphores.size();
+	submitInfo.pWaitSemaphores = waitSemaphores.data();
+	submitInfo.pWaitDstStageMask = waitStages.data();
 	submitInfo.commandBufferCount = 1;
 	submitInfo.pCommandBuffers = &commandBuffer[i];
-	VkSemaphore signalSemaphores[] = { renderFinishedSemaphore[i] };
-	submitInfo.signalSemaphoreCount = 1;
+	VkSemaphore signalSemaphores[] = { renderFinishedSemaphore[i], this->frameTimelineSemaphore };
+	submitInfo.signalSemaphoreCount = this->timelineSemaphoreEnabled ? 2 : 1;
 	submitInfo.pSignalSemaphores = signalSemaphores;
 
-	if (VK_SUCCESS != vkQueueSubmit(this->graphicsQueue, 1, &submitInfo, this->inFlightFence[i]))
+	// The frame's number goes on the timeline.  Every semaphore gets a value, but the binary ones ignore theirs.
+	uint64_t waitValues[] = { 0, 0 };
+	uint64_t signalValues[] = { 0, this->frameCount };
+	VkTimelineSemaphoreSubmitInfoKHR timelineSubmitInfo{};
+	timelineSubmitInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR;
+	timelineSubmitInfo.waitSemaphoreValueCount = submitInfo.waitSemaphoreCount;
+	timelineSubmitInfo.pWaitSemaphoreValues = waitValues;
+	timelineSubmitInfo.signalSemaphoreValueCount = submitInfo.signalSemaphoreCount;
+	timelineSubmitInfo.pSignalSemaphoreValues = signalValues;
+	if (this->timelineSemaphoreEnabled)
+		submitInfo.pNext = &timelineSubmitInfo;
+
+	if (VK_SUCCESS != vkQueueSubmit(this->graphicsQueue, 1, &submitInfo, this->timelineSemaphoreEnabled ? VK_NULL_HANDLE : this->inFlightFence[i]))
 		throw new std::runtime_error("Failed to submit draw command buffer!");
 
+	this->frameSlotNumbers[i] = this->frameCount;
+
 	VkPresentInfoKHR presentInfo{};
 	presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
 	presentInfo.waitSemaphoreCount = 1;
@@ -1360,6 +2518,8 @@ void Application::DrawFrame()
 	}
 	else if (result != VK_SUCCESS)
 		throw new std::runtime_error("Failed to present swap chain image!");
+
+	VulkanCounters::EndFrame();
 }
 
 VkShaderModule Application::CreateShaderModule(const std::vector<char>& code)
@@ -1385,12 +2545,24 @@ Application::QueueFamilyIndices Application::FindQueueFamilies(VkPhysicalDevice
 
 	QueueFamilyIndices indices;
 
+	// Any family that can do graphics can also do compute, but we'd rather find one that can't do graphics so that the
+	// compute work gets its own hardware queue and can actually run asynchronously.  Fall back on a graphics family.
+	std::optional<uint32_t> fallbackComputeFamily;
+
 	int i = 0;
 	for (const auto& queueFamily : queueFamiliesArray)
 	{
 		if (0 != (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT))
 			indices.graphicsFamily = i;
 
+		if (0 != (queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT))
+		{
+			if (0 == (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT))
+				indices.computeFamily = i;
+			else if (!fallbackComputeFamily.has_value())
+				fallbackComputeFamily = i;
+		}
+
 		// Look for a queue family that supports transfer operations, but not graphics operations.
 		// This is just for demonstration purposes, since any queue family supporting graphics operations will also
 		// handle transfer operations, even if the transfer bit is not set.
@@ -1408,6 +2580,9 @@ Application::QueueFamilyIndices Application::FindQueueFamilies(VkPhysicalDevice
 		i++;
 	}
 
+	if (!indices.computeFamily.has_value())
+		indices.computeFamily = fallbackComputeFamily;
+
 	return indices;
 }
 
@@ -1438,10 +2613,45 @@ Application::SwapChainSupportDetails Application::QuerySwapChainSupport(VkPhysic
 
 VkBool32 Application::HandleDebugMessage(VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity, VkDebugUtilsMessageTypeFlagsEXT messageType, const VkDebugUtilsMessengerCallbackDataEXT* pCallbackData)
 {
-	std::cerr << "Validation layer: " << pCallbackData->pMessage << std::endl;
+	// This is on the driver's thread, in the middle of whatever call it's validating, so hand it off and get out.
+	if (this->debugLog)
+		this->debugLog->Post(messageSeverity, messageType, pCallbackData);
+
 	return VK_FALSE;
 }
 
+void Application::StartDebugLog()
+{
+	// VULKAN_TUTORIAL_VALIDATION_SEVERITY and VULKAN_TUTORIAL_VALIDATION_TYPES are lists like "warning,error" and
+	// "validation,performance".  The messenger only subscribes to what passes, so filtered messages don't even get
+	// formatted by the layer; that also means the filters can be narrowed later, but not widened.
+	// The messenger needs at least one of each, so a list with nothing we recognize (a typo like "warn") gets the default.
+	const char* defaultSeverities = "warning,error";
+	const char* defaultTypes = "general,validation,performance";
+
+	VkDebugUtilsMessageSeverityFlagsEXT severities = DebugLog::ParseSeverities(ReadEnvironmentSetting("VULKAN_TUTORIAL_VALIDATION_SEVERITY", defaultSeverities));
+	if (severities == 0)
+	{
+		std::cerr << "WARNING: VULKAN_TUTORIAL_VALIDATION_SEVERITY names no severity we know; using \"" << defaultSeverities << "\"." << std::endl;
+		severities = DebugLog::ParseSeverities(defaultSeverities);
+	}
+
+	VkDebugUtilsMessageTypeFlagsEXT types = DebugLog::ParseTypes(ReadEnvironmentSetting("VULKAN_TUTORIAL_VALIDATION_TYPES", defaultTypes));
+	if (types == 0)
+	{
+		std::cerr << "WARNING: VULKAN_TUTORIAL_VALIDATION_TYPES names no message type we know; using \"" << defaultTypes << "\"." << std::endl;
+		types = DebugLog::ParseTypes(defaultTypes);
+	}
+
+	this->debugLog = new DebugLog();
+	this->debugLog->SetSeverityFilter(severities);
+	this->debugLog->SetTypeFilter(types);
+	this->debugLog->Start(ReadEnvironmentSetting("VULKAN_TUTORIAL_VALIDATION_LOG", "validation.log"));
+
+	this->debugUtilsMessengerCreateInfo.messageSeverity = this->debugLog->GetSeverityFilter();
+	this->debugUtilsMessengerCreateInfo.messageType = this->debugLog->GetTypeFilter();
+}
+
 void Application::SetupDebugMessenger()
 {
 	if (enableValidationLayers)
@@ -1466,7 +2676,7 @@ void Application::CreateInstance()
 	appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
 	appInfo.pEngineName = "No Engine";
 	appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-	appInfo.apiVersion = VK_API_VERSION_1_0;
+	appInfo.apiVersion = VK_API_VERSION_1_3;	// What we actually get is capped by each device's own version; see CheckDynamicRenderingSupport.
 
 	// Find out what extensions VK supports...
 	uint32_t vkExtensionCount = 0;
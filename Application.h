@@ -19,6 +19,66 @@
 #include <limits>
 #include <algorithm>
 #include <fstream>
+#include "DeviceSelector.h"
+#include "VulkanCounters.h"
+
+const int MAX_FRAMES_IN_FLIGHT = 2;
+
+struct Vertex
+{
+	glm::vec2 pos;
+	glm::vec3 color;
+	glm::vec2 texCoord;
+
+	static VkVertexInputBindingDescription GetBindingDescription()
+	{
+		VkVertexInputBindingDescription bindingDescription{};
+		bindingDescription.binding = 0;
+		bindingDescription.stride = sizeof(Vertex);
+		bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+		return bindingDescription;
+	}
+
+	static std::array<VkVertexInputAttributeDescription, 3> GetAttributeDescriptions()
+	{
+		std::array<VkVertexInputAttributeDescription, 3> attributeDescriptions{};
+
+		attributeDescriptions[0].binding = 0;
+		attributeDescriptions[0].location = 0;
+		attributeDescriptions[0].format = VK_FORMAT_R32G32_SFLOAT;
+		attributeDescriptions[0].offset = offsetof(Vertex, pos);
+
+		attributeDescriptions[1].binding = 0;
+		attributeDescriptions[1].location = 1;
+		attributeDescriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
+		attributeDescriptions[1].offset = offsetof(Vertex, color);
+
+		attributeDescriptions[2].binding = 0;
+		attributeDescriptions[2].location = 2;
+		attributeDescriptions[2].format = VK_FORMAT_R32G32_SFLOAT;
+		attributeDescriptions[2].offset = offsetof(Vertex, texCoord);
+
+		return attributeDescriptions;
+	}
+};
+
+class ParticleSystem;
+class SpriteBatch;
+class ObjectRenderer;
+class SceneRenderer;
+class LodRenderer;
+class MeshletRenderer;
+class TextureAtlas;
+class TextureResidency;
+class OffscreenRenderer;
+class FrameCapture;
+class PerformanceHud;
+class DynamicResolution;
+class GeometryPool;
+class PipelineCache;
+class DebugLog;
+class MemoryTracker;
+class ThreadPool;
 
 class Application
 {
@@ -30,38 +90,48 @@ public:
 	void InitWindow();
 	void InitVulkan();
 	void MainLoop();
+	void RenderBatch();
 	void Cleanup();
 	void CreateInstance();
 	bool CheckValidationLayerSupport();
+	void StartDebugLog();
 	void SetupDebugMessenger();
 	void PickPhsyicalDevice();
 	bool IsDeviceSuitable(VkPhysicalDevice device);
+	DeviceProfile BuildDeviceProfile(VkPhysicalDevice device);
 	void CreateLogicalDevice();
 	void CreateSurface();
 	bool CheckDeviceExtensionsSupport(VkPhysicalDevice device);
 	void CreateSwapChain();
 	void CreateImageViews();
 	void CreateGraphicsPipeline();
+	void CreatePipelineCache();
 	void CreateRenderPass();
 	void CreateFramebuffers();
 	void CreateCommandPools();
 	void CreateCommandBuffers();
 	void RecordCommandBuffer(VkCommandBuffer givenCommandBuffer, uint32_t imageIndex, uint32_t i);
+	void RecordScene(VkCommandBuffer givenCommandBuffer, VkExtent2D extent, VkDescriptorSet descriptorSet);
 	void DrawFrame();
 	void CreateSyncObjects();
 	void RecreateSwapChain();
 	void CleanupSwapChain();
-	void CreateVertexBuffer();
-	void CreateIndexBuffer();
+	void CreateGeometryPool();
 	void CreateGeneralBuffer(const void* bufferData, VkDeviceSize bufferSize, VkBufferUsageFlags usageFlags, VkBuffer& targetBuffer, VkDeviceMemory& targetBufferMemory);
-	void CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory);
+	void CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory, const std::vector<uint32_t>& concurrentQueueFamilies = {});
 	void CopyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
 	uint32_t FindMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
+	static const char* BufferUsageTag(VkBufferUsageFlags usage, VkMemoryPropertyFlags properties);
 	void CreateDescriptorSetLayout();
 	void CreateDescriptorPool();
 	void CreateDescriptorSets();
+	void WriteDescriptorSet(uint32_t i);
 	void CreateUniformBuffer();
 	void UpdateUniformBuffer(uint32_t i);
+	void GetCameraMatrices(glm::mat4& view, glm::mat4& proj);
+	void LoadTextureImage();
+	void LoadShaderFiles();
+	void ChooseSwapChainSurfaceFormat();
 	void CreateTextureImage();
 	void CreateImage(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory);
 	VkCommandBuffer BeginSingleTimeCommands(VkCommandPool commandPool);
@@ -71,6 +141,31 @@ public:
 	void CreateTextureImageView();
 	VkImageView CreateImageView(VkImage image, VkFormat format);
 	void CreateTextureSampler();
+	bool CheckDynamicRenderingSupport(VkPhysicalDevice device, bool& extensionRequired);
+	bool CheckTimelineSemaphoreSupport(VkPhysicalDevice device, bool& extensionRequired);
+	bool CheckMeshShaderSupport(VkPhysicalDevice device);
+	void WaitForFrameSlot(uint32_t i);
+	void WaitForFrame(uint64_t frameNumber);
+	uint64_t GetCompletedFrame();
+	void ConfigurePipelineRenderingInfo(VkGraphicsPipelineCreateInfo& pipelineInfo, VkPipelineRenderingCreateInfoKHR& renderingInfo);
+	void BeginSwapChainRendering(VkCommandBuffer givenCommandBuffer, uint32_t imageIndex);
+	void EndSwapChainRendering(VkCommandBuffer givenCommandBuffer, uint32_t imageIndex);
+	void RecordSwapChainImageBarrier(VkCommandBuffer givenCommandBuffer, uint32_t imageIndex, VkImageLayout oldLayout, VkImageLayout newLayout);
+	void CreateParticleSystem();
+	void CreateSpriteBatch();
+	void CreateSpriteAtlas();
+	void CreateSpriteResidency();
+	void CreateFrameCapture();
+	void CreatePerformanceHud();
+	void CreateDynamicResolution();
+	void UpdateSprites(float deltaTime, uint32_t i);
+	void CreateObjectRenderer();
+	void CreateSceneRenderer();
+	void CreateLodRenderer();
+	void CreateMeshletRenderer();
+
+	static std::vector<char> ReadFile(const std::string& filename);
+	static std::string ReadEnvironmentSetting(const char* name, const std::string& defaultValue = "");
 
 	// Note that we must satisfy Vulkan's alignment requirements here.
 	struct UniformBufferObject
@@ -98,12 +193,14 @@ public:
 		std::optional<uint32_t> graphicsFamily;
 		std::optional<uint32_t> presentFamily;
 		std::optional<uint32_t> transferFamily;
+		std::optional<uint32_t> computeFamily;
 
 		bool IsComplete()
 		{
 			return this->graphicsFamily.has_value() &&
 				this->presentFamily.has_value() &&
-				this->transferFamily.has_value();
+				this->transferFamily.has_value() &&
+				this->computeFamily.has_value();
 		}
 	};
 
@@ -118,11 +215,13 @@ public:
 	VkQueue graphicsQueue;
 	VkQueue presentQueue;
 	VkQueue transferQueue;
+	VkQueue computeQueue;
 	VkSurfaceKHR surface;
 	VkSwapchainKHR swapChain;
 	std::vector<VkImage> swapChainImages;
 	VkFormat swapChainImageFormat;
 	VkExtent2D swapChainExtent;
+	bool swapChainCaptureSupported;
 	std::vector<VkImageView> swapChainImageViews;
 	VkPipelineLayout pipelineLayout;
 	VkRenderPass renderPass;
@@ -131,16 +230,17 @@ public:
 	std::vector<VkFramebuffer> swapChainFramebuffers;
 	VkCommandPool graphicsCommandPool;
 	VkCommandPool transferCommandPool;
+	VkCommandPool computeCommandPool;
 	std::vector<VkCommandBuffer> commandBuffer;
 	std::vector<VkSemaphore> imageAvailableSemaphore;
 	std::vector<VkSemaphore> renderFinishedSemaphore;
-	std::vector<VkFence> inFlightFence;
+	std::vector<VkFence> inFlightFence;				// Only without timeline semaphores.
+	VkSemaphore frameTimelineSemaphore;				// Signaled with each frame's number as the GPU finishes it.
+	std::vector<uint64_t> frameSlotNumbers;			// The number of the frame last submitted in each slot.
 	uint32_t frameCount;
 	bool frameBufferResized;
-	VkBuffer vertexBuffer;
-	VkDeviceMemory vertexBufferMemory;
-	VkBuffer indexBuffer;
-	VkDeviceMemory indexBufferMemory;
+	GeometryPool* geometryPool;
+	uint32_t quadMeshId;		// The tutorial quad, in the geometry pool.
 	std::vector<VkBuffer> uniformBuffers;
 	std::vector<VkDeviceMemory> uniformBuffersMemory;
 	VkDescriptorPool descriptorPool;
@@ -149,6 +249,41 @@ public:
 	VkDeviceMemory textureImageMemory;
 	VkImageView textureImageView;
 	VkSampler textureSampler;
+	bool dynamicRenderingEnabled;
+	bool dynamicRenderingExtensionRequired;
+	PFN_vkCmdBeginRenderingKHR pfnCmdBeginRendering;
+	PFN_vkCmdEndRenderingKHR pfnCmdEndRendering;
+	bool timelineSemaphoreEnabled;
+	bool timelineSemaphoreExtensionRequired;
+	PFN_vkWaitSemaphoresKHR pfnWaitSemaphores;
+	PFN_vkGetSemaphoreCounterValueKHR pfnGetSemaphoreCounterValue;
+	bool meshShaderEnabled;
+	PFN_vkCmdDrawMeshTasksNV pfnCmdDrawMeshTasks;
+	ParticleSystem* particleSystem;
+	SpriteBatch* spriteBatch;
+	ObjectRenderer* objectRenderer;
+	SceneRenderer* sceneRenderer;
+	LodRenderer* lodRenderer;
+	MeshletRenderer* meshletRenderer;
+	TextureAtlas* spriteAtlas;
+	TextureResidency* spriteResidency;
+	FrameCapture* frameCapture;
+	PerformanceHud* performanceHud;
+	DynamicResolution* dynamicResolution;
+	PipelineCache* pipelineCache;
+	DebugLog* debugLog;
+	MemoryTracker* memoryTracker;
+	std::vector<uint16_t> spriteAtlasTextureIds;
+	std::vector<uint16_t> spriteResidentTextureIds;
+	std::vector<glm::vec4> spriteMotionArray;
+	ThreadPool* threadPool;
+	unsigned char* texturePixels;
+	int textureWidth;
+	int textureHeight;
+	std::vector<char> vertShaderCode;
+	std::vector<char> fragShaderCode;
+	VkSurfaceFormatKHR swapChainSurfaceFormat;
+	std::chrono::high_resolution_clock::time_point lastFrameTime;
 
 	VkBool32 HandleDebugMessage(VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity, VkDebugUtilsMessageTypeFlagsEXT messageType, const VkDebugUtilsMessengerCallbackDataEXT* pCallbackData);
 };
\ No newline at end of file
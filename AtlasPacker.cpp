@@ -0,0 +1,140 @@
+#include "AtlasPacker.h"
+#include <algorithm>
+#include <limits>
+
+AtlasPacker::AtlasPacker(uint32_t pageWidth, uint32_t pageHeight)
+{
+	this->pageWidth = pageWidth;
+	this->pageHeight = pageHeight;
+	this->usedArea = 0;
+}
+
+/*virtual*/ AtlasPacker::~AtlasPacker()
+{
+}
+
+bool AtlasPacker::Pack(uint32_t width, uint32_t height, Placement& placement)
+{
+	if (width == 0 || height == 0 || width > this->pageWidth || height > this->pageHeight)
+		return false;
+
+	// Earlier pages first, so they fill up with the small stuff that comes along later.
+	for (uint32_t page = 0; page <= (uint32_t)this->skylinesArray.size(); page++)
+	{
+		if (page == this->skylinesArray.size())
+			this->skylinesArray.push_back(std::vector<Segment>{ Segment{ 0, 0, this->pageWidth } });
+
+		std::vector<Segment>& skyline = this->skylinesArray[page];
+
+		size_t segment = 0;
+		uint32_t y = 0;
+		if (this->FindPosition(skyline, width, height, segment, y))
+		{
+			placement.page = page;
+			placement.x = skyline[segment].x;
+			placement.y = y;
+
+			this->Place(skyline, segment, y, width, height);
+			this->usedArea += uint64_t(width) * height;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+double AtlasPacker::GetOccupancy() const
+{
+	if (this->skylinesArray.empty())
+		return 0.0;
+
+	return double(this->usedArea) / (double(this->pageWidth) * double(this->pageHeight) * double(this->skylinesArray.size()));
+}
+
+bool AtlasPacker::FindPosition(const std::vector<Segment>& skyline, uint32_t width, uint32_t height, size_t& bestSegment, uint32_t& bestY) const
+{
+	uint32_t bestTop = std::numeric_limits<uint32_t>::max();
+	uint32_t bestWaste = std::numeric_limits<uint32_t>::max();
+	bool found = false;
+
+	for (size_t j = 0; j < skyline.size(); j++)
+	{
+		if (skyline[j].x + width > this->pageWidth)
+			break;
+
+		// Resting the left edge on segment j, the rectangle spans however many segments it takes, and sits on the highest.
+		uint32_t y = 0;
+		uint32_t remaining = width;
+		size_t k = j;
+		for (; remaining > 0; k++)
+		{
+			y = std::max(y, skyline[k].y);
+			remaining -= std::min(remaining, skyline[k].width);
+		}
+
+		if (y + height > this->pageHeight)
+			continue;
+
+		// The area trapped under the rectangle, between it and the segments it spans.
+		uint32_t waste = 0;
+		remaining = width;
+		for (size_t m = j; m < k; m++)
+		{
+			uint32_t spanned = std::min(remaining, skyline[m].width);
+			waste += spanned * (y - skyline[m].y);
+			remaining -= spanned;
+		}
+
+		uint32_t top = y + height;
+		if (top < bestTop || (top == bestTop && waste < bestWaste))
+		{
+			bestTop = top;
+			bestWaste = waste;
+			bestSegment = j;
+			bestY = y;
+			found = true;
+		}
+	}
+
+	return found;
+}
+
+void AtlasPacker::Place(std::vector<Segment>& skyline, size_t segment, uint32_t y, uint32_t width, uint32_t height)
+{
+	uint32_t x = skyline[segment].x;
+	skyline.insert(skyline.begin() + segment, Segment{ x, y + height, width });
+
+	// Whatever the new segment now covers gets cut back or removed.
+	size_t j = segment + 1;
+	while (j < skyline.size())
+	{
+		uint32_t coveredEnd = x + width;
+		if (skyline[j].x >= coveredEnd)
+			break;
+
+		uint32_t shrink = coveredEnd - skyline[j].x;
+		if (shrink >= skyline[j].width)
+		{
+			skyline.erase(skyline.begin() + j);
+			continue;
+		}
+
+		skyline[j].x += shrink;
+		skyline[j].width -= shrink;
+		break;
+	}
+
+	// Neighbors at the same height are one segment.
+	for (j = 0; j + 1 < skyline.size();)
+	{
+		if (skyline[j].y == skyline[j + 1].y)
+		{
+			skyline[j].width += skyline[j + 1].width;
+			skyline.erase(skyline.begin() + j + 1);
+		}
+		else
+		{
+			j++;
+		}
+	}
+}
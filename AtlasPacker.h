@@ -0,0 +1,47 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// Packs rectangles into any number of equally sized pages with the skyline bottom-left heuristic: each page keeps the
+// outline of what's been placed so far as a list of horizontal segments, and a new rectangle goes wherever along that
+// outline it would sit lowest, ties going to the spot that traps the least space under it.  It's fast, needs little
+// memory and does well when rectangles are fed in tallest first.  A rectangle that fits no open page opens a new one.
+class AtlasPacker
+{
+public:
+	struct Placement
+	{
+		uint32_t page;
+		uint32_t x;
+		uint32_t y;
+	};
+
+	AtlasPacker(uint32_t pageWidth, uint32_t pageHeight);
+	virtual ~AtlasPacker();
+
+	// Returns false only if the rectangle is bigger than a page.
+	bool Pack(uint32_t width, uint32_t height, Placement& placement);
+
+	uint32_t GetPageCount() const { return (uint32_t)this->skylinesArray.size(); }
+
+	// Fraction of the area of the pages opened so far that's covered by rectangles.
+	double GetOccupancy() const;
+
+private:
+	struct Segment
+	{
+		uint32_t x;
+		uint32_t y;
+		uint32_t width;
+	};
+
+	bool FindPosition(const std::vector<Segment>& skyline, uint32_t width, uint32_t height, size_t& bestSegment, uint32_t& bestY) const;
+	void Place(std::vector<Segment>& skyline, size_t segment, uint32_t y, uint32_t width, uint32_t height);
+
+	uint32_t pageWidth;
+	uint32_t pageHeight;
+	std::vector<std::vector<Segment>> skylinesArray;
+	uint64_t usedArea;
+};
@@ -0,0 +1,186 @@
+#include "Benchmarks.h"
+#include "Application.h"
+#include "TransformStore.h"
+#include "FrustumCuller.h"
+#include "ThreadPool.h"
+#include <glm/gtc/quaternion.hpp>
+#include <functional>
+#include <iomanip>
+
+const double BENCHMARK_MIN_MILLISECONDS = 250.0;	// Keep repeating a measurement for at least this long...
+const int BENCHMARK_MIN_REPETITIONS = 5;			// ...and at least this many times, then take the best.
+
+// Best-of-N wall time of one call, after a warm-up call.
+static double MeasureMilliseconds(const std::function<void()>& function)
+{
+	function();
+
+	double bestMilliseconds = std::numeric_limits<double>::max();
+	double totalMilliseconds = 0.0;
+	int repetitions = 0;
+
+	while (repetitions < BENCHMARK_MIN_REPETITIONS || totalMilliseconds < BENCHMARK_MIN_MILLISECONDS)
+	{
+		auto startTime = std::chrono::high_resolution_clock::now();
+		function();
+		auto endTime = std::chrono::high_resolution_clock::now();
+
+		double milliseconds = std::chrono::duration<double, std::milli>(endTime - startTime).count();
+		bestMilliseconds = std::min(bestMilliseconds, milliseconds);
+		totalMilliseconds += milliseconds;
+		repetitions++;
+	}
+
+	return bestMilliseconds;
+}
+
+static void ReportMeasurement(std::ostream& stream, const std::string& name, double milliseconds, uint32_t itemCount, double baselineMilliseconds)
+{
+	stream << '\t' << std::setw(24) << std::left << name << std::right
+		<< std::setw(10) << std::fixed << std::setprecision(3) << milliseconds << " ms"
+		<< std::setw(10) << std::setprecision(2) << 1e6 * milliseconds / double(itemCount) << " ns/item"
+		<< std::setw(8) << std::setprecision(2) << baselineMilliseconds / milliseconds << "x\n";
+}
+
+static void BenchmarkTransforms(std::ostream& stream, uint32_t objectCount, ThreadPool* threadPool)
+{
+	// The same random transforms, in the usual per-object glm form and in the transform store.
+	std::vector<glm::vec3> positionsArray(objectCount);
+	std::vector<glm::quat> rotationsArray(objectCount);
+	std::vector<glm::vec3> scalesArray(objectCount);
+
+	TransformStore transformStore;
+	transformStore.Resize(objectCount);
+
+	uint32_t seed = 12345;
+	auto random = [&seed]() { seed = seed * 1664525 + 1013904223; return float(seed >> 8) / float(1 << 24) - 0.5f; };
+
+	for (uint32_t j = 0; j < objectCount; j++)
+	{
+		positionsArray[j] = glm::vec3(random(), random(), random()) * 100.0f;
+		rotationsArray[j] = glm::normalize(glm::quat(random(), random(), random(), random()));
+		scalesArray[j] = glm::vec3(1.0f + random(), 1.0f + random(), 1.0f + random());
+
+		transformStore.SetPosition(j, positionsArray[j].x, positionsArray[j].y, positionsArray[j].z);
+		transformStore.SetRotation(j, rotationsArray[j].x, rotationsArray[j].y, rotationsArray[j].z, rotationsArray[j].w);
+		transformStore.SetScale(j, scalesArray[j].x, scalesArray[j].y, scalesArray[j].z);
+	}
+
+	glm::mat4 view = glm::lookAt(glm::vec3(2.0f, 2.0f, 2.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+	glm::mat4 proj = glm::perspective(glm::radians(45.0f), 4.0f / 3.0f, 0.1f, 10.0f);
+	glm::mat4 viewProjection = proj * view;
+
+	std::vector<glm::mat4> mvpMatricesArray(objectCount);
+
+	stream << "Transforms, " << objectCount << " objects (world and MVP matrices):\n";
+
+	double baselineMilliseconds = MeasureMilliseconds([&]()
+	{
+		for (uint32_t j = 0; j < objectCount; j++)
+		{
+			glm::mat4 world = glm::translate(glm::mat4(1.0f), positionsArray[j]) * glm::mat4_cast(rotationsArray[j]) * glm::scale(glm::mat4(1.0f), scalesArray[j]);
+			mvpMatricesArray[j] = viewProjection * world;
+		}
+	});
+	ReportMeasurement(stream, "glm per object", baselineMilliseconds, objectCount, baselineMilliseconds);
+
+	float* output = &mvpMatricesArray[0][0][0];
+
+	TransformStore::SimdPath bestSimdPath = TransformStore::BestSupportedSimdPath();
+	for (int simdPath = TransformStore::SIMD_SCALAR; simdPath <= bestSimdPath; simdPath++)
+	{
+		transformStore.SetSimdPath((TransformStore::SimdPath)simdPath);
+
+		double milliseconds = MeasureMilliseconds([&]() { transformStore.ComputeMatrices(&viewProjection[0][0], nullptr, output, nullptr); });
+		ReportMeasurement(stream, std::string("store, ") + TransformStore::SimdPathName((TransformStore::SimdPath)simdPath), milliseconds, objectCount, baselineMilliseconds);
+	}
+
+	double milliseconds = MeasureMilliseconds([&]() { transformStore.ComputeMatrices(&viewProjection[0][0], nullptr, output, threadPool); });
+	ReportMeasurement(stream, std::string("store, ") + TransformStore::SimdPathName(bestSimdPath) + " x" + std::to_string(threadPool->GetThreadCount() + 1) + " threads", milliseconds, objectCount, baselineMilliseconds);
+}
+
+static void BenchmarkCulling(std::ostream& stream, uint32_t objectCount, ThreadPool* threadPool)
+{
+	// Random spheres in a volume a bit bigger than the frustum, so that a fair share of them is culled.
+	std::vector<glm::vec4> spheresArray(objectCount);
+	std::vector<float> centerX(objectCount), centerY(objectCount), centerZ(objectCount), radius(objectCount);
+
+	uint32_t seed = 54321;
+	auto random = [&seed]() { seed = seed * 1664525 + 1013904223; return float(seed >> 8) / float(1 << 24) - 0.5f; };
+
+	for (uint32_t j = 0; j < objectCount; j++)
+	{
+		spheresArray[j] = glm::vec4(random() * 12.0f, random() * 12.0f, random() * 12.0f, 0.25f + 0.2f * random());
+		centerX[j] = spheresArray[j].x;
+		centerY[j] = spheresArray[j].y;
+		centerZ[j] = spheresArray[j].z;
+		radius[j] = spheresArray[j].w;
+	}
+
+	glm::mat4 view = glm::lookAt(glm::vec3(2.0f, 2.0f, 2.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+	glm::mat4 proj = glm::perspective(glm::radians(45.0f), 4.0f / 3.0f, 0.1f, 10.0f);
+	glm::mat4 viewProjection = proj * view;
+
+	FrustumCuller frustumCuller;
+	frustumCuller.SetViewProjection(&viewProjection[0][0]);
+
+	// The baseline tests one sphere at a time against glm planes, the way it'd usually be written.
+	glm::mat4 transpose = glm::transpose(viewProjection);
+	glm::vec4 planesArray[6] = { transpose[3] + transpose[0], transpose[3] - transpose[0], transpose[3] + transpose[1], transpose[3] - transpose[1], transpose[2], transpose[3] - transpose[2] };
+	for (glm::vec4& plane : planesArray)
+		plane /= glm::length(glm::vec3(plane));
+
+	std::vector<uint32_t> visibleArray;
+	visibleArray.reserve(objectCount);
+
+	stream << "Frustum culling, " << objectCount << " spheres:\n";
+
+	double baselineMilliseconds = MeasureMilliseconds([&]()
+	{
+		visibleArray.clear();
+		for (uint32_t j = 0; j < objectCount; j++)
+		{
+			bool inside = true;
+			for (const glm::vec4& plane : planesArray)
+				if (glm::dot(glm::vec3(plane), glm::vec3(spheresArray[j])) + plane.w < -spheresArray[j].w)
+				{
+					inside = false;
+					break;
+				}
+
+			if (inside)
+				visibleArray.push_back(j);
+		}
+	});
+	ReportMeasurement(stream, "glm per sphere", baselineMilliseconds, objectCount, baselineMilliseconds);
+
+	for (bool simdEnabled : { false, true })
+	{
+		frustumCuller.SetSimdEnabled(simdEnabled);
+		if (frustumCuller.GetSimdEnabled() != simdEnabled)
+			continue;
+
+		double milliseconds = MeasureMilliseconds([&]() { frustumCuller.CullSpheres(centerX.data(), centerY.data(), centerZ.data(), radius.data(), objectCount, nullptr); });
+		ReportMeasurement(stream, simdEnabled ? "culler, SSE" : "culler, scalar", milliseconds, objectCount, baselineMilliseconds);
+	}
+
+	frustumCuller.SetSimdEnabled(true);
+
+	double milliseconds = MeasureMilliseconds([&]() { frustumCuller.CullSpheres(centerX.data(), centerY.data(), centerZ.data(), radius.data(), objectCount, threadPool); });
+	ReportMeasurement(stream, std::string("culler x") + std::to_string(threadPool->GetThreadCount() + 1) + " threads", milliseconds, objectCount, baselineMilliseconds);
+
+	stream << '\t' << frustumCuller.GetStatistics().visible << " of " << frustumCuller.GetStatistics().tested << " visible\n";
+}
+
+void RunBenchmarks(std::ostream& stream)
+{
+	ThreadPool threadPool(ThreadPool::DefaultThreadCount());
+
+	for (uint32_t objectCount : { 1000u, 100000u, 1000000u })
+		BenchmarkTransforms(stream, objectCount, &threadPool);
+
+	for (uint32_t objectCount : { 1000u, 100000u, 1000000u })
+		BenchmarkCulling(stream, objectCount, &threadPool);
+
+	stream << std::defaultfloat << std::flush;
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <iostream>
+#include <string>
+
+// CPU microbenchmarks for the hot loops we've hand-optimized, each measured against the straightforward way of doing
+// the same thing.  Run with "VulkanTutorial --benchmark"; no window or Vulkan device is needed.
+void RunBenchmarks(std::ostream& stream);
+
+// CPU cost per call, in time and heap allocations, of the renderer's own per-frame work, on a real device, checked
+// against a baseline file from an earlier run.  Returns EXIT_FAILURE if anything regressed.  Run with
+// "VulkanTutorial --benchmark-renderer [baseline file] [--update-baseline]".  Times are only compared against a baseline
+// measured on the same device; allocation counts are compared on any.
+int RunRendererBenchmarks(std::ostream& stream, const std::string& baselinePath, bool updateBaseline);
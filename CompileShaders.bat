@@ -1,2 +1,19 @@
 C:\VulkanSDK\1.3.216.0\Bin\glslc.exe shader.vert -o vert.spv
 C:\VulkanSDK\1.3.216.0\Bin\glslc.exe shader.frag -o frag.spv
+C:\VulkanSDK\1.3.216.0\Bin\glslc.exe particle.comp -o particle_comp.spv
+C:\VulkanSDK\1.3.216.0\Bin\glslc.exe particle.vert -o particle_vert.spv
+C:\VulkanSDK\1.3.216.0\Bin\glslc.exe particle.frag -o particle_frag.spv
+C:\VulkanSDK\1.3.216.0\Bin\glslc.exe sprite.vert -o sprite_vert.spv
+C:\VulkanSDK\1.3.216.0\Bin\glslc.exe sprite.frag -o sprite_frag.spv
+C:\VulkanSDK\1.3.216.0\Bin\glslc.exe object.vert -o object_vert.spv
+C:\VulkanSDK\1.3.216.0\Bin\glslc.exe scene.vert -o scene_vert.spv
+C:\VulkanSDK\1.3.216.0\Bin\glslc.exe lod.vert -o lod_vert.spv
+C:\VulkanSDK\1.3.216.0\Bin\glslc.exe lod.frag -o lod_frag.spv
+C:\VulkanSDK\1.3.216.0\Bin\glslc.exe upscale.vert -o upscale_vert.spv
+C:\VulkanSDK\1.3.216.0\Bin\glslc.exe upscale.frag -o upscale_frag.spv
+C:\VulkanSDK\1.3.216.0\Bin\glslc.exe hiz_reduce.comp -o hiz_reduce_comp.spv
+C:\VulkanSDK\1.3.216.0\Bin\glslc.exe scene_cull.comp -o scene_cull_comp.spv
+C:\VulkanSDK\1.3.216.0\Bin\glslc.exe meshlet_cull.comp -o meshlet_cull_comp.spv
+C:\VulkanSDK\1.3.216.0\Bin\glslc.exe meshlet.vert -o meshlet_vert.spv
+C:\VulkanSDK\1.3.216.0\Bin\glslc.exe meshlet.task -o meshlet_task.spv
+C:\VulkanSDK\1.3.216.0\Bin\glslc.exe meshlet.mesh -o meshlet_mesh.spv
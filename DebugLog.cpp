@@ -0,0 +1,256 @@
+#include "DebugLog.h"
+#include <cstring>
+
+const std::chrono::milliseconds DEBUG_LOG_DRAIN_INTERVAL(5);
+
+static uint64_t HashMessageId(const char* name, int32_t number)
+{
+	// FNV-1a over the id's name, then its number.  The low bit is forced on so a key is never zero, which means free.
+	uint64_t hash = 0xCBF29CE484222325ull;
+	for (const char* c = name; c && *c; c++)
+	{
+		hash ^= uint8_t(*c);
+		hash *= 0x100000001B3ull;
+	}
+
+	hash ^= uint32_t(number);
+	hash *= 0x100000001B3ull;
+	return hash | 1;
+}
+
+static const char* SeverityName(VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity)
+{
+	switch (messageSeverity)
+	{
+	case VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT: return "verbose";
+	case VK_DEBUG_UTILS_MESSAGE_SEVERITY_INFO_BIT_EXT: return "info";
+	case VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT: return "warning";
+	case VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT: return "error";
+	default: return "unknown";
+	}
+}
+
+DebugLog::DebugLog()
+{
+	this->severityMask.store(VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT);
+	this->typeMask.store(VK_DEBUG_UTILS_MESSAGE_TYPE_GENERAL_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT);
+
+	this->ringArray.reset(new RingSlot[RING_SIZE]);
+	for (size_t j = 0; j < RING_SIZE; j++)
+		this->ringArray[j].sequence.store(j);
+
+	this->idTableArray.reset(new IdSlot[ID_TABLE_SIZE]);
+	for (size_t j = 0; j < ID_TABLE_SIZE; j++)
+	{
+		this->idTableArray[j].key.store(0);
+		this->idTableArray[j].count.store(0);
+		this->idTableArray[j].name[0] = '\0';
+	}
+
+	this->enqueuePosition.store(0);
+	this->dequeuePosition = 0;
+	this->droppedCount.store(0);
+	this->filteredCount.store(0);
+	this->stopping.store(false);
+}
+
+/*virtual*/ DebugLog::~DebugLog()
+{
+	this->Stop();
+}
+
+void DebugLog::Start(const std::string& logFilePath)
+{
+	this->logFile.open(logFilePath, std::ios::out | std::ios::trunc);
+	if (!this->logFile.is_open())
+		throw new std::runtime_error("Failed to open validation log file!");
+
+	this->drainThread = std::thread([this]() { this->DrainThreadMain(); });
+}
+
+void DebugLog::Stop()
+{
+	if (!this->drainThread.joinable())
+		return;
+
+	// The drain thread empties the ring once more after seeing this, so nothing posted before now gets lost.
+	this->stopping.store(true);
+	this->drainThread.join();
+
+	this->WriteSummary();
+	this->logFile.close();
+}
+
+/*static*/ VkDebugUtilsMessageSeverityFlagsEXT DebugLog::ParseSeverities(const std::string& list)
+{
+	VkDebugUtilsMessageSeverityFlagsEXT severityMask = 0;
+	if (list.find("verbose") != std::string::npos)
+		severityMask |= VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT;
+	if (list.find("info") != std::string::npos)
+		severityMask |= VK_DEBUG_UTILS_MESSAGE_SEVERITY_INFO_BIT_EXT;
+	if (list.find("warning") != std::string::npos)
+		severityMask |= VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT;
+	if (list.find("error") != std::string::npos)
+		severityMask |= VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT;
+
+	return severityMask;
+}
+
+/*static*/ VkDebugUtilsMessageTypeFlagsEXT DebugLog::ParseTypes(const std::string& list)
+{
+	VkDebugUtilsMessageTypeFlagsEXT typeMask = 0;
+	if (list.find("general") != std::string::npos)
+		typeMask |= VK_DEBUG_UTILS_MESSAGE_TYPE_GENERAL_BIT_EXT;
+	if (list.find("validation") != std::string::npos)
+		typeMask |= VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT;
+	if (list.find("performance") != std::string::npos)
+		typeMask |= VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT;
+
+	return typeMask;
+}
+
+void DebugLog::Post(VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity, VkDebugUtilsMessageTypeFlagsEXT messageType, const VkDebugUtilsMessengerCallbackDataEXT* pCallbackData)
+{
+	if (0 == (messageSeverity & this->severityMask.load(std::memory_order_relaxed)) || 0 == (messageType & this->typeMask.load(std::memory_order_relaxed)))
+	{
+		this->filteredCount.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	// Repeats only bump their count; the text of a message id is only worth writing out once.
+	if (this->CountMessage(pCallbackData) > 1)
+		return;
+
+	if (!this->Enqueue(messageSeverity, pCallbackData))
+		this->droppedCount.fetch_add(1, std::memory_order_relaxed);
+}
+
+uint32_t DebugLog::CountMessage(const VkDebugUtilsMessengerCallbackDataEXT* pCallbackData)
+{
+	// Messages without an id of any kind are keyed by their text instead.
+	const char* name = pCallbackData->pMessageIdName;
+	if ((!name || !*name) && pCallbackData->messageIdNumber == 0)
+		name = pCallbackData->pMessage;
+
+	uint64_t key = HashMessageId(name, pCallbackData->messageIdNumber);
+
+	// Open addressing with linear probing.  Slots are only ever claimed, never freed, so a probe can stop at the first
+	// free slot it finds.
+	for (size_t probe = 0; probe < ID_TABLE_SIZE; probe++)
+	{
+		IdSlot& slot = this->idTableArray[(key + probe) & (ID_TABLE_SIZE - 1)];
+
+		uint64_t slotKey = slot.key.load(std::memory_order_acquire);
+		if (slotKey == 0)
+		{
+			uint64_t expected = 0;
+			if (slot.key.compare_exchange_strong(expected, key, std::memory_order_acq_rel))
+			{
+				// Only read back by WriteSummary, once everything has stopped.
+				::strncpy(slot.name, (pCallbackData->pMessageIdName ? pCallbackData->pMessageIdName : "(unnamed)"), ID_NAME_LENGTH - 1);
+				slot.name[ID_NAME_LENGTH - 1] = '\0';
+				return slot.count.fetch_add(1, std::memory_order_relaxed) + 1;
+			}
+
+			slotKey = expected;
+		}
+
+		if (slotKey == key)
+			return slot.count.fetch_add(1, std::memory_order_relaxed) + 1;
+	}
+
+	// The table's full, so we can't tell; treat it as new.
+	return 1;
+}
+
+bool DebugLog::Enqueue(VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity, const VkDebugUtilsMessengerCallbackDataEXT* pCallbackData)
+{
+	size_t position = this->enqueuePosition.load(std::memory_order_relaxed);
+	RingSlot* slot = nullptr;
+
+	while (true)
+	{
+		slot = &this->ringArray[position & (RING_SIZE - 1)];
+		size_t sequence = slot->sequence.load(std::memory_order_acquire);
+		intptr_t difference = intptr_t(sequence) - intptr_t(position);
+
+		if (difference == 0)
+		{
+			if (this->enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+				break;
+		}
+		else if (difference < 0)
+		{
+			return false;		// Full.
+		}
+		else
+		{
+			position = this->enqueuePosition.load(std::memory_order_relaxed);
+		}
+	}
+
+	slot->severity = messageSeverity;
+	::strncpy(slot->text, pCallbackData->pMessage ? pCallbackData->pMessage : "", MESSAGE_LENGTH - 1);
+	slot->text[MESSAGE_LENGTH - 1] = '\0';
+	slot->sequence.store(position + 1, std::memory_order_release);
+	return true;
+}
+
+bool DebugLog::Dequeue(VkDebugUtilsMessageSeverityFlagBitsEXT& messageSeverity, std::string& text)
+{
+	// There's only the one consumer, so no need to claim positions atomically here.
+	RingSlot& slot = this->ringArray[this->dequeuePosition & (RING_SIZE - 1)];
+	if (slot.sequence.load(std::memory_order_acquire) != this->dequeuePosition + 1)
+		return false;
+
+	messageSeverity = slot.severity;
+	text = slot.text;
+	slot.sequence.store(this->dequeuePosition + RING_SIZE, std::memory_order_release);
+	this->dequeuePosition++;
+	return true;
+}
+
+void DebugLog::DrainThreadMain()
+{
+	VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity;
+	std::string text;
+
+	while (true)
+	{
+		bool stopping = this->stopping.load();
+
+		bool drained = false;
+		while (this->Dequeue(messageSeverity, text))
+		{
+			this->logFile << "[" << SeverityName(messageSeverity) << "] " << text << '\n';
+			if (messageSeverity == VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT)
+				std::cerr << "Validation layer: " << text << std::endl;
+
+			drained = true;
+		}
+
+		if (drained)
+			this->logFile.flush();
+
+		if (stopping)
+			break;
+
+		std::this_thread::sleep_for(DEBUG_LOG_DRAIN_INTERVAL);
+	}
+}
+
+void DebugLog::WriteSummary()
+{
+	std::vector<const IdSlot*> slotsArray;
+	for (size_t j = 0; j < ID_TABLE_SIZE; j++)
+		if (this->idTableArray[j].key.load() != 0)
+			slotsArray.push_back(&this->idTableArray[j]);
+
+	std::sort(slotsArray.begin(), slotsArray.end(), [](const IdSlot* a, const IdSlot* b) { return a->count.load() > b->count.load(); });
+
+	this->logFile << "\nMessage counts by id:\n";
+	for (const IdSlot* slot : slotsArray)
+		this->logFile << '\t' << slot->count.load() << '\t' << slot->name << '\n';
+
+	this->logFile << "Filtered out: " << this->filteredCount.load() << ", dropped with the ring full: " << this->droppedCount.load() << std::endl;
+}
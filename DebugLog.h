@@ -0,0 +1,76 @@
+#pragma once
+
+#include "Application.h"
+#include <atomic>
+#include <thread>
+#include <memory>
+
+// Takes the validation layer's messages off the driver's threads as cheaply as we can manage.  The callback just checks
+// the severity and type filters, counts the message against its id, and, only the first time that id turns up, copies
+// the text into a lock-free ring buffer.  A background thread drains the ring to a log file (errors go to stderr too),
+// and on shutdown the log gets a table of how many times each id came up.  If the ring is full, messages are dropped
+// and counted rather than making the driver wait for us.
+class DebugLog
+{
+public:
+	DebugLog();
+	virtual ~DebugLog();
+
+	void Start(const std::string& logFilePath);
+	void Stop();
+
+	// These can be changed at any time.  Parsed from lists like "warning,error" or "validation,performance".
+	void SetSeverityFilter(VkDebugUtilsMessageSeverityFlagsEXT severityMask) { this->severityMask.store(severityMask); }
+	void SetTypeFilter(VkDebugUtilsMessageTypeFlagsEXT typeMask) { this->typeMask.store(typeMask); }
+	VkDebugUtilsMessageSeverityFlagsEXT GetSeverityFilter() const { return this->severityMask.load(); }
+	VkDebugUtilsMessageTypeFlagsEXT GetTypeFilter() const { return this->typeMask.load(); }
+
+	static VkDebugUtilsMessageSeverityFlagsEXT ParseSeverities(const std::string& list);
+	static VkDebugUtilsMessageTypeFlagsEXT ParseTypes(const std::string& list);
+
+	// Called from whatever thread the driver calls us on.
+	void Post(VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity, VkDebugUtilsMessageTypeFlagsEXT messageType, const VkDebugUtilsMessengerCallbackDataEXT* pCallbackData);
+
+private:
+	enum
+	{
+		RING_SIZE = 1024,				// Must be a power of two.
+		MESSAGE_LENGTH = 1024,
+		ID_TABLE_SIZE = 4096,			// Must be a power of two.
+		ID_NAME_LENGTH = 64
+	};
+
+	// A bounded multi-producer queue in the style of Dmitry Vyukov's: each slot's sequence number says whether it's
+	// free for the producer claiming that position, or full for the consumer expecting it.
+	struct RingSlot
+	{
+		std::atomic<size_t> sequence;
+		VkDebugUtilsMessageSeverityFlagBitsEXT severity;
+		char text[MESSAGE_LENGTH];
+	};
+
+	struct IdSlot
+	{
+		std::atomic<uint64_t> key;		// Zero while the slot is free.
+		std::atomic<uint32_t> count;
+		char name[ID_NAME_LENGTH];
+	};
+
+	uint32_t CountMessage(const VkDebugUtilsMessengerCallbackDataEXT* pCallbackData);
+	bool Enqueue(VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity, const VkDebugUtilsMessengerCallbackDataEXT* pCallbackData);
+	bool Dequeue(VkDebugUtilsMessageSeverityFlagBitsEXT& messageSeverity, std::string& text);
+	void DrainThreadMain();
+	void WriteSummary();
+
+	std::atomic<VkDebugUtilsMessageSeverityFlagsEXT> severityMask;
+	std::atomic<VkDebugUtilsMessageTypeFlagsEXT> typeMask;
+	std::unique_ptr<RingSlot[]> ringArray;
+	std::atomic<size_t> enqueuePosition;
+	size_t dequeuePosition;
+	std::unique_ptr<IdSlot[]> idTableArray;
+	std::atomic<uint32_t> droppedCount;
+	std::atomic<uint32_t> filteredCount;
+	std::atomic<bool> stopping;
+	std::thread drainThread;
+	std::ofstream logFile;
+};
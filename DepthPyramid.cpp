@@ -0,0 +1,462 @@
+#include "DepthPyramid.h"
+#include "MemoryTracker.h"
+#include <algorithm>
+
+const VkFormat DEPTH_PYRAMID_DEPTH_FORMAT = VK_FORMAT_D32_SFLOAT;
+const VkFormat DEPTH_PYRAMID_FORMAT = VK_FORMAT_R32_SFLOAT;
+const uint32_t DEPTH_PYRAMID_MAX_LEVELS = 16;
+const uint32_t DEPTH_PYRAMID_GROUP_SIZE = 8;		// Must match the local size in hiz_reduce.comp, in both dimensions.
+
+DepthPyramid::DepthPyramid(Application* app)
+{
+	this->app = app;
+	this->extent = { 0, 0 };
+	this->pyramidExtent = { 0, 0 };
+	this->levelCount = 0;
+	this->valid = false;
+	this->layoutInitialized = false;
+	this->depthImage = VK_NULL_HANDLE;
+	this->depthImageMemory = nullptr;
+	this->depthImageView = VK_NULL_HANDLE;
+	this->renderPass = VK_NULL_HANDLE;
+	this->framebuffer = VK_NULL_HANDLE;
+	this->pyramidImage = VK_NULL_HANDLE;
+	this->pyramidImageMemory = nullptr;
+	this->pyramidView = VK_NULL_HANDLE;
+	this->sampler = VK_NULL_HANDLE;
+	this->descriptorSetLayout = VK_NULL_HANDLE;
+	this->descriptorPool = VK_NULL_HANDLE;
+	this->pipelineLayout = VK_NULL_HANDLE;
+	this->pipeline = VK_NULL_HANDLE;
+}
+
+/*virtual*/ DepthPyramid::~DepthPyramid()
+{
+}
+
+/*static*/ bool DepthPyramid::IsSupported(Application* app)
+{
+	VkFormatProperties formatProperties{};
+	vkGetPhysicalDeviceFormatProperties(app->physicalDevice, DEPTH_PYRAMID_DEPTH_FORMAT, &formatProperties);
+
+	VkFormatFeatureFlags requiredFeatures = VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT;
+	return requiredFeatures == (formatProperties.optimalTilingFeatures & requiredFeatures);
+}
+
+void DepthPyramid::Create()
+{
+	// Every fetch is an exact texel, so the sampler is only there because the descriptor type wants one.
+	VkSamplerCreateInfo samplerInfo{};
+	samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	samplerInfo.magFilter = VK_FILTER_NEAREST;
+	samplerInfo.minFilter = VK_FILTER_NEAREST;
+	samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.anisotropyEnable = VK_FALSE;
+	samplerInfo.maxAnisotropy = 1.0f;
+	samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+	samplerInfo.unnormalizedCoordinates = VK_FALSE;
+	samplerInfo.compareEnable = VK_FALSE;
+	samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
+	samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+	samplerInfo.minLod = 0.0f;
+	samplerInfo.maxLod = float(DEPTH_PYRAMID_MAX_LEVELS);
+
+	if (VK_SUCCESS != vkCreateSampler(this->app->logicalDevice, &samplerInfo, nullptr, &this->sampler))
+		throw new std::runtime_error("Failed to create depth pyramid sampler!");
+
+	this->CreateRenderPass();
+	this->CreateReducePipeline();
+	this->CreateImages();
+}
+
+void DepthPyramid::Destroy()
+{
+	VkDevice logicalDevice = this->app->logicalDevice;
+
+	this->DestroyImages();
+
+	vkDestroyPipeline(logicalDevice, this->pipeline, nullptr);
+	vkDestroyPipelineLayout(logicalDevice, this->pipelineLayout, nullptr);
+	vkDestroyDescriptorPool(logicalDevice, this->descriptorPool, nullptr);
+	vkDestroyDescriptorSetLayout(logicalDevice, this->descriptorSetLayout, nullptr);
+	vkDestroyRenderPass(logicalDevice, this->renderPass, nullptr);
+	vkDestroySampler(logicalDevice, this->sampler, nullptr);
+}
+
+/*static*/ VkFormat DepthPyramid::GetDepthFormat()
+{
+	return DEPTH_PYRAMID_DEPTH_FORMAT;
+}
+
+void DepthPyramid::Resize()
+{
+	this->DestroyImages();
+	this->CreateImages();
+}
+
+void DepthPyramid::CreateRenderPass()
+{
+	// Its own render pass, used whether or not we've got dynamic rendering, since it's nothing like the swap-chain's.
+	// It leaves the depth ready to be read by the reduction, which is what the outgoing dependency waits for.
+	VkAttachmentDescription depthAttachment{};
+	depthAttachment.format = DEPTH_PYRAMID_DEPTH_FORMAT;
+	depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+	depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+	depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+	depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+	depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	depthAttachment.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+	VkAttachmentReference depthAttachmentRef{};
+	depthAttachmentRef.attachment = 0;
+	depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+	VkSubpassDescription subpass{};
+	subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+	subpass.colorAttachmentCount = 0;
+	subpass.pDepthStencilAttachment = &depthAttachmentRef;
+
+	std::array<VkSubpassDependency, 2> dependencies{};
+
+	// The last reduction may still be reading the depth we're about to clear.
+	dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+	dependencies[0].dstSubpass = 0;
+	dependencies[0].srcStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+	dependencies[0].srcAccessMask = 0;
+	dependencies[0].dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+	dependencies[0].dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+	dependencies[1].srcSubpass = 0;
+	dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+	dependencies[1].srcStageMask = VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+	dependencies[1].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	dependencies[1].dstStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+	dependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+	VkRenderPassCreateInfo renderPassInfo{};
+	renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+	renderPassInfo.attachmentCount = 1;
+	renderPassInfo.pAttachments = &depthAttachment;
+	renderPassInfo.subpassCount = 1;
+	renderPassInfo.pSubpasses = &subpass;
+	renderPassInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
+	renderPassInfo.pDependencies = dependencies.data();
+
+	if (VK_SUCCESS != vkCreateRenderPass(this->app->logicalDevice, &renderPassInfo, nullptr, &this->renderPass))
+		throw new std::runtime_error("Failed to create depth pyramid render pass!");
+}
+
+void DepthPyramid::CreateReducePipeline()
+{
+	std::array<VkDescriptorSetLayoutBinding, 2> bindings{};
+
+	bindings[0].binding = 0;
+	bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	bindings[0].descriptorCount = 1;
+	bindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	bindings[1].binding = 1;
+	bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	bindings[1].descriptorCount = 1;
+	bindings[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo{};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+	layoutInfo.pBindings = bindings.data();
+
+	if (VK_SUCCESS != vkCreateDescriptorSetLayout(this->app->logicalDevice, &layoutInfo, nullptr, &this->descriptorSetLayout))
+		throw new std::runtime_error("Failed to create depth pyramid descriptor set layout!");
+
+	// Enough for the deepest pyramid we'd ever build; the sets are reallocated from scratch on a resize.
+	std::array<VkDescriptorPoolSize, 2> poolSizes{};
+	poolSizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	poolSizes[0].descriptorCount = DEPTH_PYRAMID_MAX_LEVELS;
+	poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	poolSizes[1].descriptorCount = DEPTH_PYRAMID_MAX_LEVELS;
+
+	VkDescriptorPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+	poolInfo.pPoolSizes = poolSizes.data();
+	poolInfo.maxSets = DEPTH_PYRAMID_MAX_LEVELS;
+
+	if (VK_SUCCESS != vkCreateDescriptorPool(this->app->logicalDevice, &poolInfo, nullptr, &this->descriptorPool))
+		throw new std::runtime_error("Failed to create depth pyramid descriptor pool!");
+
+	auto compShaderCode = Application::ReadFile("hiz_reduce_comp.spv");
+	VkShaderModule compShaderModule = this->app->CreateShaderModule(compShaderCode);
+
+	VkPipelineShaderStageCreateInfo compShaderStageInfo{};
+	compShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	compShaderStageInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	compShaderStageInfo.module = compShaderModule;
+	compShaderStageInfo.pName = "main";
+
+	// The source level's size, then the destination's.
+	VkPushConstantRange pushConstantRange{};
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	pushConstantRange.offset = 0;
+	pushConstantRange.size = 4 * sizeof(int32_t);
+
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount = 1;
+	pipelineLayoutInfo.pSetLayouts = &this->descriptorSetLayout;
+	pipelineLayoutInfo.pushConstantRangeCount = 1;
+	pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+	if (VK_SUCCESS != vkCreatePipelineLayout(this->app->logicalDevice, &pipelineLayoutInfo, nullptr, &this->pipelineLayout))
+		throw new std::runtime_error("Failed to create depth pyramid pipeline layout!");
+
+	VkComputePipelineCreateInfo pipelineInfo{};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipelineInfo.stage = compShaderStageInfo;
+	pipelineInfo.layout = this->pipelineLayout;
+
+	if (VK_SUCCESS != vkCreateComputePipelines(this->app->logicalDevice, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &this->pipeline))
+		throw new std::runtime_error("Failed to create depth pyramid pipeline!");
+
+	vkDestroyShaderModule(this->app->logicalDevice, compShaderModule, nullptr);
+}
+
+void DepthPyramid::CreateImages()
+{
+	VkDevice logicalDevice = this->app->logicalDevice;
+
+	this->extent = this->app->swapChainExtent;
+	this->pyramidExtent.width = std::max(this->extent.width / 2, 1u);
+	this->pyramidExtent.height = std::max(this->extent.height / 2, 1u);
+
+	this->levelCount = 1;
+	while (this->levelCount < DEPTH_PYRAMID_MAX_LEVELS && std::max(this->pyramidExtent.width, this->pyramidExtent.height) >> this->levelCount > 0)
+		this->levelCount++;
+
+	this->app->CreateImage(this->extent.width, this->extent.height, DEPTH_PYRAMID_DEPTH_FORMAT, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, this->depthImage, this->depthImageMemory);
+
+	VkImageViewCreateInfo viewInfo{};
+	viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+	viewInfo.image = this->depthImage;
+	viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+	viewInfo.format = DEPTH_PYRAMID_DEPTH_FORMAT;
+	viewInfo.subresourceRange = { VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0, 1 };
+
+	if (VK_SUCCESS != vkCreateImageView(logicalDevice, &viewInfo, nullptr, &this->depthImageView))
+		throw new std::runtime_error("Failed to create depth pyramid depth view!");
+
+	VkFramebufferCreateInfo framebufferInfo{};
+	framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+	framebufferInfo.renderPass = this->renderPass;
+	framebufferInfo.attachmentCount = 1;
+	framebufferInfo.pAttachments = &this->depthImageView;
+	framebufferInfo.width = this->extent.width;
+	framebufferInfo.height = this->extent.height;
+	framebufferInfo.layers = 1;
+
+	if (VK_SUCCESS != vkCreateFramebuffer(logicalDevice, &framebufferInfo, nullptr, &this->framebuffer))
+		throw new std::runtime_error("Failed to create depth pyramid framebuffer!");
+
+	// The application's CreateImage only does single-level images, so the pyramid is made here.
+	VkImageCreateInfo imageInfo{};
+	imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	imageInfo.imageType = VK_IMAGE_TYPE_2D;
+	imageInfo.extent.width = this->pyramidExtent.width;
+	imageInfo.extent.height = this->pyramidExtent.height;
+	imageInfo.extent.depth = 1;
+	imageInfo.mipLevels = this->levelCount;
+	imageInfo.arrayLayers = 1;
+	imageInfo.format = DEPTH_PYRAMID_FORMAT;
+	imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+	imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	imageInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+	imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+
+	if (VK_SUCCESS != vkCreateImage(logicalDevice, &imageInfo, nullptr, &this->pyramidImage))
+		throw new std::runtime_error("Failed to create depth pyramid image!");
+
+	VkMemoryRequirements memRequirements;
+	vkGetImageMemoryRequirements(logicalDevice, this->pyramidImage, &memRequirements);
+
+	VkMemoryAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.allocationSize = memRequirements.size;
+	allocInfo.memoryTypeIndex = this->app->FindMemoryType(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+	if (VK_SUCCESS != this->app->memoryTracker->Allocate(allocInfo, "depth pyramid", this->pyramidImageMemory))
+		throw new std::runtime_error("Failed to allocate depth pyramid memory!");
+
+	vkBindImageMemory(logicalDevice, this->pyramidImage, this->pyramidImageMemory, 0);
+
+	viewInfo.image = this->pyramidImage;
+	viewInfo.format = DEPTH_PYRAMID_FORMAT;
+	viewInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, this->levelCount, 0, 1 };
+
+	if (VK_SUCCESS != vkCreateImageView(logicalDevice, &viewInfo, nullptr, &this->pyramidView))
+		throw new std::runtime_error("Failed to create depth pyramid view!");
+
+	this->levelViewsArray.resize(this->levelCount);
+	for (uint32_t level = 0; level < this->levelCount; level++)
+	{
+		viewInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, level, 1, 0, 1 };
+
+		if (VK_SUCCESS != vkCreateImageView(logicalDevice, &viewInfo, nullptr, &this->levelViewsArray[level]))
+			throw new std::runtime_error("Failed to create depth pyramid level view!");
+	}
+
+	std::vector<VkDescriptorSetLayout> layoutsArray(this->levelCount, this->descriptorSetLayout);
+
+	VkDescriptorSetAllocateInfo setAllocInfo{};
+	setAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	setAllocInfo.descriptorPool = this->descriptorPool;
+	setAllocInfo.descriptorSetCount = this->levelCount;
+	setAllocInfo.pSetLayouts = layoutsArray.data();
+
+	this->descriptorSetsArray.resize(this->levelCount);
+	if (VK_SUCCESS != vkAllocateDescriptorSets(logicalDevice, &setAllocInfo, this->descriptorSetsArray.data()))
+		throw new std::runtime_error("Failed to allocate depth pyramid descriptor sets!");
+
+	for (uint32_t level = 0; level < this->levelCount; level++)
+	{
+		VkDescriptorImageInfo sourceInfo{};
+		sourceInfo.sampler = this->sampler;
+		sourceInfo.imageView = (level == 0) ? this->depthImageView : this->levelViewsArray[level - 1];
+		sourceInfo.imageLayout = (level == 0) ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_GENERAL;
+
+		VkDescriptorImageInfo destinationInfo{};
+		destinationInfo.imageView = this->levelViewsArray[level];
+		destinationInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+		std::array<VkWriteDescriptorSet, 2> descriptorWrites{};
+
+		descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWrites[0].dstSet = this->descriptorSetsArray[level];
+		descriptorWrites[0].dstBinding = 0;
+		descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		descriptorWrites[0].descriptorCount = 1;
+		descriptorWrites[0].pImageInfo = &sourceInfo;
+
+		descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWrites[1].dstSet = this->descriptorSetsArray[level];
+		descriptorWrites[1].dstBinding = 1;
+		descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+		descriptorWrites[1].descriptorCount = 1;
+		descriptorWrites[1].pImageInfo = &destinationInfo;
+
+		vkUpdateDescriptorSets(logicalDevice, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+	}
+
+	this->valid = false;
+	this->layoutInitialized = false;
+}
+
+void DepthPyramid::DestroyImages()
+{
+	VkDevice logicalDevice = this->app->logicalDevice;
+
+	vkResetDescriptorPool(logicalDevice, this->descriptorPool, 0);
+	this->descriptorSetsArray.clear();
+
+	for (VkImageView levelView : this->levelViewsArray)
+		vkDestroyImageView(logicalDevice, levelView, nullptr);
+	this->levelViewsArray.clear();
+
+	vkDestroyImageView(logicalDevice, this->pyramidView, nullptr);
+	vkDestroyImage(logicalDevice, this->pyramidImage, nullptr);
+	this->app->memoryTracker->Free(this->pyramidImageMemory);
+
+	vkDestroyFramebuffer(logicalDevice, this->framebuffer, nullptr);
+	vkDestroyImageView(logicalDevice, this->depthImageView, nullptr);
+	vkDestroyImage(logicalDevice, this->depthImage, nullptr);
+	this->app->memoryTracker->Free(this->depthImageMemory);
+
+	this->valid = false;
+}
+
+void DepthPyramid::BeginDepthPass(VkCommandBuffer givenCommandBuffer)
+{
+	VkClearValue clearDepth{};
+	clearDepth.depthStencil = { 1.0f, 0 };
+
+	VkRenderPassBeginInfo renderPassInfo{};
+	renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+	renderPassInfo.renderPass = this->renderPass;
+	renderPassInfo.framebuffer = this->framebuffer;
+	renderPassInfo.renderArea.offset = { 0, 0 };
+	renderPassInfo.renderArea.extent = this->extent;
+	renderPassInfo.clearValueCount = 1;
+	renderPassInfo.pClearValues = &clearDepth;
+
+	vkCmdBeginRenderPass(givenCommandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+	VkViewport viewport{};
+	viewport.x = 0.0f;
+	viewport.y = 0.0f;
+	viewport.width = float(this->extent.width);
+	viewport.height = float(this->extent.height);
+	viewport.minDepth = 0.0f;
+	viewport.maxDepth = 1.0f;
+	vkCmdSetViewport(givenCommandBuffer, 0, 1, &viewport);
+
+	VkRect2D scissor{};
+	scissor.offset = { 0, 0 };
+	scissor.extent = this->extent;
+	vkCmdSetScissor(givenCommandBuffer, 0, 1, &scissor);
+}
+
+void DepthPyramid::EndDepthPass(VkCommandBuffer givenCommandBuffer)
+{
+	vkCmdEndRenderPass(givenCommandBuffer);
+}
+
+void DepthPyramid::RecordBuild(VkCommandBuffer givenCommandBuffer)
+{
+	VkImageMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = this->pyramidImage;
+
+	// First time through, move the whole thing into the layout it'll stay in.
+	if (!this->layoutInitialized)
+	{
+		barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+		barrier.srcAccessMask = 0;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, this->levelCount, 0, 1 };
+		vkCmdPipelineBarrier(givenCommandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+		this->layoutInitialized = true;
+	}
+
+	vkCmdBindPipeline(givenCommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, this->pipeline);
+
+	int32_t sizes[4] = { int32_t(this->extent.width), int32_t(this->extent.height), int32_t(this->pyramidExtent.width), int32_t(this->pyramidExtent.height) };
+
+	// Each level waits for the one before it to be written.  The barrier after the last one is for whoever reads the
+	// pyramid next.
+	barrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+	barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+	barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+	for (uint32_t level = 0; level < this->levelCount; level++)
+	{
+		vkCmdBindDescriptorSets(givenCommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, this->pipelineLayout, 0, 1, &this->descriptorSetsArray[level], 0, nullptr);
+		vkCmdPushConstants(givenCommandBuffer, this->pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(sizes), sizes);
+		vkCmdDispatch(givenCommandBuffer, (uint32_t(sizes[2]) + DEPTH_PYRAMID_GROUP_SIZE - 1) / DEPTH_PYRAMID_GROUP_SIZE, (uint32_t(sizes[3]) + DEPTH_PYRAMID_GROUP_SIZE - 1) / DEPTH_PYRAMID_GROUP_SIZE, 1);
+
+		barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, level, 1, 0, 1 };
+		vkCmdPipelineBarrier(givenCommandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+		sizes[0] = sizes[2];
+		sizes[1] = sizes[3];
+		sizes[2] = std::max(sizes[2] / 2, 1);
+		sizes[3] = std::max(sizes[3] / 2, 1);
+	}
+
+	this->valid = true;
+}
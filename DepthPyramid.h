@@ -0,0 +1,76 @@
+#pragma once
+
+#include "Application.h"
+
+// A depth buffer of its own, swap-chain sized and rendered in a depth-only pass of its own, plus a hierarchical-Z
+// pyramid built from it by a compute reduction: each level is half the one below, as mip levels are, and each texel keeps
+// the farthest depth of the 2x2 texels it covers (the last row and column also take in the odd one out, if there is one).
+// So any screen rectangle can be tested against at most 2x2 texels of a suitably coarse level, and anything whose nearest
+// point is behind all of them is definitely hidden.
+//
+// The pyramid is left in the general layout for good, so it can be written and read by compute without transitions.
+// Until it has been built once (and again after a resize), it holds nothing and IsValid says so.
+class DepthPyramid
+{
+public:
+	DepthPyramid(Application* app);
+	virtual ~DepthPyramid();
+
+	// Whether the device can render to and sample the depth format we use.
+	static bool IsSupported(Application* app);
+
+	void Create();
+	void Destroy();
+
+	// Call after the swap-chain has been recreated, with the device idle.
+	void Resize();
+
+	// The depth-only pass; draw the occluders between these, at GetExtent, with pipelines made for GetRenderPass.
+	void BeginDepthPass(VkCommandBuffer givenCommandBuffer);
+	void EndDepthPass(VkCommandBuffer givenCommandBuffer);
+
+	// Reduces the depth just rendered into the pyramid; leaves it ready to be read by compute.
+	void RecordBuild(VkCommandBuffer givenCommandBuffer);
+
+	bool IsValid() const { return this->valid; }
+	VkExtent2D GetExtent() const { return this->extent; }
+	uint32_t GetLevelCount() const { return this->levelCount; }
+	VkRenderPass GetRenderPass() const { return this->renderPass; }
+	static VkFormat GetDepthFormat();
+
+	// The whole pyramid, for texelFetch from compute, in the general layout.
+	VkImageView GetPyramidView() const { return this->pyramidView; }
+	VkSampler GetSampler() const { return this->sampler; }
+
+private:
+	void CreateRenderPass();
+	void CreateReducePipeline();
+	void CreateImages();
+	void DestroyImages();
+
+	Application* app;
+	VkExtent2D extent;
+	VkExtent2D pyramidExtent;		// Level 0, which is already half the depth buffer.
+	uint32_t levelCount;
+	bool valid;
+	bool layoutInitialized;
+
+	VkImage depthImage;
+	VkDeviceMemory depthImageMemory;
+	VkImageView depthImageView;
+	VkRenderPass renderPass;
+	VkFramebuffer framebuffer;
+
+	VkImage pyramidImage;
+	VkDeviceMemory pyramidImageMemory;
+	VkImageView pyramidView;
+	std::vector<VkImageView> levelViewsArray;
+	VkSampler sampler;
+
+	// One set per level: the level below it (or the depth buffer) in, the level itself out.
+	VkDescriptorSetLayout descriptorSetLayout;
+	VkDescriptorPool descriptorPool;
+	std::vector<VkDescriptorSet> descriptorSetsArray;
+	VkPipelineLayout pipelineLayout;
+	VkPipeline pipeline;
+};
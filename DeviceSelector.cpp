@@ -0,0 +1,242 @@
+#include "DeviceSelector.h"
+#include <sstream>
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+
+static const char* DeviceTypeName(uint32_t deviceType)
+{
+	switch (deviceType)
+	{
+	case DeviceProfile::TYPE_INTEGRATED_GPU: return "integrated GPU";
+	case DeviceProfile::TYPE_DISCRETE_GPU: return "discrete GPU";
+	case DeviceProfile::TYPE_VIRTUAL_GPU: return "virtual GPU";
+	case DeviceProfile::TYPE_CPU: return "CPU (software rasterizer)";
+	default: return "other";
+	}
+}
+
+static std::string ToLower(std::string text)
+{
+	std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+	return text;
+}
+
+DeviceScore ScoreDevice(const DeviceProfile& profile)
+{
+	DeviceScore result;
+
+	auto add = [&result](int64_t points, const std::string& why)
+	{
+		if (points == 0)
+			return;
+
+		result.score += points;
+		result.reasons.push_back((points > 0 ? "+" : "") + std::to_string(points) + " " + why);
+	};
+
+	// Device type dominates everything else.  A discrete GPU with a small heap is still a better bet than an
+	// integrated one sharing system memory, and anything beats a software rasterizer.
+	int64_t typePoints = 0;
+	switch (profile.deviceType)
+	{
+	case DeviceProfile::TYPE_DISCRETE_GPU: typePoints = 10000; break;
+	case DeviceProfile::TYPE_INTEGRATED_GPU: typePoints = 5000; break;
+	case DeviceProfile::TYPE_VIRTUAL_GPU: typePoints = 2000; break;
+	case DeviceProfile::TYPE_CPU: typePoints = 100; break;
+	default: typePoints = 1000; break;
+	}
+	add(typePoints, DeviceTypeName(profile.deviceType));
+
+	// One point per 16 MiB of device-local memory, capped so that a huge shared heap can't outweigh the device type.
+	int64_t heapMiB = int64_t(profile.deviceLocalHeapBytes / (1024 * 1024));
+	add(std::min<int64_t>(heapMiB / 16, 2048), std::to_string(heapMiB) + " MiB device-local heap");
+
+	// Limits only serve as tie-breakers between otherwise similar devices.
+	add(profile.maxImageDimension2D / 1024, "maxImageDimension2D " + std::to_string(profile.maxImageDimension2D));
+	add(profile.maxComputeWorkGroupInvocations / 64, "maxComputeWorkGroupInvocations " + std::to_string(profile.maxComputeWorkGroupInvocations));
+	add(std::min<uint32_t>(profile.maxPerStageDescriptorSamplers, 1u << 20) / 4096, "maxPerStageDescriptorSamplers " + std::to_string(profile.maxPerStageDescriptorSamplers));
+
+	if (profile.asyncCompute)
+		add(300, "async compute queue");
+
+	if (profile.timestamps)
+		add(200, "timestamp queries");
+
+	if (profile.descriptorIndexing)
+		add(200, "descriptor indexing");
+
+	if (profile.dynamicRendering)
+		add(100, "dynamic rendering");
+
+	uint32_t minorVersion = (profile.apiVersion >> 12) & 0x3FF;
+	add(int64_t(minorVersion) * 50, "Vulkan 1." + std::to_string(minorVersion));
+
+	return result;
+}
+
+int SelectDevice(const std::vector<DeviceProfile>& profilesArray, const std::string& overrideSetting, std::ostream& log)
+{
+	log << "Ranking " << profilesArray.size() << " physical device(s)...\n";
+
+	int bestIndex = -1;
+	int64_t bestScore = 0;
+
+	for (int i = 0; i < (int)profilesArray.size(); i++)
+	{
+		const DeviceProfile& profile = profilesArray[i];
+
+		if (!profile.suitable)
+		{
+			log << '\t' << i << ": " << profile.name << " (not suitable: " << profile.unsuitableReason << ")\n";
+			continue;
+		}
+
+		DeviceScore score = ScoreDevice(profile);
+		log << '\t' << i << ": " << profile.name << " (score " << score.score << ")\n";
+		for (const std::string& reason : score.reasons)
+			log << "\t\t" << reason << '\n';
+
+		if (bestIndex < 0 || score.score > bestScore)
+		{
+			bestIndex = i;
+			bestScore = score.score;
+		}
+	}
+
+	if (!overrideSetting.empty())
+	{
+		int overrideIndex = -1;
+
+		bool isNumber = std::all_of(overrideSetting.begin(), overrideSetting.end(), [](unsigned char c) { return std::isdigit(c) != 0; });
+		if (isNumber)
+		{
+			overrideIndex = std::atoi(overrideSetting.c_str());
+		}
+		else
+		{
+			std::string wanted = ToLower(overrideSetting);
+			for (int i = 0; i < (int)profilesArray.size(); i++)
+			{
+				if (ToLower(profilesArray[i].name).find(wanted) != std::string::npos)
+				{
+					overrideIndex = i;
+					break;
+				}
+			}
+		}
+
+		if (overrideIndex >= 0 && overrideIndex < (int)profilesArray.size() && profilesArray[overrideIndex].suitable)
+		{
+			log << "Chose " << overrideIndex << ": " << profilesArray[overrideIndex].name << " (overridden by \"" << overrideSetting << "\")\n";
+			return overrideIndex;
+		}
+
+		log << "Ignoring device override \"" << overrideSetting << "\"; it doesn't name a suitable device.\n";
+	}
+
+	if (bestIndex >= 0)
+		log << "Chose " << bestIndex << ": " << profilesArray[bestIndex].name << " (highest score, " << bestScore << ")\n";
+
+	return bestIndex;
+}
+
+void WriteDeviceProfile(std::ostream& stream, const DeviceProfile& profile)
+{
+	stream << "name=" << profile.name << '\n';
+	stream << "vendorId=" << profile.vendorId << '\n';
+	stream << "deviceId=" << profile.deviceId << '\n';
+	stream << "apiVersion=" << profile.apiVersion << '\n';
+	stream << "deviceType=" << profile.deviceType << '\n';
+	stream << "deviceLocalHeapBytes=" << profile.deviceLocalHeapBytes << '\n';
+	stream << "maxImageDimension2D=" << profile.maxImageDimension2D << '\n';
+	stream << "maxComputeWorkGroupInvocations=" << profile.maxComputeWorkGroupInvocations << '\n';
+	stream << "maxPerStageDescriptorSamplers=" << profile.maxPerStageDescriptorSamplers << '\n';
+	stream << "timestamps=" << profile.timestamps << '\n';
+	stream << "descriptorIndexing=" << profile.descriptorIndexing << '\n';
+	stream << "asyncCompute=" << profile.asyncCompute << '\n';
+	stream << "dynamicRendering=" << profile.dynamicRendering << '\n';
+	stream << "suitable=" << profile.suitable << '\n';
+	stream << "unsuitableReason=" << profile.unsuitableReason << '\n';
+	stream << "end\n";
+}
+
+bool ReadDeviceProfile(std::istream& stream, DeviceProfile& profile)
+{
+	profile = DeviceProfile{};
+
+	// A dump is a sequence of key=value lines terminated by "end", so several profiles can live in one file.
+	bool readAnything = false;
+	std::string line;
+	while (std::getline(stream, line))
+	{
+		if (!line.empty() && line.back() == '\r')
+			line.pop_back();
+
+		if (line == "end")
+			return true;
+
+		size_t equals = line.find('=');
+		if (equals == std::string::npos)
+			continue;
+
+		readAnything = true;
+
+		std::string key = line.substr(0, equals);
+		std::string value = line.substr(equals + 1);
+		std::istringstream valueStream(value);
+
+		if (key == "name") profile.name = value;
+		else if (key == "vendorId") valueStream >> profile.vendorId;
+		else if (key == "deviceId") valueStream >> profile.deviceId;
+		else if (key == "apiVersion") valueStream >> profile.apiVersion;
+		else if (key == "deviceType") valueStream >> profile.deviceType;
+		else if (key == "deviceLocalHeapBytes") valueStream >> profile.deviceLocalHeapBytes;
+		else if (key == "maxImageDimension2D") valueStream >> profile.maxImageDimension2D;
+		else if (key == "maxComputeWorkGroupInvocations") valueStream >> profile.maxComputeWorkGroupInvocations;
+		else if (key == "maxPerStageDescriptorSamplers") valueStream >> profile.maxPerStageDescriptorSamplers;
+		else if (key == "timestamps") valueStream >> profile.timestamps;
+		else if (key == "descriptorIndexing") valueStream >> profile.descriptorIndexing;
+		else if (key == "asyncCompute") valueStream >> profile.asyncCompute;
+		else if (key == "dynamicRendering") valueStream >> profile.dynamicRendering;
+		else if (key == "suitable") valueStream >> profile.suitable;
+		else if (key == "unsuitableReason") profile.unsuitableReason = value;
+	}
+
+	return readAnything;
+}
+
+int ReplayDeviceProfiles(std::istream& stream, const std::string& overrideSetting, std::ostream& log)
+{
+	std::vector<DeviceProfile> profilesArray;
+	DeviceProfile profile;
+	while (ReadDeviceProfile(stream, profile))
+		profilesArray.push_back(profile);
+
+	// Writing what was read and reading that back has to give the very same text, or some field is getting lost.
+	int mismatchCount = 0;
+	for (int i = 0; i < (int)profilesArray.size(); i++)
+	{
+		std::ostringstream written;
+		WriteDeviceProfile(written, profilesArray[i]);
+
+		std::istringstream readBack(written.str());
+		DeviceProfile copy;
+		std::ostringstream rewritten;
+		if (ReadDeviceProfile(readBack, copy))
+			WriteDeviceProfile(rewritten, copy);
+
+		if (rewritten.str() != written.str())
+		{
+			log << "Device profile " << i << " (" << profilesArray[i].name << ") doesn't survive a round trip!\n";
+			mismatchCount++;
+		}
+	}
+
+	int chosenIndex = SelectDevice(profilesArray, overrideSetting, log);
+	if (chosenIndex < 0)
+		log << "No suitable device among the " << profilesArray.size() << " replayed.\n";
+
+	log << std::flush;
+	return (mismatchCount == 0 && chosenIndex >= 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <cstdint>
+
+// Everything we care about when choosing between physical devices, boiled down to plain data.  The application fills
+// these in from Vulkan queries, but they can just as well be read back from a recorded dump (see WriteDeviceProfile),
+// which is what lets the scoring be exercised without the hardware in question.
+struct DeviceProfile
+{
+	// Same values as VkPhysicalDeviceType.  Kept as plain integers so this header doesn't need Vulkan.
+	enum DeviceType : uint32_t
+	{
+		TYPE_OTHER = 0,
+		TYPE_INTEGRATED_GPU = 1,
+		TYPE_DISCRETE_GPU = 2,
+		TYPE_VIRTUAL_GPU = 3,
+		TYPE_CPU = 4
+	};
+
+	std::string name;
+	uint32_t vendorId = 0;
+	uint32_t deviceId = 0;
+	uint32_t apiVersion = 0;
+	uint32_t deviceType = TYPE_OTHER;
+	uint64_t deviceLocalHeapBytes = 0;		// Size of the largest device-local heap.
+	uint32_t maxImageDimension2D = 0;
+	uint32_t maxComputeWorkGroupInvocations = 0;
+	uint32_t maxPerStageDescriptorSamplers = 0;
+	bool timestamps = false;
+	bool descriptorIndexing = false;
+	bool asyncCompute = false;				// Has a compute queue family separate from the graphics one.
+	bool dynamicRendering = false;
+	bool suitable = false;					// Passes the application's hard requirements.
+	std::string unsuitableReason;
+};
+
+struct DeviceScore
+{
+	int64_t score = 0;
+	std::vector<std::string> reasons;
+};
+
+DeviceScore ScoreDevice(const DeviceProfile& profile);
+
+// Returns the index of the chosen profile, or -1 if none is suitable.  The override setting may be a device index or a
+// (case-insensitive) substring of the device name, and wins over the scores as long as it names a suitable device.
+// Everything considered, and why the winner won, is written to the given log.
+int SelectDevice(const std::vector<DeviceProfile>& profilesArray, const std::string& overrideSetting, std::ostream& log);
+
+void WriteDeviceProfile(std::ostream& stream, const DeviceProfile& profile);
+bool ReadDeviceProfile(std::istream& stream, DeviceProfile& profile);
+
+// Replays a choice against a dump written with VULKAN_TUTORIAL_DEVICE_DUMP: every profile in it is checked to come back
+// the same through WriteDeviceProfile and ReadDeviceProfile, then SelectDevice ranks them as if they were the devices
+// present.  Returns EXIT_FAILURE if any profile didn't survive the round trip or none is suitable.  Run with
+// "VulkanTutorial --replay-devices [dump file]".
+int ReplayDeviceProfiles(std::istream& stream, const std::string& overrideSetting, std::ostream& log);
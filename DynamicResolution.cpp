@@ -0,0 +1,429 @@
+#include "DynamicResolution.h"
+#include "MemoryTracker.h"
+#include "PipelineCache.h"
+#include <algorithm>
+#include <cmath>
+
+const float DYNAMIC_RESOLUTION_MIN_SCALE = 0.5f;
+const float DYNAMIC_RESOLUTION_MAX_SCALE = 1.0f;
+const float DYNAMIC_RESOLUTION_SMOOTHING = 0.25f;		// Weight of the newest measurement in the estimate.
+const float DYNAMIC_RESOLUTION_STEP_DOWN = 0.1f;		// Most the scale drops in one frame...
+const float DYNAMIC_RESOLUTION_STEP_UP = 0.02f;			// ...and rises, so it recovers without oscillating.
+const float DYNAMIC_RESOLUTION_HEADROOM = 0.9f;			// Only scale up while under this fraction of the target.
+const uint32_t DYNAMIC_RESOLUTION_REPORT_INTERVAL = 240;
+
+DynamicResolution::DynamicResolution(Application* app, float targetMilliseconds)
+{
+	this->app = app;
+	this->targetMilliseconds = targetMilliseconds;
+	this->scale = DYNAMIC_RESOLUTION_MAX_SCALE;
+	this->renderExtent = { 0, 0 };
+	this->sceneImage = VK_NULL_HANDLE;
+	this->sceneImageMemory = nullptr;
+	this->sceneImageView = VK_NULL_HANDLE;
+	this->sceneFramebuffer = VK_NULL_HANDLE;
+	this->sceneSampler = VK_NULL_HANDLE;
+	this->descriptorSetLayout = VK_NULL_HANDLE;
+	this->descriptorPool = VK_NULL_HANDLE;
+	this->descriptorSet = VK_NULL_HANDLE;
+	this->pipelineLayout = VK_NULL_HANDLE;
+	this->pipelineId = 0;
+	this->queryPool = VK_NULL_HANDLE;
+	this->timestampPeriod = 0.0f;
+	this->fullResolutionMilliseconds = 0.0f;
+	this->estimateValid = false;
+	this->reportFrameCount = 0;
+	this->reportMilliseconds = 0.0;
+	this->reportScale = 0.0;
+}
+
+/*virtual*/ DynamicResolution::~DynamicResolution()
+{
+}
+
+void DynamicResolution::Create()
+{
+	this->slotScales.resize(MAX_FRAMES_IN_FLIGHT, this->scale);
+
+	// Bilinear, so the upscale is a filter rather than a pixel doubler.
+	VkSamplerCreateInfo samplerInfo{};
+	samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	samplerInfo.magFilter = VK_FILTER_LINEAR;
+	samplerInfo.minFilter = VK_FILTER_LINEAR;
+	samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.anisotropyEnable = VK_FALSE;
+	samplerInfo.maxAnisotropy = 1.0f;
+	samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+	samplerInfo.unnormalizedCoordinates = VK_FALSE;
+	samplerInfo.compareEnable = VK_FALSE;
+	samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
+	samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+	samplerInfo.minLod = 0.0f;
+	samplerInfo.maxLod = 0.0f;
+
+	if (VK_SUCCESS != vkCreateSampler(this->app->logicalDevice, &samplerInfo, nullptr, &this->sceneSampler))
+		throw new std::runtime_error("Failed to create dynamic resolution sampler!");
+
+	this->CreateDescriptorSet();
+	this->CreateSceneImage();
+	this->CreatePipeline();
+	this->CreateQueryPool();
+
+	std::cout << "Dynamic resolution: aiming the scene at " << this->targetMilliseconds << " ms of GPU time, at "
+		<< int(DYNAMIC_RESOLUTION_MIN_SCALE * 100.0f) << "% to " << int(DYNAMIC_RESOLUTION_MAX_SCALE * 100.0f) << "% resolution" << std::endl;
+}
+
+void DynamicResolution::Destroy()
+{
+	VkDevice logicalDevice = this->app->logicalDevice;
+
+	this->DestroySceneImage();
+
+	vkDestroyQueryPool(logicalDevice, this->queryPool, nullptr);
+
+	// The upscale pipeline is left to the pipeline cache.  Freeing the pool frees the set that samples the scene image.
+	vkDestroyPipelineLayout(logicalDevice, this->pipelineLayout, nullptr);
+	vkDestroyDescriptorPool(logicalDevice, this->descriptorPool, nullptr);
+	vkDestroyDescriptorSetLayout(logicalDevice, this->descriptorSetLayout, nullptr);
+	vkDestroySampler(logicalDevice, this->sceneSampler, nullptr);
+}
+
+void DynamicResolution::Resize()
+{
+	// The device is idle, so nothing is still reading the old image.
+	this->DestroySceneImage();
+	this->CreateSceneImage();
+}
+
+void DynamicResolution::CreateSceneImage()
+{
+	VkDevice logicalDevice = this->app->logicalDevice;
+	VkExtent2D extent = this->app->swapChainExtent;
+	VkFormat format = this->app->swapChainImageFormat;
+
+	// Same format as the swap-chain, so every pipeline that draws the scene (and the render pass, if we're using one)
+	// works on it as it is.
+	this->app->CreateImage(extent.width, extent.height, format, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, this->sceneImage, this->sceneImageMemory);
+	this->sceneImageView = this->app->CreateImageView(this->sceneImage, format);
+
+	if (!this->app->dynamicRenderingEnabled)
+	{
+		VkFramebufferCreateInfo framebufferInfo{};
+		framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+		framebufferInfo.renderPass = this->app->renderPass;
+		framebufferInfo.attachmentCount = 1;
+		framebufferInfo.pAttachments = &this->sceneImageView;
+		framebufferInfo.width = extent.width;
+		framebufferInfo.height = extent.height;
+		framebufferInfo.layers = 1;
+
+		if (VK_SUCCESS != vkCreateFramebuffer(logicalDevice, &framebufferInfo, nullptr, &this->sceneFramebuffer))
+			throw new std::runtime_error("Failed to create dynamic resolution framebuffer!");
+	}
+
+	VkDescriptorImageInfo imageInfo{};
+	imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	imageInfo.imageView = this->sceneImageView;
+	imageInfo.sampler = this->sceneSampler;
+
+	VkWriteDescriptorSet descriptorWrite{};
+	descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	descriptorWrite.dstSet = this->descriptorSet;
+	descriptorWrite.dstBinding = 0;
+	descriptorWrite.dstArrayElement = 0;
+	descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	descriptorWrite.descriptorCount = 1;
+	descriptorWrite.pImageInfo = &imageInfo;
+
+	vkUpdateDescriptorSets(logicalDevice, 1, &descriptorWrite, 0, nullptr);
+
+	this->renderExtent = extent;
+}
+
+void DynamicResolution::DestroySceneImage()
+{
+	VkDevice logicalDevice = this->app->logicalDevice;
+
+	if (this->sceneFramebuffer != VK_NULL_HANDLE)
+		vkDestroyFramebuffer(logicalDevice, this->sceneFramebuffer, nullptr);
+
+	vkDestroyImageView(logicalDevice, this->sceneImageView, nullptr);
+	vkDestroyImage(logicalDevice, this->sceneImage, nullptr);
+	this->app->memoryTracker->Free(this->sceneImageMemory);
+
+	this->sceneFramebuffer = VK_NULL_HANDLE;
+	this->sceneImageView = VK_NULL_HANDLE;
+	this->sceneImage = VK_NULL_HANDLE;
+	this->sceneImageMemory = nullptr;
+}
+
+void DynamicResolution::CreateDescriptorSet()
+{
+	VkDescriptorSetLayoutBinding samplerLayoutBinding{};
+	samplerLayoutBinding.binding = 0;
+	samplerLayoutBinding.descriptorCount = 1;
+	samplerLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	samplerLayoutBinding.pImmutableSamplers = nullptr;
+	samplerLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo{};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.bindingCount = 1;
+	layoutInfo.pBindings = &samplerLayoutBinding;
+
+	if (VK_SUCCESS != vkCreateDescriptorSetLayout(this->app->logicalDevice, &layoutInfo, nullptr, &this->descriptorSetLayout))
+		throw new std::runtime_error("Failed to create dynamic resolution descriptor set layout!");
+
+	VkDescriptorPoolSize poolSize{};
+	poolSize.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	poolSize.descriptorCount = 1;
+
+	VkDescriptorPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.poolSizeCount = 1;
+	poolInfo.pPoolSizes = &poolSize;
+	poolInfo.maxSets = 1;
+
+	if (VK_SUCCESS != vkCreateDescriptorPool(this->app->logicalDevice, &poolInfo, nullptr, &this->descriptorPool))
+		throw new std::runtime_error("Failed to create dynamic resolution descriptor pool!");
+
+	VkDescriptorSetAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = this->descriptorPool;
+	allocInfo.descriptorSetCount = 1;
+	allocInfo.pSetLayouts = &this->descriptorSetLayout;
+
+	if (VK_SUCCESS != vkAllocateDescriptorSets(this->app->logicalDevice, &allocInfo, &this->descriptorSet))
+		throw new std::runtime_error("Failed to allocate dynamic resolution descriptor set!");
+}
+
+void DynamicResolution::CreatePipeline()
+{
+	VkPushConstantRange pushConstantRange{};
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+	pushConstantRange.offset = 0;
+	pushConstantRange.size = sizeof(UpscalePushConstants);
+
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount = 1;
+	pipelineLayoutInfo.pSetLayouts = &this->descriptorSetLayout;
+	pipelineLayoutInfo.pushConstantRangeCount = 1;
+	pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+	if (VK_SUCCESS != vkCreatePipelineLayout(this->app->logicalDevice, &pipelineLayoutInfo, nullptr, &this->pipelineLayout))
+		throw new std::runtime_error("Failed to create dynamic resolution pipeline layout!");
+
+	PipelineCache* pipelineCache = this->app->pipelineCache;
+
+	// No vertex inputs at all; the shader makes its triangle out of the vertex index.
+	PipelineState state;
+	state.layout = this->pipelineLayout;
+	state.vertexShader = pipelineCache->AddShader(Application::ReadFile("upscale_vert.spv"));
+	state.fragmentShader = pipelineCache->AddShader(Application::ReadFile("upscale_frag.spv"));
+	state.colorFormat = this->app->swapChainImageFormat;
+	state.cullMode = VK_CULL_MODE_NONE;
+
+	this->pipelineId = pipelineCache->Request(state);
+}
+
+void DynamicResolution::CreateQueryPool()
+{
+	// The caller has checked that the graphics queue has timestamps; without them there's nothing to steer by.
+	VkPhysicalDeviceProperties properties{};
+	vkGetPhysicalDeviceProperties(this->app->physicalDevice, &properties);
+	this->timestampPeriod = properties.limits.timestampPeriod;
+	this->timingsPending.resize(MAX_FRAMES_IN_FLIGHT, false);
+
+	VkQueryPoolCreateInfo queryPoolInfo{};
+	queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+	queryPoolInfo.queryCount = 2 * static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+
+	if (VK_SUCCESS != vkCreateQueryPool(this->app->logicalDevice, &queryPoolInfo, nullptr, &this->queryPool))
+		throw new std::runtime_error("Failed to create dynamic resolution query pool!");
+}
+
+void DynamicResolution::Update(uint32_t i)
+{
+	this->CollectTimings(i);
+
+	if (this->estimateValid)
+	{
+		// The scale that would bring the full-resolution cost down to the target, approached at a limited rate.
+		float idealScale = std::sqrt(this->targetMilliseconds / std::max(this->fullResolutionMilliseconds, 0.001f));
+		float currentMilliseconds = this->fullResolutionMilliseconds * this->scale * this->scale;
+
+		if (currentMilliseconds > this->targetMilliseconds)
+			this->scale = std::max(idealScale, this->scale - DYNAMIC_RESOLUTION_STEP_DOWN);
+		else if (currentMilliseconds < this->targetMilliseconds * DYNAMIC_RESOLUTION_HEADROOM)
+			this->scale = std::min(idealScale, this->scale + DYNAMIC_RESOLUTION_STEP_UP);
+
+		this->scale = std::clamp(this->scale, DYNAMIC_RESOLUTION_MIN_SCALE, DYNAMIC_RESOLUTION_MAX_SCALE);
+	}
+
+	VkExtent2D extent = this->app->swapChainExtent;
+	this->renderExtent.width = std::clamp((uint32_t)std::lround(float(extent.width) * this->scale), 1u, extent.width);
+	this->renderExtent.height = std::clamp((uint32_t)std::lround(float(extent.height) * this->scale), 1u, extent.height);
+	this->slotScales[i] = this->scale;
+
+	this->reportFrameCount++;
+	this->reportScale += this->scale;
+	if (this->reportFrameCount == DYNAMIC_RESOLUTION_REPORT_INTERVAL)
+	{
+		std::cout << "Dynamic resolution: " << int(100.0 * this->reportScale / double(this->reportFrameCount)) << "% on average, now "
+			<< this->renderExtent.width << "x" << this->renderExtent.height << ", scene GPU " << this->reportMilliseconds / double(this->reportFrameCount)
+			<< " ms (target " << this->targetMilliseconds << ")" << std::endl;
+
+		this->reportFrameCount = 0;
+		this->reportMilliseconds = 0.0;
+		this->reportScale = 0.0;
+	}
+}
+
+void DynamicResolution::CollectTimings(uint32_t i)
+{
+	// The slot's frame has finished, so its results are there without waiting.
+	if (!this->timingsPending[i])
+		return;
+
+	this->timingsPending[i] = false;
+
+	uint64_t timestamps[2] = { 0, 0 };
+	if (VK_SUCCESS != vkGetQueryPoolResults(this->app->logicalDevice, this->queryPool, 2 * i, 2, sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT))
+		return;
+
+	float milliseconds = float(double(timestamps[1] - timestamps[0]) * double(this->timestampPeriod) * 1e-6);
+	this->reportMilliseconds += milliseconds;
+
+	// What the frame would have cost at full resolution, had it been rendered at that.
+	float slotScale = this->slotScales[i];
+	float fullMilliseconds = milliseconds / (slotScale * slotScale);
+
+	if (this->estimateValid)
+		this->fullResolutionMilliseconds += DYNAMIC_RESOLUTION_SMOOTHING * (fullMilliseconds - this->fullResolutionMilliseconds);
+	else
+		this->fullResolutionMilliseconds = fullMilliseconds;
+
+	this->estimateValid = true;
+}
+
+void DynamicResolution::BeginScene(VkCommandBuffer givenCommandBuffer, uint32_t i)
+{
+	// Query resets aren't allowed inside rendering, so this goes first.
+	vkCmdResetQueryPool(givenCommandBuffer, this->queryPool, 2 * i, 2);
+	vkCmdWriteTimestamp(givenCommandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, this->queryPool, 2 * i);
+
+	// The last frame's upscale may still be reading the image, so wait for that before writing it; its old contents
+	// don't matter.
+	VkImageMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	barrier.newLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = this->sceneImage;
+	barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+	barrier.srcAccessMask = 0;
+	barrier.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+	vkCmdPipelineBarrier(givenCommandBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+	VkClearValue clearColor = { {{0.0f, 0.0f, 0.0f, 1.0f}} };
+
+	if (this->app->dynamicRenderingEnabled)
+	{
+		VkRenderingAttachmentInfoKHR colorAttachment{};
+		colorAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+		colorAttachment.imageView = this->sceneImageView;
+		colorAttachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		colorAttachment.resolveMode = VK_RESOLVE_MODE_NONE;
+		colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+		colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+		colorAttachment.clearValue = clearColor;
+
+		VkRenderingInfoKHR renderingInfo{};
+		renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO_KHR;
+		renderingInfo.renderArea.offset = { 0, 0 };
+		renderingInfo.renderArea.extent = this->renderExtent;
+		renderingInfo.layerCount = 1;
+		renderingInfo.colorAttachmentCount = 1;
+		renderingInfo.pColorAttachments = &colorAttachment;
+
+		this->app->pfnCmdBeginRendering(givenCommandBuffer, &renderingInfo);
+	}
+	else
+	{
+		VkRenderPassBeginInfo renderPassInfo{};
+		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+		renderPassInfo.renderPass = this->app->renderPass;
+		renderPassInfo.framebuffer = this->sceneFramebuffer;
+		renderPassInfo.renderArea.offset = { 0, 0 };
+		renderPassInfo.renderArea.extent = this->renderExtent;
+		renderPassInfo.clearValueCount = 1;
+		renderPassInfo.pClearValues = &clearColor;
+
+		vkCmdBeginRenderPass(givenCommandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+	}
+}
+
+void DynamicResolution::EndScene(VkCommandBuffer givenCommandBuffer, uint32_t i)
+{
+	// Dynamic rendering leaves the scene image a color attachment.  The application's render pass, made for the swap
+	// chain, leaves it in the present layout instead, though it's never presented; the upscale samples it either way.
+	VkImageLayout renderedLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+	if (this->app->dynamicRenderingEnabled)
+	{
+		this->app->pfnCmdEndRendering(givenCommandBuffer);
+	}
+	else
+	{
+		vkCmdEndRenderPass(givenCommandBuffer);
+		renderedLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+	}
+
+	vkCmdWriteTimestamp(givenCommandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, this->queryPool, 2 * i + 1);
+	this->timingsPending[i] = true;
+
+	VkImageMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.oldLayout = renderedLayout;
+	barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = this->sceneImage;
+	barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+	barrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	vkCmdPipelineBarrier(givenCommandBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+}
+
+void DynamicResolution::RecordUpscale(VkCommandBuffer givenCommandBuffer)
+{
+	VkExtent2D extent = this->app->swapChainExtent;
+
+	UpscalePushConstants pushConstants;
+	pushConstants.uvScale = glm::vec2(float(this->renderExtent.width) / float(extent.width), float(this->renderExtent.height) / float(extent.height));
+	pushConstants.uvClamp = pushConstants.uvScale - glm::vec2(0.5f / float(extent.width), 0.5f / float(extent.height));
+
+	vkCmdBindPipeline(givenCommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, this->app->pipelineCache->GetPipeline(this->pipelineId));
+	vkCmdPushConstants(givenCommandBuffer, this->pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(pushConstants), &pushConstants);
+	vkCmdBindDescriptorSets(givenCommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, this->pipelineLayout, 0, 1, &this->descriptorSet, 0, nullptr);
+
+	// Full-screen, which is also what anything drawn after us expects.
+	VkViewport viewport{};
+	viewport.x = 0.0f;
+	viewport.y = 0.0f;
+	viewport.width = float(extent.width);
+	viewport.height = float(extent.height);
+	viewport.minDepth = 0.0f;
+	viewport.maxDepth = 1.0f;
+	vkCmdSetViewport(givenCommandBuffer, 0, 1, &viewport);
+
+	VkRect2D scissor{};
+	scissor.offset = { 0, 0 };
+	scissor.extent = extent;
+	vkCmdSetScissor(givenCommandBuffer, 0, 1, &scissor);
+
+	vkCmdDraw(givenCommandBuffer, 3, 1, 0, 0);
+}
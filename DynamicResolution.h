@@ -0,0 +1,81 @@
+#pragma once
+
+#include "Application.h"
+
+// Renders the scene into an image of its own at somewhere between half and full resolution, then scales it up to the
+// swap-chain with a filtered full-screen draw, so that a GPU load spike costs resolution rather than frame rate.  The
+// scale is picked each frame by a small controller that's fed the scene's GPU time from timestamp queries: GPU time goes
+// roughly with the number of pixels, so it estimates what the scene would cost at full resolution and picks the scale
+// whose square brings that down to the target, dropping quickly when over and creeping back up when there's room.
+//
+// The scene image is always swap-chain sized, and only the top-left part of it is rendered to, so changing the scale
+// never reallocates anything, and the swap-chain itself is left alone.  Anything drawn after the upscale (the HUD, say)
+// is drawn at full resolution.
+class DynamicResolution
+{
+public:
+	DynamicResolution(Application* app, float targetMilliseconds);
+	virtual ~DynamicResolution();
+
+	void Create();
+	void Destroy();
+
+	// Call after the swap-chain has been recreated.
+	void Resize();
+
+	// Call once slot i's frame has finished on the GPU; picks the scale for the frame about to be recorded.
+	void Update(uint32_t i);
+
+	float GetScale() const { return this->scale; }
+	VkExtent2D GetRenderExtent() const { return this->renderExtent; }
+
+	// In place of beginning the swap-chain's rendering, for the scene; draw at GetRenderExtent.
+	void BeginScene(VkCommandBuffer givenCommandBuffer, uint32_t i);
+	void EndScene(VkCommandBuffer givenCommandBuffer, uint32_t i);
+
+	// Inside the swap-chain's rendering, after EndScene.
+	void RecordUpscale(VkCommandBuffer givenCommandBuffer);
+
+private:
+	struct UpscalePushConstants
+	{
+		glm::vec2 uvScale;
+		glm::vec2 uvClamp;
+	};
+
+	void CreateSceneImage();
+	void DestroySceneImage();
+	void CreateDescriptorSet();
+	void CreatePipeline();
+	void CreateQueryPool();
+	void CollectTimings(uint32_t i);
+
+	Application* app;
+	float targetMilliseconds;
+	float scale;
+	VkExtent2D renderExtent;
+
+	VkImage sceneImage;
+	VkDeviceMemory sceneImageMemory;
+	VkImageView sceneImageView;
+	VkFramebuffer sceneFramebuffer;		// Only with the render pass; dynamic rendering needs none.
+	VkSampler sceneSampler;
+	VkDescriptorSetLayout descriptorSetLayout;
+	VkDescriptorPool descriptorPool;
+	VkDescriptorSet descriptorSet;
+	VkPipelineLayout pipelineLayout;
+	uint32_t pipelineId;				// From the application's pipeline cache.
+
+	// Two timestamps per frame in flight, around the scene.
+	VkQueryPool queryPool;
+	float timestampPeriod;
+	std::vector<bool> timingsPending;
+	std::vector<float> slotScales;		// The scale each slot's frame was rendered at.
+
+	float fullResolutionMilliseconds;	// Smoothed estimate of what the scene would cost unscaled.
+	bool estimateValid;
+
+	uint32_t reportFrameCount;
+	double reportMilliseconds;
+	double reportScale;
+};
@@ -0,0 +1,220 @@
+#include "FrameCapture.h"
+#include "MemoryTracker.h"
+#include "ThreadPool.h"
+#include "OffscreenRenderer.h"
+#include <stb_image_write.h>
+#include <cstring>
+#include <cstdio>
+
+const uint32_t FRAME_CAPTURE_SLOTS = MAX_FRAMES_IN_FLIGHT + 2;		// Enough to capture every frame while the workers keep up.
+
+FrameCapture::FrameCapture(Application* app, const std::string& pathPrefix)
+{
+	this->app = app;
+	this->pathPrefix = pathPrefix;
+	this->readbackMemoryProperties = 0;
+	this->screenshotRequested = false;
+	this->sequenceFramesLeft = 0;
+	this->statistics = Statistics{};
+	this->writtenCount.store(0);
+}
+
+/*virtual*/ FrameCapture::~FrameCapture()
+{
+}
+
+void FrameCapture::Create()
+{
+	if (!OffscreenRenderer::ConvertToRgba(this->app->swapChainImageFormat, nullptr, 0))
+		throw new std::runtime_error("Frame capture needs an 8-bit RGBA or BGRA swap-chain format!");
+
+	this->readbackMemoryProperties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+	if (this->app->memoryTracker->HasMemoryType(this->readbackMemoryProperties | VK_MEMORY_PROPERTY_HOST_CACHED_BIT))
+		this->readbackMemoryProperties |= VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+
+	// The buffers themselves are made on first use, at whatever size the swap-chain is then.
+	this->slotsArray.reset(new Slot[FRAME_CAPTURE_SLOTS]);
+	for (uint32_t j = 0; j < FRAME_CAPTURE_SLOTS; j++)
+	{
+		Slot& slot = this->slotsArray[j];
+		slot.state.store(SLOT_FREE);
+		slot.buffer = VK_NULL_HANDLE;
+		slot.bufferMemory = nullptr;
+		slot.mappedPixels = nullptr;
+		slot.size = 0;
+		slot.width = 0;
+		slot.height = 0;
+		slot.frameNumber = 0;
+	}
+}
+
+void FrameCapture::Destroy()
+{
+	// The device is idle and the thread pool is gone by now, so whatever was still being copied is done, and can be
+	// written out here rather than lost off the end of a sequence.
+	for (uint32_t j = 0; j < FRAME_CAPTURE_SLOTS; j++)
+	{
+		Slot& slot = this->slotsArray[j];
+		if (slot.state.load() == SLOT_COPYING)
+		{
+			slot.state.store(SLOT_WRITING);
+			this->WriteSlot(&slot);
+		}
+
+		vkDestroyBuffer(this->app->logicalDevice, slot.buffer, nullptr);
+		this->app->memoryTracker->Free(slot.bufferMemory);
+	}
+
+	this->slotsArray.reset();
+
+	this->statistics.writtenCount = this->writtenCount.load();
+	std::cout << "Frame capture: " << this->statistics.capturedCount << " captured, " << this->statistics.writtenCount << " written, " << this->statistics.droppedCount << " dropped" << std::endl;
+}
+
+void FrameCapture::RequestScreenshot()
+{
+	this->screenshotRequested = true;
+}
+
+void FrameCapture::StartSequence(uint32_t frameCount)
+{
+	this->sequenceFramesLeft = (frameCount == 0) ? UINT32_MAX : frameCount;
+}
+
+void FrameCapture::StopSequence()
+{
+	this->sequenceFramesLeft = 0;
+}
+
+void FrameCapture::Service()
+{
+	// Any copy recorded into a frame the GPU has finished is finished too.
+	uint64_t completedFrame = this->app->GetCompletedFrame();
+
+	for (uint32_t j = 0; j < FRAME_CAPTURE_SLOTS; j++)
+	{
+		Slot* slot = &this->slotsArray[j];
+		if (slot->state.load() != SLOT_COPYING || slot->frameNumber > completedFrame)
+			continue;
+
+		slot->state.store(SLOT_WRITING);
+		this->app->threadPool->Submit([this, slot]() { this->WriteSlot(slot); });
+	}
+
+	this->statistics.writtenCount = this->writtenCount.load();
+}
+
+void FrameCapture::RecordCopy(VkCommandBuffer givenCommandBuffer, uint32_t imageIndex)
+{
+	if (!this->screenshotRequested && this->sequenceFramesLeft == 0)
+		return;
+
+	if (this->sequenceFramesLeft > 0 && this->sequenceFramesLeft != UINT32_MAX)
+		this->sequenceFramesLeft--;
+
+	uint32_t width = this->app->swapChainExtent.width;
+	uint32_t height = this->app->swapChainExtent.height;
+
+	// Nothing free means the writers are behind; a screenshot just waits for the next frame, a sequence skips this one.
+	Slot* slot = this->FindFreeSlot(4 * VkDeviceSize(width) * height);
+	if (!slot)
+	{
+		if (!this->screenshotRequested)
+			this->statistics.droppedCount++;
+		return;
+	}
+
+	this->screenshotRequested = false;
+
+	slot->width = width;
+	slot->height = height;
+	slot->frameNumber = this->app->frameCount;
+	slot->state.store(SLOT_COPYING);
+	this->statistics.capturedCount++;
+
+	VkImageMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.oldLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+	barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = this->app->swapChainImages[imageIndex];
+	barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+	barrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+	vkCmdPipelineBarrier(givenCommandBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+	VkBufferImageCopy region{};
+	region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+	region.imageExtent = { width, height, 1 };
+	vkCmdCopyImageToBuffer(givenCommandBuffer, barrier.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, slot->buffer, 1, &region);
+
+	// Back to where presentation expects it.  Presentation waits on the frame's semaphore, so there's nothing to make
+	// visible to it here.
+	barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+	barrier.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+	barrier.dstAccessMask = 0;
+	vkCmdPipelineBarrier(givenCommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+	VkBufferMemoryBarrier bufferBarrier{};
+	bufferBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	bufferBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	bufferBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+	bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	bufferBarrier.buffer = slot->buffer;
+	bufferBarrier.offset = 0;
+	bufferBarrier.size = VK_WHOLE_SIZE;
+	vkCmdPipelineBarrier(givenCommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &bufferBarrier, 0, nullptr);
+}
+
+FrameCapture::Slot* FrameCapture::FindFreeSlot(VkDeviceSize size)
+{
+	for (uint32_t j = 0; j < FRAME_CAPTURE_SLOTS; j++)
+	{
+		Slot* slot = &this->slotsArray[j];
+		if (slot->state.load(std::memory_order_acquire) != SLOT_FREE)
+			continue;
+
+		// A free slot isn't in use by the GPU or a worker, so it can be regrown if the swap-chain got bigger.
+		if (slot->size < size)
+		{
+			vkDestroyBuffer(this->app->logicalDevice, slot->buffer, nullptr);
+			this->app->memoryTracker->Free(slot->bufferMemory);
+
+			this->app->CreateBuffer(size, VK_BUFFER_USAGE_TRANSFER_DST_BIT, this->readbackMemoryProperties, slot->buffer, slot->bufferMemory);
+			vkMapMemory(this->app->logicalDevice, slot->bufferMemory, 0, size, 0, (void**)&slot->mappedPixels);
+			slot->size = size;
+		}
+
+		return slot;
+	}
+
+	return nullptr;
+}
+
+void FrameCapture::WriteSlot(Slot* slot)
+{
+	// Copy out and give the slot back first; the conversion and encoding can take as long as they like after that.
+	uint32_t width = slot->width;
+	uint32_t height = slot->height;
+	uint64_t frameNumber = slot->frameNumber;
+	std::vector<uint8_t> pixels(slot->mappedPixels, slot->mappedPixels + 4 * size_t(width) * height);
+	slot->state.store(SLOT_FREE, std::memory_order_release);
+
+	OffscreenRenderer::ConvertToRgba(this->app->swapChainImageFormat, pixels.data(), size_t(width) * height);
+
+	// Presented images are opaque, whatever the alpha channel says.
+	for (size_t j = 3; j < pixels.size(); j += 4)
+		pixels[j] = 255;
+
+	char suffix[32];
+	::snprintf(suffix, sizeof(suffix), "%06llu.png", (unsigned long long)frameNumber);
+	std::string filePath = this->pathPrefix + suffix;
+
+	if (0 == stbi_write_png(filePath.c_str(), (int)width, (int)height, 4, pixels.data(), (int)width * 4))
+		std::cerr << "Failed to write " << filePath << "!" << std::endl;
+	else
+		this->writtenCount.fetch_add(1);
+}
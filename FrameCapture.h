@@ -0,0 +1,73 @@
+#pragma once
+
+#include "Application.h"
+#include <atomic>
+#include <memory>
+
+// Captures presented frames (single screenshots, or every frame for a while) without the render loop ever waiting on
+// the GPU or the disk.  A capture is a copy of the swap-chain image, recorded at the end of the frame's own command
+// buffer, into one of a small ring of persistently mapped readback buffers.  The buffer isn't looked at until the GPU
+// says it has finished that frame, which is usually by the next one, at which point it's handed to the thread pool to
+// be converted and written out as a PNG, and goes back into the ring as soon as its pixels have been copied out.  If
+// the ring or the writers can't keep up, captures are dropped (and counted), never the frames themselves.
+class FrameCapture
+{
+public:
+	struct Statistics
+	{
+		uint64_t capturedCount;
+		uint64_t writtenCount;
+		uint64_t droppedCount;
+	};
+
+	FrameCapture(Application* app, const std::string& pathPrefix);
+	virtual ~FrameCapture();
+
+	void Create();
+	void Destroy();
+
+	void RequestScreenshot();
+	void StartSequence(uint32_t frameCount);		// Zero means until StopSequence.
+	void StopSequence();
+	bool IsSequenceRunning() const { return this->sequenceFramesLeft > 0; }
+
+	// Call once a frame; it only polls.
+	void Service();
+
+	// Call after the frame's rendering has ended, with the swap-chain image ready to present.
+	void RecordCopy(VkCommandBuffer givenCommandBuffer, uint32_t imageIndex);
+
+	const Statistics& GetStatistics() const { return this->statistics; }
+
+private:
+	enum SlotState : uint32_t
+	{
+		SLOT_FREE,
+		SLOT_COPYING,		// Recorded into a frame the GPU may not have finished yet.
+		SLOT_WRITING		// Handed to a worker, which is still copying the pixels out.
+	};
+
+	struct Slot
+	{
+		std::atomic<uint32_t> state;
+		VkBuffer buffer;
+		VkDeviceMemory bufferMemory;
+		uint8_t* mappedPixels;
+		VkDeviceSize size;
+		uint32_t width;
+		uint32_t height;
+		uint64_t frameNumber;		// Also what the copy waits on; see Application::GetCompletedFrame.
+	};
+
+	Slot* FindFreeSlot(VkDeviceSize size);
+	void WriteSlot(Slot* slot);
+
+	Application* app;
+	std::string pathPrefix;
+	VkMemoryPropertyFlags readbackMemoryProperties;
+	std::unique_ptr<Slot[]> slotsArray;
+	bool screenshotRequested;
+	uint32_t sequenceFramesLeft;
+	Statistics statistics;
+	std::atomic<uint64_t> writtenCount;		// Bumped by the workers; copied into the statistics in Service.
+};
@@ -0,0 +1,222 @@
+#include "FrustumCuller.h"
+#include <algorithm>
+#include <cmath>
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define FRUSTUM_CULLER_SSE
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <immintrin.h>
+#endif
+#endif
+
+const uint32_t CULL_CHUNK_SIZE = 16 * 1024;		// Volumes per chunk; each chunk writes its survivors into its own slice.
+
+FrustumCuller::FrustumCuller()
+{
+	for (int j = 0; j < 6; j++)
+		for (int k = 0; k < 4; k++)
+			this->planes[j][k] = 0.0f;
+
+	this->SetSimdEnabled(true);
+	this->statistics = Statistics{};
+}
+
+/*virtual*/ FrustumCuller::~FrustumCuller()
+{
+}
+
+void FrustumCuller::SetSimdEnabled(bool simdEnabled)
+{
+#if defined(FRUSTUM_CULLER_SSE)
+	this->simdEnabled = simdEnabled;
+#else
+	this->simdEnabled = false;
+#endif
+}
+
+void FrustumCuller::SetViewProjection(const float* viewProjection)
+{
+	// A point p is inside when -w <= x <= w, -w <= y <= w and 0 <= z <= w in clip space, and each of those is a plane
+	// equation in terms of the rows of the matrix (Gribb and Hartmann).  Row r is every fourth float, starting at r.
+	float rows[4][4];
+	for (int row = 0; row < 4; row++)
+		for (int column = 0; column < 4; column++)
+			rows[row][column] = viewProjection[column * 4 + row];
+
+	for (int k = 0; k < 4; k++)
+	{
+		this->planes[0][k] = rows[3][k] + rows[0][k];		// Left
+		this->planes[1][k] = rows[3][k] - rows[0][k];		// Right
+		this->planes[2][k] = rows[3][k] + rows[1][k];		// Bottom (or top, with a flipped projection; it doesn't matter here.)
+		this->planes[3][k] = rows[3][k] - rows[1][k];		// Top
+		this->planes[4][k] = rows[2][k];					// Near
+		this->planes[5][k] = rows[3][k] - rows[2][k];		// Far
+	}
+
+	// Normalized, so that plane distances are real distances and can be compared against radii and extents.
+	for (int j = 0; j < 6; j++)
+	{
+		float length = std::sqrt(this->planes[j][0] * this->planes[j][0] + this->planes[j][1] * this->planes[j][1] + this->planes[j][2] * this->planes[j][2]);
+		if (length > 0.0f)
+			for (int k = 0; k < 4; k++)
+				this->planes[j][k] /= length;
+	}
+}
+
+const std::vector<uint32_t>& FrustumCuller::CullSpheres(const float* centerX, const float* centerY, const float* centerZ, const float* radius, uint32_t count, ThreadPool* threadPool)
+{
+	return this->Cull(Volumes{ centerX, centerY, centerZ, radius, nullptr, nullptr }, count, threadPool);
+}
+
+const std::vector<uint32_t>& FrustumCuller::CullBoxes(const float* centerX, const float* centerY, const float* centerZ, const float* extentX, const float* extentY, const float* extentZ, uint32_t count, ThreadPool* threadPool)
+{
+	return this->Cull(Volumes{ centerX, centerY, centerZ, extentX, extentY, extentZ }, count, threadPool);
+}
+
+const std::vector<uint32_t>& FrustumCuller::Cull(const Volumes& volumes, uint32_t count, ThreadPool* threadPool)
+{
+	// Chunk c writes its survivors starting at c * CULL_CHUNK_SIZE, so the chunks never need to agree on anything while
+	// they run.  Afterwards the slices are slid down over the gaps, which keeps the result in ascending order.
+	uint32_t chunkCount = (count + CULL_CHUNK_SIZE - 1) / CULL_CHUNK_SIZE;
+
+	this->visibleArray.resize(count);
+	this->chunkCountsArray.resize(chunkCount);
+
+	auto cullChunks = [this, &volumes, count](size_t chunkBegin, size_t chunkEnd)
+	{
+		for (size_t chunk = chunkBegin; chunk < chunkEnd; chunk++)
+		{
+			uint32_t begin = (uint32_t)chunk * CULL_CHUNK_SIZE;
+			uint32_t end = std::min(begin + CULL_CHUNK_SIZE, count);
+			this->chunkCountsArray[chunk] = this->CullChunk(volumes, begin, end, &this->visibleArray[begin]);
+		}
+	};
+
+	if (threadPool)
+		threadPool->ParallelFor(chunkCount, 1, cullChunks);
+	else
+		cullChunks(0, chunkCount);
+
+	uint32_t visibleCount = 0;
+	for (uint32_t chunk = 0; chunk < chunkCount; chunk++)
+	{
+		uint32_t* slice = &this->visibleArray[chunk * CULL_CHUNK_SIZE];
+		if (chunk > 0)
+			std::copy(slice, slice + this->chunkCountsArray[chunk], &this->visibleArray[visibleCount]);
+
+		visibleCount += this->chunkCountsArray[chunk];
+	}
+
+	this->visibleArray.resize(visibleCount);
+
+	this->statistics.tested = count;
+	this->statistics.visible = visibleCount;
+	return this->visibleArray;
+}
+
+uint32_t FrustumCuller::CullChunk(const Volumes& volumes, uint32_t begin, uint32_t end, uint32_t* visible) const
+{
+	if (this->simdEnabled)
+		return this->CullChunkSSE(volumes, begin, end, visible);
+
+	return this->CullChunkScalar(volumes, begin, end, visible);
+}
+
+uint32_t FrustumCuller::CullChunkScalar(const Volumes& volumes, uint32_t begin, uint32_t end, uint32_t* visible) const
+{
+	uint32_t visibleCount = 0;
+
+	for (uint32_t i = begin; i < end; i++)
+	{
+		bool inside = true;
+
+		for (int j = 0; j < 6 && inside; j++)
+		{
+			const float* plane = this->planes[j];
+			float distance = plane[0] * volumes.centerX[i] + plane[1] * volumes.centerY[i] + plane[2] * volumes.centerZ[i] + plane[3];
+
+			// How far the volume reaches toward the plane: the radius, or for a box, its extents projected on the normal.
+			float reach = volumes.extentY
+				? std::fabs(plane[0]) * volumes.extentX[i] + std::fabs(plane[1]) * volumes.extentY[i] + std::fabs(plane[2]) * volumes.extentZ[i]
+				: volumes.extentX[i];
+
+			inside = distance + reach >= 0.0f;
+		}
+
+		if (inside)
+			visible[visibleCount++] = i;
+	}
+
+	return visibleCount;
+}
+
+#if defined(FRUSTUM_CULLER_SSE)
+
+uint32_t FrustumCuller::CullChunkSSE(const Volumes& volumes, uint32_t begin, uint32_t end, uint32_t* visible) const
+{
+	// Four volumes per iteration against one plane at a time, with the plane's coefficients splatted across the lanes.
+	__m128 planeA[6], planeB[6], planeC[6], planeD[6];
+	__m128 absA[6], absB[6], absC[6];
+
+	const __m128 signMask = _mm_set1_ps(-0.0f);
+
+	for (int j = 0; j < 6; j++)
+	{
+		planeA[j] = _mm_set1_ps(this->planes[j][0]);
+		planeB[j] = _mm_set1_ps(this->planes[j][1]);
+		planeC[j] = _mm_set1_ps(this->planes[j][2]);
+		planeD[j] = _mm_set1_ps(this->planes[j][3]);
+		absA[j] = _mm_andnot_ps(signMask, planeA[j]);
+		absB[j] = _mm_andnot_ps(signMask, planeB[j]);
+		absC[j] = _mm_andnot_ps(signMask, planeC[j]);
+	}
+
+	uint32_t visibleCount = 0;
+	bool boxes = volumes.extentY != nullptr;
+
+	uint32_t i = begin;
+	for (; i + 4 <= end; i += 4)
+	{
+		__m128 x = _mm_loadu_ps(&volumes.centerX[i]);
+		__m128 y = _mm_loadu_ps(&volumes.centerY[i]);
+		__m128 z = _mm_loadu_ps(&volumes.centerZ[i]);
+		__m128 ex = _mm_loadu_ps(&volumes.extentX[i]);
+		__m128 ey = boxes ? _mm_loadu_ps(&volumes.extentY[i]) : _mm_setzero_ps();
+		__m128 ez = boxes ? _mm_loadu_ps(&volumes.extentZ[i]) : _mm_setzero_ps();
+
+		__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+
+		for (int j = 0; j < 6; j++)
+		{
+			__m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planeA[j], x), _mm_mul_ps(planeB[j], y)), _mm_add_ps(_mm_mul_ps(planeC[j], z), planeD[j]));
+			__m128 reach = boxes ? _mm_add_ps(_mm_add_ps(_mm_mul_ps(absA[j], ex), _mm_mul_ps(absB[j], ey)), _mm_mul_ps(absC[j], ez)) : ex;
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(distance, reach), _mm_setzero_ps()));
+		}
+
+		// Write all four candidates but only advance past the ones that passed; no branches on the outcome.  This never
+		// writes beyond the chunk's slice, since we're never ahead of the volumes we've read.
+		int mask = _mm_movemask_ps(inside);
+		visible[visibleCount] = i + 0;
+		visibleCount += (mask >> 0) & 1;
+		visible[visibleCount] = i + 1;
+		visibleCount += (mask >> 1) & 1;
+		visible[visibleCount] = i + 2;
+		visibleCount += (mask >> 2) & 1;
+		visible[visibleCount] = i + 3;
+		visibleCount += (mask >> 3) & 1;
+	}
+
+	return visibleCount + this->CullChunkScalar(volumes, i, end, visible + visibleCount);
+}
+
+#else
+
+// Not an x86 build, so SetSimdEnabled never turns this on.
+uint32_t FrustumCuller::CullChunkSSE(const Volumes& volumes, uint32_t begin, uint32_t end, uint32_t* visible) const
+{
+	return this->CullChunkScalar(volumes, begin, end, visible);
+}
+
+#endif
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "ThreadPool.h"
+#include <vector>
+#include <cstdint>
+
+// Tests bounding volumes, given as structure-of-arrays streams, against the six planes of a view frustum, four at a time
+// with SSE, and spreads big sets over the thread pool.  The result is a compact, ascending list of the indices that
+// survived, ready to be handed to the GPU as an instance indirection.  Like the transform store, it knows nothing of
+// Vulkan or glm; matrices are column-major float[16].
+//
+// The test is conservative: a volume that straddles a plane, or sits just outside a corner of the frustum, is kept.
+class FrustumCuller
+{
+public:
+	struct Statistics
+	{
+		uint32_t tested;
+		uint32_t visible;
+	};
+
+	FrustumCuller();
+	virtual ~FrustumCuller();
+
+	// Extracts the planes from a view-projection matrix, assuming Vulkan's 0 to 1 clip-space depth range.
+	void SetViewProjection(const float* viewProjection);
+
+	// Each returns the indices in [0, count) that are at least partly inside the frustum.  The result is valid until the
+	// next call.  Boxes are axis-aligned, given by their centers and half-extents.
+	const std::vector<uint32_t>& CullSpheres(const float* centerX, const float* centerY, const float* centerZ, const float* radius, uint32_t count, ThreadPool* threadPool);
+	const std::vector<uint32_t>& CullBoxes(const float* centerX, const float* centerY, const float* centerZ, const float* extentX, const float* extentY, const float* extentZ, uint32_t count, ThreadPool* threadPool);
+
+	const Statistics& GetStatistics() const { return this->statistics; }
+
+	// SIMD is on whenever the build supports it.  Turning it off is mainly for benchmarking.
+	void SetSimdEnabled(bool simdEnabled);
+	bool GetSimdEnabled() const { return this->simdEnabled; }
+
+private:
+	struct Volumes
+	{
+		const float* centerX;
+		const float* centerY;
+		const float* centerZ;
+		const float* extentX;		// Radius, for spheres.
+		const float* extentY;		// Null for spheres.
+		const float* extentZ;
+	};
+
+	const std::vector<uint32_t>& Cull(const Volumes& volumes, uint32_t count, ThreadPool* threadPool);
+	uint32_t CullChunk(const Volumes& volumes, uint32_t begin, uint32_t end, uint32_t* visible) const;
+	uint32_t CullChunkScalar(const Volumes& volumes, uint32_t begin, uint32_t end, uint32_t* visible) const;
+	uint32_t CullChunkSSE(const Volumes& volumes, uint32_t begin, uint32_t end, uint32_t* visible) const;
+
+	float planes[6][4];		// (a, b, c, d) with (a, b, c) unit length and pointing inward.
+	bool simdEnabled;
+
+	std::vector<uint32_t> visibleArray;
+	std::vector<uint32_t> chunkCountsArray;
+	Statistics statistics;
+};
@@ -0,0 +1,228 @@
+#include "GeometryPool.h"
+#include "MemoryTracker.h"
+#include <cstring>
+
+GeometryPool::GeometryPool(Application* app, VkDeviceSize vertexCapacity, VkDeviceSize indexCapacity)
+{
+	this->app = app;
+	this->vertexCapacity = vertexCapacity;
+	this->indexCapacity = indexCapacity;
+	this->vertexBuffer = VK_NULL_HANDLE;
+	this->vertexBufferMemory = nullptr;
+	this->indexBuffer = VK_NULL_HANDLE;
+	this->indexBufferMemory = nullptr;
+}
+
+/*virtual*/ GeometryPool::~GeometryPool()
+{
+}
+
+void GeometryPool::Create()
+{
+	// Written by the transfer queue and read by the graphics queue, so shared between the two.  Storage use too, so a
+	// shader can fetch vertices and indices itself.
+	Application::QueueFamilyIndices indices = this->app->FindQueueFamilies(this->app->physicalDevice);
+	std::vector<uint32_t> sharingFamilies;
+	if (indices.transferFamily.value() != indices.graphicsFamily.value())
+		sharingFamilies = { indices.graphicsFamily.value(), indices.transferFamily.value() };
+
+	this->app->CreateBuffer(this->vertexCapacity, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, this->vertexBuffer, this->vertexBufferMemory, sharingFamilies);
+	this->app->CreateBuffer(this->indexCapacity, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, this->indexBuffer, this->indexBufferMemory, sharingFamilies);
+
+	this->vertexFreeList.Reset(this->vertexCapacity);
+	this->indexFreeList.Reset(this->indexCapacity);
+
+	std::cout << "Geometry pool: " << this->vertexCapacity / 1024 << " KiB of vertices, " << this->indexCapacity / 1024 << " KiB of indices" << std::endl;
+}
+
+void GeometryPool::Destroy()
+{
+	Statistics statistics = this->GetStatistics();
+	if (statistics.meshCount > 0)
+		std::cout << "Geometry pool: " << statistics.meshCount << " meshes still in it at exit" << std::endl;
+
+	vkDestroyBuffer(this->app->logicalDevice, this->indexBuffer, nullptr);
+	this->app->memoryTracker->Free(this->indexBufferMemory);
+	vkDestroyBuffer(this->app->logicalDevice, this->vertexBuffer, nullptr);
+	this->app->memoryTracker->Free(this->vertexBufferMemory);
+}
+
+GeometryPool::MeshId GeometryPool::AddMesh(const void* vertexData, uint32_t vertexCount, uint32_t vertexStride, const uint32_t* indexData, uint32_t indexCount)
+{
+	VkDeviceSize vertexSize = (VkDeviceSize)vertexCount * vertexStride;
+	VkDeviceSize indexSize = (VkDeviceSize)indexCount * sizeof(uint32_t);
+	VkDeviceSize vertexOffset = 0, indexOffset = 0;
+	MeshId meshId = INVALID_MESH;
+
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+
+		if (!this->vertexFreeList.Allocate(vertexSize, vertexStride, vertexOffset))
+			throw new std::runtime_error("Geometry pool is out of vertex space!");
+
+		if (!this->indexFreeList.Allocate(indexSize, sizeof(uint32_t), indexOffset))
+		{
+			this->vertexFreeList.Free(vertexOffset, vertexSize);
+			throw new std::runtime_error("Geometry pool is out of index space!");
+		}
+
+		Mesh mesh;
+		mesh.vertexOffset = int32_t(vertexOffset / vertexStride);
+		mesh.firstIndex = uint32_t(indexOffset / sizeof(uint32_t));
+		mesh.vertexCount = vertexCount;
+		mesh.indexCount = indexCount;
+		mesh.vertexStride = vertexStride;
+
+		if (!this->freeMeshIdsArray.empty())
+		{
+			meshId = this->freeMeshIdsArray.back();
+			this->freeMeshIdsArray.pop_back();
+			this->meshesArray[meshId] = mesh;
+		}
+		else
+		{
+			meshId = (MeshId)this->meshesArray.size();
+			this->meshesArray.push_back(mesh);
+		}
+	}
+
+	// Both halves go up in one staging buffer and one submission.
+	VkBuffer stagingBuffer;
+	VkDeviceMemory stagingBufferMemory;
+	this->app->CreateBuffer(vertexSize + indexSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+
+	void* data = nullptr;
+	vkMapMemory(this->app->logicalDevice, stagingBufferMemory, 0, vertexSize + indexSize, 0, &data);
+	if (vertexSize > 0)
+		::memcpy(data, vertexData, (size_t)vertexSize);
+	if (indexSize > 0)
+		::memcpy(static_cast<uint8_t*>(data) + vertexSize, indexData, (size_t)indexSize);
+	vkUnmapMemory(this->app->logicalDevice, stagingBufferMemory);
+
+	VkCommandBuffer commandBuffer = this->app->BeginSingleTimeCommands(this->app->transferCommandPool);
+
+	// Copies can't be empty.
+	if (vertexSize > 0)
+	{
+		VkBufferCopy vertexRegion{};
+		vertexRegion.srcOffset = 0;
+		vertexRegion.dstOffset = vertexOffset;
+		vertexRegion.size = vertexSize;
+		vkCmdCopyBuffer(commandBuffer, stagingBuffer, this->vertexBuffer, 1, &vertexRegion);
+	}
+
+	if (indexSize > 0)
+	{
+		VkBufferCopy indexRegion{};
+		indexRegion.srcOffset = vertexSize;
+		indexRegion.dstOffset = indexOffset;
+		indexRegion.size = indexSize;
+		vkCmdCopyBuffer(commandBuffer, stagingBuffer, this->indexBuffer, 1, &indexRegion);
+	}
+
+	this->app->EndSingleTimeCommands(commandBuffer, this->app->transferCommandPool, this->app->transferQueue);
+
+	vkDestroyBuffer(this->app->logicalDevice, stagingBuffer, nullptr);
+	this->app->memoryTracker->Free(stagingBufferMemory);
+
+	return meshId;
+}
+
+void GeometryPool::RemoveMesh(MeshId meshId)
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+
+	const Mesh& mesh = this->meshesArray[meshId];
+	this->vertexFreeList.Free((VkDeviceSize)mesh.vertexOffset * mesh.vertexStride, (VkDeviceSize)mesh.vertexCount * mesh.vertexStride);
+	this->indexFreeList.Free((VkDeviceSize)mesh.firstIndex * sizeof(uint32_t), (VkDeviceSize)mesh.indexCount * sizeof(uint32_t));
+
+	this->meshesArray[meshId] = Mesh{};
+	this->freeMeshIdsArray.push_back(meshId);
+}
+
+GeometryPool::Statistics GeometryPool::GetStatistics()
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+
+	Statistics statistics;
+	statistics.meshCount = (uint32_t)(this->meshesArray.size() - this->freeMeshIdsArray.size());
+	statistics.vertexBytesUsed = this->vertexFreeList.GetUsed();
+	statistics.indexBytesUsed = this->indexFreeList.GetUsed();
+	statistics.vertexFreeBlocks = this->vertexFreeList.GetBlockCount();
+	statistics.indexFreeBlocks = this->indexFreeList.GetBlockCount();
+	return statistics;
+}
+
+void GeometryPool::Bind(VkCommandBuffer givenCommandBuffer)
+{
+	VkDeviceSize offset = 0;
+	vkCmdBindVertexBuffers(givenCommandBuffer, 0, 1, &this->vertexBuffer, &offset);
+	vkCmdBindIndexBuffer(givenCommandBuffer, this->indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+}
+
+void GeometryPool::FreeList::Reset(VkDeviceSize capacity)
+{
+	this->blocksMap.clear();
+	this->blocksMap[0] = capacity;
+	this->used = 0;
+}
+
+bool GeometryPool::FreeList::Allocate(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset)
+{
+	// Empty ranges take no space, and Free ignores them.
+	if (size == 0)
+	{
+		offset = 0;
+		return true;
+	}
+
+	// First fit.  Whatever is skipped to get to the alignment, and whatever is left over after, stay free.
+	for (auto iter = this->blocksMap.begin(); iter != this->blocksMap.end(); iter++)
+	{
+		VkDeviceSize blockOffset = iter->first;
+		VkDeviceSize blockEnd = blockOffset + iter->second;
+		VkDeviceSize alignedOffset = ((blockOffset + alignment - 1) / alignment) * alignment;
+		if (alignedOffset + size > blockEnd)
+			continue;
+
+		this->blocksMap.erase(iter);
+		if (alignedOffset > blockOffset)
+			this->blocksMap[blockOffset] = alignedOffset - blockOffset;
+		if (alignedOffset + size < blockEnd)
+			this->blocksMap[alignedOffset + size] = blockEnd - (alignedOffset + size);
+
+		offset = alignedOffset;
+		this->used += size;
+		return true;
+	}
+
+	return false;
+}
+
+void GeometryPool::FreeList::Free(VkDeviceSize offset, VkDeviceSize size)
+{
+	if (size == 0)
+		return;
+
+	this->used -= size;
+
+	// Merge with the block after, then the one before, if they touch.
+	auto next = this->blocksMap.lower_bound(offset);
+	if (next != this->blocksMap.end() && offset + size == next->first)
+	{
+		size += next->second;
+		next = this->blocksMap.erase(next);
+	}
+
+	if (next != this->blocksMap.begin())
+	{
+		auto previous = std::prev(next);
+		if (previous->first + previous->second == offset)
+		{
+			previous->second += size;
+			return;
+		}
+	}
+
+	this->blocksMap[offset] = size;
+}
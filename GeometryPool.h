@@ -0,0 +1,95 @@
+#pragma once
+
+#include "Application.h"
+#include <map>
+#include <mutex>
+
+// Every static mesh's vertices and indices, suballocated out of one big device-local vertex buffer and one big index
+// buffer, so that the two are bound once at the top of a command buffer and meshes differ only in the firstIndex and
+// vertexOffset of their draws (which also means any number of them could go in one multi-draw indirect).  Indices are
+// always 32-bit.  Vertices of any layout can share the vertex buffer: each mesh's vertices start at a multiple of its
+// own stride, so that vertexOffset counts whole vertices from the start of the buffer.
+//
+// Free space is kept in a free list per buffer, as offset-ordered blocks that are merged with their neighbors when freed,
+// and allocated first-fit.  Meshes are referred to by id, like textures in the atlas.
+class GeometryPool
+{
+public:
+	typedef uint32_t MeshId;
+	static constexpr MeshId INVALID_MESH = 0xFFFFFFFF;
+
+	struct Mesh
+	{
+		int32_t vertexOffset;		// Both in elements, ready to be passed to vkCmdDrawIndexed as they are.
+		uint32_t firstIndex;
+		uint32_t vertexCount;
+		uint32_t indexCount;
+		uint32_t vertexStride;
+	};
+
+	struct Statistics
+	{
+		uint32_t meshCount;
+		VkDeviceSize vertexBytesUsed;
+		VkDeviceSize indexBytesUsed;
+		uint32_t vertexFreeBlocks;
+		uint32_t indexFreeBlocks;
+	};
+
+	GeometryPool(Application* app, VkDeviceSize vertexCapacity, VkDeviceSize indexCapacity);
+	virtual ~GeometryPool();
+
+	void Create();
+	void Destroy();
+
+	// Copies the mesh in through a staging buffer on the transfer queue, and waits for that, so it's the same as
+	// CreateGeneralBuffer as far as who else may use the transfer queue at the same time.  Throws if there's no room.
+	// Either part may be empty, for meshes that keep their triangles some other way.
+	MeshId AddMesh(const void* vertexData, uint32_t vertexCount, uint32_t vertexStride, const uint32_t* indexData, uint32_t indexCount);
+
+	// The GPU must be done with the mesh.
+	void RemoveMesh(MeshId meshId);
+
+	// Not locked, so don't call it while meshes are being added on another thread; they're all added during startup.
+	const Mesh& GetMesh(MeshId meshId) const { return this->meshesArray[meshId]; }
+	Statistics GetStatistics();
+
+	// For shaders that fetch vertices themselves; a mesh's vertices start vertexOffset times its stride bytes in.
+	VkBuffer GetVertexBuffer() const { return this->vertexBuffer; }
+
+	// Binds both buffers, at binding 0 and with 32-bit indices.
+	void Bind(VkCommandBuffer givenCommandBuffer);
+
+private:
+	class FreeList
+	{
+	public:
+		void Reset(VkDeviceSize capacity);
+
+		// Returns false if there's no block big enough.
+		bool Allocate(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset);
+		void Free(VkDeviceSize offset, VkDeviceSize size);
+
+		uint32_t GetBlockCount() const { return (uint32_t)this->blocksMap.size(); }
+		VkDeviceSize GetUsed() const { return this->used; }
+
+	private:
+		std::map<VkDeviceSize, VkDeviceSize> blocksMap;		// Offset to size, of each free block.
+		VkDeviceSize used;
+	};
+
+	Application* app;
+	VkDeviceSize vertexCapacity;
+	VkDeviceSize indexCapacity;
+
+	VkBuffer vertexBuffer;
+	VkDeviceMemory vertexBufferMemory;
+	VkBuffer indexBuffer;
+	VkDeviceMemory indexBufferMemory;
+
+	std::mutex mutex;		// Around everything below.
+	FreeList vertexFreeList;
+	FreeList indexFreeList;
+	std::vector<Mesh> meshesArray;
+	std::vector<MeshId> freeMeshIdsArray;
+};
@@ -0,0 +1,312 @@
+#include "LodMesh.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+// A symmetric 4x4 matrix, stored as its upper triangle: a00 a01 a02 a03 a11 a12 a13 a22 a23 a33.  v^T Q v is the sum of
+// the squared distances of v from every plane that has been added to it, and weight is how many planes that is.
+struct Quadric
+{
+	double a[10];
+	double weight;
+};
+
+static void AddPlane(Quadric& quadric, double nx, double ny, double nz, double d)
+{
+	quadric.a[0] += nx * nx; quadric.a[1] += nx * ny; quadric.a[2] += nx * nz; quadric.a[3] += nx * d;
+	quadric.a[4] += ny * ny; quadric.a[5] += ny * nz; quadric.a[6] += ny * d;
+	quadric.a[7] += nz * nz; quadric.a[8] += nz * d;
+	quadric.a[9] += d * d;
+	quadric.weight += 1.0;
+}
+
+// The mean squared distance of v from the planes of both quadrics.  Using the mean rather than the sum keeps the cost
+// a distance (squared), independent of how finely the original was tessellated.
+static double EvaluateQuadric(const Quadric& q, const Quadric& r, const float* v)
+{
+	double x = v[0], y = v[1], z = v[2];
+	double a[10];
+	for (int k = 0; k < 10; k++)
+		a[k] = q.a[k] + r.a[k];
+
+	double weight = q.weight + r.weight;
+	if (weight == 0.0)
+		return 0.0;
+
+	double cost = a[0] * x * x + 2.0 * a[1] * x * y + 2.0 * a[2] * x * z + 2.0 * a[3] * x
+		+ a[4] * y * y + 2.0 * a[5] * y * z + 2.0 * a[6] * y
+		+ a[7] * z * z + 2.0 * a[8] * z
+		+ a[9];
+
+	return std::max(cost, 0.0) / weight;
+}
+
+static void TriangleNormal(const float* p0, const float* p1, const float* p2, double* normal)
+{
+	double e1[3] = { double(p1[0]) - p0[0], double(p1[1]) - p0[1], double(p1[2]) - p0[2] };
+	double e2[3] = { double(p2[0]) - p0[0], double(p2[1]) - p0[1], double(p2[2]) - p0[2] };
+	normal[0] = e1[1] * e2[2] - e1[2] * e2[1];
+	normal[1] = e1[2] * e2[0] - e1[0] * e2[2];
+	normal[2] = e1[0] * e2[1] - e1[1] * e2[0];
+}
+
+struct Collapse
+{
+	double cost;
+	uint32_t from;
+	uint32_t to;
+};
+
+LodMesh::LodMesh()
+{
+}
+
+/*virtual*/ LodMesh::~LodMesh()
+{
+}
+
+void LodMesh::Build(const float* positions, uint32_t vertexCount, size_t positionStride, const std::vector<uint32_t>& indicesArray, uint32_t maxLevels, float reduction)
+{
+	this->indicesArray = indicesArray;
+	this->levelsArray.clear();
+	this->levelsArray.push_back(Level{ 0, (uint32_t)indicesArray.size(), 0.0f });
+
+	// Each level starts over from the original mesh rather than from the level before, so that its quadrics, and hence
+	// its error, are measured against the real surface.
+	while (this->levelsArray.size() < maxLevels)
+	{
+		const Level& previousLevel = this->levelsArray.back();
+		size_t targetIndexCount = size_t(float(previousLevel.indexCount / 3) * reduction) * 3;
+		if (targetIndexCount < 3)
+			break;
+
+		float error = 0.0f;
+		std::vector<uint32_t> simplifiedArray = Simplify(positions, vertexCount, positionStride, indicesArray, targetIndexCount, std::numeric_limits<float>::max(), &error);
+
+		// Stop once a level wouldn't save much over the last one; it isn't worth the memory or the selection step.
+		if (simplifiedArray.empty() || simplifiedArray.size() * 10 > size_t(previousLevel.indexCount) * 9)
+			break;
+
+		Level level{ (uint32_t)this->indicesArray.size(), (uint32_t)simplifiedArray.size(), std::max(error, previousLevel.error) };
+		this->indicesArray.insert(this->indicesArray.end(), simplifiedArray.begin(), simplifiedArray.end());
+		this->levelsArray.push_back(level);
+	}
+}
+
+uint32_t LodMesh::SelectLevel(float distance, float projectionScale, float pixelThreshold) const
+{
+	if (distance <= 0.0f)
+		return 0;
+
+	for (uint32_t level = (uint32_t)this->levelsArray.size(); level-- > 1;)
+		if (this->levelsArray[level].error * projectionScale / distance <= pixelThreshold)
+			return level;
+
+	return 0;
+}
+
+/*static*/ std::vector<uint32_t> LodMesh::Simplify(const float* positions, uint32_t vertexCount, size_t positionStride, const std::vector<uint32_t>& indicesArray, size_t targetIndexCount, float maxError, float* resultError)
+{
+	auto position = [positions, positionStride](uint32_t vertex) { return &positions[vertex * positionStride]; };
+
+	// Every vertex starts out with the planes of the triangles around it.  As vertices merge, so do their quadrics, so a
+	// vertex's quadric always measures the distance to all of the original surface it now stands in for.
+	std::vector<Quadric> quadricsArray(vertexCount, Quadric{});
+	for (size_t j = 0; j + 2 < indicesArray.size(); j += 3)
+	{
+		const float* p0 = position(indicesArray[j]);
+		double normal[3];
+		TriangleNormal(p0, position(indicesArray[j + 1]), position(indicesArray[j + 2]), normal);
+
+		double length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+		if (length == 0.0)
+			continue;
+
+		double nx = normal[0] / length, ny = normal[1] / length, nz = normal[2] / length;
+		double d = -(nx * p0[0] + ny * p0[1] + nz * p0[2]);
+		for (int k = 0; k < 3; k++)
+			AddPlane(quadricsArray[indicesArray[j + k]], nx, ny, nz, d);
+	}
+
+	std::vector<uint32_t> resultArray = indicesArray;
+	double maxCost = double(maxError) * double(maxError);
+	double reachedCost = 0.0;
+
+	std::vector<uint32_t> triangleOffsetsArray, vertexTrianglesArray, remapArray;
+	std::vector<uint64_t> edgesArray;
+	std::vector<Collapse> collapsesArray;
+	std::vector<uint8_t> lockedArray;
+
+	// Rather than keeping a priority queue up to date through every collapse, each pass collapses as many of the
+	// cheapest edges as it can without two of them touching, then rebuilds everything from the new triangles.
+	while (resultArray.size() > targetIndexCount)
+	{
+		uint32_t triangleCount = (uint32_t)(resultArray.size() / 3);
+
+		// Triangles around each vertex, as one flat array with offsets.
+		triangleOffsetsArray.assign(vertexCount + 1, 0);
+		for (uint32_t index : resultArray)
+			triangleOffsetsArray[index + 1]++;
+
+		for (uint32_t v = 0; v < vertexCount; v++)
+			triangleOffsetsArray[v + 1] += triangleOffsetsArray[v];
+
+		vertexTrianglesArray.resize(resultArray.size());
+		{
+			std::vector<uint32_t> cursorsArray(triangleOffsetsArray.begin(), triangleOffsetsArray.end() - 1);
+			for (uint32_t t = 0; t < triangleCount; t++)
+				for (int k = 0; k < 3; k++)
+					vertexTrianglesArray[cursorsArray[resultArray[3 * t + k]]++] = t;
+		}
+
+		// Unique edges, each costed in whichever direction is cheaper.
+		edgesArray.clear();
+		for (uint32_t t = 0; t < triangleCount; t++)
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				uint32_t a = resultArray[3 * t + k];
+				uint32_t b = resultArray[3 * t + (k + 1) % 3];
+				edgesArray.push_back((uint64_t(std::min(a, b)) << 32) | std::max(a, b));
+			}
+		}
+
+		std::sort(edgesArray.begin(), edgesArray.end());
+		edgesArray.erase(std::unique(edgesArray.begin(), edgesArray.end()), edgesArray.end());
+
+		collapsesArray.clear();
+		for (uint64_t edge : edgesArray)
+		{
+			uint32_t a = uint32_t(edge >> 32);
+			uint32_t b = uint32_t(edge);
+			double costAB = EvaluateQuadric(quadricsArray[a], quadricsArray[b], position(b));
+			double costBA = EvaluateQuadric(quadricsArray[a], quadricsArray[b], position(a));
+			collapsesArray.push_back((costAB <= costBA) ? Collapse{ costAB, a, b } : Collapse{ costBA, b, a });
+		}
+
+		std::sort(collapsesArray.begin(), collapsesArray.end(), [](const Collapse& left, const Collapse& right) { return left.cost < right.cost; });
+
+		lockedArray.assign(vertexCount, 0);
+		remapArray.resize(vertexCount);
+		for (uint32_t v = 0; v < vertexCount; v++)
+			remapArray[v] = v;
+
+		size_t trianglesToRemove = (resultArray.size() - targetIndexCount + 2) / 3;
+		size_t trianglesRemoved = 0;
+		uint32_t collapseCount = 0;
+
+		for (const Collapse& collapse : collapsesArray)
+		{
+			if (collapse.cost > maxCost || trianglesRemoved >= trianglesToRemove)
+				break;
+
+			if (lockedArray[collapse.from] || lockedArray[collapse.to])
+				continue;
+
+			// Moving "from" onto "to" must not turn any surviving triangle around it inside out...
+			bool acceptable = true;
+			uint32_t sharedTriangles = 0;
+			for (uint32_t j = triangleOffsetsArray[collapse.from]; j < triangleOffsetsArray[collapse.from + 1] && acceptable; j++)
+			{
+				const uint32_t* triangle = &resultArray[3 * vertexTrianglesArray[j]];
+				if (triangle[0] == collapse.to || triangle[1] == collapse.to || triangle[2] == collapse.to)
+				{
+					sharedTriangles++;
+					continue;
+				}
+
+				double before[3], after[3];
+				TriangleNormal(position(triangle[0]), position(triangle[1]), position(triangle[2]), before);
+				TriangleNormal(
+					position(triangle[0] == collapse.from ? collapse.to : triangle[0]),
+					position(triangle[1] == collapse.from ? collapse.to : triangle[1]),
+					position(triangle[2] == collapse.from ? collapse.to : triangle[2]), after);
+
+				acceptable = before[0] * after[0] + before[1] * after[1] + before[2] * after[2] > 0.0;
+			}
+
+			// ...and, on a closed surface, the two ends must only share the two neighbors across the edge, or the
+			// collapse would pinch the surface into something non-manifold.
+			if (acceptable)
+			{
+				uint32_t commonNeighbors = 0;
+				for (uint32_t j = triangleOffsetsArray[collapse.from]; j < triangleOffsetsArray[collapse.from + 1]; j++)
+				{
+					for (int k = 0; k < 3; k++)
+					{
+						uint32_t neighbor = resultArray[3 * vertexTrianglesArray[j] + k];
+						if (neighbor == collapse.from || neighbor == collapse.to)
+							continue;
+
+						// Each neighbor of "from" is seen twice going around it, so count it only from its first triangle.
+						bool seenBefore = false;
+						for (uint32_t m = triangleOffsetsArray[collapse.from]; m < j && !seenBefore; m++)
+						{
+							const uint32_t* other = &resultArray[3 * vertexTrianglesArray[m]];
+							seenBefore = other[0] == neighbor || other[1] == neighbor || other[2] == neighbor;
+						}
+
+						if (seenBefore)
+							continue;
+
+						for (uint32_t m = triangleOffsetsArray[collapse.to]; m < triangleOffsetsArray[collapse.to + 1]; m++)
+						{
+							const uint32_t* other = &resultArray[3 * vertexTrianglesArray[m]];
+							if (other[0] == neighbor || other[1] == neighbor || other[2] == neighbor)
+							{
+								commonNeighbors++;
+								break;
+							}
+						}
+					}
+				}
+
+				acceptable = commonNeighbors <= 2;
+			}
+
+			if (!acceptable)
+				continue;
+
+			remapArray[collapse.from] = collapse.to;
+			for (int k = 0; k < 10; k++)
+				quadricsArray[collapse.to].a[k] += quadricsArray[collapse.from].a[k];
+
+			quadricsArray[collapse.to].weight += quadricsArray[collapse.from].weight;
+
+			reachedCost = std::max(reachedCost, collapse.cost);
+			trianglesRemoved += sharedTriangles;
+			collapseCount++;
+
+			// Nothing else this pass may touch the triangles we just changed.
+			lockedArray[collapse.to] = 1;
+			for (uint32_t j = triangleOffsetsArray[collapse.from]; j < triangleOffsetsArray[collapse.from + 1]; j++)
+				for (int k = 0; k < 3; k++)
+					lockedArray[resultArray[3 * vertexTrianglesArray[j] + k]] = 1;
+		}
+
+		if (collapseCount == 0)
+			break;
+
+		// Apply the collapses, dropping the triangles that they squashed flat.
+		size_t writeIndex = 0;
+		for (size_t j = 0; j < resultArray.size(); j += 3)
+		{
+			uint32_t a = remapArray[resultArray[j]];
+			uint32_t b = remapArray[resultArray[j + 1]];
+			uint32_t c = remapArray[resultArray[j + 2]];
+			if (a == b || b == c || c == a)
+				continue;
+
+			resultArray[writeIndex++] = a;
+			resultArray[writeIndex++] = b;
+			resultArray[writeIndex++] = c;
+		}
+
+		resultArray.resize(writeIndex);
+	}
+
+	if (resultError)
+		*resultError = float(std::sqrt(reachedCost));
+
+	return resultArray;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// A chain of ever coarser versions of one indexed triangle mesh, made by quadric error metric simplification (Garland
+// and Heckbert) when the mesh is loaded.  Every level keeps using the original vertices, so the whole chain is one
+// vertex buffer plus one index buffer, with each level being a range of the latter.  Each level also records how far
+// (in object space) it may stray from the original surface, which is what picking a level from screen size is based on.
+//
+// Like the transform store, nothing in here depends on Vulkan or glm.
+class LodMesh
+{
+public:
+	struct Level
+	{
+		uint32_t indexOffset;
+		uint32_t indexCount;
+		float error;			// Object-space distance; never decreases from one level to the next.
+	};
+
+	LodMesh();
+	virtual ~LodMesh();
+
+	// Positions are float[3], positionStride floats apart.  Each level aims for reduction times the triangles of the one
+	// before, and the chain stops early once simplification can't make meaningful progress.  The mesh should be closed;
+	// open borders aren't given any special protection.
+	void Build(const float* positions, uint32_t vertexCount, size_t positionStride, const std::vector<uint32_t>& indicesArray, uint32_t maxLevels, float reduction);
+
+	const std::vector<uint32_t>& GetIndices() const { return this->indicesArray; }
+	const std::vector<Level>& GetLevels() const { return this->levelsArray; }
+
+	// The coarsest level whose error, seen from the given distance, covers no more than pixelThreshold pixels.
+	// projectionScale is how many pixels one unit at distance one covers: proj[1][1] times half the viewport height.
+	uint32_t SelectLevel(float distance, float projectionScale, float pixelThreshold) const;
+
+	// One simplification: collapses edges of the given mesh, cheapest first, until it is down to targetIndexCount indices
+	// or the next collapse would cost more than maxError.  The error actually reached is returned through resultError.
+	static std::vector<uint32_t> Simplify(const float* positions, uint32_t vertexCount, size_t positionStride, const std::vector<uint32_t>& indicesArray, size_t targetIndexCount, float maxError, float* resultError);
+
+private:
+	std::vector<uint32_t> indicesArray;
+	std::vector<Level> levelsArray;
+};
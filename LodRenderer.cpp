@@ -0,0 +1,453 @@
+#include "LodRenderer.h"
+#include "MemoryTracker.h"
+#include "ThreadPool.h"
+#include <cmath>
+
+const uint32_t LOD_MESH_RINGS = 64;
+const uint32_t LOD_MESH_SEGMENTS = 128;
+const uint32_t LOD_MAX_LEVELS = 8;
+const float LOD_LEVEL_REDUCTION = 0.5f;		// Each level has about half the triangles of the one before.
+const float LOD_PIXEL_THRESHOLD = 1.0f;		// Largest error, in pixels, that we're willing to let show.
+const float LOD_MESH_BUMPINESS = 0.05f;
+const size_t LOD_SELECT_BATCH_SIZE = 16 * 1024;
+const uint32_t LOD_REPORT_INTERVAL = 240;
+
+LodRenderer::LodRenderer(Application* app, uint32_t objectCount)
+{
+	this->app = app;
+	this->objectCount = objectCount;
+	this->viewProjection = glm::mat4(1.0f);
+	this->meshId = GeometryPool::INVALID_MESH;
+	this->instanceBuffer = VK_NULL_HANDLE;
+	this->instanceBufferMemory = nullptr;
+	this->mappedInstances = nullptr;
+	this->descriptorSetLayout = VK_NULL_HANDLE;
+	this->descriptorPool = VK_NULL_HANDLE;
+	this->descriptorSet = VK_NULL_HANDLE;
+	this->pipelineLayout = VK_NULL_HANDLE;
+	this->graphicsPipeline = VK_NULL_HANDLE;
+	this->reportFrameCount = 0;
+	this->reportMilliseconds = 0.0;
+	this->reportTriangles = 0;
+}
+
+/*virtual*/ LodRenderer::~LodRenderer()
+{
+}
+
+void LodRenderer::Create()
+{
+	auto startTime = std::chrono::high_resolution_clock::now();
+
+	this->BuildMesh();
+
+	auto endTime = std::chrono::high_resolution_clock::now();
+
+	this->PlaceObjects();
+	this->CreateMeshBuffers();
+	this->CreateInstanceBuffer();
+	this->CreateDescriptorSet();
+	this->CreateGraphicsPipeline();
+
+	std::cout << "LOD: " << this->objectCount << " objects, " << this->lodMesh.GetLevels().size() << " levels built in " << std::chrono::duration<double, std::milli>(endTime - startTime).count() << " ms (triangles/error:";
+	for (const LodMesh::Level& level : this->lodMesh.GetLevels())
+		std::cout << " " << level.indexCount / 3 << "/" << level.error;
+	std::cout << ")" << std::endl;
+}
+
+void LodRenderer::Destroy()
+{
+	VkDevice logicalDevice = this->app->logicalDevice;
+
+	vkUnmapMemory(logicalDevice, this->instanceBufferMemory);
+	vkDestroyBuffer(logicalDevice, this->instanceBuffer, nullptr);
+	this->app->memoryTracker->Free(this->instanceBufferMemory);
+	this->app->geometryPool->RemoveMesh(this->meshId);
+	vkDestroyPipeline(logicalDevice, this->graphicsPipeline, nullptr);
+	vkDestroyPipelineLayout(logicalDevice, this->pipelineLayout, nullptr);
+	vkDestroyDescriptorPool(logicalDevice, this->descriptorPool, nullptr);
+	vkDestroyDescriptorSetLayout(logicalDevice, this->descriptorSetLayout, nullptr);
+}
+
+void LodRenderer::BuildMesh()
+{
+	// A unit sphere with some bumps on it, so that there's detail worth simplifying away.  The seam is closed by wrapping
+	// around rather than by duplicating vertices, which keeps the mesh closed as far as the simplifier is concerned.
+	auto addVertex = [this](float theta, float phi)
+	{
+		float radius = 1.0f + LOD_MESH_BUMPINESS * std::sin(5.0f * theta) * std::cos(7.0f * phi);
+		LodVertex vertex{};
+		vertex.position = radius * glm::vec3(std::sin(theta) * std::cos(phi), std::sin(theta) * std::sin(phi), std::cos(theta));
+		vertex.normal = glm::vec3(0.0f, 0.0f, 0.0f);
+		this->verticesArray.push_back(vertex);
+	};
+
+	addVertex(0.0f, 0.0f);
+	for (uint32_t ring = 1; ring < LOD_MESH_RINGS; ring++)
+		for (uint32_t segment = 0; segment < LOD_MESH_SEGMENTS; segment++)
+			addVertex(glm::pi<float>() * float(ring) / float(LOD_MESH_RINGS), 2.0f * glm::pi<float>() * float(segment) / float(LOD_MESH_SEGMENTS));
+	addVertex(glm::pi<float>(), 0.0f);
+
+	uint32_t southPole = (uint32_t)this->verticesArray.size() - 1;
+	auto ringVertex = [](uint32_t ring, uint32_t segment) { return 1 + (ring - 1) * LOD_MESH_SEGMENTS + segment % LOD_MESH_SEGMENTS; };
+
+	// Counter-clockwise seen from outside.
+	std::vector<uint32_t> indicesArray;
+	for (uint32_t segment = 0; segment < LOD_MESH_SEGMENTS; segment++)
+		indicesArray.insert(indicesArray.end(), { 0, ringVertex(1, segment), ringVertex(1, segment + 1) });
+
+	for (uint32_t ring = 1; ring < LOD_MESH_RINGS - 1; ring++)
+	{
+		for (uint32_t segment = 0; segment < LOD_MESH_SEGMENTS; segment++)
+		{
+			uint32_t a = ringVertex(ring, segment), b = ringVertex(ring + 1, segment), c = ringVertex(ring + 1, segment + 1), d = ringVertex(ring, segment + 1);
+			indicesArray.insert(indicesArray.end(), { a, b, c, a, c, d });
+		}
+	}
+
+	for (uint32_t segment = 0; segment < LOD_MESH_SEGMENTS; segment++)
+		indicesArray.insert(indicesArray.end(), { ringVertex(LOD_MESH_RINGS - 1, segment), southPole, ringVertex(LOD_MESH_RINGS - 1, segment + 1) });
+
+	// Smooth normals from the full-detail triangles; the coarser levels just reuse them.
+	for (size_t j = 0; j < indicesArray.size(); j += 3)
+	{
+		LodVertex& v0 = this->verticesArray[indicesArray[j]];
+		LodVertex& v1 = this->verticesArray[indicesArray[j + 1]];
+		LodVertex& v2 = this->verticesArray[indicesArray[j + 2]];
+		glm::vec3 faceNormal = glm::cross(v1.position - v0.position, v2.position - v0.position);
+		v0.normal += faceNormal;
+		v1.normal += faceNormal;
+		v2.normal += faceNormal;
+	}
+
+	for (LodVertex& vertex : this->verticesArray)
+		vertex.normal = glm::normalize(vertex.normal);
+
+	this->lodMesh.Build(&this->verticesArray[0].position.x, (uint32_t)this->verticesArray.size(), sizeof(LodVertex) / sizeof(float), indicesArray, LOD_MAX_LEVELS, LOD_LEVEL_REDUCTION);
+}
+
+void LodRenderer::PlaceObjects()
+{
+	// A square field in the z = 0 plane, stretching away from the camera, so that there's a good spread of distances.
+	uint32_t gridSize = (uint32_t)std::ceil(std::sqrt(double(this->objectCount)));
+	float spacing = 8.0f / float(gridSize);
+
+	this->objectsArray.resize(this->objectCount);
+	this->objectLevelsArray.resize(this->objectCount);
+
+	for (uint32_t j = 0; j < this->objectCount; j++)
+	{
+		float x = (float(j % gridSize) + 0.5f) * spacing - 6.0f;
+		float y = (float(j / gridSize) + 0.5f) * spacing - 6.0f;
+		this->objectsArray[j] = glm::vec4(x, y, 0.0f, 0.3f * spacing);
+	}
+}
+
+void LodRenderer::CreateMeshBuffers()
+{
+	// Every level's indices, back to back, as one mesh of the pool; a level's index offset is relative to the mesh's.
+	const std::vector<uint32_t>& indicesArray = this->lodMesh.GetIndices();
+
+	this->meshId = this->app->geometryPool->AddMesh(this->verticesArray.data(), (uint32_t)this->verticesArray.size(), sizeof(LodVertex), indicesArray.data(), (uint32_t)indicesArray.size());
+}
+
+void LodRenderer::CreateInstanceBuffer()
+{
+	VkDeviceSize bufferSize = sizeof(glm::vec4) * (VkDeviceSize)this->objectCount * MAX_FRAMES_IN_FLIGHT;
+
+	this->app->CreateBuffer(bufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, this->instanceBuffer, this->instanceBufferMemory);
+
+	void* data = nullptr;
+	if (VK_SUCCESS != vkMapMemory(this->app->logicalDevice, this->instanceBufferMemory, 0, bufferSize, 0, &data))
+		throw new std::runtime_error("Failed to map LOD instance buffer!");
+
+	this->mappedInstances = static_cast<glm::vec4*>(data);
+
+	uint32_t levelCount = (uint32_t)this->lodMesh.GetLevels().size();
+	this->levelCountsArray.resize(MAX_FRAMES_IN_FLIGHT, std::vector<uint32_t>(levelCount, 0));
+	this->reportLevelCountsArray.resize(levelCount, 0);
+}
+
+void LodRenderer::CreateDescriptorSet()
+{
+	VkDescriptorSetLayoutBinding binding{};
+	binding.binding = 0;
+	binding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	binding.descriptorCount = 1;
+	binding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo{};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.bindingCount = 1;
+	layoutInfo.pBindings = &binding;
+
+	if (VK_SUCCESS != vkCreateDescriptorSetLayout(this->app->logicalDevice, &layoutInfo, nullptr, &this->descriptorSetLayout))
+		throw new std::runtime_error("Failed to create LOD descriptor set layout!");
+
+	VkDescriptorPoolSize poolSize{};
+	poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	poolSize.descriptorCount = 1;
+
+	VkDescriptorPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.poolSizeCount = 1;
+	poolInfo.pPoolSizes = &poolSize;
+	poolInfo.maxSets = 1;
+
+	if (VK_SUCCESS != vkCreateDescriptorPool(this->app->logicalDevice, &poolInfo, nullptr, &this->descriptorPool))
+		throw new std::runtime_error("Failed to create LOD descriptor pool!");
+
+	VkDescriptorSetAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = this->descriptorPool;
+	allocInfo.descriptorSetCount = 1;
+	allocInfo.pSetLayouts = &this->descriptorSetLayout;
+
+	if (VK_SUCCESS != vkAllocateDescriptorSets(this->app->logicalDevice, &allocInfo, &this->descriptorSet))
+		throw new std::runtime_error("Failed to allocate LOD descriptor set!");
+
+	VkDescriptorBufferInfo bufferInfo{};
+	bufferInfo.buffer = this->instanceBuffer;
+	bufferInfo.offset = 0;
+	bufferInfo.range = VK_WHOLE_SIZE;
+
+	VkWriteDescriptorSet descriptorWrite{};
+	descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	descriptorWrite.dstSet = this->descriptorSet;
+	descriptorWrite.dstBinding = 0;
+	descriptorWrite.dstArrayElement = 0;
+	descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	descriptorWrite.descriptorCount = 1;
+	descriptorWrite.pBufferInfo = &bufferInfo;
+
+	vkUpdateDescriptorSets(this->app->logicalDevice, 1, &descriptorWrite, 0, nullptr);
+}
+
+void LodRenderer::CreateGraphicsPipeline()
+{
+	auto vertShaderCode = Application::ReadFile("lod_vert.spv");
+	auto fragShaderCode = Application::ReadFile("lod_frag.spv");
+
+	VkShaderModule vertShaderModule = this->app->CreateShaderModule(vertShaderCode);
+	VkShaderModule fragShaderModule = this->app->CreateShaderModule(fragShaderCode);
+
+	VkPipelineShaderStageCreateInfo shaderStages[2]{};
+
+	shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+	shaderStages[0].module = vertShaderModule;
+	shaderStages[0].pName = "main";
+
+	shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+	shaderStages[1].module = fragShaderModule;
+	shaderStages[1].pName = "main";
+
+	VkVertexInputBindingDescription bindingDescription{};
+	bindingDescription.binding = 0;
+	bindingDescription.stride = sizeof(LodVertex);
+	bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+	std::array<VkVertexInputAttributeDescription, 2> attributeDescriptions{};
+
+	attributeDescriptions[0].binding = 0;
+	attributeDescriptions[0].location = 0;
+	attributeDescriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
+	attributeDescriptions[0].offset = offsetof(LodVertex, position);
+
+	attributeDescriptions[1].binding = 0;
+	attributeDescriptions[1].location = 1;
+	attributeDescriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
+	attributeDescriptions[1].offset = offsetof(LodVertex, normal);
+
+	VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
+	vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+	vertexInputInfo.vertexBindingDescriptionCount = 1;
+	vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
+	vertexInputInfo.vertexAttributeDescriptionCount = (uint32_t)attributeDescriptions.size();
+	vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
+
+	VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
+	inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+	inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+	inputAssembly.primitiveRestartEnable = VK_FALSE;
+
+	std::vector<VkDynamicState> dynamicStatesArray =
+	{
+			VK_DYNAMIC_STATE_VIEWPORT,
+			VK_DYNAMIC_STATE_SCISSOR
+	};
+
+	VkPipelineDynamicStateCreateInfo dynamicState{};
+	dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+	dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStatesArray.size());
+	dynamicState.pDynamicStates = dynamicStatesArray.data();
+
+	VkPipelineViewportStateCreateInfo viewportState{};
+	viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+	viewportState.viewportCount = 1;
+	viewportState.scissorCount = 1;
+
+	// There's no depth buffer, so back faces must go; same winding convention as the tutorial quad.
+	VkPipelineRasterizationStateCreateInfo rasterizer{};
+	rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+	rasterizer.depthClampEnable = VK_FALSE;
+	rasterizer.rasterizerDiscardEnable = VK_FALSE;
+	rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+	rasterizer.lineWidth = 1.0f;
+	rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
+	rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+	rasterizer.depthBiasEnable = VK_FALSE;
+
+	VkPipelineMultisampleStateCreateInfo multisampling{};
+	multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+	multisampling.sampleShadingEnable = VK_FALSE;
+	multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+	VkPipelineColorBlendAttachmentState colorBlendAttachment{};
+	colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+	colorBlendAttachment.blendEnable = VK_FALSE;
+
+	VkPipelineColorBlendStateCreateInfo colorBlending{};
+	colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+	colorBlending.logicOpEnable = VK_FALSE;
+	colorBlending.attachmentCount = 1;
+	colorBlending.pAttachments = &colorBlendAttachment;
+
+	VkPushConstantRange pushConstantRange{};
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+	pushConstantRange.offset = 0;
+	pushConstantRange.size = sizeof(glm::mat4);
+
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount = 1;
+	pipelineLayoutInfo.pSetLayouts = &this->descriptorSetLayout;
+	pipelineLayoutInfo.pushConstantRangeCount = 1;
+	pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+	if (VK_SUCCESS != vkCreatePipelineLayout(this->app->logicalDevice, &pipelineLayoutInfo, nullptr, &this->pipelineLayout))
+		throw new std::runtime_error("Failed to create LOD pipeline layout!");
+
+	VkGraphicsPipelineCreateInfo pipelineInfo{};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+	pipelineInfo.stageCount = 2;
+	pipelineInfo.pStages = shaderStages;
+	pipelineInfo.pVertexInputState = &vertexInputInfo;
+	pipelineInfo.pInputAssemblyState = &inputAssembly;
+	pipelineInfo.pViewportState = &viewportState;
+	pipelineInfo.pRasterizationState = &rasterizer;
+	pipelineInfo.pMultisampleState = &multisampling;
+	pipelineInfo.pDepthStencilState = nullptr;
+	pipelineInfo.pColorBlendState = &colorBlending;
+	pipelineInfo.pDynamicState = &dynamicState;
+	pipelineInfo.layout = this->pipelineLayout;
+	pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+	pipelineInfo.basePipelineIndex = -1;
+
+	VkPipelineRenderingCreateInfoKHR pipelineRenderingInfo{};
+	this->app->ConfigurePipelineRenderingInfo(pipelineInfo, pipelineRenderingInfo);
+
+	if (VK_SUCCESS != vkCreateGraphicsPipelines(this->app->logicalDevice, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &this->graphicsPipeline))
+		throw new std::runtime_error("Failed to create LOD graphics pipeline!");
+
+	vkDestroyShaderModule(this->app->logicalDevice, vertShaderModule, nullptr);
+	vkDestroyShaderModule(this->app->logicalDevice, fragShaderModule, nullptr);
+}
+
+void LodRenderer::Update(float deltaTime, uint32_t i, const glm::mat4& view, const glm::mat4& proj)
+{
+	// The caller must have waited on frame slot i's fence, since we're about to overwrite its instances.
+	auto startTime = std::chrono::high_resolution_clock::now();
+
+	this->viewProjection = proj * view;
+
+	// One world unit at a distance of one covers this many pixels, vertically.
+	glm::vec3 eye = glm::vec3(glm::inverse(view)[3]);
+	float projectionScale = std::fabs(proj[1][1]) * 0.5f * float(this->app->swapChainExtent.height);
+
+	// The mesh's errors are for a unit sphere, so for an object of scale s, seen from distance d, they look like the
+	// unit mesh's from d / s.  Measuring to the nearest point of the bounds rather than the center keeps us on the
+	// cautious side for objects up close.
+	auto selectLevels = [this, eye, projectionScale](size_t begin, size_t end)
+	{
+		for (size_t j = begin; j < end; j++)
+		{
+			const glm::vec4& object = this->objectsArray[j];
+			float distance = glm::length(glm::vec3(object) - eye) - object.w * (1.0f + LOD_MESH_BUMPINESS);
+			this->objectLevelsArray[j] = (uint8_t)this->lodMesh.SelectLevel(std::max(distance, 0.0f) / object.w, projectionScale, LOD_PIXEL_THRESHOLD);
+		}
+	};
+
+	if (this->app->threadPool)
+		this->app->threadPool->ParallelFor(this->objectCount, LOD_SELECT_BATCH_SIZE, selectLevels);
+	else
+		selectLevels(0, this->objectCount);
+
+	// Counting sort by level, straight into this frame slot's part of the instance buffer.
+	const std::vector<LodMesh::Level>& levelsArray = this->lodMesh.GetLevels();
+	std::vector<uint32_t>& levelCounts = this->levelCountsArray[i];
+	std::fill(levelCounts.begin(), levelCounts.end(), 0);
+
+	for (uint32_t j = 0; j < this->objectCount; j++)
+		levelCounts[this->objectLevelsArray[j]]++;
+
+	std::vector<uint32_t> cursorsArray(levelCounts.size(), 0);
+	for (size_t level = 1; level < levelCounts.size(); level++)
+		cursorsArray[level] = cursorsArray[level - 1] + levelCounts[level - 1];
+
+	glm::vec4* instances = this->mappedInstances + i * (size_t)this->objectCount;
+	for (uint32_t j = 0; j < this->objectCount; j++)
+		instances[cursorsArray[this->objectLevelsArray[j]]++] = this->objectsArray[j];
+
+	auto endTime = std::chrono::high_resolution_clock::now();
+
+	this->reportFrameCount++;
+	this->reportMilliseconds += std::chrono::duration<double, std::milli>(endTime - startTime).count();
+	for (size_t level = 0; level < levelCounts.size(); level++)
+	{
+		this->reportLevelCountsArray[level] += levelCounts[level];
+		this->reportTriangles += uint64_t(levelCounts[level]) * (levelsArray[level].indexCount / 3);
+	}
+
+	if (this->reportFrameCount == LOD_REPORT_INTERVAL)
+	{
+		double frames = double(this->reportFrameCount);
+		double fullTriangles = double(this->objectCount) * double(levelsArray[0].indexCount / 3);
+
+		std::cout << "LOD: " << this->objectCount << " objects | select " << this->reportMilliseconds / frames << " ms"
+			<< " | " << double(this->reportTriangles) / frames << " triangles (" << 100.0 * double(this->reportTriangles) / (frames * fullTriangles) << "% of full detail)"
+			<< " | objects per level:";
+		for (uint64_t& count : this->reportLevelCountsArray)
+		{
+			std::cout << " " << double(count) / frames;
+			count = 0;
+		}
+		std::cout << std::endl;
+
+		this->reportFrameCount = 0;
+		this->reportMilliseconds = 0.0;
+		this->reportTriangles = 0;
+	}
+}
+
+void LodRenderer::RecordDraw(VkCommandBuffer givenCommandBuffer, uint32_t i)
+{
+	vkCmdBindPipeline(givenCommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, this->graphicsPipeline);
+	vkCmdBindDescriptorSets(givenCommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, this->pipelineLayout, 0, 1, &this->descriptorSet, 0, nullptr);
+	vkCmdPushConstants(givenCommandBuffer, this->pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(glm::mat4), &this->viewProjection);
+
+	// One instanced draw per level, over that level's index range.  The instances of a level start where the counting
+	// sort put them, and gl_InstanceIndex counts from firstInstance.  Coarse levels are the far ones, so drawing them
+	// first gets us roughly back-to-front order, which is the best we can do without a depth buffer.
+	const std::vector<LodMesh::Level>& levelsArray = this->lodMesh.GetLevels();
+	const std::vector<uint32_t>& levelCounts = this->levelCountsArray[i];
+	const GeometryPool::Mesh& mesh = this->app->geometryPool->GetMesh(this->meshId);
+
+	uint32_t firstInstance = i * this->objectCount + this->objectCount;
+	for (size_t level = levelsArray.size(); level-- > 0;)
+	{
+		firstInstance -= levelCounts[level];
+		if (levelCounts[level] > 0)
+			vkCmdDrawIndexed(givenCommandBuffer, levelsArray[level].indexCount, levelCounts[level], mesh.firstIndex + levelsArray[level].indexOffset, mesh.vertexOffset, firstInstance);
+	}
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "Application.h"
+#include "LodMesh.h"
+#include "GeometryPool.h"
+
+// Draws a large field of copies of one detailed mesh (a procedurally made, bumpy sphere), each at a level of detail
+// picked every frame from how big that level's error would look on screen.  The mesh and all its levels are one mesh
+// of the geometry pool.  Each frame the instances are sorted by level into that frame slot's part of a
+// mapped storage buffer, and each level is then one instanced draw of its index range.
+class LodRenderer
+{
+public:
+	LodRenderer(Application* app, uint32_t objectCount);
+	virtual ~LodRenderer();
+
+	void Create();
+	void Destroy();
+	void Update(float deltaTime, uint32_t i, const glm::mat4& view, const glm::mat4& proj);
+	void RecordDraw(VkCommandBuffer givenCommandBuffer, uint32_t i);
+
+	const LodMesh& GetLodMesh() const { return this->lodMesh; }
+
+private:
+	struct LodVertex
+	{
+		glm::vec3 position;
+		glm::vec3 normal;
+	};
+
+	void BuildMesh();
+	void PlaceObjects();
+	void CreateMeshBuffers();
+	void CreateInstanceBuffer();
+	void CreateDescriptorSet();
+	void CreateGraphicsPipeline();
+
+	Application* app;
+	uint32_t objectCount;
+	std::vector<LodVertex> verticesArray;
+	LodMesh lodMesh;
+	std::vector<glm::vec4> objectsArray;		// Position in xyz, uniform scale in w.
+	std::vector<uint8_t> objectLevelsArray;
+	glm::mat4 viewProjection;
+
+	GeometryPool::MeshId meshId;		// Every level of the mesh, in the geometry pool.
+	VkBuffer instanceBuffer;
+	VkDeviceMemory instanceBufferMemory;
+	glm::vec4* mappedInstances;		// An object count's worth per frame slot.
+	std::vector<std::vector<uint32_t>> levelCountsArray;		// Per frame slot, per level.
+	VkDescriptorSetLayout descriptorSetLayout;
+	VkDescriptorPool descriptorPool;
+	VkDescriptorSet descriptorSet;
+	VkPipelineLayout pipelineLayout;
+	VkPipeline graphicsPipeline;
+
+	uint32_t reportFrameCount;
+	double reportMilliseconds;
+	uint64_t reportTriangles;
+	std::vector<uint64_t> reportLevelCountsArray;
+};
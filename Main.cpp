@@ -1,7 +1,55 @@
 #include "Application.h"
+#include "Benchmarks.h"
+#include "DeviceSelector.h"
+#include <fstream>
+#include <cstring>
 
-int main()
+int main(int argc, char** argv)
 {
+	if (argc > 1 && 0 == ::strcmp(argv[1], "--benchmark"))
+	{
+		RunBenchmarks(std::cout);
+		return EXIT_SUCCESS;
+	}
+
+	if (argc > 1 && 0 == ::strcmp(argv[1], "--benchmark-renderer"))
+	{
+		std::string baselinePath = "renderer_baseline.txt";
+		bool updateBaseline = false;
+		for (int j = 2; j < argc; j++)
+		{
+			if (0 == ::strcmp(argv[j], "--update-baseline"))
+				updateBaseline = true;
+			else
+				baselinePath = argv[j];
+		}
+
+		try
+		{
+			return RunRendererBenchmarks(std::cout, baselinePath, updateBaseline);
+		}
+		catch (std::exception* e)
+		{
+			std::cerr << e->what() << std::endl;
+			delete e;
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (argc > 1 && 0 == ::strcmp(argv[1], "--replay-devices"))
+	{
+		std::string dumpPath = (argc > 2) ? argv[2] : "device_profiles.txt";
+		std::ifstream dumpStream(dumpPath);
+		if (!dumpStream.is_open())
+		{
+			std::cerr << "Failed to open device dump " << dumpPath << "!" << std::endl;
+			return EXIT_FAILURE;
+		}
+
+		// The same override the application honors, e.g. VULKAN_TUTORIAL_DEVICE=nvidia.
+		return ReplayDeviceProfiles(dumpStream, Application::ReadEnvironmentSetting("VULKAN_TUTORIAL_DEVICE"), std::cout);
+	}
+
 	Application app;
 
 	try
@@ -0,0 +1,217 @@
+#include "MemoryTracker.h"
+#include <cstring>
+#include <iomanip>
+
+const uint32_t MEMORY_REPORT_INTERVAL = 240;
+const double MEMORY_BUDGET_WARNING = 0.9;		// Warn once a heap's usage is past this fraction of its budget.
+
+static double Megabytes(VkDeviceSize size)
+{
+	return double(size) / (1024.0 * 1024.0);
+}
+
+MemoryTracker::MemoryTracker(Application* app)
+{
+	this->app = app;
+	this->budgetEnabled = false;
+	this->pfnGetPhysicalDeviceMemoryProperties2 = nullptr;
+	this->tickCount = 0;
+
+	::memset(&this->memoryProperties, 0, sizeof(this->memoryProperties));
+	::memset(this->driverUsageArray, 0, sizeof(this->driverUsageArray));
+	::memset(this->budgetArray, 0, sizeof(this->budgetArray));
+	::memset(this->heapUsageArray, 0, sizeof(this->heapUsageArray));
+}
+
+/*virtual*/ MemoryTracker::~MemoryTracker()
+{
+}
+
+/*static*/ bool MemoryTracker::CheckBudgetSupport(VkPhysicalDevice device)
+{
+	uint32_t extensionCount = 0;
+	vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+	std::vector<VkExtensionProperties> availableExtensionsArray(extensionCount);
+	vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensionsArray.data());
+
+	for (const auto& extension : availableExtensionsArray)
+		if (0 == ::strcmp(extension.extensionName, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME))
+			return true;
+
+	return false;
+}
+
+void MemoryTracker::Initialize(bool budgetEnabled)
+{
+	vkGetPhysicalDeviceMemoryProperties(this->app->physicalDevice, &this->memoryProperties);
+
+	// The budget is queried through the 1.1 entry point, which the device might not have, in which case we do without.
+	if (budgetEnabled)
+		this->pfnGetPhysicalDeviceMemoryProperties2 = (PFN_vkGetPhysicalDeviceMemoryProperties2)vkGetInstanceProcAddr(this->app->instance, "vkGetPhysicalDeviceMemoryProperties2");
+
+	this->budgetEnabled = budgetEnabled && this->pfnGetPhysicalDeviceMemoryProperties2 != nullptr;
+
+	for (uint32_t heap = 0; heap < this->memoryProperties.memoryHeapCount; heap++)
+		this->budgetArray[heap] = this->memoryProperties.memoryHeaps[heap].size;
+
+	this->QueryBudget();
+
+	std::cout << "Memory heaps:" << std::endl;
+	for (uint32_t heap = 0; heap < this->memoryProperties.memoryHeapCount; heap++)
+	{
+		const VkMemoryHeap& memoryHeap = this->memoryProperties.memoryHeaps[heap];
+		std::cout << '\t' << heap << ": " << Megabytes(memoryHeap.size) << " MB" << ((memoryHeap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) ? ", device local" : "") << ", budget " << (this->budgetEnabled ? std::to_string(uint64_t(Megabytes(this->budgetArray[heap]))) + " MB" : "unknown") << std::endl;
+	}
+}
+
+uint32_t MemoryTracker::FindMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const
+{
+	for (uint32_t i = 0; i < this->memoryProperties.memoryTypeCount; i++)
+		if (0 != (typeFilter & (1 << i)) && (this->memoryProperties.memoryTypes[i].propertyFlags & properties) == properties)
+			return i;
+
+	throw new std::runtime_error("Failed to find suitable memory type!");
+}
+
+bool MemoryTracker::HasMemoryType(VkMemoryPropertyFlags properties) const
+{
+	for (uint32_t i = 0; i < this->memoryProperties.memoryTypeCount; i++)
+		if ((this->memoryProperties.memoryTypes[i].propertyFlags & properties) == properties)
+			return true;
+
+	return false;
+}
+
+VkResult MemoryTracker::Allocate(const VkMemoryAllocateInfo& allocInfo, const char* tag, VkDeviceMemory& memory)
+{
+	VkResult result = vkAllocateMemory(this->app->logicalDevice, &allocInfo, nullptr, &memory);
+	if (result != VK_SUCCESS)
+		return result;
+
+	Allocation allocation;
+	allocation.size = allocInfo.allocationSize;
+	allocation.heap = this->memoryProperties.memoryTypes[allocInfo.memoryTypeIndex].heapIndex;
+	allocation.tag = tag;
+
+	std::lock_guard<std::mutex> lock(this->mutex);
+
+	this->allocationMap[memory] = allocation;
+
+	Usage& heapUsage = this->heapUsageArray[allocation.heap];
+	heapUsage.usage += allocation.size;
+	heapUsage.peakUsage = std::max(heapUsage.peakUsage, heapUsage.usage);
+	heapUsage.allocationCount++;
+
+	Usage& tagUsage = this->tagUsageMap[tag];
+	tagUsage.usage += allocation.size;
+	tagUsage.peakUsage = std::max(tagUsage.peakUsage, tagUsage.usage);
+	tagUsage.allocationCount++;
+
+	return VK_SUCCESS;
+}
+
+void MemoryTracker::Free(VkDeviceMemory memory)
+{
+	if (memory == VK_NULL_HANDLE)
+		return;
+
+	vkFreeMemory(this->app->logicalDevice, memory, nullptr);
+
+	std::lock_guard<std::mutex> lock(this->mutex);
+
+	auto iter = this->allocationMap.find(memory);
+	if (iter == this->allocationMap.end())
+		return;
+
+	const Allocation& allocation = iter->second;
+
+	Usage& heapUsage = this->heapUsageArray[allocation.heap];
+	heapUsage.usage -= allocation.size;
+	heapUsage.allocationCount--;
+
+	Usage& tagUsage = this->tagUsageMap[allocation.tag];
+	tagUsage.usage -= allocation.size;
+	tagUsage.allocationCount--;
+
+	this->allocationMap.erase(iter);
+}
+
+MemoryTracker::HeapStatistics MemoryTracker::GetHeapStatistics(uint32_t heap)
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+
+	HeapStatistics stats;
+	stats.usage = this->heapUsageArray[heap].usage;
+	stats.peakUsage = this->heapUsageArray[heap].peakUsage;
+	stats.allocationCount = this->heapUsageArray[heap].allocationCount;
+	stats.driverUsage = this->driverUsageArray[heap];
+	stats.budget = this->budgetArray[heap];
+	return stats;
+}
+
+void MemoryTracker::Tick()
+{
+	if (++this->tickCount < MEMORY_REPORT_INTERVAL)
+		return;
+
+	this->tickCount = 0;
+	this->QueryBudget();
+	this->Report(std::cout);
+}
+
+void MemoryTracker::Report(std::ostream& stream)
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+
+	// The stream is usually std::cout, so its formatting goes back the way it was when we're done.
+	std::ios_base::fmtflags flags = stream.flags();
+	std::streamsize precision = stream.precision();
+	stream << std::fixed << std::setprecision(1);
+
+	for (uint32_t heap = 0; heap < this->memoryProperties.memoryHeapCount; heap++)
+	{
+		const Usage& heapUsage = this->heapUsageArray[heap];
+		if (heapUsage.peakUsage == 0 && this->driverUsageArray[heap] == 0)
+			continue;
+
+		stream << "Memory heap " << heap << ": " << Megabytes(heapUsage.usage) << " MB in " << heapUsage.allocationCount << " allocations, peak " << Megabytes(heapUsage.peakUsage) << " MB";
+		if (this->budgetEnabled)
+			stream << ", process " << Megabytes(this->driverUsageArray[heap]) << " of " << Megabytes(this->budgetArray[heap]) << " MB budget";
+		stream << std::endl;
+
+		// The driver's figure covers the whole process, swap-chain and all, so that's the one to hold against the budget.
+		VkDeviceSize usage = this->budgetEnabled ? this->driverUsageArray[heap] : heapUsage.usage;
+		if (double(usage) > MEMORY_BUDGET_WARNING * double(this->budgetArray[heap]))
+			stream << "WARNING: Memory heap " << heap << " is at " << int(100.0 * double(usage) / double(this->budgetArray[heap])) << "% of its budget!" << std::endl;
+	}
+
+	stream << "Memory by usage:";
+	for (const auto& pair : this->tagUsageMap)
+		stream << ' ' << pair.first << " " << Megabytes(pair.second.usage) << " MB (" << pair.second.allocationCount << ")";
+	stream << std::endl;
+
+	stream.flags(flags);
+	stream.precision(precision);
+}
+
+void MemoryTracker::QueryBudget()
+{
+	if (!this->budgetEnabled)
+		return;
+
+	VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties{};
+	budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+
+	VkPhysicalDeviceMemoryProperties2 memoryProperties2{};
+	memoryProperties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+	memoryProperties2.pNext = &budgetProperties;
+
+	this->pfnGetPhysicalDeviceMemoryProperties2(this->app->physicalDevice, &memoryProperties2);
+
+	std::lock_guard<std::mutex> lock(this->mutex);
+	for (uint32_t heap = 0; heap < this->memoryProperties.memoryHeapCount; heap++)
+	{
+		this->driverUsageArray[heap] = budgetProperties.heapUsage[heap];
+		this->budgetArray[heap] = budgetProperties.heapBudget[heap];
+	}
+}
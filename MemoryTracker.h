@@ -0,0 +1,76 @@
+#pragma once
+
+#include "Application.h"
+#include <mutex>
+#include <map>
+#include <unordered_map>
+
+// Every device memory allocation goes through here, so we know where our GPU memory is going: how much of each heap
+// we're using, our peak, and how many allocations that took, with a breakdown by what the memory was for.  If the
+// device has VK_EXT_memory_budget, each heap also gets the driver's own figures: what the whole process is using, and
+// how much it can use before the driver starts paging things out.  A summary is logged every so often, with a warning
+// for any heap over its budget threshold.  The device's memory properties are queried once and kept, too.
+class MemoryTracker
+{
+public:
+	struct HeapStatistics
+	{
+		VkDeviceSize usage;
+		VkDeviceSize peakUsage;
+		uint32_t allocationCount;
+		VkDeviceSize driverUsage;		// From VK_EXT_memory_budget, else zero.
+		VkDeviceSize budget;			// From VK_EXT_memory_budget, else the heap's size.
+	};
+
+	MemoryTracker(Application* app);
+	virtual ~MemoryTracker();
+
+	static bool CheckBudgetSupport(VkPhysicalDevice device);
+
+	// Call once the device exists, saying whether VK_EXT_memory_budget was enabled on it.
+	void Initialize(bool budgetEnabled);
+
+	uint32_t FindMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const;
+	bool HasMemoryType(VkMemoryPropertyFlags properties) const;
+	const VkPhysicalDeviceMemoryProperties& GetMemoryProperties() const { return this->memoryProperties; }
+
+	// The tag says what the memory is for.  It's kept as a pointer, so it should be a literal.
+	VkResult Allocate(const VkMemoryAllocateInfo& allocInfo, const char* tag, VkDeviceMemory& memory);
+	void Free(VkDeviceMemory memory);
+
+	uint32_t GetHeapCount() const { return this->memoryProperties.memoryHeapCount; }
+	HeapStatistics GetHeapStatistics(uint32_t heap);
+
+	// Logs a summary every MEMORY_REPORT_INTERVAL calls; call once a frame.
+	void Tick();
+	void Report(std::ostream& stream);
+
+private:
+	struct Allocation
+	{
+		VkDeviceSize size;
+		uint32_t heap;
+		const char* tag;
+	};
+
+	struct Usage
+	{
+		VkDeviceSize usage;
+		VkDeviceSize peakUsage;
+		uint32_t allocationCount;
+	};
+
+	void QueryBudget();
+
+	Application* app;
+	VkPhysicalDeviceMemoryProperties memoryProperties;
+	bool budgetEnabled;
+	PFN_vkGetPhysicalDeviceMemoryProperties2 pfnGetPhysicalDeviceMemoryProperties2;
+	VkDeviceSize driverUsageArray[VK_MAX_MEMORY_HEAPS];
+	VkDeviceSize budgetArray[VK_MAX_MEMORY_HEAPS];
+	Usage heapUsageArray[VK_MAX_MEMORY_HEAPS];
+	std::map<std::string, Usage> tagUsageMap;
+	std::unordered_map<VkDeviceMemory, Allocation> allocationMap;
+	std::mutex mutex;
+	uint32_t tickCount;
+};
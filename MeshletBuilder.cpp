@@ -0,0 +1,238 @@
+#include "MeshletBuilder.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+MeshletBuilder::MeshletBuilder()
+{
+}
+
+/*virtual*/ MeshletBuilder::~MeshletBuilder()
+{
+}
+
+void MeshletBuilder::Build(const float* positions, uint32_t vertexCount, size_t positionStride, const std::vector<uint32_t>& indicesArray)
+{
+	this->meshletsArray.clear();
+	this->boundsArray.clear();
+	this->vertexIndicesArray.clear();
+	this->trianglesArray.clear();
+
+	uint32_t triangleCount = (uint32_t)(indicesArray.size() / 3);
+
+	// Which triangles use each vertex, as one flat array with a starting offset per vertex.
+	std::vector<uint32_t> adjacencyOffsetsArray(vertexCount + 1, 0);
+	for (uint32_t index : indicesArray)
+		adjacencyOffsetsArray[index + 1]++;
+	for (uint32_t v = 0; v < vertexCount; v++)
+		adjacencyOffsetsArray[v + 1] += adjacencyOffsetsArray[v];
+
+	std::vector<uint32_t> adjacencyArray(indicesArray.size());
+	std::vector<uint32_t> cursorsArray(adjacencyOffsetsArray.begin(), adjacencyOffsetsArray.end() - 1);
+	for (uint32_t t = 0; t < triangleCount; t++)
+		for (uint32_t k = 0; k < 3; k++)
+			adjacencyArray[cursorsArray[indicesArray[3 * t + k]]++] = t;
+
+	std::vector<bool> triangleUsedArray(triangleCount, false);
+	std::vector<uint32_t> triangleQueuedArray(triangleCount, std::numeric_limits<uint32_t>::max());		// The meshlet it was last made a candidate of.
+	std::vector<uint8_t> localIndexArray(vertexCount, 0xFF);		// Where each vertex is in the meshlet being grown, if it's in it.
+	std::vector<uint32_t> candidatesArray;
+	uint32_t nextSeed = 0;
+
+	Meshlet meshlet{};
+	float centroidSum[3] = { 0.0f, 0.0f, 0.0f };
+
+	auto finishMeshlet = [&]()
+	{
+		for (uint32_t j = 0; j < meshlet.vertexCount; j++)
+			localIndexArray[this->vertexIndicesArray[meshlet.vertexOffset + j]] = 0xFF;
+
+		this->boundsArray.push_back(this->ComputeBounds(positions, positionStride, meshlet));
+		this->meshletsArray.push_back(meshlet);
+
+		meshlet.vertexOffset = (uint32_t)this->vertexIndicesArray.size();
+		meshlet.triangleOffset = (uint32_t)this->trianglesArray.size();
+		meshlet.vertexCount = 0;
+		meshlet.triangleCount = 0;
+		centroidSum[0] = centroidSum[1] = centroidSum[2] = 0.0f;
+		candidatesArray.clear();
+	};
+
+	for (;;)
+	{
+		if (meshlet.triangleCount == MAX_TRIANGLES)
+		{
+			finishMeshlet();
+			continue;
+		}
+
+		// Of the unused triangles touching the meshlet, the one that brings in the fewest new vertices, and of those,
+		// the one nearest the middle of what we have so far, which keeps the meshlet round and so its bounds tight.
+		float center[3] = { 0.0f, 0.0f, 0.0f };
+		if (meshlet.vertexCount > 0)
+			for (int k = 0; k < 3; k++)
+				center[k] = centroidSum[k] / float(meshlet.vertexCount);
+
+		uint32_t best = std::numeric_limits<uint32_t>::max();
+		uint32_t bestNewCount = 4;
+		float bestDistance = std::numeric_limits<float>::max();
+		for (size_t c = 0; c < candidatesArray.size();)
+		{
+			uint32_t t = candidatesArray[c];
+			if (triangleUsedArray[t])
+			{
+				candidatesArray[c] = candidatesArray.back();
+				candidatesArray.pop_back();
+				continue;
+			}
+
+			uint32_t newCount = 0;
+			float distance = 0.0f;
+			for (uint32_t k = 0; k < 3; k++)
+			{
+				uint32_t index = indicesArray[3 * t + k];
+				if (localIndexArray[index] == 0xFF)
+					newCount++;
+
+				const float* position = positions + index * positionStride;
+				float dx = position[0] - center[0], dy = position[1] - center[1], dz = position[2] - center[2];
+				distance += dx * dx + dy * dy + dz * dz;
+			}
+
+			if (newCount < bestNewCount || (newCount == bestNewCount && distance < bestDistance))
+			{
+				best = t;
+				bestNewCount = newCount;
+				bestDistance = distance;
+			}
+
+			c++;
+		}
+
+		if (best == std::numeric_limits<uint32_t>::max())
+		{
+			// Nothing left around this one, so it's done; or we're starting a new one, from the first unused triangle.
+			if (meshlet.triangleCount > 0)
+			{
+				finishMeshlet();
+				continue;
+			}
+
+			while (nextSeed < triangleCount && triangleUsedArray[nextSeed])
+				nextSeed++;
+
+			if (nextSeed == triangleCount)
+				break;
+
+			best = nextSeed;
+			bestNewCount = 3;
+		}
+		else if (meshlet.vertexCount + bestNewCount > MAX_VERTICES)
+		{
+			finishMeshlet();
+			continue;
+		}
+
+		uint32_t meshletIndex = (uint32_t)this->meshletsArray.size();
+		uint32_t packed = 0;
+		for (uint32_t k = 0; k < 3; k++)
+		{
+			uint32_t index = indicesArray[3 * best + k];
+			if (localIndexArray[index] == 0xFF)
+			{
+				localIndexArray[index] = (uint8_t)meshlet.vertexCount++;
+				this->vertexIndicesArray.push_back(index);
+
+				const float* position = positions + index * positionStride;
+				for (int j = 0; j < 3; j++)
+					centroidSum[j] += position[j];
+
+				// Only a new vertex can bring in triangles that aren't candidates already.
+				for (uint32_t a = adjacencyOffsetsArray[index]; a < adjacencyOffsetsArray[index + 1]; a++)
+				{
+					uint32_t neighbor = adjacencyArray[a];
+					if (!triangleUsedArray[neighbor] && triangleQueuedArray[neighbor] != meshletIndex)
+					{
+						triangleQueuedArray[neighbor] = meshletIndex;
+						candidatesArray.push_back(neighbor);
+					}
+				}
+			}
+
+			packed |= uint32_t(localIndexArray[index]) << (8 * k);
+		}
+
+		this->trianglesArray.push_back(packed);
+		meshlet.triangleCount++;
+		triangleUsedArray[best] = true;
+	}
+
+	if (meshlet.triangleCount > 0)
+		finishMeshlet();
+}
+
+MeshletBuilder::Bounds MeshletBuilder::ComputeBounds(const float* positions, size_t positionStride, const Meshlet& meshlet) const
+{
+	Bounds bounds{};
+
+	// The sphere is around the centroid of the vertices, which isn't the smallest one, but is close enough for patches
+	// as round as ours.
+	for (uint32_t j = 0; j < meshlet.vertexCount; j++)
+	{
+		const float* position = positions + this->vertexIndicesArray[meshlet.vertexOffset + j] * positionStride;
+		for (int k = 0; k < 3; k++)
+			bounds.center[k] += position[k] / float(meshlet.vertexCount);
+	}
+
+	float radiusSquared = 0.0f;
+	for (uint32_t j = 0; j < meshlet.vertexCount; j++)
+	{
+		const float* position = positions + this->vertexIndicesArray[meshlet.vertexOffset + j] * positionStride;
+		float dx = position[0] - bounds.center[0], dy = position[1] - bounds.center[1], dz = position[2] - bounds.center[2];
+		radiusSquared = std::max(radiusSquared, dx * dx + dy * dy + dz * dz);
+	}
+	bounds.radius = std::sqrt(radiusSquared);
+
+	// The cone's axis is the average of the unit triangle normals, and it's as wide as the one furthest from it.
+	std::vector<float> normalsArray;
+	normalsArray.reserve(3 * meshlet.triangleCount);
+	float axis[3] = { 0.0f, 0.0f, 0.0f };
+	for (uint32_t t = 0; t < meshlet.triangleCount; t++)
+	{
+		uint32_t packed = this->trianglesArray[meshlet.triangleOffset + t];
+		const float* p0 = positions + this->vertexIndicesArray[meshlet.vertexOffset + (packed & 0xFF)] * positionStride;
+		const float* p1 = positions + this->vertexIndicesArray[meshlet.vertexOffset + ((packed >> 8) & 0xFF)] * positionStride;
+		const float* p2 = positions + this->vertexIndicesArray[meshlet.vertexOffset + ((packed >> 16) & 0xFF)] * positionStride;
+
+		float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+		float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+		float normal[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+		float length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+		if (length == 0.0f)
+			continue;		// Degenerate triangles can't be seen from either side.
+
+		for (int k = 0; k < 3; k++)
+		{
+			normalsArray.push_back(normal[k] / length);
+			axis[k] += normal[k] / length;
+		}
+	}
+
+	bounds.coneCutoff = 2.0f;
+	float axisLength = std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+	if (axisLength > 0.0f)
+	{
+		for (int k = 0; k < 3; k++)
+			bounds.coneAxis[k] = axis[k] / axisLength;
+
+		float minDot = 1.0f;
+		for (size_t n = 0; n < normalsArray.size(); n += 3)
+			minDot = std::min(minDot, normalsArray[n] * bounds.coneAxis[0] + normalsArray[n + 1] * bounds.coneAxis[1] + normalsArray[n + 2] * bounds.coneAxis[2]);
+
+		// Half angle 90 degrees or more, and some triangle always faces the camera.
+		if (minDot > 0.0f)
+			bounds.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+	}
+
+	return bounds;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// Splits an indexed triangle mesh into meshlets: clusters of at most MAX_VERTICES vertices and MAX_TRIANGLES triangles,
+// each grown greedily out of neighboring triangles so that it's a compact patch of the surface.  Every meshlet gets a
+// bounding sphere and a cone around the normals of its triangles, so that the GPU can throw whole clusters away, for
+// being outside the frustum or facing away from the camera, before any of their vertices are touched.
+//
+// The results are flat arrays meant to be uploaded as they are: the meshlets, their bounds, the mesh vertex index of each
+// meshlet vertex, and each triangle's three meshlet-local vertex indices, packed 8 bits apiece into one 32-bit word.
+// Like the LOD mesh, nothing in here depends on Vulkan or glm.
+class MeshletBuilder
+{
+public:
+	static const uint32_t MAX_VERTICES = 64;
+	static const uint32_t MAX_TRIANGLES = 124;
+
+	struct Meshlet
+	{
+		uint32_t vertexOffset;		// Into the vertex indices.
+		uint32_t triangleOffset;	// Into the packed triangles.
+		uint32_t vertexCount;
+		uint32_t triangleCount;
+	};
+
+	// Seen from the eye e, every triangle of a meshlet faces away when
+	//     dot(center - e, coneAxis) >= coneCutoff * (length(center - e) + radius) + radius
+	// The cutoff is the sine of the cone's half angle; a cone too wide for that ever to hold gets a cutoff of two.
+	struct Bounds
+	{
+		float center[3];
+		float radius;
+		float coneAxis[3];
+		float coneCutoff;
+	};
+
+	MeshletBuilder();
+	virtual ~MeshletBuilder();
+
+	// Positions are float[3], positionStride floats apart.  Triangles keep their winding.
+	void Build(const float* positions, uint32_t vertexCount, size_t positionStride, const std::vector<uint32_t>& indicesArray);
+
+	const std::vector<Meshlet>& GetMeshlets() const { return this->meshletsArray; }
+	const std::vector<Bounds>& GetBounds() const { return this->boundsArray; }
+	const std::vector<uint32_t>& GetVertexIndices() const { return this->vertexIndicesArray; }
+	const std::vector<uint32_t>& GetTriangles() const { return this->trianglesArray; }
+
+private:
+	Bounds ComputeBounds(const float* positions, size_t positionStride, const Meshlet& meshlet) const;
+
+	std::vector<Meshlet> meshletsArray;
+	std::vector<Bounds> boundsArray;
+	std::vector<uint32_t> vertexIndicesArray;
+	std::vector<uint32_t> trianglesArray;
+};
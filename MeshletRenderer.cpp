@@ -0,0 +1,541 @@
+#include "MeshletRenderer.h"
+#include "MemoryTracker.h"
+#include "PipelineCache.h"
+#include <cmath>
+
+const uint32_t MESHLET_MESH_RINGS = 512;
+const uint32_t MESHLET_MESH_SEGMENTS = 1024;
+const float MESHLET_MESH_BUMPINESS = 0.05f;
+const uint32_t MESHLET_CULL_GROUP_SIZE = 64;		// Must match meshlet_cull.comp.
+const uint32_t MESHLET_TASK_GROUP_SIZE = 32;		// Must match meshlet.task and meshlet.mesh.
+const uint32_t MESHLET_REPORT_INTERVAL = 240;
+
+MeshletRenderer::MeshletRenderer(Application* app, uint32_t objectCount, bool cullingEnabled, bool meshShadersEnabled)
+{
+	this->app = app;
+	this->objectCount = objectCount;
+	this->cullingEnabled = cullingEnabled;
+	this->meshShadersEnabled = meshShadersEnabled;
+	this->shaderStages = 0;
+	this->meshId = GeometryPool::INVALID_MESH;
+	this->objectBuffer = VK_NULL_HANDLE;
+	this->objectBufferMemory = nullptr;
+	this->meshletBuffer = VK_NULL_HANDLE;
+	this->meshletBufferMemory = nullptr;
+	this->boundsBuffer = VK_NULL_HANDLE;
+	this->boundsBufferMemory = nullptr;
+	this->vertexIndexBuffer = VK_NULL_HANDLE;
+	this->vertexIndexBufferMemory = nullptr;
+	this->triangleBuffer = VK_NULL_HANDLE;
+	this->triangleBufferMemory = nullptr;
+	this->cullParamsBuffer = VK_NULL_HANDLE;
+	this->cullParamsBufferMemory = nullptr;
+	this->mappedCullParams = nullptr;
+	this->drawStateBuffer = VK_NULL_HANDLE;
+	this->drawStateBufferMemory = nullptr;
+	this->mappedDrawStates = nullptr;
+	this->visibleBuffer = VK_NULL_HANDLE;
+	this->visibleBufferMemory = nullptr;
+	this->descriptorSetLayout = VK_NULL_HANDLE;
+	this->descriptorPool = VK_NULL_HANDLE;
+	this->descriptorSet = VK_NULL_HANDLE;
+	this->pipelineLayout = VK_NULL_HANDLE;
+	this->cullPipeline = VK_NULL_HANDLE;
+	this->graphicsPipeline = VK_NULL_HANDLE;
+	this->pipelineId = 0;
+	this->reportFrameCount = 0;
+	this->reportClusters = 0;
+}
+
+/*virtual*/ MeshletRenderer::~MeshletRenderer()
+{
+}
+
+void MeshletRenderer::Create()
+{
+	auto startTime = std::chrono::high_resolution_clock::now();
+
+	this->BuildMesh();
+
+	auto endTime = std::chrono::high_resolution_clock::now();
+
+	// A draw can only launch so many task workgroups; past that, we cull in compute instead.
+	uint32_t clusterCount = this->objectCount * (uint32_t)this->meshletBuilder.GetMeshlets().size();
+	if (this->meshShadersEnabled)
+	{
+		VkPhysicalDeviceMeshShaderPropertiesNV meshShaderProperties{};
+		meshShaderProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_PROPERTIES_NV;
+
+		VkPhysicalDeviceProperties2 properties2{};
+		properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+		properties2.pNext = &meshShaderProperties;
+		vkGetPhysicalDeviceProperties2(this->app->physicalDevice, &properties2);
+
+		if ((clusterCount + MESHLET_TASK_GROUP_SIZE - 1) / MESHLET_TASK_GROUP_SIZE > meshShaderProperties.maxDrawMeshTasksCount)
+			this->meshShadersEnabled = false;
+	}
+
+	this->shaderStages = this->meshShadersEnabled ? (VK_SHADER_STAGE_TASK_BIT_NV | VK_SHADER_STAGE_MESH_BIT_NV) : (VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_VERTEX_BIT);
+
+	this->PlaceObjects();
+	this->CreateBuffers();
+	this->CreateDescriptorSet();
+	this->CreatePipelineLayout();
+	if (!this->meshShadersEnabled)
+		this->CreateCullPipeline();
+	this->CreateGraphicsPipeline();
+
+	std::cout << "Meshlets: " << this->meshletBuilder.GetMeshlets().size() << " clusters of " << this->meshletBuilder.GetTriangles().size() << " triangles built in "
+		<< std::chrono::duration<double, std::milli>(endTime - startTime).count() << " ms, " << this->objectCount << " copies, "
+		<< (this->meshShadersEnabled ? "task and mesh shaders" : "compute culling and vertex pulling") << (this->cullingEnabled ? "" : ", culling off") << std::endl;
+}
+
+void MeshletRenderer::Destroy()
+{
+	VkDevice logicalDevice = this->app->logicalDevice;
+
+	vkDestroyPipeline(logicalDevice, this->graphicsPipeline, nullptr);
+	vkDestroyPipeline(logicalDevice, this->cullPipeline, nullptr);
+	vkDestroyPipelineLayout(logicalDevice, this->pipelineLayout, nullptr);
+	vkDestroyDescriptorPool(logicalDevice, this->descriptorPool, nullptr);
+	vkDestroyDescriptorSetLayout(logicalDevice, this->descriptorSetLayout, nullptr);
+
+	vkUnmapMemory(logicalDevice, this->drawStateBufferMemory);
+	vkUnmapMemory(logicalDevice, this->cullParamsBufferMemory);
+
+	VkBuffer* buffersArray[] = { &this->objectBuffer, &this->meshletBuffer, &this->boundsBuffer, &this->vertexIndexBuffer, &this->triangleBuffer, &this->cullParamsBuffer, &this->drawStateBuffer, &this->visibleBuffer };
+	VkDeviceMemory* memoriesArray[] = { &this->objectBufferMemory, &this->meshletBufferMemory, &this->boundsBufferMemory, &this->vertexIndexBufferMemory, &this->triangleBufferMemory, &this->cullParamsBufferMemory, &this->drawStateBufferMemory, &this->visibleBufferMemory };
+	for (int j = 0; j < 8; j++)
+	{
+		vkDestroyBuffer(logicalDevice, *buffersArray[j], nullptr);
+		this->app->memoryTracker->Free(*memoriesArray[j]);
+	}
+
+	this->app->geometryPool->RemoveMesh(this->meshId);
+}
+
+void MeshletRenderer::BuildMesh()
+{
+	// The same bumpy sphere as the LOD renderer's, only much finer.
+	auto addVertex = [this](float theta, float phi)
+	{
+		float radius = 1.0f + MESHLET_MESH_BUMPINESS * std::sin(5.0f * theta) * std::cos(7.0f * phi);
+		MeshletVertex vertex{};
+		vertex.position = radius * glm::vec3(std::sin(theta) * std::cos(phi), std::sin(theta) * std::sin(phi), std::cos(theta));
+		vertex.normal = glm::vec3(0.0f, 0.0f, 0.0f);
+		this->verticesArray.push_back(vertex);
+	};
+
+	addVertex(0.0f, 0.0f);
+	for (uint32_t ring = 1; ring < MESHLET_MESH_RINGS; ring++)
+		for (uint32_t segment = 0; segment < MESHLET_MESH_SEGMENTS; segment++)
+			addVertex(glm::pi<float>() * float(ring) / float(MESHLET_MESH_RINGS), 2.0f * glm::pi<float>() * float(segment) / float(MESHLET_MESH_SEGMENTS));
+	addVertex(glm::pi<float>(), 0.0f);
+
+	uint32_t southPole = (uint32_t)this->verticesArray.size() - 1;
+	auto ringVertex = [](uint32_t ring, uint32_t segment) { return 1 + (ring - 1) * MESHLET_MESH_SEGMENTS + segment % MESHLET_MESH_SEGMENTS; };
+
+	// Counter-clockwise seen from outside.
+	std::vector<uint32_t> indicesArray;
+	for (uint32_t segment = 0; segment < MESHLET_MESH_SEGMENTS; segment++)
+		indicesArray.insert(indicesArray.end(), { 0, ringVertex(1, segment), ringVertex(1, segment + 1) });
+
+	for (uint32_t ring = 1; ring < MESHLET_MESH_RINGS - 1; ring++)
+	{
+		for (uint32_t segment = 0; segment < MESHLET_MESH_SEGMENTS; segment++)
+		{
+			uint32_t a = ringVertex(ring, segment), b = ringVertex(ring + 1, segment), c = ringVertex(ring + 1, segment + 1), d = ringVertex(ring, segment + 1);
+			indicesArray.insert(indicesArray.end(), { a, b, c, a, c, d });
+		}
+	}
+
+	for (uint32_t segment = 0; segment < MESHLET_MESH_SEGMENTS; segment++)
+		indicesArray.insert(indicesArray.end(), { ringVertex(MESHLET_MESH_RINGS - 1, segment), southPole, ringVertex(MESHLET_MESH_RINGS - 1, segment + 1) });
+
+	for (size_t j = 0; j < indicesArray.size(); j += 3)
+	{
+		MeshletVertex& v0 = this->verticesArray[indicesArray[j]];
+		MeshletVertex& v1 = this->verticesArray[indicesArray[j + 1]];
+		MeshletVertex& v2 = this->verticesArray[indicesArray[j + 2]];
+		glm::vec3 faceNormal = glm::cross(v1.position - v0.position, v2.position - v0.position);
+		v0.normal += faceNormal;
+		v1.normal += faceNormal;
+		v2.normal += faceNormal;
+	}
+
+	for (MeshletVertex& vertex : this->verticesArray)
+		vertex.normal = glm::normalize(vertex.normal);
+
+	this->meshletBuilder.Build(&this->verticesArray[0].position.x, (uint32_t)this->verticesArray.size(), sizeof(MeshletVertex) / sizeof(float), indicesArray);
+}
+
+void MeshletRenderer::PlaceObjects()
+{
+	// A square field in the z = 0 plane, big enough that some copies are off-screen and some are far away.
+	uint32_t gridSize = (uint32_t)std::ceil(std::sqrt(double(this->objectCount)));
+	float spacing = 8.0f / float(gridSize);
+
+	this->objectsArray.resize(this->objectCount);
+	for (uint32_t j = 0; j < this->objectCount; j++)
+	{
+		float x = (float(j % gridSize) + 0.5f) * spacing - 6.0f;
+		float y = (float(j / gridSize) + 0.5f) * spacing - 6.0f;
+		this->objectsArray[j] = glm::vec4(x, y, 0.0f, 0.4f * spacing);
+	}
+}
+
+void MeshletRenderer::CreateBuffers()
+{
+	// The vertices go in the pool; the meshlets don't need the triangle list itself, so nothing goes in its index buffer.
+	this->meshId = this->app->geometryPool->AddMesh(this->verticesArray.data(), (uint32_t)this->verticesArray.size(), sizeof(MeshletVertex), nullptr, 0);
+	this->verticesArray.clear();
+	this->verticesArray.shrink_to_fit();
+
+	const std::vector<MeshletBuilder::Meshlet>& meshletsArray = this->meshletBuilder.GetMeshlets();
+	const std::vector<MeshletBuilder::Bounds>& boundsArray = this->meshletBuilder.GetBounds();
+	const std::vector<uint32_t>& vertexIndicesArray = this->meshletBuilder.GetVertexIndices();
+	const std::vector<uint32_t>& trianglesArray = this->meshletBuilder.GetTriangles();
+
+	this->app->CreateGeneralBuffer(this->objectsArray.data(), sizeof(glm::vec4) * this->objectsArray.size(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, this->objectBuffer, this->objectBufferMemory);
+	this->app->CreateGeneralBuffer(meshletsArray.data(), sizeof(MeshletBuilder::Meshlet) * meshletsArray.size(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, this->meshletBuffer, this->meshletBufferMemory);
+	this->app->CreateGeneralBuffer(boundsArray.data(), sizeof(MeshletBuilder::Bounds) * boundsArray.size(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, this->boundsBuffer, this->boundsBufferMemory);
+	this->app->CreateGeneralBuffer(vertexIndicesArray.data(), sizeof(uint32_t) * vertexIndicesArray.size(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, this->vertexIndexBuffer, this->vertexIndexBufferMemory);
+	this->app->CreateGeneralBuffer(trianglesArray.data(), sizeof(uint32_t) * trianglesArray.size(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, this->triangleBuffer, this->triangleBufferMemory);
+
+	void* data = nullptr;
+
+	VkDeviceSize cullParamsBufferSize = sizeof(CullParams) * MAX_FRAMES_IN_FLIGHT;
+	this->app->CreateBuffer(cullParamsBufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, this->cullParamsBuffer, this->cullParamsBufferMemory);
+	if (VK_SUCCESS != vkMapMemory(this->app->logicalDevice, this->cullParamsBufferMemory, 0, cullParamsBufferSize, 0, &data))
+		throw new std::runtime_error("Failed to map meshlet cull parameters buffer!");
+	this->mappedCullParams = static_cast<CullParams*>(data);
+
+	VkDeviceSize drawStateBufferSize = sizeof(DrawState) * MAX_FRAMES_IN_FLIGHT;
+	this->app->CreateBuffer(drawStateBufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, this->drawStateBuffer, this->drawStateBufferMemory);
+	if (VK_SUCCESS != vkMapMemory(this->app->logicalDevice, this->drawStateBufferMemory, 0, drawStateBufferSize, 0, &data))
+		throw new std::runtime_error("Failed to map meshlet draw state buffer!");
+	this->mappedDrawStates = static_cast<DrawState*>(data);
+
+	for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+		this->mappedDrawStates[i] = DrawState{ MeshletBuilder::MAX_TRIANGLES * 3, 0, 0, 0 };
+	this->drawPending.resize(MAX_FRAMES_IN_FLIGHT, false);
+
+	VkDeviceSize visibleBufferSize = sizeof(uint32_t) * (VkDeviceSize)this->objectCount * meshletsArray.size() * MAX_FRAMES_IN_FLIGHT;
+	this->app->CreateBuffer(visibleBufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, this->visibleBuffer, this->visibleBufferMemory);
+}
+
+void MeshletRenderer::CreateDescriptorSet()
+{
+	// In binding order: cull parameters, objects, meshlets, bounds, meshlet vertex indices, packed triangles, the geometry
+	// pool's vertices, draw states and visible clusters.  Every stage we use sees them all.
+	VkBuffer buffersArray[] = { this->cullParamsBuffer, this->objectBuffer, this->meshletBuffer, this->boundsBuffer, this->vertexIndexBuffer, this->triangleBuffer, this->app->geometryPool->GetVertexBuffer(), this->drawStateBuffer, this->visibleBuffer };
+	const uint32_t bindingCount = sizeof(buffersArray) / sizeof(buffersArray[0]);
+
+	std::vector<VkDescriptorSetLayoutBinding> bindingsArray(bindingCount);
+	for (uint32_t j = 0; j < bindingCount; j++)
+	{
+		bindingsArray[j].binding = j;
+		bindingsArray[j].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindingsArray[j].descriptorCount = 1;
+		bindingsArray[j].stageFlags = this->shaderStages;
+	}
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo{};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.bindingCount = bindingCount;
+	layoutInfo.pBindings = bindingsArray.data();
+
+	if (VK_SUCCESS != vkCreateDescriptorSetLayout(this->app->logicalDevice, &layoutInfo, nullptr, &this->descriptorSetLayout))
+		throw new std::runtime_error("Failed to create meshlet descriptor set layout!");
+
+	VkDescriptorPoolSize poolSize{};
+	poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	poolSize.descriptorCount = bindingCount;
+
+	VkDescriptorPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.poolSizeCount = 1;
+	poolInfo.pPoolSizes = &poolSize;
+	poolInfo.maxSets = 1;
+
+	if (VK_SUCCESS != vkCreateDescriptorPool(this->app->logicalDevice, &poolInfo, nullptr, &this->descriptorPool))
+		throw new std::runtime_error("Failed to create meshlet descriptor pool!");
+
+	VkDescriptorSetAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = this->descriptorPool;
+	allocInfo.descriptorSetCount = 1;
+	allocInfo.pSetLayouts = &this->descriptorSetLayout;
+
+	if (VK_SUCCESS != vkAllocateDescriptorSets(this->app->logicalDevice, &allocInfo, &this->descriptorSet))
+		throw new std::runtime_error("Failed to allocate meshlet descriptor set!");
+
+	std::vector<VkDescriptorBufferInfo> bufferInfosArray(bindingCount);
+	std::vector<VkWriteDescriptorSet> descriptorWritesArray(bindingCount);
+	for (uint32_t j = 0; j < bindingCount; j++)
+	{
+		bufferInfosArray[j].buffer = buffersArray[j];
+		bufferInfosArray[j].offset = 0;
+		bufferInfosArray[j].range = VK_WHOLE_SIZE;
+
+		descriptorWritesArray[j].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWritesArray[j].dstSet = this->descriptorSet;
+		descriptorWritesArray[j].dstBinding = j;
+		descriptorWritesArray[j].dstArrayElement = 0;
+		descriptorWritesArray[j].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		descriptorWritesArray[j].descriptorCount = 1;
+		descriptorWritesArray[j].pBufferInfo = &bufferInfosArray[j];
+	}
+
+	vkUpdateDescriptorSets(this->app->logicalDevice, bindingCount, descriptorWritesArray.data(), 0, nullptr);
+}
+
+void MeshletRenderer::CreatePipelineLayout()
+{
+	// One layout for the culling and the drawing alike.
+	VkPushConstantRange pushConstantRange{};
+	pushConstantRange.stageFlags = this->shaderStages;
+	pushConstantRange.offset = 0;
+	pushConstantRange.size = sizeof(PushConstants);
+
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount = 1;
+	pipelineLayoutInfo.pSetLayouts = &this->descriptorSetLayout;
+	pipelineLayoutInfo.pushConstantRangeCount = 1;
+	pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+	if (VK_SUCCESS != vkCreatePipelineLayout(this->app->logicalDevice, &pipelineLayoutInfo, nullptr, &this->pipelineLayout))
+		throw new std::runtime_error("Failed to create meshlet pipeline layout!");
+}
+
+void MeshletRenderer::CreateCullPipeline()
+{
+	auto compShaderCode = Application::ReadFile("meshlet_cull_comp.spv");
+	VkShaderModule compShaderModule = this->app->CreateShaderModule(compShaderCode);
+
+	VkPipelineShaderStageCreateInfo compShaderStageInfo{};
+	compShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	compShaderStageInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	compShaderStageInfo.module = compShaderModule;
+	compShaderStageInfo.pName = "main";
+
+	VkComputePipelineCreateInfo pipelineInfo{};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipelineInfo.stage = compShaderStageInfo;
+	pipelineInfo.layout = this->pipelineLayout;
+
+	if (VK_SUCCESS != vkCreateComputePipelines(this->app->logicalDevice, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &this->cullPipeline))
+		throw new std::runtime_error("Failed to create meshlet cull pipeline!");
+
+	vkDestroyShaderModule(this->app->logicalDevice, compShaderModule, nullptr);
+}
+
+void MeshletRenderer::CreateGraphicsPipeline()
+{
+	// Either task + mesh or vertex, and the LOD renderer's fragment shader, since we light the same way.  Like the LOD
+	// renderer, there's no depth buffer, so back faces must go.  The cone test already got rid of most of them a cluster
+	// at a time; culling gets the rest.
+	if (!this->meshShadersEnabled)
+	{
+		// Just a vertex and a fragment shader, which is what the pipeline cache builds.  No vertex attributes; the
+		// vertex shader pulls its own from the pool.  The state's defaults are the rest of what we want.
+		PipelineCache* pipelineCache = this->app->pipelineCache;
+
+		PipelineState state;
+		state.layout = this->pipelineLayout;
+		state.vertexShader = pipelineCache->AddShader(Application::ReadFile("meshlet_vert.spv"));
+		state.fragmentShader = pipelineCache->AddShader(Application::ReadFile("lod_frag.spv"));
+		state.colorFormat = this->app->swapChainImageFormat;
+
+		this->pipelineId = pipelineCache->Request(state);
+		return;
+	}
+
+	// The cache only knows vertex pipelines, so the mesh one is built here.  Mesh pipelines have no vertex input or
+	// input assembly.
+	std::vector<std::pair<VkShaderStageFlagBits, const char*>> stageFilesArray =
+	{
+		{ VK_SHADER_STAGE_TASK_BIT_NV, "meshlet_task.spv" },
+		{ VK_SHADER_STAGE_MESH_BIT_NV, "meshlet_mesh.spv" },
+		{ VK_SHADER_STAGE_FRAGMENT_BIT, "lod_frag.spv" }
+	};
+
+	std::vector<VkShaderModule> shaderModulesArray;
+	std::vector<VkPipelineShaderStageCreateInfo> shaderStagesArray(stageFilesArray.size());
+	for (size_t j = 0; j < stageFilesArray.size(); j++)
+	{
+		shaderModulesArray.push_back(this->app->CreateShaderModule(Application::ReadFile(stageFilesArray[j].second)));
+
+		shaderStagesArray[j].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		shaderStagesArray[j].stage = stageFilesArray[j].first;
+		shaderStagesArray[j].module = shaderModulesArray[j];
+		shaderStagesArray[j].pName = "main";
+	}
+
+	std::vector<VkDynamicState> dynamicStatesArray =
+	{
+			VK_DYNAMIC_STATE_VIEWPORT,
+			VK_DYNAMIC_STATE_SCISSOR
+	};
+
+	VkPipelineDynamicStateCreateInfo dynamicState{};
+	dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+	dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStatesArray.size());
+	dynamicState.pDynamicStates = dynamicStatesArray.data();
+
+	VkPipelineViewportStateCreateInfo viewportState{};
+	viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+	viewportState.viewportCount = 1;
+	viewportState.scissorCount = 1;
+
+	VkPipelineRasterizationStateCreateInfo rasterizer{};
+	rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+	rasterizer.depthClampEnable = VK_FALSE;
+	rasterizer.rasterizerDiscardEnable = VK_FALSE;
+	rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+	rasterizer.lineWidth = 1.0f;
+	rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
+	rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+	rasterizer.depthBiasEnable = VK_FALSE;
+
+	VkPipelineMultisampleStateCreateInfo multisampling{};
+	multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+	multisampling.sampleShadingEnable = VK_FALSE;
+	multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+	VkPipelineColorBlendAttachmentState colorBlendAttachment{};
+	colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+	colorBlendAttachment.blendEnable = VK_FALSE;
+
+	VkPipelineColorBlendStateCreateInfo colorBlending{};
+	colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+	colorBlending.logicOpEnable = VK_FALSE;
+	colorBlending.attachmentCount = 1;
+	colorBlending.pAttachments = &colorBlendAttachment;
+
+	VkGraphicsPipelineCreateInfo pipelineInfo{};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+	pipelineInfo.stageCount = (uint32_t)shaderStagesArray.size();
+	pipelineInfo.pStages = shaderStagesArray.data();
+	pipelineInfo.pVertexInputState = nullptr;
+	pipelineInfo.pInputAssemblyState = nullptr;
+	pipelineInfo.pViewportState = &viewportState;
+	pipelineInfo.pRasterizationState = &rasterizer;
+	pipelineInfo.pMultisampleState = &multisampling;
+	pipelineInfo.pDepthStencilState = nullptr;
+	pipelineInfo.pColorBlendState = &colorBlending;
+	pipelineInfo.pDynamicState = &dynamicState;
+	pipelineInfo.layout = this->pipelineLayout;
+	pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+	pipelineInfo.basePipelineIndex = -1;
+
+	VkPipelineRenderingCreateInfoKHR pipelineRenderingInfo{};
+	this->app->ConfigurePipelineRenderingInfo(pipelineInfo, pipelineRenderingInfo);
+
+	if (VK_SUCCESS != vkCreateGraphicsPipelines(this->app->logicalDevice, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &this->graphicsPipeline))
+		throw new std::runtime_error("Failed to create meshlet graphics pipeline!");
+
+	for (VkShaderModule shaderModule : shaderModulesArray)
+		vkDestroyShaderModule(this->app->logicalDevice, shaderModule, nullptr);
+}
+
+void MeshletRenderer::Update(float deltaTime, uint32_t i, const glm::mat4& view, const glm::mat4& proj)
+{
+	// The caller must have waited on frame slot i's fence, so the count the GPU left there is final, and both the draw
+	// state and the view can be replaced for the next frame.
+	if (this->drawPending[i])
+	{
+		this->reportFrameCount++;
+		this->reportClusters += this->mappedDrawStates[i].instanceCount;
+		this->drawPending[i] = false;
+	}
+
+	this->mappedDrawStates[i] = DrawState{ MeshletBuilder::MAX_TRIANGLES * 3, 0, 0, 0 };
+
+	// Gribb and Hartmann: each plane is a sum or difference of rows of the view-projection, with Vulkan's 0 to 1 depth.
+	CullParams& cullParams = this->mappedCullParams[i];
+	cullParams.viewProjection = proj * view;
+
+	glm::mat4 rows = glm::transpose(cullParams.viewProjection);
+	cullParams.planes[0] = rows[3] + rows[0];
+	cullParams.planes[1] = rows[3] - rows[0];
+	cullParams.planes[2] = rows[3] + rows[1];
+	cullParams.planes[3] = rows[3] - rows[1];
+	cullParams.planes[4] = rows[2];
+	cullParams.planes[5] = rows[3] - rows[2];
+	for (glm::vec4& plane : cullParams.planes)
+		plane /= glm::length(glm::vec3(plane));
+
+	cullParams.cameraPosition = glm::vec4(glm::vec3(glm::inverse(view)[3]), 1.0f);
+
+	if (this->reportFrameCount == MESHLET_REPORT_INTERVAL)
+	{
+		double frames = double(this->reportFrameCount);
+		double totalClusters = double(this->objectCount) * double(this->meshletBuilder.GetMeshlets().size());
+		double trianglesPerCluster = double(this->meshletBuilder.GetTriangles().size()) / double(this->meshletBuilder.GetMeshlets().size());
+		double drawnClusters = double(this->reportClusters) / frames;
+
+		std::cout << "Meshlets: " << drawnClusters << " of " << totalClusters << " clusters drawn (" << 100.0 * drawnClusters / totalClusters << "%), about "
+			<< drawnClusters * trianglesPerCluster << " triangles" << std::endl;
+
+		this->reportFrameCount = 0;
+		this->reportClusters = 0;
+	}
+}
+
+void MeshletRenderer::RecordCull(VkCommandBuffer givenCommandBuffer, uint32_t i)
+{
+	if (this->meshShadersEnabled)
+		return;
+
+	// The draw state was reset by the CPU before submission, and slot i's visible list was last read by a frame that has
+	// finished, so there's nothing to wait on before the dispatch.
+	PushConstants pushConstants = this->MakePushConstants(i);
+	uint32_t clusterCount = pushConstants.meshletCount * this->objectCount;
+
+	vkCmdBindPipeline(givenCommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, this->cullPipeline);
+	vkCmdBindDescriptorSets(givenCommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, this->pipelineLayout, 0, 1, &this->descriptorSet, 0, nullptr);
+	vkCmdPushConstants(givenCommandBuffer, this->pipelineLayout, this->shaderStages, 0, sizeof(pushConstants), &pushConstants);
+	vkCmdDispatch(givenCommandBuffer, (clusterCount + MESHLET_CULL_GROUP_SIZE - 1) / MESHLET_CULL_GROUP_SIZE, 1, 1);
+
+	VkMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+	vkCmdPipelineBarrier(givenCommandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+MeshletRenderer::PushConstants MeshletRenderer::MakePushConstants(uint32_t i) const
+{
+	PushConstants pushConstants{};
+	pushConstants.slot = i;
+	pushConstants.meshletCount = (uint32_t)this->meshletBuilder.GetMeshlets().size();
+	pushConstants.objectCount = this->objectCount;
+	pushConstants.vertexBase = (uint32_t)(this->app->geometryPool->GetMesh(this->meshId).vertexOffset * (sizeof(MeshletVertex) / sizeof(float)));
+	pushConstants.cullingEnabled = this->cullingEnabled ? 1 : 0;
+	return pushConstants;
+}
+
+void MeshletRenderer::RecordDraw(VkCommandBuffer givenCommandBuffer, uint32_t i)
+{
+	PushConstants pushConstants = this->MakePushConstants(i);
+
+	VkPipeline pipeline = this->meshShadersEnabled ? this->graphicsPipeline : this->app->pipelineCache->GetPipeline(this->pipelineId);
+	vkCmdBindPipeline(givenCommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+	vkCmdBindDescriptorSets(givenCommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, this->pipelineLayout, 0, 1, &this->descriptorSet, 0, nullptr);
+	vkCmdPushConstants(givenCommandBuffer, this->pipelineLayout, this->shaderStages, 0, sizeof(pushConstants), &pushConstants);
+
+	// With mesh shaders, each task workgroup culls its 32 clusters and launches a mesh workgroup per survivor.  Without
+	// them, the culling already wrote how many clusters to draw, as the instance count.
+	if (this->meshShadersEnabled)
+	{
+		uint32_t clusterCount = pushConstants.meshletCount * this->objectCount;
+		CountedCmdDrawMeshTasks(this->app->pfnCmdDrawMeshTasks, givenCommandBuffer, (clusterCount + MESHLET_TASK_GROUP_SIZE - 1) / MESHLET_TASK_GROUP_SIZE, 0);
+	}
+	else
+	{
+		vkCmdDrawIndirect(givenCommandBuffer, this->drawStateBuffer, i * sizeof(DrawState), 1, sizeof(DrawState));
+	}
+
+	this->drawPending[i] = true;
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include "Application.h"
+#include "MeshletBuilder.h"
+#include "GeometryPool.h"
+
+// Draws copies of one very large mesh (a bumpy sphere of about a million triangles) split into meshlets, and culls them
+// a cluster at a time on the GPU, against the frustum and against each cluster's normal cone, so that the vertices of
+// clusters that are off-screen or facing away never get processed.  The vertices live in the geometry pool; the meshlets,
+// their bounds and their triangles are storage buffers of our own.
+//
+// Where mesh shaders are available (VK_NV_mesh_shader), a task shader culls 32 clusters per workgroup and launches a mesh
+// shader workgroup for each survivor.  Otherwise a compute pass culls every cluster of every copy into this frame slot's
+// list of visible clusters, and one indirect draw then pulls the vertices of that many clusters from the vertex shader,
+// MAX_TRIANGLES worth apiece, with the ones past a cluster's triangle count made degenerate.
+class MeshletRenderer
+{
+public:
+	MeshletRenderer(Application* app, uint32_t objectCount, bool cullingEnabled, bool meshShadersEnabled);
+	virtual ~MeshletRenderer();
+
+	void Create();
+	void Destroy();
+	void Update(float deltaTime, uint32_t i, const glm::mat4& view, const glm::mat4& proj);
+
+	// The compute culling, to be recorded outside of any rendering; does nothing on the mesh shader path.
+	void RecordCull(VkCommandBuffer givenCommandBuffer, uint32_t i);
+	void RecordDraw(VkCommandBuffer givenCommandBuffer, uint32_t i);
+
+private:
+	struct MeshletVertex
+	{
+		glm::vec3 position;
+		glm::vec3 normal;
+	};
+
+	// Slot i's view, as the culling needs it: the frustum planes point inward, and are normalized.
+	struct CullParams
+	{
+		glm::mat4 viewProjection;
+		glm::vec4 planes[6];
+		glm::vec4 cameraPosition;
+	};
+
+	// A VkDrawIndirectCommand, whose instance count is how many clusters survived.  The mesh shader path only uses that
+	// count, to report it.
+	struct DrawState
+	{
+		uint32_t vertexCount;
+		uint32_t instanceCount;
+		uint32_t firstVertex;
+		uint32_t firstInstance;
+	};
+
+	struct PushConstants
+	{
+		uint32_t slot;
+		uint32_t meshletCount;
+		uint32_t objectCount;
+		uint32_t vertexBase;		// Where our vertices start in the geometry pool, in floats.
+		uint32_t cullingEnabled;
+	};
+
+	void BuildMesh();
+	void PlaceObjects();
+	void CreateBuffers();
+	void CreateDescriptorSet();
+	void CreatePipelineLayout();
+	void CreateCullPipeline();
+	void CreateGraphicsPipeline();
+	PushConstants MakePushConstants(uint32_t i) const;
+
+	Application* app;
+	uint32_t objectCount;
+	bool cullingEnabled;
+	bool meshShadersEnabled;
+	VkShaderStageFlags shaderStages;		// Every stage that sees our descriptors and push constants.
+	std::vector<MeshletVertex> verticesArray;
+	MeshletBuilder meshletBuilder;
+	std::vector<glm::vec4> objectsArray;		// Position in xyz, uniform scale in w.
+
+	GeometryPool::MeshId meshId;
+	VkBuffer objectBuffer;
+	VkDeviceMemory objectBufferMemory;
+	VkBuffer meshletBuffer;
+	VkDeviceMemory meshletBufferMemory;
+	VkBuffer boundsBuffer;
+	VkDeviceMemory boundsBufferMemory;
+	VkBuffer vertexIndexBuffer;
+	VkDeviceMemory vertexIndexBufferMemory;
+	VkBuffer triangleBuffer;
+	VkDeviceMemory triangleBufferMemory;
+	VkBuffer cullParamsBuffer;		// One CullParams per frame slot, mapped.
+	VkDeviceMemory cullParamsBufferMemory;
+	CullParams* mappedCullParams;
+	VkBuffer drawStateBuffer;		// One DrawState per frame slot, mapped.
+	VkDeviceMemory drawStateBufferMemory;
+	DrawState* mappedDrawStates;
+	VkBuffer visibleBuffer;			// Per frame slot, room for every cluster of every copy.
+	VkDeviceMemory visibleBufferMemory;
+	std::vector<bool> drawPending;		// Per frame slot, whether its draw state holds a count we haven't read.
+
+	VkDescriptorSetLayout descriptorSetLayout;
+	VkDescriptorPool descriptorPool;
+	VkDescriptorSet descriptorSet;
+	VkPipelineLayout pipelineLayout;
+	VkPipeline cullPipeline;
+	VkPipeline graphicsPipeline;		// With mesh shaders; ours.
+	uint32_t pipelineId;				// Without; from the application's pipeline cache.
+
+	uint32_t reportFrameCount;
+	uint64_t reportClusters;
+};
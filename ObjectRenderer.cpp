@@ -0,0 +1,343 @@
+#include "ObjectRenderer.h"
+#include "MemoryTracker.h"
+#include "GeometryPool.h"
+#include "ThreadPool.h"
+#include <cmath>
+
+const uint32_t OBJECT_REPORT_INTERVAL = 240;
+const float OBJECT_SPIN_RATE = 1.0f;		// Radians per second.
+
+ObjectRenderer::ObjectRenderer(Application* app, uint32_t objectCount)
+{
+	this->app = app;
+	this->objectCount = objectCount;
+	this->descriptorSetLayout = VK_NULL_HANDLE;
+	this->descriptorPool = VK_NULL_HANDLE;
+	this->pipelineLayout = VK_NULL_HANDLE;
+	this->graphicsPipeline = VK_NULL_HANDLE;
+	this->reportFrameCount = 0;
+	this->reportMilliseconds = 0.0;
+}
+
+/*virtual*/ ObjectRenderer::~ObjectRenderer()
+{
+}
+
+void ObjectRenderer::Create()
+{
+	// Lay the objects out on a square grid in the z = 0 plane, under the same camera as the tutorial quad, each
+	// starting at some arbitrary orientation.
+	uint32_t gridSize = (uint32_t)std::ceil(std::sqrt(double(this->objectCount)));
+	float spacing = 3.0f / float(gridSize);
+
+	this->transformStore.Resize(this->objectCount);
+
+	uint32_t seed = 0x9E3779B9;
+	auto random = [&seed]() { seed = seed * 1664525 + 1013904223; return float(seed >> 8) / float(1 << 24); };
+
+	for (uint32_t j = 0; j < this->objectCount; j++)
+	{
+		float x = (float(j % gridSize) + 0.5f) * spacing - 1.5f;
+		float y = (float(j / gridSize) + 0.5f) * spacing - 1.5f;
+		this->transformStore.SetPosition(j, x, y, 0.0f);
+		this->transformStore.SetScale(j, 0.8f * spacing, 0.8f * spacing, 0.8f * spacing);
+
+		glm::vec4 rotation(random() - 0.5f, random() - 0.5f, random() - 0.5f, random() - 0.5f);
+		rotation /= glm::length(rotation);
+		this->transformStore.SetRotation(j, rotation.x, rotation.y, rotation.z, rotation.w);
+	}
+
+	this->CreateObjectBuffers();
+	this->CreateDescriptorSets();
+	this->CreateGraphicsPipeline();
+
+	std::cout << "Objects: " << this->objectCount << " instances, transforms computed with " << TransformStore::SimdPathName(this->transformStore.GetSimdPath()) << std::endl;
+}
+
+void ObjectRenderer::Destroy()
+{
+	VkDevice logicalDevice = this->app->logicalDevice;
+
+	for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+	{
+		vkUnmapMemory(logicalDevice, this->objectBuffersMemory[i]);
+		vkDestroyBuffer(logicalDevice, this->objectBuffers[i], nullptr);
+		this->app->memoryTracker->Free(this->objectBuffersMemory[i]);
+	}
+
+	vkDestroyPipeline(logicalDevice, this->graphicsPipeline, nullptr);
+	vkDestroyPipelineLayout(logicalDevice, this->pipelineLayout, nullptr);
+	vkDestroyDescriptorPool(logicalDevice, this->descriptorPool, nullptr);
+	vkDestroyDescriptorSetLayout(logicalDevice, this->descriptorSetLayout, nullptr);
+}
+
+void ObjectRenderer::CreateObjectBuffers()
+{
+	VkDeviceSize bufferSize = sizeof(glm::mat4) * (VkDeviceSize)this->objectCount;
+
+	this->objectBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+	this->objectBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
+	this->mappedMatrices.resize(MAX_FRAMES_IN_FLIGHT);
+
+	// Mapped once, for good, so the transform store can write its output directly where the GPU will read it.
+	for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+	{
+		this->app->CreateBuffer(bufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, this->objectBuffers[i], this->objectBuffersMemory[i]);
+
+		void* data = nullptr;
+		if (VK_SUCCESS != vkMapMemory(this->app->logicalDevice, this->objectBuffersMemory[i], 0, bufferSize, 0, &data))
+			throw new std::runtime_error("Failed to map object buffer!");
+
+		this->mappedMatrices[i] = static_cast<float*>(data);
+	}
+}
+
+void ObjectRenderer::CreateDescriptorSets()
+{
+	std::array<VkDescriptorSetLayoutBinding, 2> bindings{};
+
+	bindings[0].binding = 0;
+	bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	bindings[0].descriptorCount = 1;
+	bindings[0].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+
+	// Same binding as in shader.frag, which we reuse as is.
+	bindings[1].binding = 1;
+	bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	bindings[1].descriptorCount = 1;
+	bindings[1].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo{};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+	layoutInfo.pBindings = bindings.data();
+
+	if (VK_SUCCESS != vkCreateDescriptorSetLayout(this->app->logicalDevice, &layoutInfo, nullptr, &this->descriptorSetLayout))
+		throw new std::runtime_error("Failed to create object descriptor set layout!");
+
+	std::array<VkDescriptorPoolSize, 2> poolSizes{};
+	poolSizes[0].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	poolSizes[0].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+	poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	poolSizes[1].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+
+	VkDescriptorPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+	poolInfo.pPoolSizes = poolSizes.data();
+	poolInfo.maxSets = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+
+	if (VK_SUCCESS != vkCreateDescriptorPool(this->app->logicalDevice, &poolInfo, nullptr, &this->descriptorPool))
+		throw new std::runtime_error("Failed to create object descriptor pool!");
+
+	std::vector<VkDescriptorSetLayout> layouts(MAX_FRAMES_IN_FLIGHT, this->descriptorSetLayout);
+
+	VkDescriptorSetAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = this->descriptorPool;
+	allocInfo.descriptorSetCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+	allocInfo.pSetLayouts = layouts.data();
+
+	this->descriptorSets.resize(MAX_FRAMES_IN_FLIGHT);
+	if (VK_SUCCESS != vkAllocateDescriptorSets(this->app->logicalDevice, &allocInfo, this->descriptorSets.data()))
+		throw new std::runtime_error("Failed to allocate object descriptor sets!");
+
+	for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+	{
+		VkDescriptorBufferInfo bufferInfo{};
+		bufferInfo.buffer = this->objectBuffers[i];
+		bufferInfo.offset = 0;
+		bufferInfo.range = VK_WHOLE_SIZE;
+
+		VkDescriptorImageInfo imageInfo{};
+		imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		imageInfo.imageView = this->app->textureImageView;
+		imageInfo.sampler = this->app->textureSampler;
+
+		std::array<VkWriteDescriptorSet, 2> descriptorWrites{};
+
+		descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWrites[0].dstSet = this->descriptorSets[i];
+		descriptorWrites[0].dstBinding = 0;
+		descriptorWrites[0].dstArrayElement = 0;
+		descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		descriptorWrites[0].descriptorCount = 1;
+		descriptorWrites[0].pBufferInfo = &bufferInfo;
+
+		descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWrites[1].dstSet = this->descriptorSets[i];
+		descriptorWrites[1].dstBinding = 1;
+		descriptorWrites[1].dstArrayElement = 0;
+		descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		descriptorWrites[1].descriptorCount = 1;
+		descriptorWrites[1].pImageInfo = &imageInfo;
+
+		vkUpdateDescriptorSets(this->app->logicalDevice, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+	}
+}
+
+void ObjectRenderer::CreateGraphicsPipeline()
+{
+	auto vertShaderCode = Application::ReadFile("object_vert.spv");
+
+	VkShaderModule vertShaderModule = this->app->CreateShaderModule(vertShaderCode);
+	VkShaderModule fragShaderModule = this->app->CreateShaderModule(this->app->fragShaderCode);
+
+	VkPipelineShaderStageCreateInfo shaderStages[2]{};
+
+	shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+	shaderStages[0].module = vertShaderModule;
+	shaderStages[0].pName = "main";
+
+	shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+	shaderStages[1].module = fragShaderModule;
+	shaderStages[1].pName = "main";
+
+	auto bindingDescription = Vertex::GetBindingDescription();
+	auto attributeDescriptions = Vertex::GetAttributeDescriptions();
+
+	VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
+	vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+	vertexInputInfo.vertexBindingDescriptionCount = 1;
+	vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
+	vertexInputInfo.vertexAttributeDescriptionCount = (uint32_t)attributeDescriptions.size();
+	vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
+
+	VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
+	inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+	inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+	inputAssembly.primitiveRestartEnable = VK_FALSE;
+
+	std::vector<VkDynamicState> dynamicStatesArray =
+	{
+			VK_DYNAMIC_STATE_VIEWPORT,
+			VK_DYNAMIC_STATE_SCISSOR
+	};
+
+	VkPipelineDynamicStateCreateInfo dynamicState{};
+	dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+	dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStatesArray.size());
+	dynamicState.pDynamicStates = dynamicStatesArray.data();
+
+	VkPipelineViewportStateCreateInfo viewportState{};
+	viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+	viewportState.viewportCount = 1;
+	viewportState.scissorCount = 1;
+
+	// The objects tumble, so we see their backs half the time.
+	VkPipelineRasterizationStateCreateInfo rasterizer{};
+	rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+	rasterizer.depthClampEnable = VK_FALSE;
+	rasterizer.rasterizerDiscardEnable = VK_FALSE;
+	rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+	rasterizer.lineWidth = 1.0f;
+	rasterizer.cullMode = VK_CULL_MODE_NONE;
+	rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+	rasterizer.depthBiasEnable = VK_FALSE;
+
+	VkPipelineMultisampleStateCreateInfo multisampling{};
+	multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+	multisampling.sampleShadingEnable = VK_FALSE;
+	multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+	VkPipelineColorBlendAttachmentState colorBlendAttachment{};
+	colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+	colorBlendAttachment.blendEnable = VK_FALSE;
+
+	VkPipelineColorBlendStateCreateInfo colorBlending{};
+	colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+	colorBlending.logicOpEnable = VK_FALSE;
+	colorBlending.attachmentCount = 1;
+	colorBlending.pAttachments = &colorBlendAttachment;
+
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount = 1;
+	pipelineLayoutInfo.pSetLayouts = &this->descriptorSetLayout;
+	if (VK_SUCCESS != vkCreatePipelineLayout(this->app->logicalDevice, &pipelineLayoutInfo, nullptr, &this->pipelineLayout))
+		throw new std::runtime_error("Failed to create object pipeline layout!");
+
+	VkGraphicsPipelineCreateInfo pipelineInfo{};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+	pipelineInfo.stageCount = 2;
+	pipelineInfo.pStages = shaderStages;
+	pipelineInfo.pVertexInputState = &vertexInputInfo;
+	pipelineInfo.pInputAssemblyState = &inputAssembly;
+	pipelineInfo.pViewportState = &viewportState;
+	pipelineInfo.pRasterizationState = &rasterizer;
+	pipelineInfo.pMultisampleState = &multisampling;
+	pipelineInfo.pDepthStencilState = nullptr;
+	pipelineInfo.pColorBlendState = &colorBlending;
+	pipelineInfo.pDynamicState = &dynamicState;
+	pipelineInfo.layout = this->pipelineLayout;
+	pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+	pipelineInfo.basePipelineIndex = -1;
+
+	VkPipelineRenderingCreateInfoKHR pipelineRenderingInfo{};
+	this->app->ConfigurePipelineRenderingInfo(pipelineInfo, pipelineRenderingInfo);
+
+	if (VK_SUCCESS != vkCreateGraphicsPipelines(this->app->logicalDevice, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &this->graphicsPipeline))
+		throw new std::runtime_error("Failed to create object graphics pipeline!");
+
+	vkDestroyShaderModule(this->app->logicalDevice, vertShaderModule, nullptr);
+	vkDestroyShaderModule(this->app->logicalDevice, fragShaderModule, nullptr);
+}
+
+void ObjectRenderer::SpinObjects(float deltaTime)
+{
+	// Spin every object about its local z-axis, i.e., rotation = rotation * spin, with the same spin quaternion (0, 0, s, c)
+	// for all of them.  A quaternion multiply per object straight through the SoA streams is cheap, unlike calling
+	// sin/cos per object, and the compiler can vectorize it.
+	float halfAngle = 0.5f * OBJECT_SPIN_RATE * deltaTime;
+	float s = std::sin(halfAngle);
+	float c = std::cos(halfAngle);
+
+	float* rotationX = this->transformStore.GetRotationX();
+	float* rotationY = this->transformStore.GetRotationY();
+	float* rotationZ = this->transformStore.GetRotationZ();
+	float* rotationW = this->transformStore.GetRotationW();
+
+	for (uint32_t j = 0; j < this->objectCount; j++)
+	{
+		float x = rotationX[j], y = rotationY[j], z = rotationZ[j], w = rotationW[j];
+		rotationX[j] = x * c + y * s;
+		rotationY[j] = y * c - x * s;
+		rotationZ[j] = z * c + w * s;
+		rotationW[j] = w * c - z * s;
+	}
+}
+
+void ObjectRenderer::Update(float deltaTime, uint32_t i, const glm::mat4& view, const glm::mat4& proj)
+{
+	// The caller must have waited on frame slot i's fence, since we're about to overwrite its matrices.
+	auto startTime = std::chrono::high_resolution_clock::now();
+
+	this->SpinObjects(deltaTime);
+
+	glm::mat4 viewProjection = proj * view;
+	this->transformStore.ComputeMatrices(&viewProjection[0][0], nullptr, this->mappedMatrices[i], this->app->threadPool);
+
+	auto endTime = std::chrono::high_resolution_clock::now();
+
+	this->reportFrameCount++;
+	this->reportMilliseconds += std::chrono::duration<double, std::milli>(endTime - startTime).count();
+
+	if (this->reportFrameCount == OBJECT_REPORT_INTERVAL)
+	{
+		std::cout << "Objects: " << this->objectCount << " | transforms " << this->reportMilliseconds / double(this->reportFrameCount) << " ms" << std::endl;
+		this->reportFrameCount = 0;
+		this->reportMilliseconds = 0.0;
+	}
+}
+
+void ObjectRenderer::RecordDraw(VkCommandBuffer givenCommandBuffer, uint32_t i)
+{
+	vkCmdBindPipeline(givenCommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, this->graphicsPipeline);
+	vkCmdBindDescriptorSets(givenCommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, this->pipelineLayout, 0, 1, &this->descriptorSets[i], 0, nullptr);
+
+	// The tutorial quad, once per object.
+	const GeometryPool::Mesh& quad = this->app->geometryPool->GetMesh(this->app->quadMeshId);
+	vkCmdDrawIndexed(givenCommandBuffer, quad.indexCount, this->objectCount, quad.firstIndex, quad.vertexOffset, 0);
+}
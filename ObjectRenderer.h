@@ -0,0 +1,43 @@
+#pragma once
+
+#include "Application.h"
+#include "TransformStore.h"
+
+// Draws many copies of the tutorial quad, each with its own transform.  The transforms live in a TransformStore, and
+// every frame their MVP matrices are computed straight into a persistently mapped storage buffer for that frame slot,
+// which the vertex shader indexes by gl_InstanceIndex.  So the whole lot is one instanced draw.
+class ObjectRenderer
+{
+public:
+	ObjectRenderer(Application* app, uint32_t objectCount);
+	virtual ~ObjectRenderer();
+
+	void Create();
+	void Destroy();
+	void Update(float deltaTime, uint32_t i, const glm::mat4& view, const glm::mat4& proj);
+	void RecordDraw(VkCommandBuffer givenCommandBuffer, uint32_t i);
+
+	TransformStore& GetTransformStore() { return this->transformStore; }
+
+private:
+	void CreateObjectBuffers();
+	void CreateDescriptorSets();
+	void CreateGraphicsPipeline();
+	void SpinObjects(float deltaTime);
+
+	Application* app;
+	uint32_t objectCount;
+	TransformStore transformStore;
+
+	std::vector<VkBuffer> objectBuffers;
+	std::vector<VkDeviceMemory> objectBuffersMemory;
+	std::vector<float*> mappedMatrices;
+	VkDescriptorSetLayout descriptorSetLayout;
+	VkDescriptorPool descriptorPool;
+	std::vector<VkDescriptorSet> descriptorSets;
+	VkPipelineLayout pipelineLayout;
+	VkPipeline graphicsPipeline;
+
+	uint32_t reportFrameCount;
+	double reportMilliseconds;
+};
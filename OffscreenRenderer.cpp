@@ -0,0 +1,467 @@
+#include "OffscreenRenderer.h"
+#include "MemoryTracker.h"
+#include "GeometryPool.h"
+#include "ThreadPool.h"
+#include <stb_image_write.h>
+#include <cstring>
+
+OffscreenRenderer::OffscreenRenderer(Application* app, uint32_t targetCount)
+{
+	this->app = app;
+	this->targetCount = std::max(targetCount, 1u);
+	this->commandPool = VK_NULL_HANDLE;
+	this->descriptorPool = VK_NULL_HANDLE;
+	this->readbackMemoryProperties = 0;
+	this->nextJobId = 1;
+	this->outstandingCount = 0;
+	this->statistics = Statistics{};
+}
+
+/*virtual*/ OffscreenRenderer::~OffscreenRenderer()
+{
+}
+
+void OffscreenRenderer::Create()
+{
+	VkDevice logicalDevice = this->app->logicalDevice;
+
+	if (!ConvertToRgba(this->app->swapChainImageFormat, nullptr, 0))
+		throw new std::runtime_error("Offscreen rendering needs an 8-bit RGBA or BGRA swap-chain format!");
+
+	Application::QueueFamilyIndices indices = this->app->FindQueueFamilies(this->app->physicalDevice);
+
+	VkCommandPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+	poolInfo.queueFamilyIndex = indices.graphicsFamily.value();
+
+	if (VK_SUCCESS != vkCreateCommandPool(logicalDevice, &poolInfo, nullptr, &this->commandPool))
+		throw new std::runtime_error("Failed to create offscreen command pool!");
+
+	std::array<VkDescriptorPoolSize, 2> poolSizes{};
+	poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	poolSizes[0].descriptorCount = this->targetCount;
+	poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	poolSizes[1].descriptorCount = this->targetCount;
+
+	VkDescriptorPoolCreateInfo descriptorPoolInfo{};
+	descriptorPoolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	descriptorPoolInfo.poolSizeCount = (uint32_t)poolSizes.size();
+	descriptorPoolInfo.pPoolSizes = poolSizes.data();
+	descriptorPoolInfo.maxSets = this->targetCount;
+
+	if (VK_SUCCESS != vkCreateDescriptorPool(logicalDevice, &descriptorPoolInfo, nullptr, &this->descriptorPool))
+		throw new std::runtime_error("Failed to create offscreen descriptor pool!");
+
+	// The CPU reads every byte of the readback buffers, so cached memory is much faster if the device has it.
+	this->readbackMemoryProperties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+	if (this->app->memoryTracker->HasMemoryType(this->readbackMemoryProperties | VK_MEMORY_PROPERTY_HOST_CACHED_BIT))
+		this->readbackMemoryProperties |= VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+
+	this->targetsArray.resize(this->targetCount);
+	for (Target& target : this->targetsArray)
+	{
+		target.width = 0;
+		target.height = 0;
+		target.image = VK_NULL_HANDLE;
+		target.imageMemory = nullptr;
+		target.imageView = VK_NULL_HANDLE;
+		target.framebuffer = VK_NULL_HANDLE;
+		target.readbackBuffer = VK_NULL_HANDLE;
+		target.readbackBufferMemory = nullptr;
+		target.mappedReadback = nullptr;
+		target.busy = false;
+		target.jobId = 0;
+
+		this->app->CreateBuffer(sizeof(Application::UniformBufferObject), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, target.uniformBuffer, target.uniformBufferMemory);
+		vkMapMemory(logicalDevice, target.uniformBufferMemory, 0, sizeof(Application::UniformBufferObject), 0, &target.mappedUniform);
+
+		VkDescriptorSetAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocInfo.descriptorPool = this->descriptorPool;
+		allocInfo.descriptorSetCount = 1;
+		allocInfo.pSetLayouts = &this->app->descriptorSetLayout;
+
+		if (VK_SUCCESS != vkAllocateDescriptorSets(logicalDevice, &allocInfo, &target.descriptorSet))
+			throw new std::runtime_error("Failed to allocate offscreen descriptor set!");
+
+		VkDescriptorBufferInfo bufferInfo{};
+		bufferInfo.buffer = target.uniformBuffer;
+		bufferInfo.offset = 0;
+		bufferInfo.range = sizeof(Application::UniformBufferObject);
+
+		VkDescriptorImageInfo imageInfo{};
+		imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		imageInfo.imageView = this->app->textureImageView;
+		imageInfo.sampler = this->app->textureSampler;
+
+		std::array<VkWriteDescriptorSet, 2> descriptorWrites{};
+
+		descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWrites[0].dstSet = target.descriptorSet;
+		descriptorWrites[0].dstBinding = 0;
+		descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		descriptorWrites[0].descriptorCount = 1;
+		descriptorWrites[0].pBufferInfo = &bufferInfo;
+
+		descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWrites[1].dstSet = target.descriptorSet;
+		descriptorWrites[1].dstBinding = 1;
+		descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		descriptorWrites[1].descriptorCount = 1;
+		descriptorWrites[1].pImageInfo = &imageInfo;
+
+		vkUpdateDescriptorSets(logicalDevice, (uint32_t)descriptorWrites.size(), descriptorWrites.data(), 0, nullptr);
+
+		VkCommandBufferAllocateInfo commandBufferInfo{};
+		commandBufferInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		commandBufferInfo.commandPool = this->commandPool;
+		commandBufferInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		commandBufferInfo.commandBufferCount = 1;
+
+		if (VK_SUCCESS != vkAllocateCommandBuffers(logicalDevice, &commandBufferInfo, &target.commandBuffer))
+			throw new std::runtime_error("Failed to allocate offscreen command buffer!");
+
+		VkFenceCreateInfo fenceInfo{};
+		fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+		if (VK_SUCCESS != vkCreateFence(logicalDevice, &fenceInfo, nullptr, &target.fence))
+			throw new std::runtime_error("Failed to create offscreen fence!");
+	}
+}
+
+void OffscreenRenderer::Destroy()
+{
+	VkDevice logicalDevice = this->app->logicalDevice;
+
+	this->Flush();
+
+	for (Target& target : this->targetsArray)
+	{
+		this->DestroyTargetImage(target);
+
+		vkDestroyBuffer(logicalDevice, target.uniformBuffer, nullptr);
+		this->app->memoryTracker->Free(target.uniformBufferMemory);
+		vkDestroyFence(logicalDevice, target.fence, nullptr);
+	}
+
+	this->targetsArray.clear();
+
+	vkDestroyDescriptorPool(logicalDevice, this->descriptorPool, nullptr);
+	vkDestroyCommandPool(logicalDevice, this->commandPool, nullptr);
+}
+
+uint64_t OffscreenRenderer::Submit(const Job& job)
+{
+	uint64_t jobId = this->nextJobId++;
+	this->pendingJobsQueue.push_back(std::make_pair(jobId, job));
+	this->statistics.submittedCount++;
+	return jobId;
+}
+
+void OffscreenRenderer::Update()
+{
+	VkDevice logicalDevice = this->app->logicalDevice;
+
+	for (Target& target : this->targetsArray)
+	{
+		if (target.busy && VK_SUCCESS == vkGetFenceStatus(logicalDevice, target.fence))
+			this->FinishJob(target);
+	}
+
+	uint32_t inFlightCount = 0;
+	for (Target& target : this->targetsArray)
+	{
+		if (!target.busy && !this->pendingJobsQueue.empty())
+		{
+			this->StartJob(target, this->pendingJobsQueue.front().first, this->pendingJobsQueue.front().second);
+			this->pendingJobsQueue.pop_front();
+		}
+
+		if (target.busy)
+			inFlightCount++;
+	}
+
+	this->statistics.peakInFlight = std::max(this->statistics.peakInFlight, inFlightCount);
+}
+
+void OffscreenRenderer::Flush()
+{
+	while (true)
+	{
+		this->Update();
+
+		bool anyBusy = false;
+		for (const Target& target : this->targetsArray)
+			anyBusy = anyBusy || target.busy;
+
+		if (!anyBusy && this->pendingJobsQueue.empty())
+			break;
+
+		this->WaitForAnyTarget();
+	}
+
+	std::unique_lock<std::mutex> lock(this->mutex);
+	this->condition.wait(lock, [this]() { return this->outstandingCount == 0; });
+}
+
+void OffscreenRenderer::WaitForAnyTarget()
+{
+	// Every target is busy, or there's nothing left to start, so the next thing that can happen is a fence signaling.
+	std::vector<VkFence> fencesArray;
+	for (const Target& target : this->targetsArray)
+		if (target.busy)
+			fencesArray.push_back(target.fence);
+
+	if (!fencesArray.empty())
+		vkWaitForFences(this->app->logicalDevice, (uint32_t)fencesArray.size(), fencesArray.data(), VK_FALSE, UINT64_MAX);
+}
+
+void OffscreenRenderer::ResizeTarget(Target& target, uint32_t width, uint32_t height)
+{
+	if (target.width == width && target.height == height)
+		return;
+
+	this->DestroyTargetImage(target);
+
+	VkDevice logicalDevice = this->app->logicalDevice;
+	VkFormat format = this->app->swapChainImageFormat;
+
+	// Same format as the swap-chain, so that the scene's pipeline (and render pass, if we're using one) work as they are.
+	this->app->CreateImage(width, height, format, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, target.image, target.imageMemory);
+	target.imageView = this->app->CreateImageView(target.image, format);
+
+	if (!this->app->dynamicRenderingEnabled)
+	{
+		VkFramebufferCreateInfo framebufferInfo{};
+		framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+		framebufferInfo.renderPass = this->app->renderPass;
+		framebufferInfo.attachmentCount = 1;
+		framebufferInfo.pAttachments = &target.imageView;
+		framebufferInfo.width = width;
+		framebufferInfo.height = height;
+		framebufferInfo.layers = 1;
+
+		if (VK_SUCCESS != vkCreateFramebuffer(logicalDevice, &framebufferInfo, nullptr, &target.framebuffer))
+			throw new std::runtime_error("Failed to create offscreen framebuffer!");
+	}
+
+	VkDeviceSize readbackSize = 4 * VkDeviceSize(width) * height;
+	this->app->CreateBuffer(readbackSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT, this->readbackMemoryProperties, target.readbackBuffer, target.readbackBufferMemory);
+	vkMapMemory(logicalDevice, target.readbackBufferMemory, 0, readbackSize, 0, (void**)&target.mappedReadback);
+
+	target.width = width;
+	target.height = height;
+}
+
+void OffscreenRenderer::DestroyTargetImage(Target& target)
+{
+	VkDevice logicalDevice = this->app->logicalDevice;
+
+	if (target.framebuffer != VK_NULL_HANDLE)
+		vkDestroyFramebuffer(logicalDevice, target.framebuffer, nullptr);
+
+	vkDestroyImageView(logicalDevice, target.imageView, nullptr);
+	vkDestroyImage(logicalDevice, target.image, nullptr);
+	this->app->memoryTracker->Free(target.imageMemory);
+	vkDestroyBuffer(logicalDevice, target.readbackBuffer, nullptr);
+	this->app->memoryTracker->Free(target.readbackBufferMemory);
+
+	target.framebuffer = VK_NULL_HANDLE;
+	target.imageView = VK_NULL_HANDLE;
+	target.image = VK_NULL_HANDLE;
+	target.imageMemory = nullptr;
+	target.readbackBuffer = VK_NULL_HANDLE;
+	target.readbackBufferMemory = nullptr;
+	target.mappedReadback = nullptr;
+	target.width = 0;
+	target.height = 0;
+}
+
+void OffscreenRenderer::StartJob(Target& target, uint64_t jobId, const Job& job)
+{
+	// The target is idle, so nothing on the GPU is using its image, buffers or command buffer.
+	this->ResizeTarget(target, job.width, job.height);
+
+	target.jobId = jobId;
+	target.job = job;
+	::memcpy(target.mappedUniform, &job.camera, sizeof(job.camera));
+
+	this->RecordJob(target);
+
+	vkResetFences(this->app->logicalDevice, 1, &target.fence);
+
+	VkSubmitInfo submitInfo{};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &target.commandBuffer;
+
+	if (VK_SUCCESS != vkQueueSubmit(this->app->graphicsQueue, 1, &submitInfo, target.fence))
+		throw new std::runtime_error("Failed to submit offscreen command buffer!");
+
+	target.busy = true;
+}
+
+void OffscreenRenderer::RecordJob(Target& target)
+{
+	VkCommandBuffer commandBuffer = target.commandBuffer;
+	VkExtent2D extent = { target.width, target.height };
+	VkClearValue clearColor = { {{0.0f, 0.0f, 0.0f, 1.0f}} };
+
+	vkResetCommandBuffer(commandBuffer, 0);
+
+	VkCommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	if (VK_SUCCESS != vkBeginCommandBuffer(commandBuffer, &beginInfo))
+		throw new std::runtime_error("Failed to begin recording offscreen command buffer!");
+
+	// RecordScene draws out of the geometry pool, but leaves binding it to us.
+	this->app->geometryPool->Bind(commandBuffer);
+
+	VkImageMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = target.image;
+	barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+
+	// The previous job's copy out of this image has finished (we waited on its fence), so there's nothing to wait on.
+	VkImageLayout renderedLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+	if (this->app->dynamicRenderingEnabled)
+	{
+		barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		barrier.newLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		barrier.srcAccessMask = 0;
+		barrier.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+		VkRenderingAttachmentInfoKHR colorAttachment{};
+		colorAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+		colorAttachment.imageView = target.imageView;
+		colorAttachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		colorAttachment.resolveMode = VK_RESOLVE_MODE_NONE;
+		colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+		colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+		colorAttachment.clearValue = clearColor;
+
+		VkRenderingInfoKHR renderingInfo{};
+		renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO_KHR;
+		renderingInfo.renderArea.offset = { 0, 0 };
+		renderingInfo.renderArea.extent = extent;
+		renderingInfo.layerCount = 1;
+		renderingInfo.colorAttachmentCount = 1;
+		renderingInfo.pColorAttachments = &colorAttachment;
+
+		this->app->pfnCmdBeginRendering(commandBuffer, &renderingInfo);
+		this->app->RecordScene(commandBuffer, extent, target.descriptorSet);
+		this->app->pfnCmdEndRendering(commandBuffer);
+	}
+	else
+	{
+		// Without dynamic rendering we borrow the application's render pass, which was made for the swap chain and so
+		// ends with the capture image in the present layout.  The copy's barrier below starts from there.
+		VkRenderPassBeginInfo renderPassInfo{};
+		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+		renderPassInfo.renderPass = this->app->renderPass;
+		renderPassInfo.framebuffer = target.framebuffer;
+		renderPassInfo.renderArea.offset = { 0, 0 };
+		renderPassInfo.renderArea.extent = extent;
+		renderPassInfo.clearValueCount = 1;
+		renderPassInfo.pClearValues = &clearColor;
+
+		vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+		this->app->RecordScene(commandBuffer, extent, target.descriptorSet);
+		vkCmdEndRenderPass(commandBuffer);
+
+		renderedLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+	}
+
+	barrier.oldLayout = renderedLayout;
+	barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+	barrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+	VkBufferImageCopy region{};
+	region.bufferOffset = 0;
+	region.bufferRowLength = 0;
+	region.bufferImageHeight = 0;
+	region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+	region.imageOffset = { 0, 0, 0 };
+	region.imageExtent = { target.width, target.height, 1 };
+	vkCmdCopyImageToBuffer(commandBuffer, target.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, target.readbackBuffer, 1, &region);
+
+	// Make the copy visible to the host once the fence has signaled.
+	VkBufferMemoryBarrier bufferBarrier{};
+	bufferBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	bufferBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	bufferBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+	bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	bufferBarrier.buffer = target.readbackBuffer;
+	bufferBarrier.offset = 0;
+	bufferBarrier.size = VK_WHOLE_SIZE;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &bufferBarrier, 0, nullptr);
+
+	if (VK_SUCCESS != vkEndCommandBuffer(commandBuffer))
+		throw new std::runtime_error("Failed to record offscreen command buffer!");
+}
+
+void OffscreenRenderer::FinishJob(Target& target)
+{
+	// Copy the pixels out so the target can take the next job straight away; the slow parts happen on a worker.
+	Result* result = new Result;
+	result->jobId = target.jobId;
+	result->width = target.width;
+	result->height = target.height;
+	result->pixels.assign(target.mappedReadback, target.mappedReadback + 4 * size_t(target.width) * target.height);
+
+	Job job = std::move(target.job);
+	target.job = Job{};
+	target.busy = false;
+	this->statistics.completedCount++;
+
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		this->outstandingCount++;
+	}
+
+	VkFormat format = this->app->swapChainImageFormat;
+	this->app->threadPool->Submit([this, result, job, format]()
+	{
+		ConvertToRgba(format, result->pixels.data(), size_t(result->width) * result->height);
+
+		if (!job.pngPath.empty())
+		{
+			if (0 == stbi_write_png(job.pngPath.c_str(), (int)result->width, (int)result->height, 4, result->pixels.data(), (int)result->width * 4))
+				std::cerr << "Failed to write " << job.pngPath << "!" << std::endl;
+		}
+
+		if (job.callback)
+			job.callback(*result);
+
+		delete result;
+
+		std::lock_guard<std::mutex> lock(this->mutex);
+		this->outstandingCount--;
+		this->condition.notify_all();
+	});
+}
+
+/*static*/ bool OffscreenRenderer::ConvertToRgba(VkFormat format, uint8_t* pixels, size_t pixelCount)
+{
+	switch (format)
+	{
+	case VK_FORMAT_R8G8B8A8_SRGB:
+	case VK_FORMAT_R8G8B8A8_UNORM:
+		return true;
+	case VK_FORMAT_B8G8R8A8_SRGB:
+	case VK_FORMAT_B8G8R8A8_UNORM:
+		for (size_t j = 0; j < pixelCount; j++)
+			std::swap(pixels[4 * j], pixels[4 * j + 2]);
+		return true;
+	default:
+		return false;
+	}
+}
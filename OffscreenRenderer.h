@@ -0,0 +1,103 @@
+#pragma once
+
+#include "Application.h"
+#include <functional>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+
+// Renders the scene from arbitrary cameras into offscreen images and reads the pixels back, for thumbnails, previews
+// and the like, with no window involved beyond the device.  Jobs are queued up and spread over a small pool of
+// targets, each with its own image, host-visible readback buffer, command buffer and fence, so that several images are
+// in flight at once: while the GPU draws one, it's copying out another, and the CPU is handing a third off to the
+// thread pool for format conversion and (optionally) PNG encoding.  Nothing ever waits on the whole device; Update just
+// polls the fences of whatever is in flight, and Flush only blocks when there's nothing else to do.
+class OffscreenRenderer
+{
+public:
+	struct Result
+	{
+		uint64_t jobId;
+		uint32_t width;
+		uint32_t height;
+		std::vector<uint8_t> pixels;		// RGBA8, top row first.
+	};
+
+	struct Job
+	{
+		Application::UniformBufferObject camera;	// Model, view and projection for the scene.
+		uint32_t width;
+		uint32_t height;
+		std::string pngPath;						// If not empty, where the image is written.
+		std::function<void(Result& result)> callback;	// Optional, and called on a worker thread.
+	};
+
+	struct Statistics
+	{
+		uint64_t submittedCount;
+		uint64_t completedCount;
+		uint32_t peakInFlight;
+	};
+
+	OffscreenRenderer(Application* app, uint32_t targetCount);
+	virtual ~OffscreenRenderer();
+
+	void Create();
+	void Destroy();
+
+	uint64_t Submit(const Job& job);
+
+	// Hands finished targets to the workers and puts queued jobs on idle ones.  Never blocks.
+	void Update();
+
+	// Returns once every job submitted so far is finished, callbacks and all.
+	void Flush();
+
+	const Statistics& GetStatistics() const { return this->statistics; }
+
+	// Reorders 8-bit BGRA pixels into RGBA in place.  Returns false for formats we don't know how to convert.
+	static bool ConvertToRgba(VkFormat format, uint8_t* pixels, size_t pixelCount);
+
+private:
+	struct Target
+	{
+		uint32_t width;
+		uint32_t height;
+		VkImage image;
+		VkDeviceMemory imageMemory;
+		VkImageView imageView;
+		VkFramebuffer framebuffer;
+		VkBuffer readbackBuffer;
+		VkDeviceMemory readbackBufferMemory;
+		uint8_t* mappedReadback;
+		VkBuffer uniformBuffer;
+		VkDeviceMemory uniformBufferMemory;
+		void* mappedUniform;
+		VkDescriptorSet descriptorSet;
+		VkCommandBuffer commandBuffer;
+		VkFence fence;
+		bool busy;
+		uint64_t jobId;
+		Job job;
+	};
+
+	void ResizeTarget(Target& target, uint32_t width, uint32_t height);
+	void DestroyTargetImage(Target& target);
+	void StartJob(Target& target, uint64_t jobId, const Job& job);
+	void RecordJob(Target& target);
+	void FinishJob(Target& target);
+	void WaitForAnyTarget();
+
+	Application* app;
+	uint32_t targetCount;
+	VkCommandPool commandPool;
+	VkDescriptorPool descriptorPool;
+	VkMemoryPropertyFlags readbackMemoryProperties;
+	std::vector<Target> targetsArray;
+	std::deque<std::pair<uint64_t, Job>> pendingJobsQueue;
+	uint64_t nextJobId;
+	uint32_t outstandingCount;			// Jobs handed to the workers but not yet done with, under the mutex.
+	std::mutex mutex;
+	std::condition_variable condition;
+	Statistics statistics;
+};
@@ -0,0 +1,526 @@
+#include "ParticleSystem.h"
+#include "MemoryTracker.h"
+
+const uint32_t PARTICLE_WORKGROUP_SIZE = 256;	// Must match local_size_x in particle.comp.
+const uint32_t PARTICLE_REPORT_INTERVAL = 240;
+
+ParticleSystem::ParticleSystem(Application* app, uint32_t particleCount)
+{
+	this->app = app;
+	this->particleCount = particleCount;
+	this->seeded = false;
+	this->computeDescriptorSetLayout = VK_NULL_HANDLE;
+	this->computeDescriptorPool = VK_NULL_HANDLE;
+	this->computePipelineLayout = VK_NULL_HANDLE;
+	this->computePipeline = VK_NULL_HANDLE;
+	this->graphicsPipelineLayout = VK_NULL_HANDLE;
+	this->graphicsPipeline = VK_NULL_HANDLE;
+	this->computeQueryPool = VK_NULL_HANDLE;
+	this->graphicsQueryPool = VK_NULL_HANDLE;
+	this->timestampsSupported = false;
+	this->timestampPeriod = 0.0f;
+	this->statistics = Statistics{};
+}
+
+/*virtual*/ ParticleSystem::~ParticleSystem()
+{
+}
+
+void ParticleSystem::Create()
+{
+	this->CreateParticleBuffers();
+	this->CreateDescriptorSets();
+	this->CreateComputePipeline();
+	this->CreateGraphicsPipeline();
+	this->CreateCommandBuffers();
+	this->CreateSyncObjects();
+	this->CreateQueryPools();
+
+	std::cout << "Particle system: " << this->particleCount << " particles, compute family " << this->app->FindQueueFamilies(this->app->physicalDevice).computeFamily.value()
+		<< (this->timestampsSupported ? "" : " (no timestamps; queue times will not be measured)") << std::endl;
+}
+
+void ParticleSystem::Destroy()
+{
+	VkDevice logicalDevice = this->app->logicalDevice;
+
+	for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+	{
+		vkDestroySemaphore(logicalDevice, this->computeFinishedSemaphores[i], nullptr);
+		vkDestroyBuffer(logicalDevice, this->particleBuffers[i], nullptr);
+		this->app->memoryTracker->Free(this->particleBuffersMemory[i]);
+	}
+
+	// The command buffers go away with the application's compute command pool.
+	vkDestroyQueryPool(logicalDevice, this->computeQueryPool, nullptr);
+	vkDestroyQueryPool(logicalDevice, this->graphicsQueryPool, nullptr);
+	vkDestroyPipeline(logicalDevice, this->computePipeline, nullptr);
+	vkDestroyPipelineLayout(logicalDevice, this->computePipelineLayout, nullptr);
+	vkDestroyPipeline(logicalDevice, this->graphicsPipeline, nullptr);
+	vkDestroyPipelineLayout(logicalDevice, this->graphicsPipelineLayout, nullptr);
+	vkDestroyDescriptorPool(logicalDevice, this->computeDescriptorPool, nullptr);
+	vkDestroyDescriptorSetLayout(logicalDevice, this->computeDescriptorSetLayout, nullptr);
+}
+
+void ParticleSystem::CreateParticleBuffers()
+{
+	// The buffers are written by the compute queue and read by the graphics queue.  If those are different families,
+	// share the buffers concurrently rather than doing queue family ownership transfers every frame.
+	Application::QueueFamilyIndices indices = this->app->FindQueueFamilies(this->app->physicalDevice);
+	std::vector<uint32_t> sharingFamilies;
+	if (indices.computeFamily.value() != indices.graphicsFamily.value())
+		sharingFamilies = { indices.graphicsFamily.value(), indices.computeFamily.value() };
+
+	VkDeviceSize bufferSize = sizeof(Particle) * (VkDeviceSize)this->particleCount;
+
+	this->particleBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+	this->particleBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
+
+	// Note that there is no upload here.  The first dispatch seeds the particles on the GPU.
+	for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+		this->app->CreateBuffer(bufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, this->particleBuffers[i], this->particleBuffersMemory[i], sharingFamilies);
+}
+
+void ParticleSystem::CreateDescriptorSets()
+{
+	std::array<VkDescriptorSetLayoutBinding, 2> bindings{};
+
+	bindings[0].binding = 0;
+	bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	bindings[0].descriptorCount = 1;
+	bindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	bindings[1].binding = 1;
+	bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	bindings[1].descriptorCount = 1;
+	bindings[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo{};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+	layoutInfo.pBindings = bindings.data();
+
+	if (VK_SUCCESS != vkCreateDescriptorSetLayout(this->app->logicalDevice, &layoutInfo, nullptr, &this->computeDescriptorSetLayout))
+		throw new std::runtime_error("Failed to create particle descriptor set layout!");
+
+	VkDescriptorPoolSize poolSize{};
+	poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	poolSize.descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT) * 2;
+
+	VkDescriptorPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.poolSizeCount = 1;
+	poolInfo.pPoolSizes = &poolSize;
+	poolInfo.maxSets = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+
+	if (VK_SUCCESS != vkCreateDescriptorPool(this->app->logicalDevice, &poolInfo, nullptr, &this->computeDescriptorPool))
+		throw new std::runtime_error("Failed to create particle descriptor pool!");
+
+	std::vector<VkDescriptorSetLayout> layouts(MAX_FRAMES_IN_FLIGHT, this->computeDescriptorSetLayout);
+
+	VkDescriptorSetAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = this->computeDescriptorPool;
+	allocInfo.descriptorSetCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+	allocInfo.pSetLayouts = layouts.data();
+
+	this->computeDescriptorSets.resize(MAX_FRAMES_IN_FLIGHT);
+	if (VK_SUCCESS != vkAllocateDescriptorSets(this->app->logicalDevice, &allocInfo, this->computeDescriptorSets.data()))
+		throw new std::runtime_error("Failed to allocate particle descriptor sets!");
+
+	VkDeviceSize bufferSize = sizeof(Particle) * (VkDeviceSize)this->particleCount;
+
+	// Frame slot i reads what the previous slot wrote and writes its own buffer.
+	for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+	{
+		VkDescriptorBufferInfo inputBufferInfo{};
+		inputBufferInfo.buffer = this->particleBuffers[(i + MAX_FRAMES_IN_FLIGHT - 1) % MAX_FRAMES_IN_FLIGHT];
+		inputBufferInfo.offset = 0;
+		inputBufferInfo.range = bufferSize;
+
+		VkDescriptorBufferInfo outputBufferInfo{};
+		outputBufferInfo.buffer = this->particleBuffers[i];
+		outputBufferInfo.offset = 0;
+		outputBufferInfo.range = bufferSize;
+
+		std::array<VkWriteDescriptorSet, 2> descriptorWrites{};
+
+		descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWrites[0].dstSet = this->computeDescriptorSets[i];
+		descriptorWrites[0].dstBinding = 0;
+		descriptorWrites[0].dstArrayElement = 0;
+		descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		descriptorWrites[0].descriptorCount = 1;
+		descriptorWrites[0].pBufferInfo = &inputBufferInfo;
+
+		descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWrites[1].dstSet = this->computeDescriptorSets[i];
+		descriptorWrites[1].dstBinding = 1;
+		descriptorWrites[1].dstArrayElement = 0;
+		descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		descriptorWrites[1].descriptorCount = 1;
+		descriptorWrites[1].pBufferInfo = &outputBufferInfo;
+
+		vkUpdateDescriptorSets(this->app->logicalDevice, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+	}
+}
+
+void ParticleSystem::CreateComputePipeline()
+{
+	auto compShaderCode = Application::ReadFile("particle_comp.spv");
+	VkShaderModule compShaderModule = this->app->CreateShaderModule(compShaderCode);
+
+	VkPipelineShaderStageCreateInfo compShaderStageInfo{};
+	compShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	compShaderStageInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	compShaderStageInfo.module = compShaderModule;
+	compShaderStageInfo.pName = "main";
+
+	VkPushConstantRange pushConstantRange{};
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	pushConstantRange.offset = 0;
+	pushConstantRange.size = sizeof(ComputePushConstants);
+
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount = 1;
+	pipelineLayoutInfo.pSetLayouts = &this->computeDescriptorSetLayout;
+	pipelineLayoutInfo.pushConstantRangeCount = 1;
+	pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+	if (VK_SUCCESS != vkCreatePipelineLayout(this->app->logicalDevice, &pipelineLayoutInfo, nullptr, &this->computePipelineLayout))
+		throw new std::runtime_error("Failed to create particle compute pipeline layout!");
+
+	VkComputePipelineCreateInfo pipelineInfo{};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipelineInfo.stage = compShaderStageInfo;
+	pipelineInfo.layout = this->computePipelineLayout;
+
+	if (VK_SUCCESS != vkCreateComputePipelines(this->app->logicalDevice, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &this->computePipeline))
+		throw new std::runtime_error("Failed to create particle compute pipeline!");
+
+	vkDestroyShaderModule(this->app->logicalDevice, compShaderModule, nullptr);
+}
+
+void ParticleSystem::CreateGraphicsPipeline()
+{
+	auto vertShaderCode = Application::ReadFile("particle_vert.spv");
+	auto fragShaderCode = Application::ReadFile("particle_frag.spv");
+
+	VkShaderModule vertShaderModule = this->app->CreateShaderModule(vertShaderCode);
+	VkShaderModule fragShaderModule = this->app->CreateShaderModule(fragShaderCode);
+
+	VkPipelineShaderStageCreateInfo shaderStages[2]{};
+
+	shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+	shaderStages[0].module = vertShaderModule;
+	shaderStages[0].pName = "main";
+
+	shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+	shaderStages[1].module = fragShaderModule;
+	shaderStages[1].pName = "main";
+
+	// One quad per particle.  The particle buffer itself is the per-instance vertex stream, and the
+	// vertex shader makes up the quad corners from gl_VertexIndex, so there is no per-vertex buffer at all.
+	VkVertexInputBindingDescription bindingDescription{};
+	bindingDescription.binding = 0;
+	bindingDescription.stride = sizeof(Particle);
+	bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+
+	std::array<VkVertexInputAttributeDescription, 2> attributeDescriptions{};
+
+	attributeDescriptions[0].binding = 0;
+	attributeDescriptions[0].location = 0;
+	attributeDescriptions[0].format = VK_FORMAT_R32G32_SFLOAT;
+	attributeDescriptions[0].offset = offsetof(Particle, position);
+
+	attributeDescriptions[1].binding = 0;
+	attributeDescriptions[1].location = 1;
+	attributeDescriptions[1].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+	attributeDescriptions[1].offset = offsetof(Particle, color);
+
+	VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
+	vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+	vertexInputInfo.vertexBindingDescriptionCount = 1;
+	vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
+	vertexInputInfo.vertexAttributeDescriptionCount = (uint32_t)attributeDescriptions.size();
+	vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
+
+	VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
+	inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+	inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+	inputAssembly.primitiveRestartEnable = VK_FALSE;
+
+	std::vector<VkDynamicState> dynamicStatesArray =
+	{
+			VK_DYNAMIC_STATE_VIEWPORT,
+			VK_DYNAMIC_STATE_SCISSOR
+	};
+
+	VkPipelineDynamicStateCreateInfo dynamicState{};
+	dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+	dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStatesArray.size());
+	dynamicState.pDynamicStates = dynamicStatesArray.data();
+
+	VkPipelineViewportStateCreateInfo viewportState{};
+	viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+	viewportState.viewportCount = 1;
+	viewportState.scissorCount = 1;
+
+	VkPipelineRasterizationStateCreateInfo rasterizer{};
+	rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+	rasterizer.depthClampEnable = VK_FALSE;
+	rasterizer.rasterizerDiscardEnable = VK_FALSE;
+	rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+	rasterizer.lineWidth = 1.0f;
+	rasterizer.cullMode = VK_CULL_MODE_NONE;
+	rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+	rasterizer.depthBiasEnable = VK_FALSE;
+
+	VkPipelineMultisampleStateCreateInfo multisampling{};
+	multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+	multisampling.sampleShadingEnable = VK_FALSE;
+	multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+	// Additive blending, so that dense clouds of particles saturate nicely and draw order doesn't matter.
+	VkPipelineColorBlendAttachmentState colorBlendAttachment{};
+	colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+	colorBlendAttachment.blendEnable = VK_TRUE;
+	colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+	colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE;
+	colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+	colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+	colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+	colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+
+	VkPipelineColorBlendStateCreateInfo colorBlending{};
+	colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+	colorBlending.logicOpEnable = VK_FALSE;
+	colorBlending.attachmentCount = 1;
+	colorBlending.pAttachments = &colorBlendAttachment;
+
+	VkPushConstantRange pushConstantRange{};
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+	pushConstantRange.offset = 0;
+	pushConstantRange.size = sizeof(glm::vec2);
+
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount = 0;
+	pipelineLayoutInfo.pushConstantRangeCount = 1;
+	pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+	if (VK_SUCCESS != vkCreatePipelineLayout(this->app->logicalDevice, &pipelineLayoutInfo, nullptr, &this->graphicsPipelineLayout))
+		throw new std::runtime_error("Failed to create particle pipeline layout!");
+
+	VkGraphicsPipelineCreateInfo pipelineInfo{};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+	pipelineInfo.stageCount = 2;
+	pipelineInfo.pStages = shaderStages;
+	pipelineInfo.pVertexInputState = &vertexInputInfo;
+	pipelineInfo.pInputAssemblyState = &inputAssembly;
+	pipelineInfo.pViewportState = &viewportState;
+	pipelineInfo.pRasterizationState = &rasterizer;
+	pipelineInfo.pMultisampleState = &multisampling;
+	pipelineInfo.pDepthStencilState = nullptr;
+	pipelineInfo.pColorBlendState = &colorBlending;
+	pipelineInfo.pDynamicState = &dynamicState;
+	pipelineInfo.layout = this->graphicsPipelineLayout;
+	pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+	pipelineInfo.basePipelineIndex = -1;
+
+	VkPipelineRenderingCreateInfoKHR pipelineRenderingInfo{};
+	this->app->ConfigurePipelineRenderingInfo(pipelineInfo, pipelineRenderingInfo);
+
+	if (VK_SUCCESS != vkCreateGraphicsPipelines(this->app->logicalDevice, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &this->graphicsPipeline))
+		throw new std::runtime_error("Failed to create particle graphics pipeline!");
+
+	vkDestroyShaderModule(this->app->logicalDevice, vertShaderModule, nullptr);
+	vkDestroyShaderModule(this->app->logicalDevice, fragShaderModule, nullptr);
+}
+
+void ParticleSystem::CreateCommandBuffers()
+{
+	VkCommandBufferAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	allocInfo.commandPool = this->app->computeCommandPool;
+	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	allocInfo.commandBufferCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+
+	this->computeCommandBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+	if (VK_SUCCESS != vkAllocateCommandBuffers(this->app->logicalDevice, &allocInfo, this->computeCommandBuffers.data()))
+		throw new std::runtime_error("Failed to allocate particle command buffers!");
+}
+
+void ParticleSystem::CreateSyncObjects()
+{
+	VkSemaphoreCreateInfo semaphoreInfo{};
+	semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+	this->computeFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
+	for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+	{
+		if (VK_SUCCESS != vkCreateSemaphore(this->app->logicalDevice, &semaphoreInfo, nullptr, &this->computeFinishedSemaphores[i]))
+			throw new std::runtime_error("Failed to create particle semaphores!");
+	}
+}
+
+void ParticleSystem::CreateQueryPools()
+{
+	this->timingsPending.resize(MAX_FRAMES_IN_FLIGHT, false);
+
+	VkPhysicalDeviceProperties properties{};
+	vkGetPhysicalDeviceProperties(this->app->physicalDevice, &properties);
+	this->timestampPeriod = properties.limits.timestampPeriod;
+
+	uint32_t queueFamilyCount = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(this->app->physicalDevice, &queueFamilyCount, nullptr);
+	std::vector<VkQueueFamilyProperties> queueFamiliesArray(queueFamilyCount);
+	vkGetPhysicalDeviceQueueFamilyProperties(this->app->physicalDevice, &queueFamilyCount, queueFamiliesArray.data());
+
+	Application::QueueFamilyIndices indices = this->app->FindQueueFamilies(this->app->physicalDevice);
+	this->timestampsSupported =
+		queueFamiliesArray[indices.graphicsFamily.value()].timestampValidBits > 0 &&
+		queueFamiliesArray[indices.computeFamily.value()].timestampValidBits > 0;
+
+	if (!this->timestampsSupported)
+		return;
+
+	VkQueryPoolCreateInfo queryPoolInfo{};
+	queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+	queryPoolInfo.queryCount = 2 * static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+
+	if (VK_SUCCESS != vkCreateQueryPool(this->app->logicalDevice, &queryPoolInfo, nullptr, &this->computeQueryPool) ||
+		VK_SUCCESS != vkCreateQueryPool(this->app->logicalDevice, &queryPoolInfo, nullptr, &this->graphicsQueryPool))
+	{
+		throw new std::runtime_error("Failed to create particle query pools!");
+	}
+}
+
+VkSemaphore ParticleSystem::SubmitCompute(uint32_t i, float deltaTime)
+{
+	// The caller has already waited on this frame slot's fence, and that fence is only signaled after the graphics
+	// submission that waited on our semaphore, so this command buffer and its output buffer are free to reuse.
+	VkCommandBuffer computeCommandBuffer = this->computeCommandBuffers[i];
+	vkResetCommandBuffer(computeCommandBuffer, 0);
+
+	VkCommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	if (VK_SUCCESS != vkBeginCommandBuffer(computeCommandBuffer, &beginInfo))
+		throw new std::runtime_error("Failed to begin recording particle command buffer!");
+
+	if (this->timestampsSupported)
+	{
+		vkCmdResetQueryPool(computeCommandBuffer, this->computeQueryPool, 2 * i, 2);
+		vkCmdWriteTimestamp(computeCommandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, this->computeQueryPool, 2 * i);
+	}
+
+	// Make the previous dispatch's writes (our input this time) visible.  Submission order on the compute queue
+	// gives us the execution dependency, but not the memory dependency.
+	VkMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	vkCmdPipelineBarrier(computeCommandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+	ComputePushConstants pushConstants{};
+	pushConstants.deltaTime = deltaTime;
+	pushConstants.particleCount = this->particleCount;
+	pushConstants.seed = this->seeded ? 0 : 0x9E3779B9;
+	this->seeded = true;
+
+	vkCmdBindPipeline(computeCommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, this->computePipeline);
+	vkCmdBindDescriptorSets(computeCommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, this->computePipelineLayout, 0, 1, &this->computeDescriptorSets[i], 0, nullptr);
+	vkCmdPushConstants(computeCommandBuffer, this->computePipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pushConstants), &pushConstants);
+	vkCmdDispatch(computeCommandBuffer, (this->particleCount + PARTICLE_WORKGROUP_SIZE - 1) / PARTICLE_WORKGROUP_SIZE, 1, 1);
+
+	if (this->timestampsSupported)
+		vkCmdWriteTimestamp(computeCommandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, this->computeQueryPool, 2 * i + 1);
+
+	if (VK_SUCCESS != vkEndCommandBuffer(computeCommandBuffer))
+		throw new std::runtime_error("Failed to record particle command buffer!");
+
+	VkSubmitInfo submitInfo{};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &computeCommandBuffer;
+	submitInfo.signalSemaphoreCount = 1;
+	submitInfo.pSignalSemaphores = &this->computeFinishedSemaphores[i];
+
+	if (VK_SUCCESS != vkQueueSubmit(this->app->computeQueue, 1, &submitInfo, VK_NULL_HANDLE))
+		throw new std::runtime_error("Failed to submit particle command buffer!");
+
+	return this->computeFinishedSemaphores[i];
+}
+
+void ParticleSystem::RecordGraphicsBegin(VkCommandBuffer givenCommandBuffer, uint32_t i)
+{
+	// Must be called outside of the render pass, since query resets aren't allowed inside one.
+	if (this->timestampsSupported)
+	{
+		vkCmdResetQueryPool(givenCommandBuffer, this->graphicsQueryPool, 2 * i, 2);
+		vkCmdWriteTimestamp(givenCommandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, this->graphicsQueryPool, 2 * i);
+	}
+}
+
+void ParticleSystem::RecordDraw(VkCommandBuffer givenCommandBuffer, uint32_t i)
+{
+	// Keep the quads roughly square and a couple of pixels across, whatever the window size.
+	glm::vec2 halfSize(2.0f / float(this->app->swapChainExtent.width), 2.0f / float(this->app->swapChainExtent.height));
+
+	vkCmdBindPipeline(givenCommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, this->graphicsPipeline);
+	vkCmdPushConstants(givenCommandBuffer, this->graphicsPipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(halfSize), &halfSize);
+
+	VkDeviceSize offset = 0;
+	vkCmdBindVertexBuffers(givenCommandBuffer, 0, 1, &this->particleBuffers[i], &offset);
+	vkCmdDraw(givenCommandBuffer, 6, this->particleCount, 0, 0);
+}
+
+void ParticleSystem::RecordGraphicsEnd(VkCommandBuffer givenCommandBuffer, uint32_t i)
+{
+	if (this->timestampsSupported)
+	{
+		vkCmdWriteTimestamp(givenCommandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, this->graphicsQueryPool, 2 * i + 1);
+		this->timingsPending[i] = true;
+	}
+}
+
+void ParticleSystem::CollectTimings(uint32_t i)
+{
+	// Only call this once the frame slot's fence has been waited on, so the results are guaranteed to be available.
+	if (!this->timingsPending[i])
+		return;
+
+	this->timingsPending[i] = false;
+
+	uint64_t computeTimestamps[2] = { 0, 0 };
+	uint64_t graphicsTimestamps[2] = { 0, 0 };
+	if (VK_SUCCESS != vkGetQueryPoolResults(this->app->logicalDevice, this->computeQueryPool, 2 * i, 2, sizeof(computeTimestamps), computeTimestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) ||
+		VK_SUCCESS != vkGetQueryPoolResults(this->app->logicalDevice, this->graphicsQueryPool, 2 * i, 2, sizeof(graphicsTimestamps), graphicsTimestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT))
+		return;
+
+	double nanosecondsPerTick = double(this->timestampPeriod);
+
+	this->statistics.frameCount++;
+	this->statistics.computeMilliseconds += double(computeTimestamps[1] - computeTimestamps[0]) * nanosecondsPerTick * 1e-6;
+	this->statistics.graphicsMilliseconds += double(graphicsTimestamps[1] - graphicsTimestamps[0]) * nanosecondsPerTick * 1e-6;
+
+	if (this->statistics.frameCount == PARTICLE_REPORT_INTERVAL)
+	{
+		this->ReportStatistics();
+		this->statistics = Statistics{};
+	}
+}
+
+void ParticleSystem::ReportStatistics()
+{
+	double frames = double(this->statistics.frameCount);
+	double computeAverage = this->statistics.computeMilliseconds / frames;
+	double graphicsAverage = this->statistics.graphicsMilliseconds / frames;
+
+	std::cout << "Particles: " << this->particleCount
+		<< " | compute " << computeAverage << " ms"
+		<< " | graphics " << graphicsAverage << " ms" << std::endl;
+}
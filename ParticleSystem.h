@@ -0,0 +1,82 @@
+#pragma once
+
+#include "Application.h"
+
+// A GPU particle system.  The simulation runs entirely in a compute shader on the compute queue, ping-ponging
+// between one storage buffer per frame in flight, and the result is drawn as instanced quads by the graphics queue.
+// Because the compute work for frame N only has to finish before frame N's vertex input stage, it is free to
+// overlap with whatever graphics work from frame N-1 is still executing.  Timestamp queries on each queue measure
+// how long its own part takes; they aren't compared across queues, since nothing promises that different queues'
+// timestamps share a time domain.
+class ParticleSystem
+{
+public:
+	ParticleSystem(Application* app, uint32_t particleCount);
+	virtual ~ParticleSystem();
+
+	void Create();
+	void Destroy();
+	VkSemaphore SubmitCompute(uint32_t i, float deltaTime);
+	void RecordGraphicsBegin(VkCommandBuffer givenCommandBuffer, uint32_t i);
+	void RecordDraw(VkCommandBuffer givenCommandBuffer, uint32_t i);
+	void RecordGraphicsEnd(VkCommandBuffer givenCommandBuffer, uint32_t i);
+	void CollectTimings(uint32_t i);
+
+	// Layout must match the Particle struct in particle.comp (std430).
+	struct Particle
+	{
+		glm::vec2 position;
+		glm::vec2 velocity;
+		glm::vec4 color;
+	};
+
+	struct ComputePushConstants
+	{
+		float deltaTime;
+		uint32_t particleCount;
+		uint32_t seed;
+	};
+
+	struct Statistics
+	{
+		uint32_t frameCount;
+		double computeMilliseconds;
+		double graphicsMilliseconds;
+	};
+
+	const Statistics& GetStatistics() const { return this->statistics; }
+
+private:
+	void CreateParticleBuffers();
+	void CreateComputePipeline();
+	void CreateGraphicsPipeline();
+	void CreateDescriptorSets();
+	void CreateCommandBuffers();
+	void CreateSyncObjects();
+	void CreateQueryPools();
+	void ReportStatistics();
+
+	Application* app;
+	uint32_t particleCount;
+	bool seeded;
+
+	std::vector<VkBuffer> particleBuffers;
+	std::vector<VkDeviceMemory> particleBuffersMemory;
+	VkDescriptorSetLayout computeDescriptorSetLayout;
+	VkDescriptorPool computeDescriptorPool;
+	std::vector<VkDescriptorSet> computeDescriptorSets;
+	VkPipelineLayout computePipelineLayout;
+	VkPipeline computePipeline;
+	VkPipelineLayout graphicsPipelineLayout;
+	VkPipeline graphicsPipeline;
+	std::vector<VkCommandBuffer> computeCommandBuffers;
+	std::vector<VkSemaphore> computeFinishedSemaphores;
+
+	// Two timestamps (begin, end) per frame in flight on each queue.
+	VkQueryPool computeQueryPool;
+	VkQueryPool graphicsQueryPool;
+	std::vector<bool> timingsPending;
+	bool timestampsSupported;
+	float timestampPeriod;
+	Statistics statistics;
+};
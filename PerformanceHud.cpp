@@ -0,0 +1,723 @@
+#include "PerformanceHud.h"
+#include "MemoryTracker.h"
+#include "PipelineCache.h"
+#include "DynamicResolution.h"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <cstdio>
+
+const uint32_t HUD_MAX_QUADS = 2048;
+const uint32_t HUD_HISTORY_FRAMES = 120;
+const uint32_t HUD_TEXT_INTERVAL = 15;				// Frames between refreshes of the numbers.
+const float HUD_SCALE = 2.0f;						// Screen pixels per atlas texel.
+const float HUD_MARGIN = 8.0f;
+const float HUD_BAR_WIDTH = 2.0f;
+const float HUD_GRAPH_HEIGHT = 64.0f;
+const float HUD_GRAPH_MILLISECONDS = 1000.0f / 30.0f;	// A frame this long fills the graph.
+const float HUD_TARGET_MILLISECONDS = 1000.0f / 60.0f;	// Marked with a line across the graph.
+const uint32_t HUD_QUERIES_PER_FRAME = 1 + 2 * PerformanceHud::PASS_COUNT;
+
+static const char* hudPassNames[PerformanceHud::PASS_COUNT] = { "SCENE", "PARTICLES", "UPSCALE", "HUD" };
+
+// The atlas is a grid of 6x8 cells, each a 5x7 glyph with a blank column and row to space it from its neighbors.  It
+// covers ' ' through '_', which is all of the digits, capitals and punctuation we need; lower case is drawn as capitals.
+// The cell after the last glyph is solid, for drawing plain rectangles.
+const uint32_t HUD_GLYPH_WIDTH = 6;
+const uint32_t HUD_GLYPH_HEIGHT = 8;
+const uint32_t HUD_ATLAS_COLUMNS = 16;
+const uint32_t HUD_ATLAS_ROWS = 5;
+const uint32_t HUD_FIRST_GLYPH = ' ';
+const uint32_t HUD_GLYPH_COUNT = 64;
+const uint32_t HUD_SOLID_CELL = HUD_GLYPH_COUNT;
+const uint32_t HUD_ATLAS_WIDTH = HUD_ATLAS_COLUMNS * HUD_GLYPH_WIDTH;
+const uint32_t HUD_ATLAS_HEIGHT = HUD_ATLAS_ROWS * HUD_GLYPH_HEIGHT;
+
+// Colors are 0xAABBGGRR, like the sprites'.
+const uint32_t HUD_COLOR_PANEL = 0xB0000000;
+const uint32_t HUD_COLOR_TEXT = 0xFFFFFFFF;
+const uint32_t HUD_COLOR_FAST = 0xFF40D040;
+const uint32_t HUD_COLOR_SLOW = 0xFF40D0E0;
+const uint32_t HUD_COLOR_SLOWER = 0xFF4040E0;
+const uint32_t HUD_COLOR_GPU = 0xFFF0A040;
+const uint32_t HUD_COLOR_TARGET = 0x80FFFFFF;
+
+// Five columns per glyph, top row in the lowest bit.
+static const uint8_t hudFont[HUD_GLYPH_COUNT][5] =
+{
+	{ 0x00, 0x00, 0x00, 0x00, 0x00 },	// ' '
+	{ 0x00, 0x00, 0x5F, 0x00, 0x00 },	// '!'
+	{ 0x00, 0x07, 0x00, 0x07, 0x00 },	// '"'
+	{ 0x14, 0x7F, 0x14, 0x7F, 0x14 },	// '#'
+	{ 0x24, 0x2A, 0x7F, 0x2A, 0x12 },	// '$'
+	{ 0x23, 0x13, 0x08, 0x64, 0x62 },	// '%'
+	{ 0x36, 0x49, 0x55, 0x22, 0x50 },	// '&'
+	{ 0x00, 0x05, 0x03, 0x00, 0x00 },	// '''
+	{ 0x00, 0x1C, 0x22, 0x41, 0x00 },	// '('
+	{ 0x00, 0x41, 0x22, 0x1C, 0x00 },	// ')'
+	{ 0x14, 0x08, 0x3E, 0x08, 0x14 },	// '*'
+	{ 0x08, 0x08, 0x3E, 0x08, 0x08 },	// '+'
+	{ 0x00, 0x50, 0x30, 0x00, 0x00 },	// ','
+	{ 0x08, 0x08, 0x08, 0x08, 0x08 },	// '-'
+	{ 0x00, 0x60, 0x60, 0x00, 0x00 },	// '.'
+	{ 0x20, 0x10, 0x08, 0x04, 0x02 },	// '/'
+	{ 0x3E, 0x51, 0x49, 0x45, 0x3E },	// '0'
+	{ 0x00, 0x42, 0x7F, 0x40, 0x00 },	// '1'
+	{ 0x42, 0x61, 0x51, 0x49, 0x46 },	// '2'
+	{ 0x21, 0x41, 0x45, 0x4B, 0x31 },	// '3'
+	{ 0x18, 0x14, 0x12, 0x7F, 0x10 },	// '4'
+	{ 0x27, 0x45, 0x45, 0x45, 0x39 },	// '5'
+	{ 0x3C, 0x4A, 0x49, 0x49, 0x30 },	// '6'
+	{ 0x01, 0x71, 0x09, 0x05, 0x03 },	// '7'
+	{ 0x36, 0x49, 0x49, 0x49, 0x36 },	// '8'
+	{ 0x06, 0x49, 0x49, 0x29, 0x1E },	// '9'
+	{ 0x00, 0x36, 0x36, 0x00, 0x00 },	// ':'
+	{ 0x00, 0x56, 0x36, 0x00, 0x00 },	// ';'
+	{ 0x08, 0x14, 0x22, 0x41, 0x00 },	// '<'
+	{ 0x14, 0x14, 0x14, 0x14, 0x14 },	// '='
+	{ 0x00, 0x41, 0x22, 0x14, 0x08 },	// '>'
+	{ 0x02, 0x01, 0x51, 0x09, 0x06 },	// '?'
+	{ 0x32, 0x49, 0x79, 0x41, 0x3E },	// '@'
+	{ 0x7E, 0x11, 0x11, 0x11, 0x7E },	// 'A'
+	{ 0x7F, 0x49, 0x49, 0x49, 0x36 },	// 'B'
+	{ 0x3E, 0x41, 0x41, 0x41, 0x22 },	// 'C'
+	{ 0x7F, 0x41, 0x41, 0x22, 0x1C },	// 'D'
+	{ 0x7F, 0x49, 0x49, 0x49, 0x41 },	// 'E'
+	{ 0x7F, 0x09, 0x09, 0x01, 0x01 },	// 'F'
+	{ 0x3E, 0x41, 0x41, 0x51, 0x32 },	// 'G'
+	{ 0x7F, 0x08, 0x08, 0x08, 0x7F },	// 'H'
+	{ 0x00, 0x41, 0x7F, 0x41, 0x00 },	// 'I'
+	{ 0x20, 0x40, 0x41, 0x3F, 0x01 },	// 'J'
+	{ 0x7F, 0x08, 0x14, 0x22, 0x41 },	// 'K'
+	{ 0x7F, 0x40, 0x40, 0x40, 0x40 },	// 'L'
+	{ 0x7F, 0x02, 0x04, 0x02, 0x7F },	// 'M'
+	{ 0x7F, 0x04, 0x08, 0x10, 0x7F },	// 'N'
+	{ 0x3E, 0x41, 0x41, 0x41, 0x3E },	// 'O'
+	{ 0x7F, 0x09, 0x09, 0x09, 0x06 },	// 'P'
+	{ 0x3E, 0x41, 0x51, 0x21, 0x5E },	// 'Q'
+	{ 0x7F, 0x09, 0x19, 0x29, 0x46 },	// 'R'
+	{ 0x46, 0x49, 0x49, 0x49, 0x31 },	// 'S'
+	{ 0x01, 0x01, 0x7F, 0x01, 0x01 },	// 'T'
+	{ 0x3F, 0x40, 0x40, 0x40, 0x3F },	// 'U'
+	{ 0x1F, 0x20, 0x40, 0x20, 0x1F },	// 'V'
+	{ 0x7F, 0x20, 0x18, 0x20, 0x7F },	// 'W'
+	{ 0x63, 0x14, 0x08, 0x14, 0x63 },	// 'X'
+	{ 0x03, 0x04, 0x78, 0x04, 0x03 },	// 'Y'
+	{ 0x61, 0x51, 0x49, 0x45, 0x43 },	// 'Z'
+	{ 0x00, 0x7F, 0x41, 0x41, 0x00 },	// '['
+	{ 0x02, 0x04, 0x08, 0x10, 0x20 },	// '\'
+	{ 0x00, 0x41, 0x41, 0x7F, 0x00 },	// ']'
+	{ 0x04, 0x02, 0x01, 0x02, 0x04 },	// '^'
+	{ 0x40, 0x40, 0x40, 0x40, 0x40 }	// '_'
+};
+
+PerformanceHud::PerformanceHud(Application* app)
+{
+	this->app = app;
+	this->visible = true;
+	this->currentFrame = 0;
+	this->glyphImage = VK_NULL_HANDLE;
+	this->glyphImageMemory = nullptr;
+	this->glyphImageView = VK_NULL_HANDLE;
+	this->glyphSampler = VK_NULL_HANDLE;
+	this->descriptorSetLayout = VK_NULL_HANDLE;
+	this->descriptorPool = VK_NULL_HANDLE;
+	this->descriptorSet = VK_NULL_HANDLE;
+	this->pipelineLayout = VK_NULL_HANDLE;
+	this->pipelineId = 0;
+	this->quadCount = 0;
+	this->queryPool = VK_NULL_HANDLE;
+	this->timestampsSupported = false;
+	this->timestampPeriod = 0.0f;
+	this->historyNext = 0;
+	this->lastGpuMilliseconds = 0.0f;
+	this->intervalFrameCount = 0;
+	this->intervalTimedFrameCount = 0;
+	this->intervalFrameMilliseconds = 0.0;
+	this->intervalGpuMilliseconds = 0.0;
+	this->intervalHudCpuMilliseconds = 0.0;
+	for (uint32_t pass = 0; pass < PASS_COUNT; pass++)
+	{
+		this->intervalPassMilliseconds[pass] = 0.0;
+		this->intervalPassFrameCount[pass] = 0;
+	}
+	this->totalFrameCount = 0;
+	this->totalTimedFrameCount = 0;
+	this->totalHudCpuMilliseconds = 0.0;
+	this->totalHudGpuMilliseconds = 0.0;
+}
+
+/*virtual*/ PerformanceHud::~PerformanceHud()
+{
+}
+
+void PerformanceHud::Create()
+{
+	this->frameHistoryArray.resize(HUD_HISTORY_FRAMES, 0.0f);
+	this->gpuHistoryArray.resize(HUD_HISTORY_FRAMES, 0.0f);
+	this->textLinesArray.reserve(16);
+
+	this->CreateGlyphAtlas();
+	this->CreateVertexBuffers();
+	this->CreateDescriptorSet();
+	this->CreatePipeline();
+	this->CreateQueryPool();
+
+	std::cout << "Performance HUD: on (F1 to hide)" << (this->timestampsSupported ? "" : ", no timestamps so no GPU times") << std::endl;
+}
+
+void PerformanceHud::Destroy()
+{
+	VkDevice logicalDevice = this->app->logicalDevice;
+
+	if (this->totalFrameCount > 0)
+	{
+		std::cout << "Performance HUD: " << this->totalFrameCount << " frames, cost per frame " << this->totalHudCpuMilliseconds / double(this->totalFrameCount) << " ms CPU";
+		if (this->totalTimedFrameCount > 0)
+			std::cout << ", " << this->totalHudGpuMilliseconds / double(this->totalTimedFrameCount) << " ms GPU";
+		std::cout << std::endl;
+	}
+
+	for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+	{
+		vkUnmapMemory(logicalDevice, this->vertexBuffersMemory[i]);
+		vkDestroyBuffer(logicalDevice, this->vertexBuffers[i], nullptr);
+		this->app->memoryTracker->Free(this->vertexBuffersMemory[i]);
+	}
+
+	if (this->queryPool != VK_NULL_HANDLE)
+		vkDestroyQueryPool(logicalDevice, this->queryPool, nullptr);
+
+	// The glyph atlas's descriptor set is freed with its pool.  The text pipeline isn't ours to destroy; the pipeline
+	// cache outlives the HUD and takes it down with everything else it built.
+	vkDestroyPipelineLayout(logicalDevice, this->pipelineLayout, nullptr);
+	vkDestroyDescriptorPool(logicalDevice, this->descriptorPool, nullptr);
+	vkDestroyDescriptorSetLayout(logicalDevice, this->descriptorSetLayout, nullptr);
+
+	vkDestroySampler(logicalDevice, this->glyphSampler, nullptr);
+	vkDestroyImageView(logicalDevice, this->glyphImageView, nullptr);
+	vkDestroyImage(logicalDevice, this->glyphImage, nullptr);
+	this->app->memoryTracker->Free(this->glyphImageMemory);
+}
+
+void PerformanceHud::CreateGlyphAtlas()
+{
+	// White everywhere, with the glyphs in the alpha channel, so the vertex color tints them.
+	std::vector<uint8_t> pixels(4 * HUD_ATLAS_WIDTH * HUD_ATLAS_HEIGHT, 255);
+	for (size_t j = 3; j < pixels.size(); j += 4)
+		pixels[j] = 0;
+
+	for (uint32_t glyph = 0; glyph <= HUD_SOLID_CELL; glyph++)
+	{
+		uint32_t cellX = (glyph % HUD_ATLAS_COLUMNS) * HUD_GLYPH_WIDTH;
+		uint32_t cellY = (glyph / HUD_ATLAS_COLUMNS) * HUD_GLYPH_HEIGHT;
+
+		for (uint32_t y = 0; y < HUD_GLYPH_HEIGHT; y++)
+		{
+			for (uint32_t x = 0; x < HUD_GLYPH_WIDTH; x++)
+			{
+				bool set = (glyph == HUD_SOLID_CELL) || (x < 5 && y < 7 && 0 != (hudFont[glyph][x] & (1 << y)));
+				if (set)
+					pixels[4 * ((cellY + y) * HUD_ATLAS_WIDTH + cellX + x) + 3] = 255;
+			}
+		}
+	}
+
+	VkDeviceSize imageSize = pixels.size();
+
+	VkBuffer stagingBuffer = VK_NULL_HANDLE;
+	VkDeviceMemory stagingBufferMemory = nullptr;
+	this->app->CreateBuffer(imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+
+	void* data = nullptr;
+	vkMapMemory(this->app->logicalDevice, stagingBufferMemory, 0, imageSize, 0, &data);
+	::memcpy(data, pixels.data(), (size_t)imageSize);
+	vkUnmapMemory(this->app->logicalDevice, stagingBufferMemory);
+
+	// Coverage, not color, so UNORM rather than SRGB.
+	this->app->CreateImage(HUD_ATLAS_WIDTH, HUD_ATLAS_HEIGHT, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, this->glyphImage, this->glyphImageMemory);
+	this->app->TransitionImageLayout(this->glyphImage, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+	this->app->CopyBufferToImage(stagingBuffer, this->glyphImage, HUD_ATLAS_WIDTH, HUD_ATLAS_HEIGHT);
+	this->app->TransitionImageLayout(this->glyphImage, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+	vkDestroyBuffer(this->app->logicalDevice, stagingBuffer, nullptr);
+	this->app->memoryTracker->Free(stagingBufferMemory);
+
+	this->glyphImageView = this->app->CreateImageView(this->glyphImage, VK_FORMAT_R8G8B8A8_UNORM);
+
+	// Glyphs are drawn at a whole multiple of their size, so nearest filtering keeps them crisp.
+	VkSamplerCreateInfo samplerInfo{};
+	samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	samplerInfo.magFilter = VK_FILTER_NEAREST;
+	samplerInfo.minFilter = VK_FILTER_NEAREST;
+	samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.anisotropyEnable = VK_FALSE;
+	samplerInfo.maxAnisotropy = 1.0f;
+	samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+	samplerInfo.unnormalizedCoordinates = VK_FALSE;
+	samplerInfo.compareEnable = VK_FALSE;
+	samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
+	samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+	samplerInfo.minLod = 0.0f;
+	samplerInfo.maxLod = 0.0f;
+
+	if (VK_SUCCESS != vkCreateSampler(this->app->logicalDevice, &samplerInfo, nullptr, &this->glyphSampler))
+		throw new std::runtime_error("Failed to create HUD sampler!");
+}
+
+void PerformanceHud::CreateVertexBuffers()
+{
+	VkDeviceSize bufferSize = sizeof(HudVertex) * 6 * (VkDeviceSize)HUD_MAX_QUADS;
+
+	this->vertexBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+	this->vertexBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
+	this->mappedVertices.resize(MAX_FRAMES_IN_FLIGHT);
+
+	// Same as the sprite batch: one persistently mapped, coherent buffer per frame slot.
+	for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+	{
+		this->app->CreateBuffer(bufferSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, this->vertexBuffers[i], this->vertexBuffersMemory[i]);
+
+		void* data = nullptr;
+		if (VK_SUCCESS != vkMapMemory(this->app->logicalDevice, this->vertexBuffersMemory[i], 0, bufferSize, 0, &data))
+			throw new std::runtime_error("Failed to map HUD vertex buffer!");
+
+		this->mappedVertices[i] = static_cast<HudVertex*>(data);
+	}
+}
+
+void PerformanceHud::CreateDescriptorSet()
+{
+	VkDescriptorSetLayoutBinding samplerLayoutBinding{};
+	samplerLayoutBinding.binding = 0;
+	samplerLayoutBinding.descriptorCount = 1;
+	samplerLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	samplerLayoutBinding.pImmutableSamplers = nullptr;
+	samplerLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo{};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.bindingCount = 1;
+	layoutInfo.pBindings = &samplerLayoutBinding;
+
+	if (VK_SUCCESS != vkCreateDescriptorSetLayout(this->app->logicalDevice, &layoutInfo, nullptr, &this->descriptorSetLayout))
+		throw new std::runtime_error("Failed to create HUD descriptor set layout!");
+
+	VkDescriptorPoolSize poolSize{};
+	poolSize.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	poolSize.descriptorCount = 1;
+
+	VkDescriptorPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.poolSizeCount = 1;
+	poolInfo.pPoolSizes = &poolSize;
+	poolInfo.maxSets = 1;
+
+	if (VK_SUCCESS != vkCreateDescriptorPool(this->app->logicalDevice, &poolInfo, nullptr, &this->descriptorPool))
+		throw new std::runtime_error("Failed to create HUD descriptor pool!");
+
+	VkDescriptorSetAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = this->descriptorPool;
+	allocInfo.descriptorSetCount = 1;
+	allocInfo.pSetLayouts = &this->descriptorSetLayout;
+
+	if (VK_SUCCESS != vkAllocateDescriptorSets(this->app->logicalDevice, &allocInfo, &this->descriptorSet))
+		throw new std::runtime_error("Failed to allocate HUD descriptor set!");
+
+	VkDescriptorImageInfo imageInfo{};
+	imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	imageInfo.imageView = this->glyphImageView;
+	imageInfo.sampler = this->glyphSampler;
+
+	VkWriteDescriptorSet descriptorWrite{};
+	descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	descriptorWrite.dstSet = this->descriptorSet;
+	descriptorWrite.dstBinding = 0;
+	descriptorWrite.dstArrayElement = 0;
+	descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	descriptorWrite.descriptorCount = 1;
+	descriptorWrite.pImageInfo = &imageInfo;
+
+	vkUpdateDescriptorSets(this->app->logicalDevice, 1, &descriptorWrite, 0, nullptr);
+}
+
+void PerformanceHud::CreatePipeline()
+{
+	VkPushConstantRange pushConstantRange{};
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+	pushConstantRange.offset = 0;
+	pushConstantRange.size = sizeof(glm::vec2);
+
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount = 1;
+	pipelineLayoutInfo.pSetLayouts = &this->descriptorSetLayout;
+	pipelineLayoutInfo.pushConstantRangeCount = 1;
+	pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+	if (VK_SUCCESS != vkCreatePipelineLayout(this->app->logicalDevice, &pipelineLayoutInfo, nullptr, &this->pipelineLayout))
+		throw new std::runtime_error("Failed to create HUD pipeline layout!");
+
+	PipelineCache* pipelineCache = this->app->pipelineCache;
+
+	PipelineState state;
+	state.layout = this->pipelineLayout;
+	state.vertexShader = pipelineCache->AddShader(Application::ReadFile("sprite_vert.spv"));
+	state.fragmentShader = pipelineCache->AddShader(Application::ReadFile("sprite_frag.spv"));
+	state.colorFormat = this->app->swapChainImageFormat;
+	state.cullMode = VK_CULL_MODE_NONE;
+	state.frontFace = VK_FRONT_FACE_CLOCKWISE;
+	state.SetAlphaBlend();
+
+	VkVertexInputBindingDescription bindingDescription{};
+	bindingDescription.binding = 0;
+	bindingDescription.stride = sizeof(HudVertex);
+	bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+	state.AddVertexBinding(bindingDescription);
+
+	state.AddVertexAttribute(VkVertexInputAttributeDescription{ 0, 0, VK_FORMAT_R32G32_SFLOAT, offsetof(HudVertex, x) });
+	state.AddVertexAttribute(VkVertexInputAttributeDescription{ 1, 0, VK_FORMAT_R32G32_SFLOAT, offsetof(HudVertex, u) });
+	state.AddVertexAttribute(VkVertexInputAttributeDescription{ 2, 0, VK_FORMAT_R8G8B8A8_UNORM, offsetof(HudVertex, color) });
+
+	this->pipelineId = pipelineCache->Request(state);
+}
+
+void PerformanceHud::CreateQueryPool()
+{
+	this->timingsPending.resize(MAX_FRAMES_IN_FLIGHT, false);
+
+	VkPhysicalDeviceProperties properties{};
+	vkGetPhysicalDeviceProperties(this->app->physicalDevice, &properties);
+	this->timestampPeriod = properties.limits.timestampPeriod;
+
+	uint32_t queueFamilyCount = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(this->app->physicalDevice, &queueFamilyCount, nullptr);
+	std::vector<VkQueueFamilyProperties> queueFamiliesArray(queueFamilyCount);
+	vkGetPhysicalDeviceQueueFamilyProperties(this->app->physicalDevice, &queueFamilyCount, queueFamiliesArray.data());
+
+	Application::QueueFamilyIndices indices = this->app->FindQueueFamilies(this->app->physicalDevice);
+	this->timestampsSupported = queueFamiliesArray[indices.graphicsFamily.value()].timestampValidBits > 0;
+	if (!this->timestampsSupported)
+		return;
+
+	VkQueryPoolCreateInfo queryPoolInfo{};
+	queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+	queryPoolInfo.queryCount = HUD_QUERIES_PER_FRAME * static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+
+	if (VK_SUCCESS != vkCreateQueryPool(this->app->logicalDevice, &queryPoolInfo, nullptr, &this->queryPool))
+		throw new std::runtime_error("Failed to create HUD query pool!");
+}
+
+void PerformanceHud::Update(uint32_t i, float deltaTime)
+{
+	if (!this->visible)
+		return;
+
+	auto startTime = std::chrono::high_resolution_clock::now();
+
+	this->CollectTimings(i);
+
+	float frameMilliseconds = deltaTime * 1000.0f;
+	this->frameHistoryArray[this->historyNext] = frameMilliseconds;
+	this->gpuHistoryArray[this->historyNext] = this->lastGpuMilliseconds;
+	this->historyNext = (this->historyNext + 1) % HUD_HISTORY_FRAMES;
+
+	this->intervalFrameCount++;
+	this->intervalFrameMilliseconds += frameMilliseconds;
+	if (this->intervalFrameCount == HUD_TEXT_INTERVAL || this->textLinesArray.empty())
+		this->RefreshText();
+
+	this->currentFrame = i;
+	this->BuildQuads();
+
+	auto endTime = std::chrono::high_resolution_clock::now();
+	double milliseconds = std::chrono::duration<double, std::milli>(endTime - startTime).count();
+	this->intervalHudCpuMilliseconds += milliseconds;
+	this->totalHudCpuMilliseconds += milliseconds;
+	this->totalFrameCount++;
+}
+
+void PerformanceHud::CollectTimings(uint32_t i)
+{
+	// The fence has been waited on, so the results are there without having to wait for them.
+	if (!this->timingsPending[i])
+		return;
+
+	this->timingsPending[i] = false;
+
+	// Passes that didn't run this frame never wrote their timestamps, so ask for availability rather than failing the
+	// whole read over them.
+	struct TimestampResult
+	{
+		uint64_t timestamp;
+		uint64_t available;
+	};
+	TimestampResult resultsArray[HUD_QUERIES_PER_FRAME]{};
+	VkResult result = vkGetQueryPoolResults(this->app->logicalDevice, this->queryPool, HUD_QUERIES_PER_FRAME * i, HUD_QUERIES_PER_FRAME,
+		sizeof(resultsArray), resultsArray, sizeof(TimestampResult), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+	if (result != VK_SUCCESS && result != VK_NOT_READY)
+		return;
+
+	double millisecondsPerTick = double(this->timestampPeriod) * 1e-6;
+	auto elapsedMilliseconds = [&resultsArray, millisecondsPerTick](uint32_t begin, uint32_t end, double& milliseconds) -> bool
+	{
+		if (resultsArray[begin].available == 0 || resultsArray[end].available == 0)
+			return false;
+		milliseconds = double(resultsArray[end].timestamp - resultsArray[begin].timestamp) * millisecondsPerTick;
+		return true;
+	};
+
+	double frameGpuMilliseconds = 0.0;
+	if (!elapsedMilliseconds(0, 1 + 2 * PASS_HUD, frameGpuMilliseconds))
+		return;
+
+	this->lastGpuMilliseconds = (float)frameGpuMilliseconds;
+	this->intervalTimedFrameCount++;
+	this->intervalGpuMilliseconds += frameGpuMilliseconds;
+
+	for (uint32_t pass = 0; pass < PASS_COUNT; pass++)
+	{
+		double passGpuMilliseconds = 0.0;
+		if (!elapsedMilliseconds(1 + 2 * pass, 2 + 2 * pass, passGpuMilliseconds))
+			continue;
+
+		this->intervalPassMilliseconds[pass] += passGpuMilliseconds;
+		this->intervalPassFrameCount[pass]++;
+
+		if (pass == PASS_HUD)
+		{
+			this->totalTimedFrameCount++;
+			this->totalHudGpuMilliseconds += passGpuMilliseconds;
+		}
+	}
+}
+
+void PerformanceHud::RefreshText()
+{
+	double frames = double(std::max(this->intervalFrameCount, 1u));
+	double timedFrames = double(std::max(this->intervalTimedFrameCount, 1u));
+	double frameMilliseconds = this->intervalFrameMilliseconds / frames;
+
+	char line[128];
+	this->textLinesArray.clear();
+
+	::snprintf(line, sizeof(line), "FRAME %.2f MS  %.0f FPS", frameMilliseconds, (frameMilliseconds > 0.0) ? 1000.0 / frameMilliseconds : 0.0);
+	this->textLinesArray.push_back(line);
+
+	if (this->timestampsSupported)
+		::snprintf(line, sizeof(line), "GPU %.2f MS", this->intervalGpuMilliseconds / timedFrames);
+	else
+		::snprintf(line, sizeof(line), "GPU N/A");
+	this->textLinesArray.push_back(line);
+
+	// Our own pass goes on the HUD line below.
+	std::string passesLine;
+	for (uint32_t pass = 0; pass < PASS_HUD; pass++)
+	{
+		if (this->intervalPassFrameCount[pass] == 0)
+			continue;
+
+		::snprintf(line, sizeof(line), "%s%s %.2f", passesLine.empty() ? "" : "  ", hudPassNames[pass], this->intervalPassMilliseconds[pass] / double(this->intervalPassFrameCount[pass]));
+		passesLine += line;
+	}
+	if (!passesLine.empty())
+		this->textLinesArray.push_back(passesLine + " MS");
+
+	if (this->app->dynamicResolution)
+	{
+		VkExtent2D renderExtent = this->app->dynamicResolution->GetRenderExtent();
+		::snprintf(line, sizeof(line), "SCALE %.0f%%  %ux%u", 100.0 * this->app->dynamicResolution->GetScale(), renderExtent.width, renderExtent.height);
+		this->textLinesArray.push_back(line);
+	}
+
+	// The counters only count while they're enabled, which they are whenever we exist.  These are the last frame's.
+	::snprintf(line, sizeof(line), "DRAWS %u  TRIS %u",
+		VulkanCounters::GetFrameCount(VulkanCounters::DRAW),
+		VulkanCounters::GetFrameCount(VulkanCounters::TRIANGLES));
+	this->textLinesArray.push_back(line);
+
+	::snprintf(line, sizeof(line), "BINDS %u  BARRIERS %u  SUBMITS %u",
+		VulkanCounters::GetFrameCount(VulkanCounters::BIND_PIPELINE) + VulkanCounters::GetFrameCount(VulkanCounters::BIND_DESCRIPTOR_SETS),
+		VulkanCounters::GetFrameCount(VulkanCounters::PIPELINE_BARRIER),
+		VulkanCounters::GetFrameCount(VulkanCounters::QUEUE_SUBMIT));
+	this->textLinesArray.push_back(line);
+
+	MemoryTracker* memoryTracker = this->app->memoryTracker;
+	for (uint32_t heap = 0; heap < memoryTracker->GetHeapCount(); heap++)
+	{
+		MemoryTracker::HeapStatistics heapStatistics = memoryTracker->GetHeapStatistics(heap);
+		bool deviceLocal = 0 != (memoryTracker->GetMemoryProperties().memoryHeaps[heap].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT);
+
+		::snprintf(line, sizeof(line), "%s HEAP %u  %.1f/%.0f MB", deviceLocal ? "VRAM" : "HOST", heap,
+			double(heapStatistics.usage) / (1024.0 * 1024.0), double(heapStatistics.budget) / (1024.0 * 1024.0));
+		this->textLinesArray.push_back(line);
+	}
+
+	double hudGpuMilliseconds = this->intervalPassMilliseconds[PASS_HUD] / double(std::max(this->intervalPassFrameCount[PASS_HUD], 1u));
+	::snprintf(line, sizeof(line), "HUD CPU %.3f MS  GPU %.3f MS", this->intervalHudCpuMilliseconds / frames, hudGpuMilliseconds);
+	this->textLinesArray.push_back(line);
+
+	this->intervalFrameCount = 0;
+	this->intervalTimedFrameCount = 0;
+	this->intervalFrameMilliseconds = 0.0;
+	this->intervalGpuMilliseconds = 0.0;
+	this->intervalHudCpuMilliseconds = 0.0;
+	for (uint32_t pass = 0; pass < PASS_COUNT; pass++)
+	{
+		this->intervalPassMilliseconds[pass] = 0.0;
+		this->intervalPassFrameCount[pass] = 0;
+	}
+}
+
+void PerformanceHud::BuildQuads()
+{
+	this->quadCount = 0;
+
+	float lineHeight = HUD_GLYPH_HEIGHT * HUD_SCALE;
+	float graphWidth = HUD_HISTORY_FRAMES * HUD_BAR_WIDTH;
+
+	float panelWidth = graphWidth;
+	for (const std::string& textLine : this->textLinesArray)
+		panelWidth = std::max(panelWidth, float(textLine.length() * HUD_GLYPH_WIDTH) * HUD_SCALE);
+
+	float panelHeight = float(this->textLinesArray.size()) * lineHeight + HUD_MARGIN + HUD_GRAPH_HEIGHT;
+
+	// Back to front, since it's all one draw: the panel, then the graph, then the text.
+	this->AddRectangle(HUD_MARGIN, HUD_MARGIN, panelWidth + 2.0f * HUD_MARGIN, panelHeight + 2.0f * HUD_MARGIN, HUD_COLOR_PANEL);
+
+	float x = 2.0f * HUD_MARGIN;
+	float y = 2.0f * HUD_MARGIN;
+	for (const std::string& textLine : this->textLinesArray)
+	{
+		this->AddText(x, y, textLine.c_str(), HUD_COLOR_TEXT);
+		y += lineHeight;
+	}
+
+	// Oldest frame on the left.  Each bar is the whole frame, colored by how it did against the target, with the GPU's
+	// time for it drawn over the bottom.
+	float graphBottom = y + HUD_MARGIN + HUD_GRAPH_HEIGHT;
+	for (uint32_t j = 0; j < HUD_HISTORY_FRAMES; j++)
+	{
+		uint32_t k = (this->historyNext + j) % HUD_HISTORY_FRAMES;
+		float frameMilliseconds = this->frameHistoryArray[k];
+		float gpuMilliseconds = this->gpuHistoryArray[k];
+
+		uint32_t color = HUD_COLOR_FAST;
+		if (frameMilliseconds > HUD_GRAPH_MILLISECONDS)
+			color = HUD_COLOR_SLOWER;
+		else if (frameMilliseconds > HUD_TARGET_MILLISECONDS)
+			color = HUD_COLOR_SLOW;
+
+		float frameHeight = std::min(frameMilliseconds / HUD_GRAPH_MILLISECONDS, 1.0f) * HUD_GRAPH_HEIGHT;
+		float gpuHeight = std::min(gpuMilliseconds / HUD_GRAPH_MILLISECONDS, 1.0f) * HUD_GRAPH_HEIGHT;
+
+		if (frameHeight > 0.0f)
+			this->AddRectangle(x + j * HUD_BAR_WIDTH, graphBottom - frameHeight, HUD_BAR_WIDTH, frameHeight, color);
+		if (gpuHeight > 0.0f)
+			this->AddRectangle(x + j * HUD_BAR_WIDTH, graphBottom - gpuHeight, HUD_BAR_WIDTH, gpuHeight, HUD_COLOR_GPU);
+	}
+
+	float targetHeight = (HUD_TARGET_MILLISECONDS / HUD_GRAPH_MILLISECONDS) * HUD_GRAPH_HEIGHT;
+	this->AddRectangle(x, graphBottom - targetHeight, graphWidth, 1.0f, HUD_COLOR_TARGET);
+}
+
+void PerformanceHud::AddQuad(float x, float y, float width, float height, float u0, float v0, float u1, float v1, uint32_t color)
+{
+	if (this->quadCount >= HUD_MAX_QUADS)
+		return;
+
+	// Two triangles, unindexed, so the whole HUD is one vkCmdDraw without an index buffer of its own.
+	HudVertex* vertex = &this->mappedVertices[this->currentFrame][this->quadCount * 6];
+	vertex[0] = HudVertex{ x, y, u0, v0, color };
+	vertex[1] = HudVertex{ x + width, y, u1, v0, color };
+	vertex[2] = HudVertex{ x + width, y + height, u1, v1, color };
+	vertex[3] = vertex[2];
+	vertex[4] = HudVertex{ x, y + height, u0, v1, color };
+	vertex[5] = vertex[0];
+
+	this->quadCount++;
+}
+
+void PerformanceHud::AddRectangle(float x, float y, float width, float height, uint32_t color)
+{
+	// Every texel of the solid cell is opaque, so any point in it will do; its center keeps clear of the neighbors.
+	float u = (float(HUD_SOLID_CELL % HUD_ATLAS_COLUMNS) + 0.5f) * HUD_GLYPH_WIDTH / float(HUD_ATLAS_WIDTH);
+	float v = (float(HUD_SOLID_CELL / HUD_ATLAS_COLUMNS) + 0.5f) * HUD_GLYPH_HEIGHT / float(HUD_ATLAS_HEIGHT);
+	this->AddQuad(x, y, width, height, u, v, u, v, color);
+}
+
+void PerformanceHud::AddText(float x, float y, const char* text, uint32_t color)
+{
+	float glyphWidth = HUD_GLYPH_WIDTH * HUD_SCALE;
+	float glyphHeight = HUD_GLYPH_HEIGHT * HUD_SCALE;
+
+	for (const char* c = text; *c != '\0'; c++)
+	{
+		uint32_t glyph = (uint32_t)::toupper((unsigned char)*c);
+		if (glyph > HUD_FIRST_GLYPH && glyph < HUD_FIRST_GLYPH + HUD_GLYPH_COUNT)
+		{
+			glyph -= HUD_FIRST_GLYPH;
+			float u0 = float((glyph % HUD_ATLAS_COLUMNS) * HUD_GLYPH_WIDTH) / float(HUD_ATLAS_WIDTH);
+			float v0 = float((glyph / HUD_ATLAS_COLUMNS) * HUD_GLYPH_HEIGHT) / float(HUD_ATLAS_HEIGHT);
+			float u1 = u0 + float(HUD_GLYPH_WIDTH) / float(HUD_ATLAS_WIDTH);
+			float v1 = v0 + float(HUD_GLYPH_HEIGHT) / float(HUD_ATLAS_HEIGHT);
+			this->AddQuad(x, y, glyphWidth, glyphHeight, u0, v0, u1, v1, color);
+		}
+
+		x += glyphWidth;
+	}
+}
+
+void PerformanceHud::RecordFrameBegin(VkCommandBuffer givenCommandBuffer, uint32_t i)
+{
+	if (!this->visible || !this->timestampsSupported)
+		return;
+
+	vkCmdResetQueryPool(givenCommandBuffer, this->queryPool, HUD_QUERIES_PER_FRAME * i, HUD_QUERIES_PER_FRAME);
+	vkCmdWriteTimestamp(givenCommandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, this->queryPool, HUD_QUERIES_PER_FRAME * i);
+	this->timingsPending[i] = true;
+}
+
+void PerformanceHud::RecordPassBegin(VkCommandBuffer givenCommandBuffer, uint32_t i, Pass pass)
+{
+	// Bottom of pipe either side, so a pass is the work that finished between its marks.
+	if (this->visible && this->timestampsSupported)
+		vkCmdWriteTimestamp(givenCommandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, this->queryPool, HUD_QUERIES_PER_FRAME * i + 1 + 2 * pass);
+}
+
+void PerformanceHud::RecordPassEnd(VkCommandBuffer givenCommandBuffer, uint32_t i, Pass pass)
+{
+	if (this->visible && this->timestampsSupported)
+		vkCmdWriteTimestamp(givenCommandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, this->queryPool, HUD_QUERIES_PER_FRAME * i + 2 + 2 * pass);
+}
+
+void PerformanceHud::RecordDraw(VkCommandBuffer givenCommandBuffer, uint32_t i)
+{
+	if (!this->visible || this->quadCount == 0)
+		return;
+
+	auto startTime = std::chrono::high_resolution_clock::now();
+
+	// Everything before this mark is the frame; everything between it and the end mark is us.
+	this->RecordPassBegin(givenCommandBuffer, i, PASS_HUD);
+
+	glm::vec2 pixelToClip(2.0f / float(this->app->swapChainExtent.width), 2.0f / float(this->app->swapChainExtent.height));
+
+	vkCmdBindPipeline(givenCommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, this->app->pipelineCache->GetPipeline(this->pipelineId));
+	vkCmdPushConstants(givenCommandBuffer, this->pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(pixelToClip), &pixelToClip);
+	vkCmdBindDescriptorSets(givenCommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, this->pipelineLayout, 0, 1, &this->descriptorSet, 0, nullptr);
+
+	VkDeviceSize offset = 0;
+	vkCmdBindVertexBuffers(givenCommandBuffer, 0, 1, &this->vertexBuffers[i], &offset);
+	vkCmdDraw(givenCommandBuffer, this->quadCount * 6, 1, 0, 0);
+
+	this->RecordPassEnd(givenCommandBuffer, i, PASS_HUD);
+
+	auto endTime = std::chrono::high_resolution_clock::now();
+	double milliseconds = std::chrono::duration<double, std::milli>(endTime - startTime).count();
+	this->intervalHudCpuMilliseconds += milliseconds;
+	this->totalHudCpuMilliseconds += milliseconds;
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include "Application.h"
+
+// An on-screen overlay of how the renderer is doing: a graph of recent frame times with the GPU's share of each, GPU
+// pass times, draw and triangle counts, and memory use per heap, so it can be read off a live machine without
+// attaching anything.  Everything is drawn as quads out of one tiny built-in glyph atlas (with a solid cell for the
+// bars and the backing panel), written straight into a persistently mapped vertex buffer per frame slot, and recorded
+// as a single draw after everything else in the frame.  It uses the sprite shaders, since the vertices are the same.
+//
+// It measures itself too: the CPU time to build and record it, and the GPU time of its draw, which are shown with the
+// rest and logged when it's destroyed.  When it isn't created at all, it costs nothing.
+class PerformanceHud
+{
+public:
+	PerformanceHud(Application* app);
+	virtual ~PerformanceHud();
+
+	void Create();
+	void Destroy();
+
+	void ToggleVisible() { this->visible = !this->visible; }
+
+	// Call once slot i's fence has been waited on, with the time since the last frame.
+	void Update(uint32_t i, float deltaTime);
+
+	// The parts of the frame whose GPU time is shown on its own.  We time our own draw; the rest are marked by whoever
+	// records them.
+	enum Pass
+	{
+		PASS_SCENE,
+		PASS_PARTICLES,
+		PASS_UPSCALE,
+		PASS_HUD,
+		PASS_COUNT
+	};
+
+	// Call before the frame's rendering begins, since query resets aren't allowed inside it.
+	void RecordFrameBegin(VkCommandBuffer givenCommandBuffer, uint32_t i);
+
+	// Call either side of a pass, inside the frame's rendering or not.  A pass that isn't marked in a frame is left out.
+	void RecordPassBegin(VkCommandBuffer givenCommandBuffer, uint32_t i, Pass pass);
+	void RecordPassEnd(VkCommandBuffer givenCommandBuffer, uint32_t i, Pass pass);
+
+	// Call last thing inside the frame's rendering.
+	void RecordDraw(VkCommandBuffer givenCommandBuffer, uint32_t i);
+
+private:
+	// Must match the vertex inputs of sprite.vert.
+	struct HudVertex
+	{
+		float x, y;
+		float u, v;
+		uint32_t color;
+	};
+
+	void CreateGlyphAtlas();
+	void CreateVertexBuffers();
+	void CreateDescriptorSet();
+	void CreatePipeline();
+	void CreateQueryPool();
+	void CollectTimings(uint32_t i);
+	void RefreshText();
+	void BuildQuads();
+	void AddQuad(float x, float y, float width, float height, float u0, float v0, float u1, float v1, uint32_t color);
+	void AddRectangle(float x, float y, float width, float height, uint32_t color);
+	void AddText(float x, float y, const char* text, uint32_t color);
+
+	Application* app;
+	bool visible;
+	uint32_t currentFrame;
+
+	VkImage glyphImage;
+	VkDeviceMemory glyphImageMemory;
+	VkImageView glyphImageView;
+	VkSampler glyphSampler;
+	VkDescriptorSetLayout descriptorSetLayout;
+	VkDescriptorPool descriptorPool;
+	VkDescriptorSet descriptorSet;
+	VkPipelineLayout pipelineLayout;
+	uint32_t pipelineId;		// From the application's pipeline cache.
+
+	std::vector<VkBuffer> vertexBuffers;
+	std::vector<VkDeviceMemory> vertexBuffersMemory;
+	std::vector<HudVertex*> mappedVertices;
+	uint32_t quadCount;
+
+	// Per frame in flight, a timestamp for the start of the frame and then one either side of each pass.  The frame's
+	// GPU time runs up to the start of our draw.
+	VkQueryPool queryPool;
+	std::vector<bool> timingsPending;
+	bool timestampsSupported;
+	float timestampPeriod;
+
+	// One entry per recent frame, oldest first from historyNext.
+	std::vector<float> frameHistoryArray;
+	std::vector<float> gpuHistoryArray;
+	uint32_t historyNext;
+	float lastGpuMilliseconds;
+
+	// Averaged over a short interval so the numbers are readable, then formatted once into these lines.
+	uint32_t intervalFrameCount;
+	uint32_t intervalTimedFrameCount;
+	double intervalFrameMilliseconds;
+	double intervalGpuMilliseconds;
+	double intervalPassMilliseconds[PASS_COUNT];
+	uint32_t intervalPassFrameCount[PASS_COUNT];
+	double intervalHudCpuMilliseconds;
+	std::vector<std::string> textLinesArray;
+
+	// For the summary logged at the end.
+	uint64_t totalFrameCount;
+	uint64_t totalTimedFrameCount;
+	double totalHudCpuMilliseconds;
+	double totalHudGpuMilliseconds;
+};
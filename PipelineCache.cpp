@@ -0,0 +1,430 @@
+#include "PipelineCache.h"
+#include "ThreadPool.h"
+#include <cstring>
+
+static uint64_t HashBytes(const void* data, size_t size)
+{
+	// FNV-1a.  The inputs are small and this only runs when a pipeline is requested, not per draw.
+	const uint8_t* bytes = static_cast<const uint8_t*>(data);
+	uint64_t hash = 0xCBF29CE484222325ull;
+	for (size_t j = 0; j < size; j++)
+	{
+		hash ^= bytes[j];
+		hash *= 0x100000001B3ull;
+	}
+
+	return hash;
+}
+
+PipelineState::PipelineState()
+{
+	::memset(this, 0, sizeof(PipelineState));
+
+	this->topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+	this->polygonMode = VK_POLYGON_MODE_FILL;
+	this->cullMode = VK_CULL_MODE_BACK_BIT;
+	this->frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+	this->blendEnable = VK_FALSE;
+	this->srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
+	this->dstColorBlendFactor = VK_BLEND_FACTOR_ZERO;
+	this->colorBlendOp = VK_BLEND_OP_ADD;
+	this->srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+	this->dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+	this->alphaBlendOp = VK_BLEND_OP_ADD;
+	this->colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+	this->depthTestEnable = VK_FALSE;
+	this->depthWriteEnable = VK_FALSE;
+	this->depthCompareOp = VK_COMPARE_OP_ALWAYS;
+	this->colorFormat = VK_FORMAT_UNDEFINED;
+	this->depthFormat = VK_FORMAT_UNDEFINED;
+	this->samples = VK_SAMPLE_COUNT_1_BIT;
+}
+
+void PipelineState::AddVertexBinding(const VkVertexInputBindingDescription& binding)
+{
+	if (this->bindingCount >= MAX_VERTEX_BINDINGS)
+		throw new std::runtime_error("Too many vertex bindings in pipeline state!");
+
+	this->bindings[this->bindingCount++] = binding;
+}
+
+void PipelineState::AddVertexAttribute(const VkVertexInputAttributeDescription& attribute)
+{
+	if (this->attributeCount >= MAX_VERTEX_ATTRIBUTES)
+		throw new std::runtime_error("Too many vertex attributes in pipeline state!");
+
+	this->attributes[this->attributeCount++] = attribute;
+}
+
+void PipelineState::SetAlphaBlend()
+{
+	this->blendEnable = VK_TRUE;
+	this->srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+	this->dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+	this->colorBlendOp = VK_BLEND_OP_ADD;
+	this->srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+	this->dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+	this->alphaBlendOp = VK_BLEND_OP_ADD;
+}
+
+void PipelineState::SetAdditiveBlend()
+{
+	this->SetAlphaBlend();
+	this->dstColorBlendFactor = VK_BLEND_FACTOR_ONE;
+}
+
+uint64_t PipelineState::Hash() const
+{
+	return HashBytes(this, sizeof(PipelineState));
+}
+
+bool PipelineState::operator==(const PipelineState& state) const
+{
+	return 0 == ::memcmp(this, &state, sizeof(PipelineState));
+}
+
+PipelineCache::PipelineCache(Application* app)
+{
+	this->app = app;
+	this->driverCache = VK_NULL_HANDLE;
+	this->statistics = Statistics{};
+}
+
+/*virtual*/ PipelineCache::~PipelineCache()
+{
+}
+
+void PipelineCache::Create()
+{
+	// The driver's own cache doesn't save us from calling vkCreateGraphicsPipelines, but it does let the driver skip
+	// work it's already done for a shader, e.g. when two of our states differ only in blending.
+	VkPipelineCacheCreateInfo cacheInfo{};
+	cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+
+	if (VK_SUCCESS != vkCreatePipelineCache(this->app->logicalDevice, &cacheInfo, nullptr, &this->driverCache))
+		throw new std::runtime_error("Failed to create pipeline cache!");
+}
+
+void PipelineCache::Destroy()
+{
+	VkDevice logicalDevice = this->app->logicalDevice;
+
+	Statistics stats = this->GetStatistics();
+	std::cout << "Pipeline cache: " << stats.requests << " requests, " << this->entriesArray.size() << " distinct states, " << stats.compiles << " compiled in " << stats.compileMilliseconds << " ms" << std::endl;
+
+	for (Entry& entry : this->entriesArray)
+		vkDestroyPipeline(logicalDevice, entry.pipeline, nullptr);
+
+	for (Shader& shader : this->shadersArray)
+		vkDestroyShaderModule(logicalDevice, shader.module, nullptr);
+
+	vkDestroyPipelineCache(logicalDevice, this->driverCache, nullptr);
+
+	this->entriesArray.clear();
+	this->entryMap.clear();
+	this->shadersArray.clear();
+}
+
+uint32_t PipelineCache::AddShader(const std::vector<char>& code)
+{
+	uint64_t hash = HashBytes(code.data(), code.size());
+
+	std::lock_guard<std::mutex> lock(this->mutex);
+
+	for (uint32_t j = 0; j < (uint32_t)this->shadersArray.size(); j++)
+		if (this->shadersArray[j].hash == hash && this->shadersArray[j].code == code)
+			return j;
+
+	Shader shader;
+	shader.hash = hash;
+	shader.code = code;
+	shader.module = this->app->CreateShaderModule(code);
+	this->shadersArray.push_back(std::move(shader));
+
+	return (uint32_t)this->shadersArray.size() - 1;
+}
+
+uint32_t PipelineCache::Request(const PipelineState& state)
+{
+	uint64_t hash = state.Hash();
+
+	std::lock_guard<std::mutex> lock(this->mutex);
+
+	this->statistics.requests++;
+
+	auto range = this->entryMap.equal_range(hash);
+	for (auto iter = range.first; iter != range.second; iter++)
+	{
+		if (this->entriesArray[iter->second].state == state)
+		{
+			this->statistics.hits++;
+			return iter->second;
+		}
+	}
+
+	if (state.vertexShader >= this->shadersArray.size() || (state.fragmentShader != PipelineState::NO_SHADER && state.fragmentShader >= this->shadersArray.size()))
+		throw new std::runtime_error("Pipeline state refers to an unknown shader!");
+
+	Entry entry;
+	entry.state = state;
+	entry.hash = hash;
+	entry.status = ENTRY_PENDING;
+	entry.pipeline = VK_NULL_HANDLE;
+	this->entriesArray.push_back(entry);
+
+	uint32_t pipelineId = (uint32_t)this->entriesArray.size() - 1;
+	this->entryMap.insert(std::make_pair(hash, pipelineId));
+	return pipelineId;
+}
+
+VkPipeline PipelineCache::GetPipeline(uint32_t pipelineId)
+{
+	{
+		std::unique_lock<std::mutex> lock(this->mutex);
+
+		// If somebody else is compiling this one, wait for theirs rather than compiling it twice.
+		this->compiledCondition.wait(lock, [this, pipelineId]() { return this->entriesArray[pipelineId].status != ENTRY_COMPILING; });
+
+		if (this->entriesArray[pipelineId].status == ENTRY_READY)
+			return this->entriesArray[pipelineId].pipeline;
+
+		this->entriesArray[pipelineId].status = ENTRY_COMPILING;
+	}
+
+	return this->CompileEntry(pipelineId);
+}
+
+void PipelineCache::Prewarm(ThreadPool* threadPool)
+{
+	std::vector<uint32_t> pendingIdsArray;
+
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+
+		for (uint32_t pipelineId = 0; pipelineId < (uint32_t)this->entriesArray.size(); pipelineId++)
+		{
+			if (this->entriesArray[pipelineId].status == ENTRY_PENDING)
+			{
+				this->entriesArray[pipelineId].status = ENTRY_COMPILING;
+				pendingIdsArray.push_back(pipelineId);
+			}
+		}
+	}
+
+	auto compileRange = [this, &pendingIdsArray](size_t begin, size_t end)
+	{
+		for (size_t j = begin; j < end; j++)
+			this->CompileEntry(pendingIdsArray[j]);
+	};
+
+	if (threadPool)
+		threadPool->ParallelFor(pendingIdsArray.size(), 1, compileRange);
+	else
+		compileRange(0, pendingIdsArray.size());
+}
+
+PipelineCache::Statistics PipelineCache::GetStatistics()
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+	return this->statistics;
+}
+
+VkPipeline PipelineCache::CompileEntry(uint32_t pipelineId)
+{
+	// The caller has marked the entry as compiling, so nobody else touches its pipeline until we mark it ready.
+	PipelineState state;
+	VkShaderModule vertShaderModule = VK_NULL_HANDLE;
+	VkShaderModule fragShaderModule = VK_NULL_HANDLE;
+
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		state = this->entriesArray[pipelineId].state;
+		vertShaderModule = this->shadersArray[state.vertexShader].module;
+		if (state.fragmentShader != PipelineState::NO_SHADER)
+			fragShaderModule = this->shadersArray[state.fragmentShader].module;
+	}
+
+	VkPipeline pipeline = VK_NULL_HANDLE;
+	auto startTime = std::chrono::high_resolution_clock::now();
+
+	try
+	{
+		pipeline = this->Compile(state, vertShaderModule, fragShaderModule);
+	}
+	catch (...)
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		this->entriesArray[pipelineId].status = ENTRY_PENDING;
+		this->compiledCondition.notify_all();
+		throw;
+	}
+
+	double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		this->entriesArray[pipelineId].pipeline = pipeline;
+		this->entriesArray[pipelineId].status = ENTRY_READY;
+		this->statistics.compiles++;
+		this->statistics.compileMilliseconds += milliseconds;
+	}
+
+	this->compiledCondition.notify_all();
+	return pipeline;
+}
+
+VkPipeline PipelineCache::Compile(const PipelineState& state, VkShaderModule vertShaderModule, VkShaderModule fragShaderModule)
+{
+	VkPipelineShaderStageCreateInfo shaderStages[2]{};
+
+	shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+	shaderStages[0].module = vertShaderModule;
+	shaderStages[0].pName = "main";
+
+	shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+	shaderStages[1].module = fragShaderModule;
+	shaderStages[1].pName = "main";
+
+	// Each constant is 32 bits, so the values array is the specialization data as it is.  Constants a stage doesn't
+	// declare are ignored by it.
+	VkSpecializationMapEntry mapEntries[PipelineState::MAX_SPECIALIZATION_CONSTANTS]{};
+	for (uint32_t j = 0; j < state.constantCount; j++)
+	{
+		mapEntries[j].constantID = state.constantIds[j];
+		mapEntries[j].offset = j * sizeof(uint32_t);
+		mapEntries[j].size = sizeof(uint32_t);
+	}
+
+	VkSpecializationInfo specializationInfo{};
+	specializationInfo.mapEntryCount = state.constantCount;
+	specializationInfo.pMapEntries = mapEntries;
+	specializationInfo.dataSize = state.constantCount * sizeof(uint32_t);
+	specializationInfo.pData = state.constantValues;
+
+	if (state.constantCount > 0)
+	{
+		shaderStages[0].pSpecializationInfo = &specializationInfo;
+		shaderStages[1].pSpecializationInfo = &specializationInfo;
+	}
+
+	VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
+	vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+	vertexInputInfo.vertexBindingDescriptionCount = state.bindingCount;
+	vertexInputInfo.pVertexBindingDescriptions = state.bindings;
+	vertexInputInfo.vertexAttributeDescriptionCount = state.attributeCount;
+	vertexInputInfo.pVertexAttributeDescriptions = state.attributes;
+
+	VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
+	inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+	inputAssembly.topology = state.topology;
+	inputAssembly.primitiveRestartEnable = VK_FALSE;
+
+	std::vector<VkDynamicState> dynamicStatesArray =
+	{
+			VK_DYNAMIC_STATE_VIEWPORT,
+			VK_DYNAMIC_STATE_SCISSOR
+	};
+
+	VkPipelineDynamicStateCreateInfo dynamicState{};
+	dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+	dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStatesArray.size());
+	dynamicState.pDynamicStates = dynamicStatesArray.data();
+
+	VkPipelineViewportStateCreateInfo viewportState{};
+	viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+	viewportState.viewportCount = 1;
+	viewportState.scissorCount = 1;
+
+	VkPipelineRasterizationStateCreateInfo rasterizer{};
+	rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+	rasterizer.depthClampEnable = VK_FALSE;
+	rasterizer.rasterizerDiscardEnable = VK_FALSE;
+	rasterizer.polygonMode = state.polygonMode;
+	rasterizer.lineWidth = 1.0f;
+	rasterizer.cullMode = state.cullMode;
+	rasterizer.frontFace = state.frontFace;
+	rasterizer.depthBiasEnable = VK_FALSE;
+
+	VkPipelineMultisampleStateCreateInfo multisampling{};
+	multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+	multisampling.sampleShadingEnable = VK_FALSE;
+	multisampling.rasterizationSamples = state.samples;
+
+	VkPipelineDepthStencilStateCreateInfo depthStencil{};
+	depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+	depthStencil.depthTestEnable = state.depthTestEnable;
+	depthStencil.depthWriteEnable = state.depthWriteEnable;
+	depthStencil.depthCompareOp = state.depthCompareOp;
+	depthStencil.depthBoundsTestEnable = VK_FALSE;
+	depthStencil.stencilTestEnable = VK_FALSE;
+
+	VkPipelineColorBlendAttachmentState colorBlendAttachment{};
+	colorBlendAttachment.colorWriteMask = state.colorWriteMask;
+	colorBlendAttachment.blendEnable = state.blendEnable;
+	colorBlendAttachment.srcColorBlendFactor = state.srcColorBlendFactor;
+	colorBlendAttachment.dstColorBlendFactor = state.dstColorBlendFactor;
+	colorBlendAttachment.colorBlendOp = state.colorBlendOp;
+	colorBlendAttachment.srcAlphaBlendFactor = state.srcAlphaBlendFactor;
+	colorBlendAttachment.dstAlphaBlendFactor = state.dstAlphaBlendFactor;
+	colorBlendAttachment.alphaBlendOp = state.alphaBlendOp;
+
+	VkPipelineColorBlendStateCreateInfo colorBlending{};
+	colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+	colorBlending.logicOpEnable = VK_FALSE;
+	colorBlending.attachmentCount = (state.colorFormat != VK_FORMAT_UNDEFINED) ? 1 : 0;
+	colorBlending.pAttachments = &colorBlendAttachment;
+
+	VkGraphicsPipelineCreateInfo pipelineInfo{};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+	pipelineInfo.stageCount = (fragShaderModule != VK_NULL_HANDLE) ? 2 : 1;
+	pipelineInfo.pStages = shaderStages;
+	pipelineInfo.pVertexInputState = &vertexInputInfo;
+	pipelineInfo.pInputAssemblyState = &inputAssembly;
+	pipelineInfo.pViewportState = &viewportState;
+	pipelineInfo.pRasterizationState = &rasterizer;
+	pipelineInfo.pMultisampleState = &multisampling;
+	pipelineInfo.pDepthStencilState = (state.depthFormat != VK_FORMAT_UNDEFINED) ? &depthStencil : nullptr;
+	pipelineInfo.pColorBlendState = &colorBlending;
+	pipelineInfo.pDynamicState = &dynamicState;
+	pipelineInfo.layout = state.layout;
+	pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+	pipelineInfo.basePipelineIndex = -1;
+
+	// A render pass given with the state is used as it is.  Otherwise, with dynamic rendering the formats are all the
+	// pipeline needs to know, and without it we need a render pass that's compatible with them, and the only one we've
+	// got is the swap-chain's.
+	VkPipelineRenderingCreateInfoKHR pipelineRenderingInfo{};
+	if (state.renderPass != VK_NULL_HANDLE)
+	{
+		pipelineInfo.renderPass = state.renderPass;
+		pipelineInfo.subpass = 0;
+	}
+	else if (this->app->dynamicRenderingEnabled)
+	{
+		pipelineRenderingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR;
+		pipelineRenderingInfo.colorAttachmentCount = (state.colorFormat != VK_FORMAT_UNDEFINED) ? 1 : 0;
+		pipelineRenderingInfo.pColorAttachmentFormats = &state.colorFormat;
+		pipelineRenderingInfo.depthAttachmentFormat = state.depthFormat;
+		pipelineRenderingInfo.stencilAttachmentFormat = VK_FORMAT_UNDEFINED;
+
+		pipelineInfo.pNext = &pipelineRenderingInfo;
+		pipelineInfo.renderPass = VK_NULL_HANDLE;
+		pipelineInfo.subpass = 0;
+	}
+	else
+	{
+		if (state.colorFormat != this->app->swapChainImageFormat || state.depthFormat != VK_FORMAT_UNDEFINED || state.samples != VK_SAMPLE_COUNT_1_BIT)
+			throw new std::runtime_error("No render pass compatible with pipeline state!");
+
+		pipelineInfo.renderPass = this->app->renderPass;
+		pipelineInfo.subpass = 0;
+	}
+
+	VkPipeline pipeline = VK_NULL_HANDLE;
+	if (VK_SUCCESS != vkCreateGraphicsPipelines(this->app->logicalDevice, this->driverCache, 1, &pipelineInfo, nullptr, &pipeline))
+		throw new std::runtime_error("Failed to create graphics pipeline!");
+
+	return pipeline;
+}
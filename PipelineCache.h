@@ -0,0 +1,133 @@
+#pragma once
+
+#include "Application.h"
+#include <unordered_map>
+#include <mutex>
+#include <condition_variable>
+
+// Everything that goes into a graphics pipeline, other than the dynamic viewport and scissor, as one flat value.
+// Everything after the two handles is 32 bits, so there's no padding, and the bytes can be hashed and compared as they
+// are.  The render target is described by its formats rather than by a render pass, since any compatible render pass will
+// do, unless it's a render pass of somebody's own.  The constructor gives the common defaults: triangle lists, back-face
+// culling, no blending and no depth.  A depth-only pipeline has no fragment shader and no color format.
+struct PipelineState
+{
+	enum
+	{
+		MAX_VERTEX_BINDINGS = 2,
+		MAX_VERTEX_ATTRIBUTES = 8,
+		MAX_SPECIALIZATION_CONSTANTS = 8,
+		NO_SHADER = 0xFFFFFFFF
+	};
+
+	PipelineState();
+
+	void AddVertexBinding(const VkVertexInputBindingDescription& binding);
+	void AddVertexAttribute(const VkVertexInputAttributeDescription& attribute);
+	void SetAlphaBlend();
+	void SetAdditiveBlend();
+
+	uint64_t Hash() const;
+	bool operator==(const PipelineState& state) const;
+
+	VkPipelineLayout layout;
+	VkRenderPass renderPass;	// Null for dynamic rendering or the swap-chain's render pass, as the formats say.
+	uint32_t vertexShader;		// From PipelineCache::AddShader.
+	uint32_t fragmentShader;	// Or NO_SHADER.
+	uint32_t bindingCount;
+	uint32_t attributeCount;
+	VkVertexInputBindingDescription bindings[MAX_VERTEX_BINDINGS];
+	VkVertexInputAttributeDescription attributes[MAX_VERTEX_ATTRIBUTES];
+	VkPrimitiveTopology topology;
+	VkPolygonMode polygonMode;
+	VkCullModeFlags cullMode;
+	VkFrontFace frontFace;
+	VkBool32 blendEnable;
+	VkBlendFactor srcColorBlendFactor;
+	VkBlendFactor dstColorBlendFactor;
+	VkBlendOp colorBlendOp;
+	VkBlendFactor srcAlphaBlendFactor;
+	VkBlendFactor dstAlphaBlendFactor;
+	VkBlendOp alphaBlendOp;
+	VkColorComponentFlags colorWriteMask;
+	VkBool32 depthTestEnable;
+	VkBool32 depthWriteEnable;
+	VkCompareOp depthCompareOp;
+	VkFormat colorFormat;
+	VkFormat depthFormat;
+	VkSampleCountFlagBits samples;
+	uint32_t constantCount;		// Specialization constants, given to both stages; see ShaderVariant.h.
+	uint32_t constantIds[MAX_SPECIALIZATION_CONSTANTS];
+	uint32_t constantValues[MAX_SPECIALIZATION_CONSTANTS];
+	uint32_t reserved;			// Keeps the size a multiple of 8, so there's no padding at the end either.
+};
+
+// Hands out one VkPipeline per distinct PipelineState, however many times and from however many places it's asked for.
+// Requesting a state only gives it an id; the pipeline itself gets compiled the first time somebody needs it, or ahead
+// of time, all at once and across the thread pool, by Prewarm.  The ids are small and handed out in order, so they make
+// good sort keys for anything that wants to order its draws to cut down on pipeline binds.  The cache owns the shader
+// modules and the pipelines; it doesn't own the layouts.
+class PipelineCache
+{
+public:
+	struct Statistics
+	{
+		uint32_t requests;
+		uint32_t hits;
+		uint32_t compiles;
+		double compileMilliseconds;
+	};
+
+	PipelineCache(Application* app);
+	virtual ~PipelineCache();
+
+	void Create();
+	void Destroy();
+
+	// Identical SPIR-V gets the same id back, and only one module.
+	uint32_t AddShader(const std::vector<char>& code);
+
+	uint32_t Request(const PipelineState& state);
+	VkPipeline GetPipeline(uint32_t pipelineId);
+	VkPipeline GetPipeline(const PipelineState& state) { return this->GetPipeline(this->Request(state)); }
+
+	// Compiles everything requested so far that isn't compiled yet.  The pool can be null.
+	void Prewarm(ThreadPool* threadPool);
+
+	Statistics GetStatistics();
+
+private:
+	enum EntryStatus
+	{
+		ENTRY_PENDING,
+		ENTRY_COMPILING,
+		ENTRY_READY
+	};
+
+	struct Entry
+	{
+		PipelineState state;
+		uint64_t hash;
+		EntryStatus status;
+		VkPipeline pipeline;
+	};
+
+	struct Shader
+	{
+		uint64_t hash;
+		std::vector<char> code;
+		VkShaderModule module;
+	};
+
+	VkPipeline Compile(const PipelineState& state, VkShaderModule vertShaderModule, VkShaderModule fragShaderModule);
+	VkPipeline CompileEntry(uint32_t pipelineId);
+
+	Application* app;
+	VkPipelineCache driverCache;
+	std::vector<Shader> shadersArray;
+	std::vector<Entry> entriesArray;
+	std::unordered_multimap<uint64_t, uint32_t> entryMap;
+	std::mutex mutex;
+	std::condition_variable compiledCondition;
+	Statistics statistics;
+};
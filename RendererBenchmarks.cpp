@@ -0,0 +1,341 @@
+#include "Benchmarks.h"
+#include "Application.h"
+#include "MemoryTracker.h"
+#include "SceneRenderer.h"
+#include <atomic>
+#include <functional>
+#include <iomanip>
+#include <map>
+#include <new>
+#include <sstream>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <limits>
+#if defined(_MSC_VER)
+#include <malloc.h>
+#endif
+
+const double RENDERER_BENCHMARK_MIN_MILLISECONDS = 200.0;	// Repeat each batch of operations for at least this long...
+const int RENDERER_BENCHMARK_MIN_REPETITIONS = 5;			// ...and at least this many times, then take the best.
+const double RENDERER_BENCHMARK_TOLERANCE = 0.25;			// How much slower than the baseline counts as a regression.
+const double RENDERER_BENCHMARK_ALLOCATION_TOLERANCE = 0.5;	// Allocations per operation are exact, give or take rounding.
+
+// While the renderer benchmarks run, every heap allocation in the process is counted, so they can report allocations
+// per operation.  The rest of the time, which is always unless we're run with --benchmark-renderer, the replacement
+// operators cost one relaxed load of the flag on top of the allocation.
+static std::atomic<bool> heapAllocationCounting(false);
+static std::atomic<uint64_t> heapAllocationCount(0);
+
+static void CountHeapAllocation()
+{
+	if (heapAllocationCounting.load(std::memory_order_relaxed))
+		heapAllocationCount.fetch_add(1, std::memory_order_relaxed);
+}
+
+void* operator new(size_t size)
+{
+	CountHeapAllocation();
+	if (void* memory = std::malloc(size ? size : 1))
+		return memory;
+
+	throw std::bad_alloc();
+}
+
+void* operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+// Over-aligned types (alignas bigger than the default, like SIMD batches) come through these instead.
+void* operator new(size_t size, std::align_val_t alignment)
+{
+	CountHeapAllocation();
+	size_t alignmentBytes = static_cast<size_t>(alignment);
+#if defined(_MSC_VER)
+	void* memory = _aligned_malloc(size ? size : 1, alignmentBytes);
+#else
+	void* memory = std::aligned_alloc(alignmentBytes, ((size ? size : 1) + alignmentBytes - 1) / alignmentBytes * alignmentBytes);
+#endif
+	if (memory)
+		return memory;
+
+	throw std::bad_alloc();
+}
+
+void* operator new[](size_t size, std::align_val_t alignment)
+{
+	return operator new(size, alignment);
+}
+
+void operator delete(void* memory) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete[](void* memory) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete[](void* memory, size_t) noexcept
+{
+	std::free(memory);
+}
+
+// What the aligned news hand out has to go back the same way, which on Windows isn't free.
+void operator delete(void* memory, std::align_val_t) noexcept
+{
+#if defined(_MSC_VER)
+	_aligned_free(memory);
+#else
+	std::free(memory);
+#endif
+}
+
+void operator delete[](void* memory, std::align_val_t alignment) noexcept
+{
+	operator delete(memory, alignment);
+}
+
+void operator delete(void* memory, size_t, std::align_val_t alignment) noexcept
+{
+	operator delete(memory, alignment);
+}
+
+void operator delete[](void* memory, size_t, std::align_val_t alignment) noexcept
+{
+	operator delete(memory, alignment);
+}
+
+struct RendererMeasurement
+{
+	double nanosecondsPerOperation;
+	double allocationsPerOperation;
+};
+
+// Best-of-N time of a batch of operations, after a warm-up batch, divided out per operation.
+static RendererMeasurement MeasureOperation(uint32_t batchSize, const std::function<void()>& operation)
+{
+	for (uint32_t j = 0; j < batchSize; j++)
+		operation();
+
+	double bestMilliseconds = std::numeric_limits<double>::max();
+	double totalMilliseconds = 0.0;
+	uint64_t allocationCount = 0;
+	int repetitions = 0;
+
+	while (repetitions < RENDERER_BENCHMARK_MIN_REPETITIONS || totalMilliseconds < RENDERER_BENCHMARK_MIN_MILLISECONDS)
+	{
+		uint64_t startAllocationCount = heapAllocationCount.load(std::memory_order_relaxed);
+		auto startTime = std::chrono::high_resolution_clock::now();
+
+		for (uint32_t j = 0; j < batchSize; j++)
+			operation();
+
+		auto endTime = std::chrono::high_resolution_clock::now();
+		allocationCount += heapAllocationCount.load(std::memory_order_relaxed) - startAllocationCount;
+
+		double milliseconds = std::chrono::duration<double, std::milli>(endTime - startTime).count();
+		bestMilliseconds = std::min(bestMilliseconds, milliseconds);
+		totalMilliseconds += milliseconds;
+		repetitions++;
+	}
+
+	RendererMeasurement measurement;
+	measurement.nanosecondsPerOperation = 1e6 * bestMilliseconds / double(batchSize);
+	measurement.allocationsPerOperation = double(allocationCount) / double(uint64_t(repetitions) * batchSize);
+	return measurement;
+}
+
+static const char* RENDERER_BASELINE_DEVICE_PREFIX = "# device: ";
+
+// Times only mean anything on the device they were measured on, so the baseline says which that was.
+struct RendererBaseline
+{
+	std::string deviceName;
+	std::map<std::string, RendererMeasurement> measurementsMap;
+};
+
+// One "name nanoseconds allocations" line per benchmark, where either figure may be "-" for none.  Lines starting with
+// '#' are comments, but for the one naming the device.
+static RendererBaseline ReadBaseline(const std::string& baselinePath)
+{
+	RendererBaseline baseline;
+	std::ifstream file(baselinePath);
+
+	auto parseFigure = [](const std::string& text) { return (text == "-") ? std::numeric_limits<double>::quiet_NaN() : std::strtod(text.c_str(), nullptr); };
+
+	std::string line;
+	while (std::getline(file, line))
+	{
+		if (!line.empty() && line.back() == '\r')
+			line.pop_back();
+
+		if (line.compare(0, ::strlen(RENDERER_BASELINE_DEVICE_PREFIX), RENDERER_BASELINE_DEVICE_PREFIX) == 0)
+		{
+			baseline.deviceName = line.substr(::strlen(RENDERER_BASELINE_DEVICE_PREFIX));
+			continue;
+		}
+
+		if (line.empty() || line[0] == '#')
+			continue;
+
+		std::istringstream lineStream(line);
+		std::string name, nanoseconds, allocations;
+		if (lineStream >> name >> nanoseconds >> allocations)
+		{
+			RendererMeasurement measurement;
+			measurement.nanosecondsPerOperation = parseFigure(nanoseconds);
+			measurement.allocationsPerOperation = parseFigure(allocations);
+			baseline.measurementsMap[name] = measurement;
+		}
+	}
+
+	return baseline;
+}
+
+static void WriteBaseline(const std::string& baselinePath, const std::string& deviceName, const std::vector<std::pair<std::string, RendererMeasurement>>& resultsArray)
+{
+	std::ofstream file(baselinePath, std::ios::out | std::ios::trunc);
+	if (!file.is_open())
+		throw new std::runtime_error("Failed to write benchmark baseline!");
+
+	file << "# Written by VulkanTutorial --benchmark-renderer --update-baseline: name, nanoseconds per op, allocations per op.\n";
+	file << RENDERER_BASELINE_DEVICE_PREFIX << deviceName << '\n';
+	for (const auto& result : resultsArray)
+		file << result.first << ' ' << result.second.nanosecondsPerOperation << ' ' << result.second.allocationsPerOperation << '\n';
+}
+
+int RunRendererBenchmarks(std::ostream& stream, const std::string& baselinePath, bool updateBaseline)
+{
+	// A real device is needed for these, though any will do.  A software one like lavapipe gives the most repeatable
+	// numbers, being free of GPU clocks and drivers' background threads: VULKAN_TUTORIAL_DEVICE=llvmpipe picks it.
+	Application app;
+	app.InitWindow();
+	app.InitVulkan();
+	vkDeviceWaitIdle(app.logicalDevice);
+
+	heapAllocationCounting.store(true, std::memory_order_relaxed);
+
+	std::vector<std::pair<std::string, RendererMeasurement>> resultsArray;
+	auto run = [&](const char* name, uint32_t batchSize, const std::function<void()>& operation)
+	{
+		resultsArray.push_back(std::make_pair(std::string(name), MeasureOperation(batchSize, operation)));
+	};
+
+	run("UpdateUniformBuffer", 1000, [&]() { app.UpdateUniformBuffer(0); });
+
+	// These recordings are never submitted, so they're made with no scene uploads pending (recording them would use them
+	// up), and the real ones are put back after, for the next frame to upload.
+	std::vector<VkBufferCopy> savedPendingCopies;
+	if (app.sceneRenderer)
+	{
+		savedPendingCopies = app.sceneRenderer->GetPendingCopies(0);
+		app.sceneRenderer->SetPendingCopies(0, {});
+	}
+
+	run("RecordCommandBuffer", 1000, [&]()
+	{
+		vkResetCommandBuffer(app.commandBuffer[0], 0);
+		app.RecordCommandBuffer(app.commandBuffer[0], 0, 0);
+	});
+
+	if (app.sceneRenderer)
+		app.sceneRenderer->SetPendingCopies(0, savedPendingCopies);
+
+	run("WriteDescriptorSet", 1000, [&]() { app.WriteDescriptorSet(0); });
+
+	volatile uint32_t memoryType = 0;
+	run("FindMemoryType", 100000, [&]() { memoryType = app.FindMemoryType(0xFFFFFFFF, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT); });
+
+	// A 64 KB vertex buffer, staged and uploaded, then thrown away again.
+	std::vector<uint8_t> uploadData(64 * 1024, 0x5A);
+	run("CreateGeneralBuffer64K", 20, [&]()
+	{
+		VkBuffer buffer = VK_NULL_HANDLE;
+		VkDeviceMemory bufferMemory = nullptr;
+		app.CreateGeneralBuffer(uploadData.data(), uploadData.size(), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, buffer, bufferMemory);
+		vkDestroyBuffer(app.logicalDevice, buffer, nullptr);
+		app.memoryTracker->Free(bufferMemory);
+	});
+
+	// Whole frames, so this includes waiting on the device and on presentation, but it's the CPU time around them that
+	// moves when the render loop gets slower.
+	run("DrawFrame", 20, [&]()
+	{
+		glfwPollEvents();
+		app.DrawFrame();
+	});
+
+	heapAllocationCounting.store(false, std::memory_order_relaxed);
+
+	VkPhysicalDeviceProperties properties{};
+	vkGetPhysicalDeviceProperties(app.physicalDevice, &properties);
+	std::string deviceName = properties.deviceName;
+
+	vkDeviceWaitIdle(app.logicalDevice);
+	app.Cleanup();
+
+	// Compare against the baseline, if there is one.  Allocations are the same anywhere, but times are only compared
+	// when the baseline was measured on this very device.
+	RendererBaseline baselineFile = ReadBaseline(baselinePath);
+	const std::map<std::string, RendererMeasurement>& baselineMap = baselineFile.measurementsMap;
+	bool timesComparable = (baselineFile.deviceName == deviceName);
+	int regressionCount = 0;
+	std::ios_base::fmtflags flags = stream.flags();
+	std::streamsize precision = stream.precision();
+
+	stream << "Renderer hot paths on " << deviceName << " (baseline " << baselinePath << (baselineMap.empty() ? ", not found" : "") << "):\n";
+	if (!baselineMap.empty() && !timesComparable)
+		stream << "\tThe baseline's times are from " << (baselineFile.deviceName.empty() ? "no device" : baselineFile.deviceName) << ", so only allocations are compared.\n";
+
+	for (const auto& result : resultsArray)
+	{
+		const RendererMeasurement& measurement = result.second;
+		stream << '\t' << std::setw(24) << std::left << result.first << std::right
+			<< std::setw(12) << std::fixed << std::setprecision(1) << measurement.nanosecondsPerOperation << " ns/op"
+			<< std::setw(8) << std::setprecision(2) << measurement.allocationsPerOperation << " allocs/op";
+
+		auto iter = baselineMap.find(result.first);
+		if (iter != baselineMap.end())
+		{
+			// A NaN (a "-" in the file) never compares greater, so a figure the baseline doesn't have never regresses.
+			const RendererMeasurement& baseline = iter->second;
+			bool timed = timesComparable && !std::isnan(baseline.nanosecondsPerOperation);
+			bool slower = timed && measurement.nanosecondsPerOperation > baseline.nanosecondsPerOperation * (1.0 + RENDERER_BENCHMARK_TOLERANCE);
+			bool allocating = measurement.allocationsPerOperation > baseline.allocationsPerOperation + RENDERER_BENCHMARK_ALLOCATION_TOLERANCE;
+
+			if (timed)
+				stream << std::setw(8) << std::setprecision(2) << measurement.nanosecondsPerOperation / baseline.nanosecondsPerOperation << "x baseline";
+			if (slower || allocating)
+			{
+				stream << "  REGRESSION" << (slower ? " (time)" : "") << (allocating ? " (allocations)" : "");
+				regressionCount++;
+			}
+		}
+
+		stream << '\n';
+	}
+
+	if (updateBaseline)
+	{
+		WriteBaseline(baselinePath, deviceName, resultsArray);
+		stream << "Baseline written to " << baselinePath << '\n';
+		regressionCount = 0;
+	}
+	else if (regressionCount > 0)
+	{
+		stream << regressionCount << " regression(s) against the baseline!\n";
+	}
+
+	stream << std::flush;
+	stream.flags(flags);
+	stream.precision(precision);
+	return (regressionCount > 0) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,254 @@
+#include "SceneGraph.h"
+#include <algorithm>
+#include <stdexcept>
+#include <cstring>
+
+const size_t SCENE_MIN_BATCH_SIZE = 8 * 1024;		// Nodes per thread pool batch when computing local matrices.
+
+// out = a * b, all column-major.  The output must not alias a.
+static inline void MultiplyMatrices(const float* a, const float* b, float* out)
+{
+	for (int column = 0; column < 4; column++)
+		for (int row = 0; row < 4; row++)
+			out[column * 4 + row] =
+				a[0 * 4 + row] * b[column * 4 + 0] +
+				a[1 * 4 + row] * b[column * 4 + 1] +
+				a[2 * 4 + row] * b[column * 4 + 2] +
+				a[3 * 4 + row] * b[column * 4 + 3];
+}
+
+SceneGraph::SceneGraph()
+{
+	this->layoutValid = true;
+	this->statistics = Statistics{};
+}
+
+/*virtual*/ SceneGraph::~SceneGraph()
+{
+}
+
+SceneGraph::NodeId SceneGraph::AddNode(NodeId parent)
+{
+	NodeId node = (NodeId)this->nodeParentsArray.size();
+
+	if (parent != INVALID_NODE && parent >= node)
+		throw new std::invalid_argument("Scene graph parent must be added before its children!");
+
+	uint32_t index = node;		// Appended for now; see Relayout.
+
+	this->nodeParentsArray.push_back(parent);
+	this->nodeIndicesArray.push_back(index);
+	this->nodeDirtyArray.push_back(0);
+	this->indexNodesArray.push_back(node);
+	this->parentIndicesArray.push_back(parent == INVALID_NODE ? INVALID_NODE : this->nodeIndicesArray[parent]);
+	this->subtreeEndsArray.push_back(index + 1);
+	this->localTransforms.Resize(index + 1);
+	this->worldMatricesArray.resize(16 * (size_t)(index + 1), 0.0f);
+
+	this->layoutValid = false;
+	return node;
+}
+
+void SceneGraph::MarkDirty(NodeId node)
+{
+	if (!this->nodeDirtyArray[node])
+	{
+		this->nodeDirtyArray[node] = 1;
+		this->dirtyNodesArray.push_back(node);
+	}
+}
+
+void SceneGraph::SetLocalPosition(NodeId node, float x, float y, float z)
+{
+	this->localTransforms.SetPosition(this->nodeIndicesArray[node], x, y, z);
+	this->MarkDirty(node);
+}
+
+void SceneGraph::SetLocalRotation(NodeId node, float x, float y, float z, float w)
+{
+	this->localTransforms.SetRotation(this->nodeIndicesArray[node], x, y, z, w);
+	this->MarkDirty(node);
+}
+
+void SceneGraph::SetLocalScale(NodeId node, float x, float y, float z)
+{
+	this->localTransforms.SetScale(this->nodeIndicesArray[node], x, y, z);
+	this->MarkDirty(node);
+}
+
+const std::vector<SceneGraph::Range>& SceneGraph::Update(ThreadPool* threadPool)
+{
+	this->changedRangesArray.clear();
+	this->statistics = Statistics{};
+
+	uint32_t nodeCount = this->GetNodeCount();
+
+	if (!this->layoutValid)
+	{
+		// Structural change: everything moves, so everything is recomputed and uploaded.
+		this->Relayout();
+		this->UpdateRange(0, nodeCount, threadPool);
+
+		if (nodeCount > 0)
+			this->changedRangesArray.push_back(Range{ 0, nodeCount });
+
+		this->statistics.relayout = true;
+	}
+	else if (!this->dirtyNodesArray.empty())
+	{
+		// Visit the dirty nodes in layout order.  A dirty node inside a subtree we've just recomputed is already taken
+		// care of, and since subtrees are contiguous, that's simply any index before the end of the last range.
+		this->dirtyIndicesArray.clear();
+		for (NodeId node : this->dirtyNodesArray)
+			this->dirtyIndicesArray.push_back(this->nodeIndicesArray[node]);
+
+		std::sort(this->dirtyIndicesArray.begin(), this->dirtyIndicesArray.end());
+
+		uint32_t coveredEnd = 0;
+		for (uint32_t index : this->dirtyIndicesArray)
+		{
+			if (index < coveredEnd)
+				continue;
+
+			Range range{ index, this->subtreeEndsArray[index] };
+			this->UpdateRange(range.begin, range.end, threadPool);
+			coveredEnd = range.end;
+
+			if (!this->changedRangesArray.empty() && this->changedRangesArray.back().end == range.begin)
+				this->changedRangesArray.back().end = range.end;
+			else
+				this->changedRangesArray.push_back(range);
+		}
+	}
+
+	for (NodeId node : this->dirtyNodesArray)
+		this->nodeDirtyArray[node] = 0;
+
+	this->dirtyNodesArray.clear();
+
+	for (const Range& range : this->changedRangesArray)
+		this->statistics.nodesUpdated += range.end - range.begin;
+
+	this->statistics.rangesChanged = (uint32_t)this->changedRangesArray.size();
+	return this->changedRangesArray;
+}
+
+void SceneGraph::Relayout()
+{
+	uint32_t nodeCount = this->GetNodeCount();
+
+	// Children of each node, in id order, as one flat array with offsets.
+	std::vector<uint32_t> childOffsetsArray(nodeCount + 1, 0);
+	for (NodeId node = 0; node < nodeCount; node++)
+		if (this->nodeParentsArray[node] != INVALID_NODE)
+			childOffsetsArray[this->nodeParentsArray[node] + 1]++;
+
+	for (uint32_t j = 0; j < nodeCount; j++)
+		childOffsetsArray[j + 1] += childOffsetsArray[j];
+
+	std::vector<NodeId> childrenArray(childOffsetsArray[nodeCount]);
+	std::vector<uint32_t> childCursorsArray(childOffsetsArray.begin(), childOffsetsArray.end() - 1);
+	for (NodeId node = 0; node < nodeCount; node++)
+		if (this->nodeParentsArray[node] != INVALID_NODE)
+			childrenArray[childCursorsArray[this->nodeParentsArray[node]]++] = node;
+
+	// Depth-first, pre-order, with an explicit stack since hierarchies can be deep.  Pushing in reverse keeps
+	// siblings in id order.
+	std::vector<NodeId> newIndexNodesArray;
+	newIndexNodesArray.reserve(nodeCount);
+
+	std::vector<NodeId> stack;
+	for (NodeId node = nodeCount; node-- > 0;)
+		if (this->nodeParentsArray[node] == INVALID_NODE)
+			stack.push_back(node);
+
+	while (!stack.empty())
+	{
+		NodeId node = stack.back();
+		stack.pop_back();
+
+		newIndexNodesArray.push_back(node);
+
+		for (uint32_t j = childOffsetsArray[node + 1]; j-- > childOffsetsArray[node];)
+			stack.push_back(childrenArray[j]);
+	}
+
+	// Move the local transforms over to their new places.
+	TransformStore newLocalTransforms;
+	newLocalTransforms.Resize(nodeCount);
+
+	const float* sourceStreams[10] = {
+		this->localTransforms.GetPositionX(), this->localTransforms.GetPositionY(), this->localTransforms.GetPositionZ(),
+		this->localTransforms.GetRotationX(), this->localTransforms.GetRotationY(), this->localTransforms.GetRotationZ(), this->localTransforms.GetRotationW(),
+		this->localTransforms.GetScaleX(), this->localTransforms.GetScaleY(), this->localTransforms.GetScaleZ()
+	};
+	float* targetStreams[10] = {
+		newLocalTransforms.GetPositionX(), newLocalTransforms.GetPositionY(), newLocalTransforms.GetPositionZ(),
+		newLocalTransforms.GetRotationX(), newLocalTransforms.GetRotationY(), newLocalTransforms.GetRotationZ(), newLocalTransforms.GetRotationW(),
+		newLocalTransforms.GetScaleX(), newLocalTransforms.GetScaleY(), newLocalTransforms.GetScaleZ()
+	};
+
+	for (uint32_t newIndex = 0; newIndex < nodeCount; newIndex++)
+	{
+		uint32_t oldIndex = this->nodeIndicesArray[newIndexNodesArray[newIndex]];
+		for (int k = 0; k < 10; k++)
+			targetStreams[k][newIndex] = sourceStreams[k][oldIndex];
+	}
+
+	newLocalTransforms.SetSimdPath(this->localTransforms.GetSimdPath());
+	this->localTransforms = newLocalTransforms;
+
+	this->indexNodesArray = newIndexNodesArray;
+	for (uint32_t index = 0; index < nodeCount; index++)
+		this->nodeIndicesArray[this->indexNodesArray[index]] = index;
+
+	for (uint32_t index = 0; index < nodeCount; index++)
+	{
+		NodeId parent = this->nodeParentsArray[this->indexNodesArray[index]];
+		this->parentIndicesArray[index] = (parent == INVALID_NODE) ? INVALID_NODE : this->nodeIndicesArray[parent];
+	}
+
+	// Children come after their parents, so walking backwards accumulates subtree sizes bottom-up.
+	for (uint32_t index = 0; index < nodeCount; index++)
+		this->subtreeEndsArray[index] = index + 1;
+
+	for (uint32_t index = nodeCount; index-- > 0;)
+	{
+		uint32_t parentIndex = this->parentIndicesArray[index];
+		if (parentIndex != INVALID_NODE)
+			this->subtreeEndsArray[parentIndex] = std::max(this->subtreeEndsArray[parentIndex], this->subtreeEndsArray[index]);
+	}
+
+	this->layoutValid = true;
+}
+
+void SceneGraph::UpdateRange(uint32_t begin, uint32_t end, ThreadPool* threadPool)
+{
+	float* worldMatrices = this->worldMatricesArray.data();
+
+	// First the local matrices, in SIMD batches, straight into the world matrix slots...
+	if (threadPool && end - begin >= 2 * SCENE_MIN_BATCH_SIZE)
+	{
+		threadPool->ParallelFor(end - begin, SCENE_MIN_BATCH_SIZE, [this, begin, worldMatrices](size_t batchBegin, size_t batchEnd)
+		{
+			this->localTransforms.ComputeMatrices(begin + (uint32_t)batchBegin, begin + (uint32_t)batchEnd, nullptr, worldMatrices, nullptr);
+		});
+	}
+	else
+	{
+		this->localTransforms.ComputeMatrices(begin, end, nullptr, worldMatrices, nullptr);
+	}
+
+	// ...then concatenate with the parents in layout order, which guarantees each parent is done before its children.
+	// A range's root has its parent outside the range, and that one is already up to date.
+	for (uint32_t index = begin; index < end; index++)
+	{
+		uint32_t parentIndex = this->parentIndicesArray[index];
+		if (parentIndex == INVALID_NODE)
+			continue;
+
+		float local[16];
+		::memcpy(local, &worldMatrices[16 * (size_t)index], sizeof(local));
+		MultiplyMatrices(&worldMatrices[16 * (size_t)parentIndex], local, &worldMatrices[16 * (size_t)index]);
+	}
+}
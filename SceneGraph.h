@@ -0,0 +1,79 @@
+#pragma once
+
+#include "TransformStore.h"
+#include <vector>
+#include <cstdint>
+
+// A parent/child transform hierarchy kept in flat arrays, laid out depth-first so that every node comes after its
+// parent and every subtree occupies one contiguous range of indices.  Changing a node's local transform just marks it
+// dirty; Update then recomputes only the dirty subtrees and reports which index ranges of the world matrix array
+// changed, so a renderer can upload just those.  With nothing dirty, Update costs next to nothing.
+//
+// Nodes are referred to by stable ids.  The index of a node (its place in the arrays, and so in any GPU buffer mirroring
+// them) only changes when nodes are added, which forces a full relayout on the next Update.
+class SceneGraph
+{
+public:
+	typedef uint32_t NodeId;
+	static constexpr NodeId INVALID_NODE = 0xFFFFFFFF;
+
+	struct Range
+	{
+		uint32_t begin;
+		uint32_t end;
+	};
+
+	struct Statistics
+	{
+		uint32_t nodesUpdated;
+		uint32_t rangesChanged;
+		bool relayout;
+	};
+
+	SceneGraph();
+	virtual ~SceneGraph();
+
+	// The parent must already exist, or be INVALID_NODE for a new root.
+	NodeId AddNode(NodeId parent);
+	uint32_t GetNodeCount() const { return (uint32_t)this->nodeParentsArray.size(); }
+
+	void SetLocalPosition(NodeId node, float x, float y, float z);
+	void SetLocalRotation(NodeId node, float x, float y, float z, float w);
+	void SetLocalScale(NodeId node, float x, float y, float z);
+
+	// Recomputes the world matrices of every dirty subtree, splitting large ones across the pool if given, and returns
+	// the (sorted, merged) index ranges whose world matrices changed.  The result is valid until the next Update.
+	const std::vector<Range>& Update(ThreadPool* threadPool);
+
+	// Only meaningful after Update.  Matrices are column-major float[16], 16 floats apart, in index order.
+	uint32_t GetIndex(NodeId node) const { return this->nodeIndicesArray[node]; }
+	NodeId GetNode(uint32_t index) const { return this->indexNodesArray[index]; }
+	uint32_t GetParentIndex(uint32_t index) const { return this->parentIndicesArray[index]; }
+	const float* GetWorldMatrices() const { return this->worldMatricesArray.data(); }
+	const float* GetWorldMatrix(NodeId node) const { return &this->worldMatricesArray[16 * (size_t)this->nodeIndicesArray[node]]; }
+
+	const Statistics& GetStatistics() const { return this->statistics; }
+
+private:
+	void MarkDirty(NodeId node);
+	void Relayout();
+	void UpdateRange(uint32_t begin, uint32_t end, ThreadPool* threadPool);
+
+	// Indexed by node id.
+	std::vector<NodeId> nodeParentsArray;
+	std::vector<uint32_t> nodeIndicesArray;
+	std::vector<uint8_t> nodeDirtyArray;
+	std::vector<NodeId> dirtyNodesArray;
+
+	// Indexed by position in the layout.  New nodes are appended at the end until the next relayout puts them in place.
+	std::vector<NodeId> indexNodesArray;
+	std::vector<uint32_t> parentIndicesArray;
+	std::vector<uint32_t> subtreeEndsArray;
+	TransformStore localTransforms;
+	std::vector<float> worldMatricesArray;
+	std::vector<uint32_t> dirtyIndicesArray;
+
+	bool layoutValid;
+	std::vector<Range> changedRangesArray;
+	Statistics statistics;
+};
@@ -0,0 +1,829 @@
+#include "SceneRenderer.h"
+#include "DepthPyramid.h"
+#include "GeometryPool.h"
+#include "MemoryTracker.h"
+#include "PipelineCache.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+const uint32_t SCENE_PLANETS_PER_SYSTEM = 8;
+const uint32_t SCENE_MOONS_PER_PLANET = 4;
+const uint32_t SCENE_REPORT_INTERVAL = 240;
+const float SCENE_SPIN_RATE = 0.5f;		// Radians per second.
+const uint32_t SCENE_BOUNDS_BATCH_SIZE = 16 * 1024;
+const float SCENE_LAYER_SPACING = 0.5f;		// Between stacked systems, as a fraction of the grid spacing.
+const uint32_t SCENE_CULL_GROUP_SIZE = 64;		// Must match the local size in scene_cull.comp.
+
+SceneRenderer::SceneRenderer(Application* app, uint32_t nodeCount, uint32_t animatedPercent, uint32_t layerCount, bool cullingEnabled, bool occlusionEnabled)
+{
+	this->app = app;
+	this->animatedPercent = std::min(animatedPercent, 100u);
+	this->layerCount = std::max(layerCount, 1u);
+	this->cullingEnabled = cullingEnabled;
+	this->occlusionEnabled = occlusionEnabled;
+	this->animationAngle = 0.0f;
+	this->viewProjection = glm::mat4(1.0f);
+	this->worldBuffer = VK_NULL_HANDLE;
+	this->worldBufferMemory = nullptr;
+	this->visibleBuffer = VK_NULL_HANDLE;
+	this->visibleBufferMemory = nullptr;
+	this->mappedVisible = nullptr;
+	this->descriptorSetLayout = VK_NULL_HANDLE;
+	this->descriptorPool = VK_NULL_HANDLE;
+	this->descriptorSet = VK_NULL_HANDLE;
+	this->pipelineLayout = VK_NULL_HANDLE;
+	this->pipelineId = 0;
+	this->depthPyramid = nullptr;
+	this->drawnBuffer = VK_NULL_HANDLE;
+	this->drawnBufferMemory = nullptr;
+	this->deferredBuffer = VK_NULL_HANDLE;
+	this->deferredBufferMemory = nullptr;
+	this->drawStateBuffer = VK_NULL_HANDLE;
+	this->drawStateBufferMemory = nullptr;
+	this->mappedDrawStates = nullptr;
+	this->cullDescriptorSetLayout = VK_NULL_HANDLE;
+	this->cullDescriptorPool = VK_NULL_HANDLE;
+	this->cullDescriptorSet = VK_NULL_HANDLE;
+	this->cullPipelineLayout = VK_NULL_HANDLE;
+	this->cullPipeline = VK_NULL_HANDLE;
+	this->depthPipelineId = 0;
+	this->reportFrameCount = 0;
+	this->reportMilliseconds = 0.0;
+	this->reportNodesUpdated = 0;
+	this->reportRangesChanged = 0;
+	this->reportCullMilliseconds = 0.0;
+	this->reportTested = 0;
+	this->reportVisible = 0;
+	this->reportOcclusionFrames = 0;
+	this->reportOcclusionCandidates = 0;
+	this->reportOcclusionDrawn = 0;
+	this->reportDisoccluded = 0;
+
+	this->BuildScene(nodeCount);
+}
+
+/*virtual*/ SceneRenderer::~SceneRenderer()
+{
+}
+
+void SceneRenderer::BuildScene(uint32_t nodeCount)
+{
+	// A grid of little solar systems: each root has planets orbiting it, and each planet has moons.  Spinning a root
+	// carries its whole subtree along, which is exactly the case the dirty-subtree update is for.  With more than one
+	// layer, each cell of the grid gets a stack of systems, one above the other, so the upper ones hide the lower ones.
+	const uint32_t nodesPerSystem = 1 + SCENE_PLANETS_PER_SYSTEM * (1 + SCENE_MOONS_PER_PLANET);
+	uint32_t systemCount = std::max(nodeCount / nodesPerSystem, 1u);
+	uint32_t cellCount = (systemCount + this->layerCount - 1) / this->layerCount;
+	uint32_t gridSize = (uint32_t)std::ceil(std::sqrt(double(cellCount)));
+	float spacing = 3.0f / float(gridSize);
+
+	// Only every so many systems are animated, spread evenly through the grid.
+	uint32_t animatedEvery = (this->animatedPercent > 0) ? 100 / this->animatedPercent : 0;
+
+	for (uint32_t system = 0; system < systemCount; system++)
+	{
+		SceneGraph::NodeId systemNode = this->sceneGraph.AddNode(SceneGraph::INVALID_NODE);
+		uint32_t cell = system / this->layerCount;
+		float x = (float(cell % gridSize) + 0.5f) * spacing - 1.5f;
+		float y = (float(cell / gridSize) + 0.5f) * spacing - 1.5f;
+		float z = float(system % this->layerCount) * SCENE_LAYER_SPACING * spacing;
+		this->sceneGraph.SetLocalPosition(systemNode, x, y, z);
+		this->sceneGraph.SetLocalScale(systemNode, 0.3f * spacing, 0.3f * spacing, 0.3f * spacing);
+
+		if (animatedEvery > 0 && system % animatedEvery == 0)
+			this->animatedNodesArray.push_back(systemNode);
+
+		for (uint32_t planet = 0; planet < SCENE_PLANETS_PER_SYSTEM; planet++)
+		{
+			float planetAngle = 2.0f * glm::pi<float>() * float(planet) / float(SCENE_PLANETS_PER_SYSTEM);
+			SceneGraph::NodeId planetNode = this->sceneGraph.AddNode(systemNode);
+			this->sceneGraph.SetLocalPosition(planetNode, 1.2f * std::cos(planetAngle), 1.2f * std::sin(planetAngle), 0.0f);
+			this->sceneGraph.SetLocalScale(planetNode, 0.3f, 0.3f, 0.3f);
+
+			for (uint32_t moon = 0; moon < SCENE_MOONS_PER_PLANET; moon++)
+			{
+				float moonAngle = 2.0f * glm::pi<float>() * float(moon) / float(SCENE_MOONS_PER_PLANET);
+				SceneGraph::NodeId moonNode = this->sceneGraph.AddNode(planetNode);
+				this->sceneGraph.SetLocalPosition(moonNode, std::cos(moonAngle), std::sin(moonAngle), 0.0f);
+				this->sceneGraph.SetLocalScale(moonNode, 0.4f, 0.4f, 0.4f);
+			}
+		}
+	}
+}
+
+void SceneRenderer::Create()
+{
+	this->CreateWorldBuffers();
+
+	if (this->occlusionEnabled)
+	{
+		this->depthPyramid = new DepthPyramid(this->app);
+		this->depthPyramid->Create();
+		this->CreateOcclusionBuffers();
+	}
+
+	this->CreateDescriptorSet();
+	this->CreateGraphicsPipeline();
+
+	if (this->occlusionEnabled)
+	{
+		this->CreateCullDescriptorSet();
+		this->CreateCullPipeline();
+	}
+
+	std::cout << "Scene: " << this->sceneGraph.GetNodeCount() << " nodes in " << this->layerCount << " layer(s), " << this->animatedNodesArray.size() << " animated subtrees, culling " << (this->cullingEnabled ? "on" : "off")
+		<< ", occlusion culling " << (this->occlusionEnabled ? "on" : "off") << std::endl;
+}
+
+void SceneRenderer::Destroy()
+{
+	VkDevice logicalDevice = this->app->logicalDevice;
+
+	for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+	{
+		vkUnmapMemory(logicalDevice, this->stagingBuffersMemory[i]);
+		vkDestroyBuffer(logicalDevice, this->stagingBuffers[i], nullptr);
+		this->app->memoryTracker->Free(this->stagingBuffersMemory[i]);
+	}
+
+	vkUnmapMemory(logicalDevice, this->visibleBufferMemory);
+	vkDestroyBuffer(logicalDevice, this->visibleBuffer, nullptr);
+	this->app->memoryTracker->Free(this->visibleBufferMemory);
+	vkDestroyBuffer(logicalDevice, this->worldBuffer, nullptr);
+	this->app->memoryTracker->Free(this->worldBufferMemory);
+	vkDestroyPipelineLayout(logicalDevice, this->pipelineLayout, nullptr);
+	vkDestroyDescriptorPool(logicalDevice, this->descriptorPool, nullptr);
+	vkDestroyDescriptorSetLayout(logicalDevice, this->descriptorSetLayout, nullptr);
+
+	if (this->depthPyramid)
+	{
+		vkDestroyPipeline(logicalDevice, this->cullPipeline, nullptr);
+		vkDestroyPipelineLayout(logicalDevice, this->cullPipelineLayout, nullptr);
+		vkDestroyDescriptorPool(logicalDevice, this->cullDescriptorPool, nullptr);
+		vkDestroyDescriptorSetLayout(logicalDevice, this->cullDescriptorSetLayout, nullptr);
+
+		vkUnmapMemory(logicalDevice, this->drawStateBufferMemory);
+		vkDestroyBuffer(logicalDevice, this->drawStateBuffer, nullptr);
+		this->app->memoryTracker->Free(this->drawStateBufferMemory);
+		vkDestroyBuffer(logicalDevice, this->deferredBuffer, nullptr);
+		this->app->memoryTracker->Free(this->deferredBufferMemory);
+		vkDestroyBuffer(logicalDevice, this->drawnBuffer, nullptr);
+		this->app->memoryTracker->Free(this->drawnBufferMemory);
+
+		this->depthPyramid->Destroy();
+		delete this->depthPyramid;
+		this->depthPyramid = nullptr;
+	}
+}
+
+void SceneRenderer::Resize()
+{
+	// The pyramid follows the swap-chain's size, so it's a new image, which the cull shader has to be pointed at.
+	if (this->depthPyramid)
+	{
+		this->depthPyramid->Resize();
+		this->WritePyramidDescriptor();
+	}
+}
+
+void SceneRenderer::CreateWorldBuffers()
+{
+	VkDeviceSize bufferSize = sizeof(glm::mat4) * (VkDeviceSize)this->sceneGraph.GetNodeCount();
+
+	this->app->CreateBuffer(bufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, this->worldBuffer, this->worldBufferMemory);
+
+	// Staging is sized for the worst case of everything changing at once (which is what the first frame does).
+	// Changed matrices go at the same offset they'll have in the world buffer, so each range is one copy region.
+	this->stagingBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+	this->stagingBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
+	this->mappedStaging.resize(MAX_FRAMES_IN_FLIGHT);
+	this->pendingCopiesArray.resize(MAX_FRAMES_IN_FLIGHT);
+
+	for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+	{
+		this->app->CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, this->stagingBuffers[i], this->stagingBuffersMemory[i]);
+
+		void* data = nullptr;
+		if (VK_SUCCESS != vkMapMemory(this->app->logicalDevice, this->stagingBuffersMemory[i], 0, bufferSize, 0, &data))
+			throw new std::runtime_error("Failed to map scene staging buffer!");
+
+		this->mappedStaging[i] = static_cast<float*>(data);
+	}
+
+	// The instance list, one slice per frame slot, read by the vertex shader as world[visible[gl_InstanceIndex]].  It
+	// holds layout indices, which are also what the culler hands back since the bounds are kept in layout order.
+	uint32_t nodeCount = this->sceneGraph.GetNodeCount();
+	VkDeviceSize visibleBufferSize = sizeof(uint32_t) * (VkDeviceSize)nodeCount * MAX_FRAMES_IN_FLIGHT;
+
+	this->app->CreateBuffer(visibleBufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, this->visibleBuffer, this->visibleBufferMemory);
+
+	void* data = nullptr;
+	if (VK_SUCCESS != vkMapMemory(this->app->logicalDevice, this->visibleBufferMemory, 0, visibleBufferSize, 0, &data))
+		throw new std::runtime_error("Failed to map scene visibility buffer!");
+
+	this->mappedVisible = static_cast<uint32_t*>(data);
+
+	// Without culling, every slice just lists everything, once.
+	this->visibleCountsArray.resize(MAX_FRAMES_IN_FLIGHT, nodeCount);
+	for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+		for (uint32_t j = 0; j < nodeCount; j++)
+			this->mappedVisible[i * (size_t)nodeCount + j] = j;
+
+	this->boundsCenterX.resize(nodeCount);
+	this->boundsCenterY.resize(nodeCount);
+	this->boundsCenterZ.resize(nodeCount);
+	this->boundsExtentX.resize(nodeCount);
+	this->boundsExtentY.resize(nodeCount);
+	this->boundsExtentZ.resize(nodeCount);
+}
+
+void SceneRenderer::CreateDescriptorSet()
+{
+	std::array<VkDescriptorSetLayoutBinding, 3> bindings{};
+
+	bindings[0].binding = 0;
+	bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	bindings[0].descriptorCount = 1;
+	bindings[0].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+
+	// Same binding as in shader.frag, which we reuse as is.
+	bindings[1].binding = 1;
+	bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	bindings[1].descriptorCount = 1;
+	bindings[1].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+	bindings[2].binding = 2;
+	bindings[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	bindings[2].descriptorCount = 1;
+	bindings[2].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo{};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+	layoutInfo.pBindings = bindings.data();
+
+	if (VK_SUCCESS != vkCreateDescriptorSetLayout(this->app->logicalDevice, &layoutInfo, nullptr, &this->descriptorSetLayout))
+		throw new std::runtime_error("Failed to create scene descriptor set layout!");
+
+	std::array<VkDescriptorPoolSize, 2> poolSizes{};
+	poolSizes[0].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	poolSizes[0].descriptorCount = 2;
+	poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	poolSizes[1].descriptorCount = 1;
+
+	VkDescriptorPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+	poolInfo.pPoolSizes = poolSizes.data();
+	poolInfo.maxSets = 1;
+
+	if (VK_SUCCESS != vkCreateDescriptorPool(this->app->logicalDevice, &poolInfo, nullptr, &this->descriptorPool))
+		throw new std::runtime_error("Failed to create scene descriptor pool!");
+
+	VkDescriptorSetAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = this->descriptorPool;
+	allocInfo.descriptorSetCount = 1;
+	allocInfo.pSetLayouts = &this->descriptorSetLayout;
+
+	if (VK_SUCCESS != vkAllocateDescriptorSets(this->app->logicalDevice, &allocInfo, &this->descriptorSet))
+		throw new std::runtime_error("Failed to allocate scene descriptor set!");
+
+	VkDescriptorBufferInfo bufferInfo{};
+	bufferInfo.buffer = this->worldBuffer;
+	bufferInfo.offset = 0;
+	bufferInfo.range = VK_WHOLE_SIZE;
+
+	// With occlusion culling, the GPU's list of what to draw stands in for the CPU's.
+	VkDescriptorBufferInfo visibleBufferInfo{};
+	visibleBufferInfo.buffer = this->occlusionEnabled ? this->drawnBuffer : this->visibleBuffer;
+	visibleBufferInfo.offset = 0;
+	visibleBufferInfo.range = VK_WHOLE_SIZE;
+
+	VkDescriptorImageInfo imageInfo{};
+	imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	imageInfo.imageView = this->app->textureImageView;
+	imageInfo.sampler = this->app->textureSampler;
+
+	std::array<VkWriteDescriptorSet, 3> descriptorWrites{};
+
+	descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	descriptorWrites[0].dstSet = this->descriptorSet;
+	descriptorWrites[0].dstBinding = 0;
+	descriptorWrites[0].dstArrayElement = 0;
+	descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	descriptorWrites[0].descriptorCount = 1;
+	descriptorWrites[0].pBufferInfo = &bufferInfo;
+
+	descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	descriptorWrites[1].dstSet = this->descriptorSet;
+	descriptorWrites[1].dstBinding = 1;
+	descriptorWrites[1].dstArrayElement = 0;
+	descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	descriptorWrites[1].descriptorCount = 1;
+	descriptorWrites[1].pImageInfo = &imageInfo;
+
+	descriptorWrites[2].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	descriptorWrites[2].dstSet = this->descriptorSet;
+	descriptorWrites[2].dstBinding = 2;
+	descriptorWrites[2].dstArrayElement = 0;
+	descriptorWrites[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	descriptorWrites[2].descriptorCount = 1;
+	descriptorWrites[2].pBufferInfo = &visibleBufferInfo;
+
+	vkUpdateDescriptorSets(this->app->logicalDevice, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+}
+
+void SceneRenderer::CreateGraphicsPipeline()
+{
+	VkPushConstantRange pushConstantRange{};
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+	pushConstantRange.offset = 0;
+	pushConstantRange.size = sizeof(glm::mat4);
+
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount = 1;
+	pipelineLayoutInfo.pSetLayouts = &this->descriptorSetLayout;
+	pipelineLayoutInfo.pushConstantRangeCount = 1;
+	pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+	if (VK_SUCCESS != vkCreatePipelineLayout(this->app->logicalDevice, &pipelineLayoutInfo, nullptr, &this->pipelineLayout))
+		throw new std::runtime_error("Failed to create scene pipeline layout!");
+
+	// The application's fragment shader, without its features picked, and no culling; otherwise the defaults.
+	PipelineCache* pipelineCache = this->app->pipelineCache;
+
+	PipelineState state;
+	state.layout = this->pipelineLayout;
+	state.vertexShader = pipelineCache->AddShader(Application::ReadFile("scene_vert.spv"));
+	state.fragmentShader = pipelineCache->AddShader(this->app->fragShaderCode);
+	state.AddVertexBinding(Vertex::GetBindingDescription());
+	for (const VkVertexInputAttributeDescription& attribute : Vertex::GetAttributeDescriptions())
+		state.AddVertexAttribute(attribute);
+	state.cullMode = VK_CULL_MODE_NONE;
+	state.colorFormat = this->app->swapChainImageFormat;
+
+	this->pipelineId = pipelineCache->Request(state);
+
+	// The occlusion prepass draws the same thing with the same layout, but only its depth, into the pyramid's own
+	// render pass.  No fragment shader is needed for that.
+	if (this->occlusionEnabled)
+	{
+		state.fragmentShader = PipelineState::NO_SHADER;
+		state.colorFormat = VK_FORMAT_UNDEFINED;
+		state.depthFormat = DepthPyramid::GetDepthFormat();
+		state.depthTestEnable = VK_TRUE;
+		state.depthWriteEnable = VK_TRUE;
+		state.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+		state.renderPass = this->depthPyramid->GetRenderPass();
+
+		this->depthPipelineId = pipelineCache->Request(state);
+	}
+}
+
+void SceneRenderer::CreateOcclusionBuffers()
+{
+	VkDeviceSize listBufferSize = sizeof(uint32_t) * (VkDeviceSize)this->sceneGraph.GetNodeCount();
+
+	this->app->CreateBuffer(listBufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, this->drawnBuffer, this->drawnBufferMemory);
+	this->app->CreateBuffer(listBufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, this->deferredBuffer, this->deferredBufferMemory);
+
+	VkDeviceSize drawStateBufferSize = sizeof(OcclusionDrawState) * MAX_FRAMES_IN_FLIGHT;
+	this->app->CreateBuffer(drawStateBufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, this->drawStateBuffer, this->drawStateBufferMemory);
+
+	void* data = nullptr;
+	if (VK_SUCCESS != vkMapMemory(this->app->logicalDevice, this->drawStateBufferMemory, 0, drawStateBufferSize, 0, &data))
+		throw new std::runtime_error("Failed to map scene draw state buffer!");
+
+	this->mappedDrawStates = static_cast<OcclusionDrawState*>(data);
+	this->occlusionPending.resize(MAX_FRAMES_IN_FLIGHT, false);
+
+	for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+		this->CollectOcclusionResults(i);
+}
+
+void SceneRenderer::CreateCullDescriptorSet()
+{
+	std::array<VkDescriptorSetLayoutBinding, 6> bindings{};
+	for (uint32_t binding = 0; binding < 5; binding++)
+	{
+		bindings[binding].binding = binding;
+		bindings[binding].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[binding].descriptorCount = 1;
+		bindings[binding].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	}
+
+	bindings[5].binding = 5;
+	bindings[5].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	bindings[5].descriptorCount = 1;
+	bindings[5].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo{};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+	layoutInfo.pBindings = bindings.data();
+
+	if (VK_SUCCESS != vkCreateDescriptorSetLayout(this->app->logicalDevice, &layoutInfo, nullptr, &this->cullDescriptorSetLayout))
+		throw new std::runtime_error("Failed to create scene cull descriptor set layout!");
+
+	std::array<VkDescriptorPoolSize, 2> poolSizes{};
+	poolSizes[0].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	poolSizes[0].descriptorCount = 5;
+	poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	poolSizes[1].descriptorCount = 1;
+
+	VkDescriptorPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+	poolInfo.pPoolSizes = poolSizes.data();
+	poolInfo.maxSets = 1;
+
+	if (VK_SUCCESS != vkCreateDescriptorPool(this->app->logicalDevice, &poolInfo, nullptr, &this->cullDescriptorPool))
+		throw new std::runtime_error("Failed to create scene cull descriptor pool!");
+
+	VkDescriptorSetAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = this->cullDescriptorPool;
+	allocInfo.descriptorSetCount = 1;
+	allocInfo.pSetLayouts = &this->cullDescriptorSetLayout;
+
+	if (VK_SUCCESS != vkAllocateDescriptorSets(this->app->logicalDevice, &allocInfo, &this->cullDescriptorSet))
+		throw new std::runtime_error("Failed to allocate scene cull descriptor set!");
+
+	// World matrices, candidates, drawn, deferred and draw states, in binding order.
+	std::array<VkDescriptorBufferInfo, 5> bufferInfos{};
+	VkBuffer buffersArray[] = { this->worldBuffer, this->visibleBuffer, this->drawnBuffer, this->deferredBuffer, this->drawStateBuffer };
+	std::array<VkWriteDescriptorSet, 5> descriptorWrites{};
+
+	for (uint32_t binding = 0; binding < 5; binding++)
+	{
+		bufferInfos[binding].buffer = buffersArray[binding];
+		bufferInfos[binding].offset = 0;
+		bufferInfos[binding].range = VK_WHOLE_SIZE;
+
+		descriptorWrites[binding].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWrites[binding].dstSet = this->cullDescriptorSet;
+		descriptorWrites[binding].dstBinding = binding;
+		descriptorWrites[binding].dstArrayElement = 0;
+		descriptorWrites[binding].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		descriptorWrites[binding].descriptorCount = 1;
+		descriptorWrites[binding].pBufferInfo = &bufferInfos[binding];
+	}
+
+	vkUpdateDescriptorSets(this->app->logicalDevice, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+
+	this->WritePyramidDescriptor();
+}
+
+void SceneRenderer::WritePyramidDescriptor()
+{
+	VkDescriptorImageInfo imageInfo{};
+	imageInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+	imageInfo.imageView = this->depthPyramid->GetPyramidView();
+	imageInfo.sampler = this->depthPyramid->GetSampler();
+
+	VkWriteDescriptorSet descriptorWrite{};
+	descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	descriptorWrite.dstSet = this->cullDescriptorSet;
+	descriptorWrite.dstBinding = 5;
+	descriptorWrite.dstArrayElement = 0;
+	descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	descriptorWrite.descriptorCount = 1;
+	descriptorWrite.pImageInfo = &imageInfo;
+
+	vkUpdateDescriptorSets(this->app->logicalDevice, 1, &descriptorWrite, 0, nullptr);
+}
+
+void SceneRenderer::CreateCullPipeline()
+{
+	auto compShaderCode = Application::ReadFile("scene_cull_comp.spv");
+	VkShaderModule compShaderModule = this->app->CreateShaderModule(compShaderCode);
+
+	VkPipelineShaderStageCreateInfo compShaderStageInfo{};
+	compShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	compShaderStageInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	compShaderStageInfo.module = compShaderModule;
+	compShaderStageInfo.pName = "main";
+
+	VkPushConstantRange pushConstantRange{};
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	pushConstantRange.offset = 0;
+	pushConstantRange.size = sizeof(CullPushConstants);
+
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount = 1;
+	pipelineLayoutInfo.pSetLayouts = &this->cullDescriptorSetLayout;
+	pipelineLayoutInfo.pushConstantRangeCount = 1;
+	pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+	if (VK_SUCCESS != vkCreatePipelineLayout(this->app->logicalDevice, &pipelineLayoutInfo, nullptr, &this->cullPipelineLayout))
+		throw new std::runtime_error("Failed to create scene cull pipeline layout!");
+
+	VkComputePipelineCreateInfo pipelineInfo{};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipelineInfo.stage = compShaderStageInfo;
+	pipelineInfo.layout = this->cullPipelineLayout;
+
+	if (VK_SUCCESS != vkCreateComputePipelines(this->app->logicalDevice, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &this->cullPipeline))
+		throw new std::runtime_error("Failed to create scene cull pipeline!");
+
+	vkDestroyShaderModule(this->app->logicalDevice, compShaderModule, nullptr);
+}
+
+void SceneRenderer::CollectOcclusionResults(uint32_t i)
+{
+	// Slot i's frame is done, so what the GPU counted for it is there to read, and its draw state can be reset for the
+	// next one.  The indirect draw starts with no instances; the culling adds them.
+	OcclusionDrawState& drawState = this->mappedDrawStates[i];
+
+	if (this->occlusionPending[i])
+	{
+		this->reportOcclusionFrames++;
+		this->reportOcclusionCandidates += this->visibleCountsArray[i];
+		this->reportOcclusionDrawn += drawState.draw.instanceCount;
+		this->reportDisoccluded += drawState.disoccludedCount;
+		this->occlusionPending[i] = false;
+	}
+
+	const GeometryPool::Mesh& quad = this->app->geometryPool->GetMesh(this->app->quadMeshId);
+	drawState.draw.indexCount = quad.indexCount;
+	drawState.draw.instanceCount = 0;
+	drawState.draw.firstIndex = quad.firstIndex;
+	drawState.draw.vertexOffset = quad.vertexOffset;
+	drawState.draw.firstInstance = 0;
+	drawState.deferredCount = 0;
+	drawState.disoccludedCount = 0;
+	drawState.unused = 0;
+}
+
+void SceneRenderer::Update(float deltaTime, uint32_t i, const glm::mat4& view, const glm::mat4& proj)
+{
+	// The caller must have waited on frame slot i's fence, since we're about to overwrite its staging buffer.
+	auto startTime = std::chrono::high_resolution_clock::now();
+
+	if (this->occlusionEnabled)
+		this->CollectOcclusionResults(i);
+
+	this->viewProjection = proj * view;
+
+	if (!this->animatedNodesArray.empty())
+	{
+		this->animationAngle += SCENE_SPIN_RATE * deltaTime;
+		float s = std::sin(0.5f * this->animationAngle);
+		float c = std::cos(0.5f * this->animationAngle);
+		for (SceneGraph::NodeId node : this->animatedNodesArray)
+			this->sceneGraph.SetLocalRotation(node, 0.0f, 0.0f, s, c);
+	}
+
+	const std::vector<SceneGraph::Range>& changedRangesArray = this->sceneGraph.Update(this->app->threadPool);
+
+	// The scene graph reports a change only once, so whatever this slot didn't get to record last time (the frame was
+	// dropped when the swap chain went out of date) is still pending, and goes along with what changed since.
+	std::vector<VkBufferCopy>& pendingCopies = this->pendingCopiesArray[i];
+	for (const SceneGraph::Range& range : changedRangesArray)
+	{
+		VkBufferCopy copyRegion{};
+		copyRegion.srcOffset = sizeof(float) * 16 * (size_t)range.begin;
+		copyRegion.dstOffset = copyRegion.srcOffset;
+		copyRegion.size = sizeof(float) * 16 * (size_t)(range.end - range.begin);
+		pendingCopies.push_back(copyRegion);
+
+		if (this->cullingEnabled)
+			this->UpdateBounds(range.begin, range.end);
+	}
+
+	// Left over and new ranges may overlap, and a copy's destination regions mustn't.
+	std::sort(pendingCopies.begin(), pendingCopies.end(), [](const VkBufferCopy& a, const VkBufferCopy& b) { return a.dstOffset < b.dstOffset; });
+	size_t mergedCount = 0;
+	for (size_t j = 0; j < pendingCopies.size(); j++)
+	{
+		if (mergedCount > 0)
+		{
+			VkBufferCopy& last = pendingCopies[mergedCount - 1];
+			if (pendingCopies[j].dstOffset <= last.dstOffset + last.size)
+			{
+				last.size = std::max(last.dstOffset + last.size, pendingCopies[j].dstOffset + pendingCopies[j].size) - last.dstOffset;
+				continue;
+			}
+		}
+
+		pendingCopies[mergedCount++] = pendingCopies[j];
+	}
+	pendingCopies.resize(mergedCount);
+
+	// Left over ranges are staged again too, since another slot may have uploaded newer matrices for them meanwhile.
+	const uint8_t* worldMatrices = reinterpret_cast<const uint8_t*>(this->sceneGraph.GetWorldMatrices());
+	uint8_t* staging = reinterpret_cast<uint8_t*>(this->mappedStaging[i]);
+	for (const VkBufferCopy& copyRegion : pendingCopies)
+		::memcpy(staging + copyRegion.srcOffset, worldMatrices + copyRegion.srcOffset, (size_t)copyRegion.size);
+
+	auto endTime = std::chrono::high_resolution_clock::now();
+
+	if (this->cullingEnabled)
+	{
+		this->frustumCuller.SetViewProjection(&this->viewProjection[0][0]);
+
+		const std::vector<uint32_t>& visibleArray = this->frustumCuller.CullBoxes(
+			this->boundsCenterX.data(), this->boundsCenterY.data(), this->boundsCenterZ.data(),
+			this->boundsExtentX.data(), this->boundsExtentY.data(), this->boundsExtentZ.data(),
+			this->sceneGraph.GetNodeCount(), this->app->threadPool);
+
+		::memcpy(this->mappedVisible + i * (size_t)this->sceneGraph.GetNodeCount(), visibleArray.data(), sizeof(uint32_t) * visibleArray.size());
+		this->visibleCountsArray[i] = (uint32_t)visibleArray.size();
+
+		const FrustumCuller::Statistics& cullStatistics = this->frustumCuller.GetStatistics();
+		this->reportTested += cullStatistics.tested;
+		this->reportVisible += cullStatistics.visible;
+	}
+
+	auto cullEndTime = std::chrono::high_resolution_clock::now();
+
+	const SceneGraph::Statistics& statistics = this->sceneGraph.GetStatistics();
+	this->reportFrameCount++;
+	this->reportMilliseconds += std::chrono::duration<double, std::milli>(endTime - startTime).count();
+	this->reportNodesUpdated += statistics.nodesUpdated;
+	this->reportRangesChanged += statistics.rangesChanged;
+	this->reportCullMilliseconds += std::chrono::duration<double, std::milli>(cullEndTime - endTime).count();
+
+	if (this->reportFrameCount == SCENE_REPORT_INTERVAL)
+	{
+		double frames = double(this->reportFrameCount);
+		std::cout << "Scene: " << this->sceneGraph.GetNodeCount() << " nodes"
+			<< " | update " << this->reportMilliseconds / frames << " ms"
+			<< " | " << double(this->reportNodesUpdated) / frames << " nodes in " << double(this->reportRangesChanged) / frames << " ranges"
+			<< " | upload " << double(this->reportNodesUpdated * sizeof(glm::mat4)) / (1024.0 * frames) << " KiB per frame";
+
+		if (this->cullingEnabled)
+			std::cout << " | cull " << this->reportCullMilliseconds / frames << " ms, " << double(this->reportVisible) / frames << " of " << double(this->reportTested) / frames << " visible";
+
+		if (this->occlusionEnabled && this->reportOcclusionFrames > 0)
+		{
+			double occlusionFrames = double(this->reportOcclusionFrames);
+			std::cout << " | occlusion culled " << double(this->reportOcclusionCandidates - this->reportOcclusionDrawn) / occlusionFrames << " of " << double(this->reportOcclusionCandidates) / occlusionFrames
+				<< ", " << double(this->reportDisoccluded) / occlusionFrames << " caught by the second pass";
+		}
+
+		std::cout << std::endl;
+
+		this->reportFrameCount = 0;
+		this->reportMilliseconds = 0.0;
+		this->reportNodesUpdated = 0;
+		this->reportRangesChanged = 0;
+		this->reportCullMilliseconds = 0.0;
+		this->reportTested = 0;
+		this->reportVisible = 0;
+		this->reportOcclusionFrames = 0;
+		this->reportOcclusionCandidates = 0;
+		this->reportOcclusionDrawn = 0;
+		this->reportDisoccluded = 0;
+	}
+}
+
+void SceneRenderer::UpdateBounds(uint32_t begin, uint32_t end)
+{
+	// The quad spans -0.5 to 0.5 in x and y, so its world-space box is centered on the translation, with half-extents
+	// given by the absolute values of the first two columns (Arvo's method, with a zero z extent).
+	const float* worldMatrices = this->sceneGraph.GetWorldMatrices();
+
+	auto updateBounds = [this, worldMatrices](size_t batchBegin, size_t batchEnd)
+	{
+		for (size_t index = batchBegin; index < batchEnd; index++)
+		{
+			const float* world = &worldMatrices[16 * index];
+			this->boundsCenterX[index] = world[12];
+			this->boundsCenterY[index] = world[13];
+			this->boundsCenterZ[index] = world[14];
+			this->boundsExtentX[index] = 0.5f * (std::fabs(world[0]) + std::fabs(world[4]));
+			this->boundsExtentY[index] = 0.5f * (std::fabs(world[1]) + std::fabs(world[5]));
+			this->boundsExtentZ[index] = 0.5f * (std::fabs(world[2]) + std::fabs(world[6]));
+		}
+	};
+
+	if (this->app->threadPool && end - begin >= 2 * SCENE_BOUNDS_BATCH_SIZE)
+		this->app->threadPool->ParallelFor(end - begin, SCENE_BOUNDS_BATCH_SIZE, [begin, &updateBounds](size_t batchBegin, size_t batchEnd) { updateBounds(begin + batchBegin, begin + batchEnd); });
+	else
+		updateBounds(begin, end);
+}
+
+void SceneRenderer::RecordTransfers(VkCommandBuffer givenCommandBuffer, uint32_t i)
+{
+	// Must be called outside of the render pass, since copies aren't allowed inside one.  So must the occlusion culling,
+	// which comes after the copies since it reads the world matrices too.
+	const std::vector<VkBufferCopy>& pendingCopies = this->pendingCopiesArray[i];
+	if (!pendingCopies.empty())
+		this->RecordWorldCopies(givenCommandBuffer, i);
+
+	if (this->occlusionEnabled)
+		this->RecordOcclusionCulling(givenCommandBuffer, i);
+}
+
+void SceneRenderer::RecordWorldCopies(VkCommandBuffer givenCommandBuffer, uint32_t i)
+{
+	const std::vector<VkBufferCopy>& pendingCopies = this->pendingCopiesArray[i];
+	VkPipelineStageFlags worldReaders = VK_PIPELINE_STAGE_VERTEX_SHADER_BIT;
+	if (this->occlusionEnabled)
+		worldReaders |= VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+
+	// The previous frame may still be reading the world buffer in its vertex shaders.  Our copy has to wait for that;
+	// an execution dependency is enough for a write-after-read hazard.
+	vkCmdPipelineBarrier(givenCommandBuffer, worldReaders, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 0, nullptr);
+
+	vkCmdCopyBuffer(givenCommandBuffer, this->stagingBuffers[i], this->worldBuffer, (uint32_t)pendingCopies.size(), pendingCopies.data());
+
+	VkBufferMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.buffer = this->worldBuffer;
+	barrier.offset = 0;
+	barrier.size = VK_WHOLE_SIZE;
+	vkCmdPipelineBarrier(givenCommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, worldReaders, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+
+	// Only now are they done with.
+	this->pendingCopiesArray[i].clear();
+}
+
+void SceneRenderer::RecordOcclusionCulling(VkCommandBuffer givenCommandBuffer, uint32_t i)
+{
+	// Everything this reads from earlier frames (the pyramid, the depth buffer) already has a barrier after it.  But the
+	// drawn and deferred lists are shared with the previous frame, whose draw may still be reading them.
+	vkCmdPipelineBarrier(givenCommandBuffer, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 0, nullptr);
+
+	uint32_t candidateCount = this->visibleCountsArray[i];
+	uint32_t groupCount = (candidateCount + SCENE_CULL_GROUP_SIZE - 1) / SCENE_CULL_GROUP_SIZE;
+	VkExtent2D depthExtent = this->depthPyramid->GetExtent();
+
+	CullPushConstants pushConstants;
+	pushConstants.viewProjection = this->viewProjection;
+	pushConstants.depthSize = glm::vec2(float(depthExtent.width), float(depthExtent.height));
+	pushConstants.candidateOffset = i * this->sceneGraph.GetNodeCount();
+	pushConstants.candidateCount = candidateCount;
+	pushConstants.slot = i;
+	pushConstants.phase = 0;
+	pushConstants.pyramidValid = this->depthPyramid->IsValid() ? 1 : 0;
+
+	VkMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+	// First pass: against last frame's pyramid (or nothing, the first time), split the candidates into drawn and deferred.
+	vkCmdBindPipeline(givenCommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, this->cullPipeline);
+	vkCmdBindDescriptorSets(givenCommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, this->cullPipelineLayout, 0, 1, &this->cullDescriptorSet, 0, nullptr);
+	vkCmdPushConstants(givenCommandBuffer, this->cullPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pushConstants), &pushConstants);
+	if (groupCount > 0)
+		vkCmdDispatch(givenCommandBuffer, groupCount, 1, 1);
+
+	vkCmdPipelineBarrier(givenCommandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+	// Draw what passed into a fresh depth buffer, and build this frame's pyramid out of it.  What the second pass adds
+	// isn't in it, which only makes the next frame's first pass a little more cautious.
+	this->depthPyramid->BeginDepthPass(givenCommandBuffer);
+
+	vkCmdBindPipeline(givenCommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, this->app->pipelineCache->GetPipeline(this->depthPipelineId));
+	vkCmdBindDescriptorSets(givenCommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, this->pipelineLayout, 0, 1, &this->descriptorSet, 0, nullptr);
+	vkCmdPushConstants(givenCommandBuffer, this->pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(glm::mat4), &this->viewProjection);
+
+	vkCmdDrawIndexedIndirect(givenCommandBuffer, this->drawStateBuffer, i * sizeof(OcclusionDrawState), 1, sizeof(OcclusionDrawState));
+
+	this->depthPyramid->EndDepthPass(givenCommandBuffer);
+	this->depthPyramid->RecordBuild(givenCommandBuffer);
+
+	// Second pass: the rejects against the pyramid we just built, adding whatever passes to the same draw.
+	pushConstants.phase = 1;
+	pushConstants.pyramidValid = 1;
+
+	vkCmdBindPipeline(givenCommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, this->cullPipeline);
+	vkCmdBindDescriptorSets(givenCommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, this->cullPipelineLayout, 0, 1, &this->cullDescriptorSet, 0, nullptr);
+	vkCmdPushConstants(givenCommandBuffer, this->cullPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pushConstants), &pushConstants);
+	if (groupCount > 0)
+		vkCmdDispatch(givenCommandBuffer, groupCount, 1, 1);
+
+	vkCmdPipelineBarrier(givenCommandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+	this->occlusionPending[i] = true;
+}
+
+void SceneRenderer::RecordDraw(VkCommandBuffer givenCommandBuffer, uint32_t i)
+{
+	vkCmdBindPipeline(givenCommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, this->app->pipelineCache->GetPipeline(this->pipelineId));
+	vkCmdBindDescriptorSets(givenCommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, this->pipelineLayout, 0, 1, &this->descriptorSet, 0, nullptr);
+	vkCmdPushConstants(givenCommandBuffer, this->pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(glm::mat4), &this->viewProjection);
+
+	// With occlusion culling, the GPU has already written the draw, instance count and all.
+	if (this->occlusionEnabled)
+	{
+		vkCmdDrawIndexedIndirect(givenCommandBuffer, this->drawStateBuffer, i * sizeof(OcclusionDrawState), 1, sizeof(OcclusionDrawState));
+		return;
+	}
+
+	// The tutorial quad, once per visible node.  The first instance selects this frame slot's slice of the instance
+	// list, since gl_InstanceIndex counts from it.
+	const GeometryPool::Mesh& quad = this->app->geometryPool->GetMesh(this->app->quadMeshId);
+	if (this->visibleCountsArray[i] > 0)
+		vkCmdDrawIndexed(givenCommandBuffer, quad.indexCount, this->visibleCountsArray[i], quad.firstIndex, quad.vertexOffset, i * this->sceneGraph.GetNodeCount());
+}
@@ -0,0 +1,139 @@
+#pragma once
+
+#include "Application.h"
+#include "SceneGraph.h"
+#include "FrustumCuller.h"
+
+class DepthPyramid;
+
+// Draws every node of a SceneGraph as an instance of the tutorial quad.  The world matrices live in one device-local
+// storage buffer that persists across frames; each frame only the ranges the scene graph reports as changed are copied
+// into it (through that frame slot's staging buffer), and the view-projection goes in as a push constant, so a scene
+// that isn't moving costs no uploads at all.
+//
+// With culling on, each node also gets a world-space bounding box (refreshed along with its matrix), and every frame the
+// boxes are culled against the camera frustum on the CPU.  The survivors' indices go to the GPU as the instance list, so
+// only they get drawn.
+//
+// With occlusion culling on as well, the frustum survivors are only candidates, and the GPU decides which of them get
+// drawn, in two passes of a compute shader around a depth-only prepass of its own.  The first tests them against the
+// depth pyramid left by the last frame, and draws the ones that pass into a fresh depth buffer; the pyramid is rebuilt
+// from that, and the second pass retests the rejects against it, catching anything that has come into view since.  The
+// survivors of both are drawn with one indirect draw, whose instance count the GPU filled in, and the counts are read
+// back once the frame is done.  The scene can be stacked in layers, so there's something to be hidden.
+class SceneRenderer
+{
+public:
+	SceneRenderer(Application* app, uint32_t nodeCount, uint32_t animatedPercent, uint32_t layerCount, bool cullingEnabled, bool occlusionEnabled);
+	virtual ~SceneRenderer();
+
+	void Create();
+	void Destroy();
+	void Update(float deltaTime, uint32_t i, const glm::mat4& view, const glm::mat4& proj);
+	void RecordTransfers(VkCommandBuffer givenCommandBuffer, uint32_t i);
+	void RecordDraw(VkCommandBuffer givenCommandBuffer, uint32_t i);
+
+	// Call after the swap-chain has been recreated, with the device idle.
+	void Resize();
+
+	SceneGraph& GetSceneGraph() { return this->sceneGraph; }
+
+	// What slot i still has to upload.  Recording a command buffer that never gets submitted (the renderer benchmarks do)
+	// would otherwise use these up, so such a caller sets them aside and puts them back.
+	const std::vector<VkBufferCopy>& GetPendingCopies(uint32_t i) const { return this->pendingCopiesArray[i]; }
+	void SetPendingCopies(uint32_t i, const std::vector<VkBufferCopy>& pendingCopies) { this->pendingCopiesArray[i] = pendingCopies; }
+
+private:
+	// Must match DrawState in scene_cull.comp: an indexed indirect draw, then what the culling counted.
+	struct OcclusionDrawState
+	{
+		VkDrawIndexedIndirectCommand draw;
+		uint32_t deferredCount;
+		uint32_t disoccludedCount;
+		uint32_t unused;
+	};
+
+	struct CullPushConstants
+	{
+		glm::mat4 viewProjection;
+		glm::vec2 depthSize;
+		uint32_t candidateOffset;
+		uint32_t candidateCount;
+		uint32_t slot;
+		uint32_t phase;
+		uint32_t pyramidValid;
+	};
+
+	void BuildScene(uint32_t nodeCount);
+	void UpdateBounds(uint32_t begin, uint32_t end);
+	void CreateWorldBuffers();
+	void CreateDescriptorSet();
+	void CreateGraphicsPipeline();
+	void CreateOcclusionBuffers();
+	void CreateCullDescriptorSet();
+	void WritePyramidDescriptor();
+	void CreateCullPipeline();
+	void CollectOcclusionResults(uint32_t i);
+	void RecordWorldCopies(VkCommandBuffer givenCommandBuffer, uint32_t i);
+	void RecordOcclusionCulling(VkCommandBuffer givenCommandBuffer, uint32_t i);
+
+	Application* app;
+	uint32_t animatedPercent;
+	uint32_t layerCount;
+	bool cullingEnabled;
+	bool occlusionEnabled;
+	SceneGraph sceneGraph;
+	std::vector<SceneGraph::NodeId> animatedNodesArray;
+	float animationAngle;
+	glm::mat4 viewProjection;
+	FrustumCuller frustumCuller;
+	std::vector<float> boundsCenterX, boundsCenterY, boundsCenterZ;		// Indexed like the world matrices.
+	std::vector<float> boundsExtentX, boundsExtentY, boundsExtentZ;
+
+	VkBuffer worldBuffer;
+	VkDeviceMemory worldBufferMemory;
+	std::vector<VkBuffer> stagingBuffers;
+	std::vector<VkDeviceMemory> stagingBuffersMemory;
+	std::vector<float*> mappedStaging;
+	std::vector<std::vector<VkBufferCopy>> pendingCopiesArray;		// Per frame slot.
+	VkBuffer visibleBuffer;
+	VkDeviceMemory visibleBufferMemory;
+	uint32_t* mappedVisible;		// A node count's worth of indices per frame slot.
+	std::vector<uint32_t> visibleCountsArray;
+	VkDescriptorSetLayout descriptorSetLayout;
+	VkDescriptorPool descriptorPool;
+	VkDescriptorSet descriptorSet;
+	VkPipelineLayout pipelineLayout;
+	uint32_t pipelineId;		// From the application's pipeline cache, as is the depth one.
+
+	// Occlusion culling.  The drawn and deferred lists are shared by the frame slots, since an indirect draw can't start
+	// at a slot's slice without drawIndirectFirstInstance; the draw states are one per slot, and host-visible so the
+	// counts can be read straight back.
+	DepthPyramid* depthPyramid;
+	VkBuffer drawnBuffer;
+	VkDeviceMemory drawnBufferMemory;
+	VkBuffer deferredBuffer;
+	VkDeviceMemory deferredBufferMemory;
+	VkBuffer drawStateBuffer;
+	VkDeviceMemory drawStateBufferMemory;
+	OcclusionDrawState* mappedDrawStates;
+	std::vector<bool> occlusionPending;
+	VkDescriptorSetLayout cullDescriptorSetLayout;
+	VkDescriptorPool cullDescriptorPool;
+	VkDescriptorSet cullDescriptorSet;
+	VkPipelineLayout cullPipelineLayout;
+	VkPipeline cullPipeline;
+	uint32_t depthPipelineId;
+
+	uint32_t reportFrameCount;
+	double reportMilliseconds;
+	uint64_t reportNodesUpdated;
+	uint64_t reportRangesChanged;
+	double reportCullMilliseconds;
+	uint64_t reportTested;
+	uint64_t reportVisible;
+	uint32_t reportOcclusionFrames;
+	uint64_t reportOcclusionCandidates;
+	uint64_t reportOcclusionDrawn;
+	uint64_t reportDisoccluded;
+};
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "PipelineCache.h"
+#include <array>
+#include <cstring>
+#include <type_traits>
+#include <utility>
+
+// Shader variants as plain structs.  A shader declares its feature toggles as specialization constants, e.g.
+//
+//     layout(constant_id = 0) const bool USE_TEXTURE = true;
+//
+// and its variant struct lists which of its members feeds which constant id:
+//
+//     struct MyVariant
+//     {
+//         bool useTexture = true;
+//         using Constants = SpecializationConstants<SpecializationConstant<0, &MyVariant::useTexture>>;
+//     };
+//
+// ApplyShaderVariant then writes them into a PipelineState, so each variant is a pipeline of its own in the cache,
+// and the driver compiles out whatever paths the constants switch off.  The list is checked at compile time: each
+// member has to be a bool, int32_t, uint32_t or float (the 32-bit types a constant can be), ids can't repeat, and there
+// can't be more of them than a pipeline state holds.
+
+inline uint32_t PackSpecializationValue(bool value) { return value ? VK_TRUE : VK_FALSE; }
+inline uint32_t PackSpecializationValue(uint32_t value) { return value; }
+inline uint32_t PackSpecializationValue(int32_t value) { return uint32_t(value); }
+inline uint32_t PackSpecializationValue(float value) { uint32_t bits; ::memcpy(&bits, &value, sizeof(bits)); return bits; }
+
+template<uint32_t ConstantId, auto Member>
+struct SpecializationConstant
+{
+	static constexpr uint32_t id = ConstantId;
+
+	template<typename Variant>
+	static uint32_t Pack(const Variant& variant)
+	{
+		// Anything narrower would quietly promote to one of these, so only these are let through.
+		using MemberType = std::remove_cv_t<std::remove_reference_t<decltype(std::declval<Variant>().*Member)>>;
+		static_assert(std::is_same_v<MemberType, bool> || std::is_same_v<MemberType, int32_t> || std::is_same_v<MemberType, uint32_t> || std::is_same_v<MemberType, float>,
+			"Specialization constant members must be bool, int32_t, uint32_t or float!");
+
+		return PackSpecializationValue(variant.*Member);
+	}
+};
+
+template<typename... Constants>
+struct SpecializationConstants
+{
+	static constexpr uint32_t count = sizeof...(Constants);
+
+	static constexpr bool IdsAreUnique()
+	{
+		std::array<uint32_t, sizeof...(Constants)> idsArray = { Constants::id... };
+		for (uint32_t j = 0; j < count; j++)
+			for (uint32_t k = j + 1; k < count; k++)
+				if (idsArray[j] == idsArray[k])
+					return false;
+
+		return true;
+	}
+
+	static_assert(count <= PipelineState::MAX_SPECIALIZATION_CONSTANTS, "Too many specialization constants in shader variant!");
+	static_assert(IdsAreUnique(), "Specialization constant ids in shader variant must be unique!");
+
+	template<typename Variant>
+	static void Apply(const Variant& variant, PipelineState& state)
+	{
+		uint32_t j = 0;
+		((state.constantIds[j] = Constants::id, state.constantValues[j] = Constants::Pack(variant), j++), ...);
+		state.constantCount = count;
+	}
+};
+
+template<typename Variant>
+void ApplyShaderVariant(PipelineState& state, const Variant& variant)
+{
+	Variant::Constants::Apply(variant, state);
+}
@@ -0,0 +1,448 @@
+#include "SpriteBatch.h"
+#include "MemoryTracker.h"
+#include "ThreadPool.h"
+#include "PipelineCache.h"
+#include "TextureResidency.h"
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SPRITE_BATCH_SSE2
+#include <emmintrin.h>
+#endif
+
+const uint32_t SPRITE_MAX_TEXTURES = 64;
+const size_t SPRITE_MIN_BATCH_SIZE = 16 * 1024;		// Don't bother the thread pool with less than this many quads per batch.
+const uint32_t SPRITE_REPORT_INTERVAL = 240;
+
+SpriteBatch::SpriteBatch(Application* app, uint32_t maxSprites)
+{
+	this->app = app;
+	this->maxSprites = maxSprites;
+	this->currentFrame = 0;
+	this->indexBuffer = VK_NULL_HANDLE;
+	this->indexBufferMemory = nullptr;
+	this->descriptorSetLayout = VK_NULL_HANDLE;
+	this->descriptorPool = VK_NULL_HANDLE;
+	this->pipelineLayout = VK_NULL_HANDLE;
+	for (uint32_t i = 0; i < BLEND_MODE_COUNT; i++)
+		this->pipelineIds[i] = 0;
+	this->statistics = Statistics{};
+	this->reportFrameCount = 0;
+	this->reportMilliseconds = 0.0;
+	this->reportDrawCalls = 0;
+}
+
+/*virtual*/ SpriteBatch::~SpriteBatch()
+{
+}
+
+void SpriteBatch::Create()
+{
+	this->spritesArray.reserve(this->maxSprites);
+	this->sortedIndicesArray.resize(this->maxSprites);
+
+	this->CreateVertexBuffers();
+	this->CreateIndexBuffer();
+	this->CreateDescriptorSetLayout();
+	this->CreatePipelines();
+
+	std::cout << "Sprite batch: up to " << this->maxSprites << " sprites, "
+		<< (this->maxSprites * 4 * sizeof(SpriteVertex)) / (1024 * 1024) << " MiB streaming vertex buffer per frame" << std::endl;
+}
+
+void SpriteBatch::Destroy()
+{
+	VkDevice logicalDevice = this->app->logicalDevice;
+
+	for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+	{
+		vkUnmapMemory(logicalDevice, this->vertexBuffersMemory[i]);
+		vkDestroyBuffer(logicalDevice, this->vertexBuffers[i], nullptr);
+		this->app->memoryTracker->Free(this->vertexBuffersMemory[i]);
+	}
+
+	vkDestroyBuffer(logicalDevice, this->indexBuffer, nullptr);
+	this->app->memoryTracker->Free(this->indexBufferMemory);
+
+	// The pipelines belong to the pipeline cache, and the descriptor sets go away with the pool.
+	vkDestroyPipelineLayout(logicalDevice, this->pipelineLayout, nullptr);
+	vkDestroyDescriptorPool(logicalDevice, this->descriptorPool, nullptr);
+	vkDestroyDescriptorSetLayout(logicalDevice, this->descriptorSetLayout, nullptr);
+}
+
+void SpriteBatch::CreateVertexBuffers()
+{
+	VkDeviceSize bufferSize = sizeof(SpriteVertex) * 4 * (VkDeviceSize)this->maxSprites;
+
+	this->vertexBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+	this->vertexBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
+	this->mappedVertices.resize(MAX_FRAMES_IN_FLIGHT);
+
+	// These stay mapped for their whole lifetime.  Each frame slot has its own buffer, so the CPU can fill one while the
+	// GPU is still reading the other, and being coherent, there is nothing to flush after writing.
+	for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+	{
+		this->app->CreateBuffer(bufferSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, this->vertexBuffers[i], this->vertexBuffersMemory[i]);
+
+		void* data = nullptr;
+		if (VK_SUCCESS != vkMapMemory(this->app->logicalDevice, this->vertexBuffersMemory[i], 0, bufferSize, 0, &data))
+			throw new std::runtime_error("Failed to map sprite vertex buffer!");
+
+		this->mappedVertices[i] = static_cast<SpriteVertex*>(data);
+	}
+}
+
+void SpriteBatch::CreateIndexBuffer()
+{
+	// Every quad has the same topology, so one index buffer covering the most quads we'll ever draw serves every run;
+	// a run just starts at its first quad's indices.
+	std::vector<uint32_t> quadIndicesArray((size_t)this->maxSprites * 6);
+	for (uint32_t j = 0; j < this->maxSprites; j++)
+	{
+		uint32_t* quadIndices = &quadIndicesArray[(size_t)j * 6];
+		uint32_t baseVertex = j * 4;
+		quadIndices[0] = baseVertex + 0;
+		quadIndices[1] = baseVertex + 1;
+		quadIndices[2] = baseVertex + 2;
+		quadIndices[3] = baseVertex + 2;
+		quadIndices[4] = baseVertex + 3;
+		quadIndices[5] = baseVertex + 0;
+	}
+
+	this->app->CreateGeneralBuffer(quadIndicesArray.data(), sizeof(uint32_t) * quadIndicesArray.size(), VK_BUFFER_USAGE_INDEX_BUFFER_BIT, this->indexBuffer, this->indexBufferMemory);
+}
+
+void SpriteBatch::CreateDescriptorSetLayout()
+{
+	VkDescriptorSetLayoutBinding samplerLayoutBinding{};
+	samplerLayoutBinding.binding = 0;
+	samplerLayoutBinding.descriptorCount = 1;
+	samplerLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	samplerLayoutBinding.pImmutableSamplers = nullptr;
+	samplerLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo{};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.bindingCount = 1;
+	layoutInfo.pBindings = &samplerLayoutBinding;
+
+	if (VK_SUCCESS != vkCreateDescriptorSetLayout(this->app->logicalDevice, &layoutInfo, nullptr, &this->descriptorSetLayout))
+		throw new std::runtime_error("Failed to create sprite descriptor set layout!");
+
+	VkDescriptorPoolSize poolSize{};
+	poolSize.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	poolSize.descriptorCount = SPRITE_MAX_TEXTURES;
+
+	VkDescriptorPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.poolSizeCount = 1;
+	poolInfo.pPoolSizes = &poolSize;
+	poolInfo.maxSets = SPRITE_MAX_TEXTURES;
+
+	if (VK_SUCCESS != vkCreateDescriptorPool(this->app->logicalDevice, &poolInfo, nullptr, &this->descriptorPool))
+		throw new std::runtime_error("Failed to create sprite descriptor pool!");
+}
+
+void SpriteBatch::CreatePipelines()
+{
+	VkPushConstantRange pushConstantRange{};
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+	pushConstantRange.offset = 0;
+	pushConstantRange.size = sizeof(glm::vec2);
+
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount = 1;
+	pipelineLayoutInfo.pSetLayouts = &this->descriptorSetLayout;
+	pipelineLayoutInfo.pushConstantRangeCount = 1;
+	pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+	if (VK_SUCCESS != vkCreatePipelineLayout(this->app->logicalDevice, &pipelineLayoutInfo, nullptr, &this->pipelineLayout))
+		throw new std::runtime_error("Failed to create sprite pipeline layout!");
+
+	PipelineCache* pipelineCache = this->app->pipelineCache;
+
+	PipelineState state;
+	state.layout = this->pipelineLayout;
+	state.vertexShader = pipelineCache->AddShader(Application::ReadFile("sprite_vert.spv"));
+	state.fragmentShader = pipelineCache->AddShader(Application::ReadFile("sprite_frag.spv"));
+	state.colorFormat = this->app->swapChainImageFormat;
+
+	// Rotated sprites can end up with either winding, so no culling.
+	state.cullMode = VK_CULL_MODE_NONE;
+	state.frontFace = VK_FRONT_FACE_CLOCKWISE;
+
+	VkVertexInputBindingDescription bindingDescription{};
+	bindingDescription.binding = 0;
+	bindingDescription.stride = sizeof(SpriteVertex);
+	bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+	state.AddVertexBinding(bindingDescription);
+
+	state.AddVertexAttribute(VkVertexInputAttributeDescription{ 0, 0, VK_FORMAT_R32G32_SFLOAT, offsetof(SpriteVertex, x) });
+	state.AddVertexAttribute(VkVertexInputAttributeDescription{ 1, 0, VK_FORMAT_R32G32_SFLOAT, offsetof(SpriteVertex, u) });
+	state.AddVertexAttribute(VkVertexInputAttributeDescription{ 2, 0, VK_FORMAT_R8G8B8A8_UNORM, offsetof(SpriteVertex, color) });
+
+	// The two pipelines differ only in their blend state, and share the layout so descriptor bindings survive switching
+	// between them.  They're only requested here; the cache compiles them when it's prewarmed, or else the first time
+	// RecordDraw needs them.
+	for (uint32_t blendMode = 0; blendMode < BLEND_MODE_COUNT; blendMode++)
+	{
+		if (blendMode == BLEND_ADDITIVE)
+			state.SetAdditiveBlend();
+		else
+			state.SetAlphaBlend();
+
+		this->pipelineIds[blendMode] = pipelineCache->Request(state);
+	}
+}
+
+uint16_t SpriteBatch::RegisterTexture(VkImageView imageView, VkSampler sampler)
+{
+	// Texture ids are baked into the sort keys, so register everything up front rather than between Begin and End.
+	if (this->textureDescriptorSets.size() >= SPRITE_MAX_TEXTURES)
+		throw new std::runtime_error("Too many sprite textures registered!");
+
+	VkDescriptorSetAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = this->descriptorPool;
+	allocInfo.descriptorSetCount = 1;
+	allocInfo.pSetLayouts = &this->descriptorSetLayout;
+
+	VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+	if (VK_SUCCESS != vkAllocateDescriptorSets(this->app->logicalDevice, &allocInfo, &descriptorSet))
+		throw new std::runtime_error("Failed to allocate sprite descriptor set!");
+
+	VkDescriptorImageInfo imageInfo{};
+	imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	imageInfo.imageView = imageView;
+	imageInfo.sampler = sampler;
+
+	VkWriteDescriptorSet descriptorWrite{};
+	descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	descriptorWrite.dstSet = descriptorSet;
+	descriptorWrite.dstBinding = 0;
+	descriptorWrite.dstArrayElement = 0;
+	descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	descriptorWrite.descriptorCount = 1;
+	descriptorWrite.pImageInfo = &imageInfo;
+
+	vkUpdateDescriptorSets(this->app->logicalDevice, 1, &descriptorWrite, 0, nullptr);
+
+	this->textureDescriptorSets.push_back(descriptorSet);
+	this->textureResidencyArray.push_back(nullptr);
+	this->residentIdsArray.push_back(0);
+	return (uint16_t)(this->textureDescriptorSets.size() - 1);
+}
+
+uint16_t SpriteBatch::RegisterResidentTexture(TextureResidency* residency, uint32_t residentId)
+{
+	if (this->textureDescriptorSets.size() >= SPRITE_MAX_TEXTURES)
+		throw new std::runtime_error("Too many sprite textures registered!");
+
+	this->textureDescriptorSets.push_back(VK_NULL_HANDLE);
+	this->textureResidencyArray.push_back(residency);
+	this->residentIdsArray.push_back(residentId);
+	return (uint16_t)(this->textureDescriptorSets.size() - 1);
+}
+
+void SpriteBatch::Begin(uint32_t i)
+{
+	// The caller must have waited on frame slot i's fence, since we're about to overwrite its vertex buffer.
+	this->currentFrame = i;
+	this->spritesArray.clear();
+	this->drawRunsArray.clear();
+	this->statistics = Statistics{};
+}
+
+void SpriteBatch::Draw(const Sprite& sprite)
+{
+	if (sprite.textureId >= this->textureDescriptorSets.size() || sprite.blendMode >= BLEND_MODE_COUNT)
+		throw new std::runtime_error("Sprite has an unregistered texture or unknown blend mode!");
+
+	if (this->spritesArray.size() >= this->maxSprites)
+	{
+		this->statistics.droppedCount++;
+		return;
+	}
+
+	this->spritesArray.push_back(sprite);
+}
+
+void SpriteBatch::End()
+{
+	auto startTime = std::chrono::high_resolution_clock::now();
+
+	this->statistics.spriteCount = (uint32_t)this->spritesArray.size();
+	this->SortSprites();
+
+	// Every sprite's quad has a fixed place in the vertex buffer once sorted, so the quads can be written from any number
+	// of threads without coordination.
+	size_t spriteCount = this->spritesArray.size();
+	if (this->app->threadPool)
+		this->app->threadPool->ParallelFor(spriteCount, SPRITE_MIN_BATCH_SIZE, [this](size_t begin, size_t end) { this->GenerateVertices(begin, end); });
+	else
+		this->GenerateVertices(0, spriteCount);
+
+	auto endTime = std::chrono::high_resolution_clock::now();
+
+	this->reportFrameCount++;
+	this->reportMilliseconds += std::chrono::duration<double, std::milli>(endTime - startTime).count();
+	this->reportDrawCalls += (uint32_t)this->drawRunsArray.size();
+
+	if (this->reportFrameCount == SPRITE_REPORT_INTERVAL)
+	{
+		std::cout << "Sprites: " << this->statistics.spriteCount
+			<< " | build " << this->reportMilliseconds / double(this->reportFrameCount) << " ms"
+			<< " | draws " << double(this->reportDrawCalls) / double(this->reportFrameCount)
+			<< (this->statistics.droppedCount > 0 ? " | dropped " + std::to_string(this->statistics.droppedCount) : "") << std::endl;
+
+		this->reportFrameCount = 0;
+		this->reportMilliseconds = 0.0;
+		this->reportDrawCalls = 0;
+	}
+}
+
+void SpriteBatch::SortSprites()
+{
+	// There are only ever a handful of distinct keys, so a counting sort beats a comparison sort by a wide margin here,
+	// and being stable, it keeps sprites of the same key in the order they were drawn.  Keys are ordered by blend mode
+	// first, so the pipeline changes at most once per blend mode; within that, by texture.
+	uint32_t textureCount = (uint32_t)this->textureDescriptorSets.size();
+	uint32_t keyCount = BLEND_MODE_COUNT * textureCount;
+
+	this->bucketOffsetsArray.assign(keyCount + 1, 0);
+
+	for (const Sprite& sprite : this->spritesArray)
+		this->bucketOffsetsArray[sprite.blendMode * textureCount + sprite.textureId + 1]++;
+
+	for (uint32_t key = 0; key < keyCount; key++)
+	{
+		uint32_t spriteCount = this->bucketOffsetsArray[key + 1];
+		this->bucketOffsetsArray[key + 1] += this->bucketOffsetsArray[key];
+
+		if (spriteCount > 0)
+			this->drawRunsArray.push_back(DrawRun{ key, this->bucketOffsetsArray[key], spriteCount });
+	}
+
+	for (uint32_t j = 0; j < (uint32_t)this->spritesArray.size(); j++)
+	{
+		const Sprite& sprite = this->spritesArray[j];
+		this->sortedIndicesArray[this->bucketOffsetsArray[sprite.blendMode * textureCount + sprite.textureId]++] = j;
+	}
+}
+
+void SpriteBatch::GenerateVertices(size_t begin, size_t end)
+{
+	SpriteVertex* vertices = this->mappedVertices[this->currentFrame];
+
+	for (size_t j = begin; j < end; j++)
+		WriteQuad(this->spritesArray[this->sortedIndicesArray[j]], &vertices[j * 4]);
+}
+
+/*static*/ void SpriteBatch::WriteQuad(const Sprite& sprite, SpriteVertex* vertex)
+{
+	// Most sprites aren't rotated, so skip the trig for those.
+	float c = 1.0f, s = 0.0f;
+	if (sprite.rotation != 0.0f)
+	{
+		c = ::cosf(sprite.rotation);
+		s = ::sinf(sprite.rotation);
+	}
+
+	float halfWidth = 0.5f * sprite.size.x;
+	float halfHeight = 0.5f * sprite.size.y;
+
+	// Corners go (-,-), (+,-), (+,+), (-,+), matching the winding of the quad indices.
+#if defined(SPRITE_BATCH_SSE2)
+	// All four corners at once, one per lane.  Note that _mm_set_ps takes its lanes highest first.
+	__m128 cornerX = _mm_set_ps(-halfWidth, halfWidth, halfWidth, -halfWidth);
+	__m128 cornerY = _mm_set_ps(halfHeight, halfHeight, -halfHeight, -halfHeight);
+	__m128 cosine = _mm_set1_ps(c);
+	__m128 sine = _mm_set1_ps(s);
+
+	__m128 x = _mm_add_ps(_mm_set1_ps(sprite.position.x), _mm_sub_ps(_mm_mul_ps(cornerX, cosine), _mm_mul_ps(cornerY, sine)));
+	__m128 y = _mm_add_ps(_mm_set1_ps(sprite.position.y), _mm_add_ps(_mm_mul_ps(cornerX, sine), _mm_mul_ps(cornerY, cosine)));
+	__m128 u = _mm_set_ps(sprite.uvRect.x, sprite.uvRect.z, sprite.uvRect.z, sprite.uvRect.x);
+	__m128 v = _mm_set_ps(sprite.uvRect.w, sprite.uvRect.w, sprite.uvRect.y, sprite.uvRect.y);
+
+	// Transpose from four lanes of x, y, u and v into four (x, y, u, v) vertices.
+	__m128 xy01 = _mm_unpacklo_ps(x, y);
+	__m128 xy23 = _mm_unpackhi_ps(x, y);
+	__m128 uv01 = _mm_unpacklo_ps(u, v);
+	__m128 uv23 = _mm_unpackhi_ps(u, v);
+
+	_mm_storeu_ps(&vertex[0].x, _mm_movelh_ps(xy01, uv01));
+	_mm_storeu_ps(&vertex[1].x, _mm_movehl_ps(uv01, xy01));
+	_mm_storeu_ps(&vertex[2].x, _mm_movelh_ps(xy23, uv23));
+	_mm_storeu_ps(&vertex[3].x, _mm_movehl_ps(uv23, xy23));
+#else
+	const float cornerX[4] = { -halfWidth, halfWidth, halfWidth, -halfWidth };
+	const float cornerY[4] = { -halfHeight, -halfHeight, halfHeight, halfHeight };
+	const float u[4] = { sprite.uvRect.x, sprite.uvRect.z, sprite.uvRect.z, sprite.uvRect.x };
+	const float v[4] = { sprite.uvRect.y, sprite.uvRect.y, sprite.uvRect.w, sprite.uvRect.w };
+
+	for (int k = 0; k < 4; k++)
+	{
+		vertex[k].x = sprite.position.x + cornerX[k] * c - cornerY[k] * s;
+		vertex[k].y = sprite.position.y + cornerX[k] * s + cornerY[k] * c;
+		vertex[k].u = u[k];
+		vertex[k].v = v[k];
+	}
+#endif
+
+	vertex[0].color = sprite.color;
+	vertex[1].color = sprite.color;
+	vertex[2].color = sprite.color;
+	vertex[3].color = sprite.color;
+}
+
+void SpriteBatch::RecordDraw(VkCommandBuffer givenCommandBuffer, uint32_t i)
+{
+	if (this->drawRunsArray.empty())
+		return;
+
+	// Sprites are positioned in pixels; the vertex shader scales them into clip space.
+	glm::vec2 pixelToClip(2.0f / float(this->app->swapChainExtent.width), 2.0f / float(this->app->swapChainExtent.height));
+
+	VkDeviceSize offset = 0;
+	vkCmdBindVertexBuffers(givenCommandBuffer, 0, 1, &this->vertexBuffers[i], &offset);
+	vkCmdBindIndexBuffer(givenCommandBuffer, this->indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+
+	uint32_t textureCount = (uint32_t)this->textureDescriptorSets.size();
+	uint32_t boundBlendMode = BLEND_MODE_COUNT;
+	uint32_t boundTextureId = textureCount;
+
+	for (const DrawRun& drawRun : this->drawRunsArray)
+	{
+		uint32_t blendMode = drawRun.key / textureCount;
+		uint32_t textureId = drawRun.key % textureCount;
+
+		if (blendMode != boundBlendMode)
+		{
+			vkCmdBindPipeline(givenCommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, this->app->pipelineCache->GetPipeline(this->pipelineIds[blendMode]));
+			if (boundBlendMode == BLEND_MODE_COUNT)
+				vkCmdPushConstants(givenCommandBuffer, this->pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(pixelToClip), &pixelToClip);
+
+			boundBlendMode = blendMode;
+			this->statistics.pipelineBinds++;
+		}
+
+		if (textureId != boundTextureId)
+		{
+			// Drawing with a resident texture is what keeps it resident.
+			VkDescriptorSet descriptorSet = this->textureDescriptorSets[textureId];
+			TextureResidency* residency = this->textureResidencyArray[textureId];
+			if (residency)
+			{
+				residency->Touch(this->residentIdsArray[textureId]);
+				descriptorSet = residency->GetDescriptorSet(this->residentIdsArray[textureId], i);
+			}
+
+			vkCmdBindDescriptorSets(givenCommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, this->pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+			boundTextureId = textureId;
+			this->statistics.descriptorBinds++;
+		}
+
+		vkCmdDrawIndexed(givenCommandBuffer, drawRun.spriteCount * 6, 1, drawRun.firstSprite * 6, 0, 0);
+		this->statistics.drawCalls++;
+	}
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include "Application.h"
+
+class TextureResidency;
+
+// Batches large numbers of dynamic 2D sprites into as few draws as possible.  Each frame the sprites are bucketed by
+// their (pipeline, texture) key with a counting sort, which keeps submission order within a key, and their quads are
+// generated straight into a persistently mapped vertex buffer belonging to that frame slot.  All quads share one static
+// index buffer, so a whole run of same-key sprites is a single vkCmdDrawIndexed.
+class SpriteBatch
+{
+public:
+	enum BlendMode : uint32_t
+	{
+		BLEND_ALPHA = 0,
+		BLEND_ADDITIVE = 1,
+		BLEND_MODE_COUNT = 2
+	};
+
+	struct Sprite
+	{
+		glm::vec2 position;		// Center, in pixels from the top-left of the window.
+		glm::vec2 size;			// In pixels.
+		float rotation;			// Radians, about the center.
+		glm::vec4 uvRect;		// (u0, v0, u1, v1)
+		uint32_t color;			// 0xAABBGGRR, multiplied with the texture.
+		uint16_t textureId;		// From RegisterTexture.
+		uint16_t blendMode;
+	};
+
+	struct Statistics
+	{
+		uint32_t spriteCount;
+		uint32_t droppedCount;
+		uint32_t drawCalls;
+		uint32_t pipelineBinds;
+		uint32_t descriptorBinds;
+	};
+
+	SpriteBatch(Application* app, uint32_t maxSprites);
+	virtual ~SpriteBatch();
+
+	void Create();
+	void Destroy();
+	uint16_t RegisterTexture(VkImageView imageView, VkSampler sampler);
+
+	// A texture whose memory is managed by the given residency cache, which must use our descriptor set layout.
+	uint16_t RegisterResidentTexture(TextureResidency* residency, uint32_t residentId);
+	VkDescriptorSetLayout GetDescriptorSetLayout() const { return this->descriptorSetLayout; }
+
+	void Begin(uint32_t i);
+	void Draw(const Sprite& sprite);
+	void End();
+	void RecordDraw(VkCommandBuffer givenCommandBuffer, uint32_t i);
+
+	const Statistics& GetStatistics() const { return this->statistics; }
+
+private:
+	// Must match the vertex inputs of sprite.vert.
+	struct SpriteVertex
+	{
+		float x, y;
+		float u, v;
+		uint32_t color;
+	};
+
+	struct DrawRun
+	{
+		uint32_t key;
+		uint32_t firstSprite;
+		uint32_t spriteCount;
+	};
+
+	void CreateVertexBuffers();
+	void CreateIndexBuffer();
+	void CreateDescriptorSetLayout();
+	void CreatePipelines();
+	void SortSprites();
+	void GenerateVertices(size_t begin, size_t end);
+
+	static void WriteQuad(const Sprite& sprite, SpriteVertex* vertex);
+
+	Application* app;
+	uint32_t maxSprites;
+	uint32_t currentFrame;
+
+	std::vector<VkBuffer> vertexBuffers;
+	std::vector<VkDeviceMemory> vertexBuffersMemory;
+	std::vector<SpriteVertex*> mappedVertices;
+	VkBuffer indexBuffer;
+	VkDeviceMemory indexBufferMemory;
+	VkDescriptorSetLayout descriptorSetLayout;
+	VkDescriptorPool descriptorPool;
+	std::vector<VkDescriptorSet> textureDescriptorSets;			// Null for resident textures, which are looked up per frame slot.
+	std::vector<TextureResidency*> textureResidencyArray;
+	std::vector<uint32_t> residentIdsArray;
+	VkPipelineLayout pipelineLayout;
+	uint32_t pipelineIds[BLEND_MODE_COUNT];		// From the application's pipeline cache.
+
+	std::vector<Sprite> spritesArray;
+	std::vector<uint32_t> sortedIndicesArray;
+	std::vector<uint32_t> bucketOffsetsArray;
+	std::vector<DrawRun> drawRunsArray;
+	Statistics statistics;
+	uint32_t reportFrameCount;
+	double reportMilliseconds;
+	uint32_t reportDrawCalls;
+};
@@ -0,0 +1,199 @@
+#include "TaskGraph.h"
+#include <algorithm>
+#include <iomanip>
+#include <map>
+#include <stdexcept>
+
+TaskGraph::TaskGraph()
+{
+	this->finishedCount = 0;
+	this->runningCount = 0;
+}
+
+/*virtual*/ TaskGraph::~TaskGraph()
+{
+}
+
+TaskGraph::TaskId TaskGraph::AddTask(const std::string& name, std::function<void()> function, const std::vector<TaskId>& dependenciesArray /*= {}*/, bool mainThreadOnly /*= false*/)
+{
+	TaskId taskId = this->tasksArray.size();
+
+	Task task;
+	task.name = name;
+	task.function = std::move(function);
+	task.dependencyCount = (uint32_t)dependenciesArray.size();
+	task.mainThreadOnly = mainThreadOnly;
+	this->tasksArray.push_back(std::move(task));
+
+	// Dependencies always refer to tasks added earlier, so the graph can't have cycles.
+	for (TaskId dependencyId : dependenciesArray)
+	{
+		if (dependencyId >= taskId)
+			throw new std::invalid_argument("Task dependencies must be added before the tasks that depend on them!");
+
+		this->tasksArray[dependencyId].dependentsArray.push_back(taskId);
+	}
+
+	return taskId;
+}
+
+void TaskGraph::Run(ThreadPool* threadPool)
+{
+	std::unique_lock<std::mutex> lock(this->mutex);
+
+	this->mainThreadId = std::this_thread::get_id();
+	this->runStartTime = std::chrono::high_resolution_clock::now();
+	this->finishedCount = 0;
+	this->runningCount = 0;
+	this->firstException = nullptr;
+	this->mainThreadQueue.clear();
+
+	this->remainingDependenciesArray.resize(this->tasksArray.size());
+	for (TaskId taskId = 0; taskId < this->tasksArray.size(); taskId++)
+		this->remainingDependenciesArray[taskId] = this->tasksArray[taskId].dependencyCount;
+
+	for (TaskId taskId = 0; taskId < this->tasksArray.size(); taskId++)
+		if (this->remainingDependenciesArray[taskId] == 0)
+			this->Schedule(taskId, threadPool);
+
+	// Service the main-thread queue until nothing is left in flight.
+	while (true)
+	{
+		this->condition.wait(lock, [this]() { return !this->mainThreadQueue.empty() || this->runningCount == 0; });
+
+		if (!this->mainThreadQueue.empty())
+		{
+			TaskId taskId = this->mainThreadQueue.front();
+			this->mainThreadQueue.pop_front();
+
+			lock.unlock();
+			this->Execute(taskId, threadPool);
+			lock.lock();
+			continue;
+		}
+
+		break;
+	}
+
+	this->runEndTime = std::chrono::high_resolution_clock::now();
+
+	if (this->firstException)
+		std::rethrow_exception(this->firstException);
+}
+
+// Call with the mutex held.
+void TaskGraph::Schedule(TaskId taskId, ThreadPool* threadPool)
+{
+	this->runningCount++;
+
+	if (threadPool == nullptr || this->tasksArray[taskId].mainThreadOnly)
+	{
+		this->mainThreadQueue.push_back(taskId);
+		this->condition.notify_all();
+	}
+	else
+	{
+		threadPool->Submit([this, taskId, threadPool]() { this->Execute(taskId, threadPool); });
+	}
+}
+
+// Call without the mutex held.
+void TaskGraph::Execute(TaskId taskId, ThreadPool* threadPool)
+{
+	Task& task = this->tasksArray[taskId];
+
+	bool skip = false;
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		skip = (this->firstException != nullptr);
+	}
+
+	std::exception_ptr exception;
+
+	task.threadId = std::this_thread::get_id();
+	task.startTime = std::chrono::high_resolution_clock::now();
+
+	if (!skip)
+	{
+		try
+		{
+			task.function();
+		}
+		catch (...)
+		{
+			exception = std::current_exception();
+		}
+	}
+
+	task.endTime = std::chrono::high_resolution_clock::now();
+
+	std::lock_guard<std::mutex> lock(this->mutex);
+
+	this->runningCount--;
+	this->finishedCount++;
+
+	if (exception && !this->firstException)
+		this->firstException = exception;
+
+	if (!skip && !exception)
+	{
+		for (TaskId dependentId : task.dependentsArray)
+			if (--this->remainingDependenciesArray[dependentId] == 0)
+				this->Schedule(dependentId, threadPool);
+	}
+
+	this->condition.notify_all();
+}
+
+void TaskGraph::PrintTimings(std::ostream& stream) const
+{
+	auto toMilliseconds = [](std::chrono::high_resolution_clock::duration duration)
+	{
+		return std::chrono::duration<double, std::milli>(duration).count();
+	};
+
+	std::vector<const Task*> sortedArray;
+	for (const Task& task : this->tasksArray)
+		sortedArray.push_back(&task);
+
+	std::sort(sortedArray.begin(), sortedArray.end(), [](const Task* a, const Task* b) { return a->startTime < b->startTime; });
+
+	double totalTaskTime = 0.0;
+	for (const Task* task : sortedArray)
+		totalTaskTime += toMilliseconds(task->endTime - task->startTime);
+
+	double wallTime = toMilliseconds(this->runEndTime - this->runStartTime);
+
+	std::ios_base::fmtflags flags = stream.flags();
+	std::streamsize precision = stream.precision();
+
+	stream << "Startup timing breakdown (wall " << std::fixed << std::setprecision(2) << wallTime << " ms, tasks " << totalTaskTime << " ms):\n";
+	stream << "\t   start      time  thread    task\n";
+
+	// Give the worker threads small stable numbers in order of first appearance.
+	std::map<std::thread::id, int> workerNumbers;
+
+	for (const Task* task : sortedArray)
+	{
+		std::string threadName;
+		if (task->threadId == this->mainThreadId)
+			threadName = "main";
+		else
+		{
+			auto iter = workerNumbers.find(task->threadId);
+			if (iter == workerNumbers.end())
+				iter = workerNumbers.insert(std::make_pair(task->threadId, (int)workerNumbers.size() + 1)).first;
+			threadName = "worker" + std::to_string(iter->second);
+		}
+
+		stream << '\t'
+			<< std::setw(8) << toMilliseconds(task->startTime - this->runStartTime) << "  "
+			<< std::setw(8) << toMilliseconds(task->endTime - task->startTime) << "  "
+			<< std::setw(8) << std::left << threadName << std::right << "  "
+			<< task->name << '\n';
+	}
+
+	stream << std::flush;
+	stream.flags(flags);
+	stream.precision(precision);
+}
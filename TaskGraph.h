@@ -0,0 +1,57 @@
+#pragma once
+
+#include "ThreadPool.h"
+#include <string>
+#include <chrono>
+#include <iostream>
+#include <exception>
+
+// A one-shot dependency graph of named tasks.  Tasks become runnable once everything they depend on has finished, and
+// runnable tasks go to the thread pool, except those flagged main-thread-only (e.g., anything that calls into GLFW),
+// which the thread calling Run picks up itself.  Each task's start and end times are recorded so we can see where
+// the time went afterwards.
+class TaskGraph
+{
+public:
+	typedef size_t TaskId;
+
+	TaskGraph();
+	virtual ~TaskGraph();
+
+	TaskId AddTask(const std::string& name, std::function<void()> function, const std::vector<TaskId>& dependenciesArray = {}, bool mainThreadOnly = false);
+
+	// Blocks until every task has run.  With no pool, everything runs on the calling thread in dependency order,
+	// which is handy for comparing against the parallel timings.  If any task throws, no further tasks are started,
+	// and the first exception is rethrown here once the ones already running have finished.
+	void Run(ThreadPool* threadPool);
+
+	void PrintTimings(std::ostream& stream) const;
+
+private:
+	struct Task
+	{
+		std::string name;
+		std::function<void()> function;
+		std::vector<TaskId> dependentsArray;
+		uint32_t dependencyCount;
+		bool mainThreadOnly;
+		std::chrono::high_resolution_clock::time_point startTime;
+		std::chrono::high_resolution_clock::time_point endTime;
+		std::thread::id threadId;
+	};
+
+	void Schedule(TaskId taskId, ThreadPool* threadPool);
+	void Execute(TaskId taskId, ThreadPool* threadPool);
+
+	std::vector<Task> tasksArray;
+	std::vector<uint32_t> remainingDependenciesArray;
+	std::deque<TaskId> mainThreadQueue;
+	size_t finishedCount;
+	size_t runningCount;
+	std::exception_ptr firstException;
+	std::mutex mutex;
+	std::condition_variable condition;
+	std::thread::id mainThreadId;
+	std::chrono::high_resolution_clock::time_point runStartTime;
+	std::chrono::high_resolution_clock::time_point runEndTime;
+};
@@ -0,0 +1,351 @@
+#include "TextureAtlas.h"
+#include "MemoryTracker.h"
+#include <algorithm>
+#include <numeric>
+#include <cmath>
+#include <cstring>
+
+const VkFormat ATLAS_FORMAT = VK_FORMAT_R8G8B8A8_SRGB;
+
+static float SrgbToLinear(uint8_t value)
+{
+	float c = float(value) / 255.0f;
+	return (c <= 0.04045f) ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+}
+
+static uint8_t LinearToSrgb(float c)
+{
+	c = (c <= 0.0031308f) ? c * 12.92f : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+	return (uint8_t)std::min(std::max(c * 255.0f + 0.5f, 0.0f), 255.0f);
+}
+
+TextureAtlas::TextureAtlas(Application* app, uint32_t layerSize, uint32_t padding, uint32_t mipLevels)
+{
+	this->app = app;
+	this->layerSize = layerSize;
+	this->padding = padding;
+	this->mipLevels = std::max(mipLevels, 1u);
+	this->image = VK_NULL_HANDLE;
+	this->imageMemory = nullptr;
+	this->arrayView = VK_NULL_HANDLE;
+	this->sampler = VK_NULL_HANDLE;
+
+	// The smallest mip has to be at least one texel across.
+	while ((this->layerSize >> (this->mipLevels - 1)) == 0)
+		this->mipLevels--;
+}
+
+/*virtual*/ TextureAtlas::~TextureAtlas()
+{
+}
+
+uint32_t TextureAtlas::AddImage(const uint8_t* pixels, uint32_t width, uint32_t height)
+{
+	PendingImage pendingImage;
+	pendingImage.width = width;
+	pendingImage.height = height;
+	pendingImage.pixels.assign(pixels, pixels + 4 * (size_t)width * height);
+	this->pendingImagesArray.push_back(std::move(pendingImage));
+
+	return (uint32_t)this->pendingImagesArray.size() - 1;
+}
+
+void TextureAtlas::Build()
+{
+	// Cells are aligned to, and a whole number of, the texels of the smallest mip, so at every mip each image still
+	// covers whole texels of its own.
+	uint32_t alignment = 1u << (this->mipLevels - 1);
+	auto cellSize = [this, alignment](uint32_t size) { return (size + 2 * this->padding + alignment - 1) & ~(alignment - 1); };
+
+	uint32_t imageCount = (uint32_t)this->pendingImagesArray.size();
+
+	std::vector<uint32_t> orderArray(imageCount);
+	std::iota(orderArray.begin(), orderArray.end(), 0);
+	std::sort(orderArray.begin(), orderArray.end(), [this](uint32_t left, uint32_t right)
+	{
+		const PendingImage& a = this->pendingImagesArray[left];
+		const PendingImage& b = this->pendingImagesArray[right];
+		return (a.height != b.height) ? a.height > b.height : a.width > b.width;
+	});
+
+	AtlasPacker packer(this->layerSize, this->layerSize);
+	std::vector<AtlasPacker::Placement> placementsArray(imageCount);
+
+	for (uint32_t imageId : orderArray)
+	{
+		const PendingImage& pendingImage = this->pendingImagesArray[imageId];
+		if (!packer.Pack(cellSize(pendingImage.width), cellSize(pendingImage.height), placementsArray[imageId]))
+			throw new std::runtime_error("Atlas image is too big to fit in a layer!");
+	}
+
+	float texelSize = 1.0f / float(this->layerSize);
+	this->regionsArray.resize(imageCount);
+	for (uint32_t imageId = 0; imageId < imageCount; imageId++)
+	{
+		const PendingImage& pendingImage = this->pendingImagesArray[imageId];
+		const AtlasPacker::Placement& placement = placementsArray[imageId];
+
+		Region& region = this->regionsArray[imageId];
+		region.layer = placement.page;
+		region.width = pendingImage.width;
+		region.height = pendingImage.height;
+		region.uvRect = glm::vec4(
+			float(placement.x + this->padding) * texelSize,
+			float(placement.y + this->padding) * texelSize,
+			float(placement.x + this->padding + pendingImage.width) * texelSize,
+			float(placement.y + this->padding + pendingImage.height) * texelSize);
+	}
+
+	uint32_t layerCount = std::max(packer.GetPageCount(), 1u);
+	std::vector<std::vector<uint8_t>> layersArray(layerCount);
+	for (uint32_t layer = 0; layer < layerCount; layer++)
+	{
+		this->ComposeLayer(layer, placementsArray, layersArray[layer]);
+		this->GenerateMips(layersArray[layer]);
+	}
+
+	this->Upload(layersArray);
+	this->CreateViewsAndSampler(layerCount);
+
+	std::cout << "Atlas: " << imageCount << " images in " << layerCount << " layers of " << this->layerSize << "x" << this->layerSize << ", " << this->mipLevels << " mips, " << int(100.0 * packer.GetOccupancy()) << "% occupied" << std::endl;
+
+	// Only the regions are needed from here on.
+	this->pendingImagesArray.clear();
+	this->pendingImagesArray.shrink_to_fit();
+}
+
+void TextureAtlas::ComposeLayer(uint32_t layer, const std::vector<AtlasPacker::Placement>& placementsArray, std::vector<uint8_t>& layerPixels) const
+{
+	size_t totalSize = 0;
+	for (uint32_t level = 0; level < this->mipLevels; level++)
+		totalSize += 4 * size_t(this->layerSize >> level) * size_t(this->layerSize >> level);
+
+	layerPixels.assign(totalSize, 0);
+
+	uint32_t alignment = 1u << (this->mipLevels - 1);
+
+	for (uint32_t imageId = 0; imageId < (uint32_t)placementsArray.size(); imageId++)
+	{
+		const AtlasPacker::Placement& placement = placementsArray[imageId];
+		if (placement.page != layer)
+			continue;
+
+		// Fill the whole cell, gutter and alignment slack included, clamping to the image's edges.
+		const PendingImage& pendingImage = this->pendingImagesArray[imageId];
+		uint32_t cellWidth = (pendingImage.width + 2 * this->padding + alignment - 1) & ~(alignment - 1);
+		uint32_t cellHeight = (pendingImage.height + 2 * this->padding + alignment - 1) & ~(alignment - 1);
+
+		for (uint32_t cy = 0; cy < cellHeight; cy++)
+		{
+			uint32_t sy = (uint32_t)std::min(std::max(int(cy) - int(this->padding), 0), int(pendingImage.height) - 1);
+			const uint8_t* sourceRow = &pendingImage.pixels[4 * size_t(sy) * pendingImage.width];
+			uint8_t* targetRow = &layerPixels[4 * (size_t(placement.y + cy) * this->layerSize + placement.x)];
+
+			for (uint32_t cx = 0; cx < cellWidth; cx++)
+			{
+				uint32_t sx = (uint32_t)std::min(std::max(int(cx) - int(this->padding), 0), int(pendingImage.width) - 1);
+				::memcpy(&targetRow[4 * cx], &sourceRow[4 * sx], 4);
+			}
+		}
+	}
+}
+
+void TextureAtlas::GenerateMips(std::vector<uint8_t>& layerPixels) const
+{
+	// A 2x2 box filter per level, averaging color in linear space since the texels are sRGB encoded.
+	float decodeTable[256];
+	for (int j = 0; j < 256; j++)
+		decodeTable[j] = SrgbToLinear((uint8_t)j);
+
+	size_t sourceOffset = 0;
+	for (uint32_t level = 1; level < this->mipLevels; level++)
+	{
+		uint32_t sourceSize = this->layerSize >> (level - 1);
+		uint32_t targetSize = sourceSize / 2;
+		size_t targetOffset = sourceOffset + 4 * size_t(sourceSize) * sourceSize;
+
+		for (uint32_t y = 0; y < targetSize; y++)
+		{
+			for (uint32_t x = 0; x < targetSize; x++)
+			{
+				const uint8_t* s00 = &layerPixels[sourceOffset + 4 * (size_t(2 * y) * sourceSize + 2 * x)];
+				const uint8_t* s01 = s00 + 4;
+				const uint8_t* s10 = s00 + 4 * size_t(sourceSize);
+				const uint8_t* s11 = s10 + 4;
+				uint8_t* target = &layerPixels[targetOffset + 4 * (size_t(y) * targetSize + x)];
+
+				for (int k = 0; k < 3; k++)
+					target[k] = LinearToSrgb(0.25f * (decodeTable[s00[k]] + decodeTable[s01[k]] + decodeTable[s10[k]] + decodeTable[s11[k]]));
+
+				target[3] = (uint8_t)((uint32_t(s00[3]) + s01[3] + s10[3] + s11[3] + 2) / 4);
+			}
+		}
+
+		sourceOffset = targetOffset;
+	}
+}
+
+void TextureAtlas::Upload(const std::vector<std::vector<uint8_t>>& layersArray)
+{
+	VkDevice logicalDevice = this->app->logicalDevice;
+	uint32_t layerCount = (uint32_t)layersArray.size();
+	VkDeviceSize layerBytes = (VkDeviceSize)layersArray[0].size();
+	VkDeviceSize stagingSize = layerBytes * layerCount;
+
+	VkImageCreateInfo imageInfo{};
+	imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	imageInfo.imageType = VK_IMAGE_TYPE_2D;
+	imageInfo.extent.width = this->layerSize;
+	imageInfo.extent.height = this->layerSize;
+	imageInfo.extent.depth = 1;
+	imageInfo.mipLevels = this->mipLevels;
+	imageInfo.arrayLayers = layerCount;
+	imageInfo.format = ATLAS_FORMAT;
+	imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+	imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+	imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+
+	if (VK_SUCCESS != vkCreateImage(logicalDevice, &imageInfo, nullptr, &this->image))
+		throw new std::runtime_error("Failed to create atlas image!");
+
+	VkMemoryRequirements memRequirements;
+	vkGetImageMemoryRequirements(logicalDevice, this->image, &memRequirements);
+
+	VkMemoryAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.allocationSize = memRequirements.size;
+	allocInfo.memoryTypeIndex = this->app->FindMemoryType(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+	if (VK_SUCCESS != this->app->memoryTracker->Allocate(allocInfo, "atlas", this->imageMemory))
+		throw new std::runtime_error("Failed to allocate atlas image memory!");
+
+	vkBindImageMemory(logicalDevice, this->image, this->imageMemory, 0);
+
+	VkBuffer stagingBuffer = VK_NULL_HANDLE;
+	VkDeviceMemory stagingBufferMemory = nullptr;
+	this->app->CreateBuffer(stagingSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+
+	void* data = nullptr;
+	vkMapMemory(logicalDevice, stagingBufferMemory, 0, stagingSize, 0, &data);
+	for (uint32_t layer = 0; layer < layerCount; layer++)
+		::memcpy(static_cast<uint8_t*>(data) + layer * layerBytes, layersArray[layer].data(), (size_t)layerBytes);
+	vkUnmapMemory(logicalDevice, stagingBufferMemory);
+
+	// One copy per layer per mip, all in a single command buffer, rather than a command buffer per step.
+	std::vector<VkBufferImageCopy> regionsArray;
+	for (uint32_t layer = 0; layer < layerCount; layer++)
+	{
+		VkDeviceSize offset = layer * layerBytes;
+		for (uint32_t level = 0; level < this->mipLevels; level++)
+		{
+			uint32_t size = this->layerSize >> level;
+
+			VkBufferImageCopy region{};
+			region.bufferOffset = offset;
+			region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			region.imageSubresource.mipLevel = level;
+			region.imageSubresource.baseArrayLayer = layer;
+			region.imageSubresource.layerCount = 1;
+			region.imageOffset = { 0, 0, 0 };
+			region.imageExtent = { size, size, 1 };
+			regionsArray.push_back(region);
+
+			offset += 4 * VkDeviceSize(size) * size;
+		}
+	}
+
+	VkCommandBuffer commandBuffer = this->app->BeginSingleTimeCommands(this->app->graphicsCommandPool);
+
+	VkImageMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = this->image;
+	barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	barrier.subresourceRange.baseMipLevel = 0;
+	barrier.subresourceRange.levelCount = this->mipLevels;
+	barrier.subresourceRange.baseArrayLayer = 0;
+	barrier.subresourceRange.layerCount = layerCount;
+	barrier.srcAccessMask = 0;
+	barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+	vkCmdCopyBufferToImage(commandBuffer, stagingBuffer, this->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, (uint32_t)regionsArray.size(), regionsArray.data());
+
+	barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+	this->app->EndSingleTimeCommands(commandBuffer, this->app->graphicsCommandPool, this->app->graphicsQueue);
+
+	vkDestroyBuffer(logicalDevice, stagingBuffer, nullptr);
+	this->app->memoryTracker->Free(stagingBufferMemory);
+}
+
+void TextureAtlas::CreateViewsAndSampler(uint32_t layerCount)
+{
+	VkImageViewCreateInfo viewInfo{};
+	viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+	viewInfo.image = this->image;
+	viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+	viewInfo.format = ATLAS_FORMAT;
+	viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	viewInfo.subresourceRange.baseMipLevel = 0;
+	viewInfo.subresourceRange.levelCount = this->mipLevels;
+	viewInfo.subresourceRange.baseArrayLayer = 0;
+	viewInfo.subresourceRange.layerCount = layerCount;
+
+	if (VK_SUCCESS != vkCreateImageView(this->app->logicalDevice, &viewInfo, nullptr, &this->arrayView))
+		throw new std::runtime_error("Failed to create atlas image view!");
+
+	this->layerViews.resize(layerCount);
+	for (uint32_t layer = 0; layer < layerCount; layer++)
+	{
+		viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewInfo.subresourceRange.baseArrayLayer = layer;
+		viewInfo.subresourceRange.layerCount = 1;
+
+		if (VK_SUCCESS != vkCreateImageView(this->app->logicalDevice, &viewInfo, nullptr, &this->layerViews[layer]))
+			throw new std::runtime_error("Failed to create atlas layer image view!");
+	}
+
+	// Trilinear, clamped, and no anisotropy: anisotropic filtering can reach further than the gutters allow for.
+	VkSamplerCreateInfo samplerInfo{};
+	samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	samplerInfo.magFilter = VK_FILTER_LINEAR;
+	samplerInfo.minFilter = VK_FILTER_LINEAR;
+	samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.anisotropyEnable = VK_FALSE;
+	samplerInfo.maxAnisotropy = 1.0f;
+	samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+	samplerInfo.unnormalizedCoordinates = VK_FALSE;
+	samplerInfo.compareEnable = VK_FALSE;
+	samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
+	samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+	samplerInfo.mipLodBias = 0.0f;
+	samplerInfo.minLod = 0.0f;
+	samplerInfo.maxLod = float(this->mipLevels - 1);
+
+	if (VK_SUCCESS != vkCreateSampler(this->app->logicalDevice, &samplerInfo, nullptr, &this->sampler))
+		throw new std::runtime_error("Failed to create atlas sampler!");
+}
+
+void TextureAtlas::Destroy()
+{
+	VkDevice logicalDevice = this->app->logicalDevice;
+
+	vkDestroySampler(logicalDevice, this->sampler, nullptr);
+	for (VkImageView layerView : this->layerViews)
+		vkDestroyImageView(logicalDevice, layerView, nullptr);
+	vkDestroyImageView(logicalDevice, this->arrayView, nullptr);
+	vkDestroyImage(logicalDevice, this->image, nullptr);
+	this->app->memoryTracker->Free(this->imageMemory);
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "Application.h"
+#include "AtlasPacker.h"
+
+// Packs lots of small RGBA images into the layers of one mipmapped 2D array image, so that things drawn with any of
+// them can share a texture binding.  Images are added up front, then Build packs them (tallest first, with the skyline
+// packer), composes the layers, makes their mips on the CPU and uploads the lot in one go.  Afterwards each image is
+// known by its region: the layer it ended up in and its UV rectangle there.
+//
+// Every image gets a gutter of its own edge pixels around it, and its cell is aligned to the size of a texel at the
+// smallest mip.  That way the box filter never mixes two images together, and bilinear sampling anywhere inside an
+// image's UV rectangle, at any mip, only ever reads that image.
+class TextureAtlas
+{
+public:
+	struct Region
+	{
+		uint32_t layer;
+		glm::vec4 uvRect;		// (u0, v0, u1, v1), same as SpriteBatch::Sprite::uvRect.
+		uint32_t width;
+		uint32_t height;
+	};
+
+	TextureAtlas(Application* app, uint32_t layerSize, uint32_t padding, uint32_t mipLevels);
+	virtual ~TextureAtlas();
+
+	// The pixels are copied.  Returns the image's id, for GetRegion once the atlas is built.
+	uint32_t AddImage(const uint8_t* pixels, uint32_t width, uint32_t height);
+
+	void Build();
+	void Destroy();
+
+	const Region& GetRegion(uint32_t imageId) const { return this->regionsArray[imageId]; }
+	uint32_t GetImageCount() const { return (uint32_t)this->regionsArray.size(); }
+	uint32_t GetLayerCount() const { return (uint32_t)this->layerViews.size(); }
+
+	// The whole array, for shaders that take a sampler2DArray, or a single layer as a plain 2D texture.
+	VkImageView GetArrayView() const { return this->arrayView; }
+	VkImageView GetLayerView(uint32_t layer) const { return this->layerViews[layer]; }
+	VkSampler GetSampler() const { return this->sampler; }
+
+private:
+	struct PendingImage
+	{
+		uint32_t width;
+		uint32_t height;
+		std::vector<uint8_t> pixels;
+	};
+
+	void ComposeLayer(uint32_t layer, const std::vector<AtlasPacker::Placement>& placementsArray, std::vector<uint8_t>& layerPixels) const;
+	void GenerateMips(std::vector<uint8_t>& layerPixels) const;
+	void Upload(const std::vector<std::vector<uint8_t>>& layersArray);
+	void CreateViewsAndSampler(uint32_t layerCount);
+
+	Application* app;
+	uint32_t layerSize;
+	uint32_t padding;
+	uint32_t mipLevels;
+	std::vector<PendingImage> pendingImagesArray;
+	std::vector<Region> regionsArray;
+
+	VkImage image;
+	VkDeviceMemory imageMemory;
+	VkImageView arrayView;
+	std::vector<VkImageView> layerViews;
+	VkSampler sampler;
+};
@@ -0,0 +1,842 @@
+#include "TextureResidency.h"
+#include "MemoryTracker.h"
+#include "ThreadPool.h"
+#include <stb_image.h>
+#include <cmath>
+#include <cstring>
+
+const VkFormat RESIDENCY_FORMAT = VK_FORMAT_R8G8B8A8_SRGB;
+const double RESIDENCY_BUDGET_FRACTION = 0.8;			// Of what's left of the device-local budget once everything else is counted.
+const uint32_t RESIDENCY_MIN_SIZE = 32;					// Textures are trimmed down to this size before they're evicted.
+const uint64_t RESIDENCY_EVICT_AFTER_FRAMES = 120;		// Unused for this long, a texture is evicted rather than trimmed.
+const uint32_t RESIDENCY_MAX_OPERATIONS_PER_FRAME = 4;	// Uploads, trims and evictions, to spread out the cost.
+const uint32_t RESIDENCY_REPORT_INTERVAL = 240;
+
+static float SrgbToLinear(uint8_t value)
+{
+	float c = float(value) / 255.0f;
+	return (c <= 0.04045f) ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+}
+
+static uint8_t LinearToSrgb(float c)
+{
+	c = (c <= 0.0031308f) ? c * 12.92f : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+	return (uint8_t)std::min(std::max(c * 255.0f + 0.5f, 0.0f), 255.0f);
+}
+
+static VkDeviceSize MipBytes(uint32_t width, uint32_t height, uint32_t mip)
+{
+	return 4 * VkDeviceSize(std::max(width >> mip, 1u)) * VkDeviceSize(std::max(height >> mip, 1u));
+}
+
+TextureResidency::TextureResidency(Application* app, VkDeviceSize budgetBytes)
+{
+	this->app = app;
+	this->fixedBudgetBytes = budgetBytes;
+	this->deviceLocalHeap = 0;
+	this->commandPool = VK_NULL_HANDLE;
+	this->descriptorPool = VK_NULL_HANDLE;
+	this->descriptorSetLayout = VK_NULL_HANDLE;
+	this->sampler = VK_NULL_HANDLE;
+	this->placeholderImage = VK_NULL_HANDLE;
+	this->placeholderImageMemory = nullptr;
+	this->placeholderImageView = VK_NULL_HANDLE;
+	this->maxTextures = 0;
+	this->frameNumber = 0;
+	this->pendingLoadCount = 0;
+	this->residentBytes = 0;
+	this->statistics = Statistics{};
+	this->reportFrameCount = 0;
+}
+
+/*virtual*/ TextureResidency::~TextureResidency()
+{
+}
+
+void TextureResidency::Create(VkDescriptorSetLayout descriptorSetLayout, uint32_t maxTextures)
+{
+	VkDevice logicalDevice = this->app->logicalDevice;
+
+	this->descriptorSetLayout = descriptorSetLayout;
+	this->maxTextures = maxTextures;
+
+	// Our own pool, since the uploads and copies are recorded on the main thread in the middle of a frame.
+	Application::QueueFamilyIndices indices = this->app->FindQueueFamilies(this->app->physicalDevice);
+
+	VkCommandPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+	poolInfo.queueFamilyIndex = indices.graphicsFamily.value();
+
+	if (VK_SUCCESS != vkCreateCommandPool(logicalDevice, &poolInfo, nullptr, &this->commandPool))
+		throw new std::runtime_error("Failed to create residency command pool!");
+
+	VkDescriptorPoolSize poolSize{};
+	poolSize.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	poolSize.descriptorCount = maxTextures * MAX_FRAMES_IN_FLIGHT;
+
+	VkDescriptorPoolCreateInfo descriptorPoolInfo{};
+	descriptorPoolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	descriptorPoolInfo.poolSizeCount = 1;
+	descriptorPoolInfo.pPoolSizes = &poolSize;
+	descriptorPoolInfo.maxSets = maxTextures * MAX_FRAMES_IN_FLIGHT;
+
+	if (VK_SUCCESS != vkCreateDescriptorPool(logicalDevice, &descriptorPoolInfo, nullptr, &this->descriptorPool))
+		throw new std::runtime_error("Failed to create residency descriptor pool!");
+
+	VkSamplerCreateInfo samplerInfo{};
+	samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	samplerInfo.magFilter = VK_FILTER_LINEAR;
+	samplerInfo.minFilter = VK_FILTER_LINEAR;
+	samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+	samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+	samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+	samplerInfo.anisotropyEnable = VK_FALSE;
+	samplerInfo.maxAnisotropy = 1.0f;
+	samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+	samplerInfo.unnormalizedCoordinates = VK_FALSE;
+	samplerInfo.compareEnable = VK_FALSE;
+	samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
+	samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+	samplerInfo.minLod = 0.0f;
+	samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+
+	if (VK_SUCCESS != vkCreateSampler(logicalDevice, &samplerInfo, nullptr, &this->sampler))
+		throw new std::runtime_error("Failed to create residency sampler!");
+
+	// The heap that device-local images come out of is the one whose budget we have to live within.
+	const VkPhysicalDeviceMemoryProperties& memoryProperties = this->app->memoryTracker->GetMemoryProperties();
+	for (uint32_t heap = 0; heap < memoryProperties.memoryHeapCount; heap++)
+	{
+		if (memoryProperties.memoryHeaps[heap].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)
+		{
+			this->deviceLocalHeap = heap;
+			break;
+		}
+	}
+
+	this->CreatePlaceholder();
+}
+
+void TextureResidency::Destroy()
+{
+	VkDevice logicalDevice = this->app->logicalDevice;
+
+	// The thread pool is gone by now, so every load has either finished or never will.
+	this->CollectSubmissions(true);
+	this->DestroyRetirees(true);
+
+	for (Texture& texture : this->texturesArray)
+	{
+		vkDestroyImageView(logicalDevice, texture.imageView, nullptr);
+		vkDestroyImage(logicalDevice, texture.image, nullptr);
+		this->app->memoryTracker->Free(texture.imageMemory);
+	}
+
+	vkDestroyImageView(logicalDevice, this->placeholderImageView, nullptr);
+	vkDestroyImage(logicalDevice, this->placeholderImage, nullptr);
+	this->app->memoryTracker->Free(this->placeholderImageMemory);
+
+	vkDestroySampler(logicalDevice, this->sampler, nullptr);
+	vkDestroyDescriptorPool(logicalDevice, this->descriptorPool, nullptr);
+	vkDestroyCommandPool(logicalDevice, this->commandPool, nullptr);
+
+	this->texturesArray.clear();
+	this->waitingLoadsArray.clear();
+}
+
+uint32_t TextureResidency::AddTexture(Loader loader)
+{
+	if (this->texturesArray.size() >= this->maxTextures)
+		throw new std::runtime_error("Too many resident textures!");
+
+	Texture texture{};
+	texture.loader = loader;
+	texture.image = VK_NULL_HANDLE;
+	texture.imageMemory = nullptr;
+	texture.imageView = VK_NULL_HANDLE;
+	texture.loadPending = false;
+	texture.loadFailed = false;
+
+	std::vector<VkDescriptorSetLayout> layoutsArray(MAX_FRAMES_IN_FLIGHT, this->descriptorSetLayout);
+
+	VkDescriptorSetAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = this->descriptorPool;
+	allocInfo.descriptorSetCount = MAX_FRAMES_IN_FLIGHT;
+	allocInfo.pSetLayouts = layoutsArray.data();
+
+	if (VK_SUCCESS != vkAllocateDescriptorSets(this->app->logicalDevice, &allocInfo, texture.descriptorSets))
+		throw new std::runtime_error("Failed to allocate residency descriptor sets!");
+
+	// Everything starts out on the placeholder.
+	for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+	{
+		VkDescriptorImageInfo imageInfo{};
+		imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		imageInfo.imageView = this->placeholderImageView;
+		imageInfo.sampler = this->sampler;
+
+		VkWriteDescriptorSet descriptorWrite{};
+		descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWrite.dstSet = texture.descriptorSets[i];
+		descriptorWrite.dstBinding = 0;
+		descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		descriptorWrite.descriptorCount = 1;
+		descriptorWrite.pImageInfo = &imageInfo;
+		vkUpdateDescriptorSets(this->app->logicalDevice, 1, &descriptorWrite, 0, nullptr);
+
+		texture.boundViews[i] = this->placeholderImageView;
+	}
+
+	this->texturesArray.push_back(texture);
+	this->statistics.textureCount = (uint32_t)this->texturesArray.size();
+	return (uint32_t)this->texturesArray.size() - 1;
+}
+
+uint32_t TextureResidency::AddTextureFile(const std::string& filePath)
+{
+	return this->AddTexture([filePath](uint32_t& width, uint32_t& height, std::vector<uint8_t>& pixels)
+	{
+		int fileWidth = 0, fileHeight = 0, fileChannels = 0;
+		stbi_uc* filePixels = stbi_load(filePath.c_str(), &fileWidth, &fileHeight, &fileChannels, STBI_rgb_alpha);
+		if (!filePixels)
+			throw new std::runtime_error("Failed to load resident texture file!");
+
+		width = (uint32_t)fileWidth;
+		height = (uint32_t)fileHeight;
+		pixels.assign(filePixels, filePixels + 4 * size_t(width) * height);
+		stbi_image_free(filePixels);
+	});
+}
+
+void TextureResidency::Touch(uint32_t textureId)
+{
+	this->texturesArray[textureId].lastUsedFrame = this->frameNumber;
+}
+
+void TextureResidency::Update(uint32_t i)
+{
+	this->frameNumber++;
+
+	this->CollectSubmissions(false);
+	this->DestroyRetirees(false);
+
+	VkDeviceSize budgetBytes = this->ComputeBudget();
+	uint32_t operationCount = 0;
+
+	// Finished loads first: the ones that didn't get an upload slot last frame, then the ones just in.
+	std::vector<LoadResult> loadsArray;
+	loadsArray.swap(this->waitingLoadsArray);
+	{
+		std::lock_guard<std::mutex> lock(this->completedLoadsMutex);
+		for (LoadResult& result : this->completedLoadsArray)
+		{
+			this->pendingLoadCount--;
+			loadsArray.push_back(std::move(result));
+		}
+		this->completedLoadsArray.clear();
+	}
+
+	for (LoadResult& result : loadsArray)
+	{
+		Texture& texture = this->texturesArray[result.textureId];
+		if (result.pixels.empty())
+		{
+			texture.loadPending = false;
+			texture.loadFailed = true;
+			continue;
+		}
+
+		// Still pending while it waits, so it isn't decoded all over again.
+		if (operationCount >= RESIDENCY_MAX_OPERATIONS_PER_FRAME)
+		{
+			this->waitingLoadsArray.push_back(std::move(result));
+			continue;
+		}
+
+		texture.loadPending = false;
+		this->Upload(result, budgetBytes);
+		operationCount++;
+	}
+
+	// Anything used last frame wants (re)loading if the budget now allows it a sharper base mip than it has.  Until
+	// the first load we don't know its size, so it just wants loading.
+	for (uint32_t textureId = 0; textureId < (uint32_t)this->texturesArray.size(); textureId++)
+	{
+		const Texture& texture = this->texturesArray[textureId];
+		bool recentlyUsed = texture.lastUsedFrame + 1 >= this->frameNumber && texture.lastUsedFrame > 0;
+		if (!recentlyUsed || texture.loadPending || texture.loadFailed || this->pendingLoadCount >= this->app->threadPool->GetThreadCount())
+			continue;
+
+		uint32_t currentBaseMip = (texture.image != VK_NULL_HANDLE) ? texture.baseMip : texture.mipLevels;
+		bool sharper = (texture.mipLevels == 0) ? (texture.image == VK_NULL_HANDLE) : (this->ComputeBaseMip(texture, budgetBytes) < currentBaseMip);
+		if (sharper)
+			this->RequestLoad(textureId);
+	}
+
+	// Over budget, take memory back from the least recently used, a step at a time.
+	while (this->residentBytes > budgetBytes && operationCount < RESIDENCY_MAX_OPERATIONS_PER_FRAME)
+	{
+		uint32_t victimId = UINT32_MAX;
+		for (uint32_t textureId = 0; textureId < (uint32_t)this->texturesArray.size(); textureId++)
+		{
+			const Texture& texture = this->texturesArray[textureId];
+			if (texture.image != VK_NULL_HANDLE && (victimId == UINT32_MAX || texture.lastUsedFrame < this->texturesArray[victimId].lastUsedFrame))
+				victimId = textureId;
+		}
+
+		if (victimId == UINT32_MAX)
+			break;
+
+		const Texture& victim = this->texturesArray[victimId];
+		bool stale = victim.lastUsedFrame + RESIDENCY_EVICT_AFTER_FRAMES < this->frameNumber;
+		bool smallest = std::max(victim.width >> victim.baseMip, victim.height >> victim.baseMip) <= RESIDENCY_MIN_SIZE;
+		if (stale || smallest)
+			this->Evict(victimId);
+		else
+			this->Trim(victimId);
+
+		operationCount++;
+	}
+
+	// Now that nothing in flight is using slot i's sets, point them at whatever each texture has now.
+	std::vector<VkDescriptorImageInfo> imageInfosArray;
+	std::vector<VkWriteDescriptorSet> descriptorWritesArray;
+	imageInfosArray.reserve(this->texturesArray.size());
+
+	for (Texture& texture : this->texturesArray)
+	{
+		VkImageView imageView = texture.imageView ? texture.imageView : this->placeholderImageView;
+		if (texture.boundViews[i] == imageView)
+			continue;
+
+		VkDescriptorImageInfo imageInfo{};
+		imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		imageInfo.imageView = imageView;
+		imageInfo.sampler = this->sampler;
+		imageInfosArray.push_back(imageInfo);
+
+		VkWriteDescriptorSet descriptorWrite{};
+		descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWrite.dstSet = texture.descriptorSets[i];
+		descriptorWrite.dstBinding = 0;
+		descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		descriptorWrite.descriptorCount = 1;
+		descriptorWrite.pImageInfo = &imageInfosArray.back();
+		descriptorWritesArray.push_back(descriptorWrite);
+
+		texture.boundViews[i] = imageView;
+	}
+
+	if (!descriptorWritesArray.empty())
+		vkUpdateDescriptorSets(this->app->logicalDevice, (uint32_t)descriptorWritesArray.size(), descriptorWritesArray.data(), 0, nullptr);
+
+	this->statistics.residentBytes = this->residentBytes;
+	this->statistics.budgetBytes = budgetBytes;
+	this->statistics.residentCount = 0;
+	for (const Texture& texture : this->texturesArray)
+		if (texture.image != VK_NULL_HANDLE)
+			this->statistics.residentCount++;
+
+	if (++this->reportFrameCount == RESIDENCY_REPORT_INTERVAL)
+	{
+		std::cout << "Residency: " << this->statistics.residentCount << " of " << this->statistics.textureCount << " textures resident, " << (this->residentBytes >> 20) << " of " << (budgetBytes >> 20) << " MB, " << this->statistics.loads << " loads, " << this->statistics.trims << " trims, " << this->statistics.evictions << " evictions" << std::endl;
+		this->reportFrameCount = 0;
+	}
+}
+
+void TextureResidency::CreatePlaceholder()
+{
+	// A single gray texel, for textures that have nothing resident at all.
+	this->CreateImage(1, 1, 1, this->placeholderImage, this->placeholderImageMemory, this->placeholderImageView);
+
+	VkBuffer stagingBuffer = VK_NULL_HANDLE;
+	VkDeviceMemory stagingBufferMemory = nullptr;
+	this->app->CreateBuffer(4, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+
+	void* data = nullptr;
+	vkMapMemory(this->app->logicalDevice, stagingBufferMemory, 0, 4, 0, &data);
+	uint8_t gray[4] = { 128, 128, 128, 255 };
+	::memcpy(data, gray, sizeof(gray));
+	vkUnmapMemory(this->app->logicalDevice, stagingBufferMemory);
+
+	VkCommandBuffer commandBuffer = this->BeginSubmission();
+
+	VkImageMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = this->placeholderImage;
+	barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+	barrier.srcAccessMask = 0;
+	barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+	VkBufferImageCopy region{};
+	region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+	region.imageExtent = { 1, 1, 1 };
+	vkCmdCopyBufferToImage(commandBuffer, stagingBuffer, this->placeholderImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+	barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+	this->EndSubmission(commandBuffer, stagingBuffer, stagingBufferMemory);
+}
+
+void TextureResidency::CreateImage(uint32_t width, uint32_t height, uint32_t mipLevels, VkImage& image, VkDeviceMemory& imageMemory, VkImageView& imageView)
+{
+	VkDevice logicalDevice = this->app->logicalDevice;
+
+	// Transfer source as well, so that trimming can copy the lower mips out into a smaller image.
+	VkImageCreateInfo imageInfo{};
+	imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	imageInfo.imageType = VK_IMAGE_TYPE_2D;
+	imageInfo.extent = { width, height, 1 };
+	imageInfo.mipLevels = mipLevels;
+	imageInfo.arrayLayers = 1;
+	imageInfo.format = RESIDENCY_FORMAT;
+	imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+	imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+	imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+
+	if (VK_SUCCESS != vkCreateImage(logicalDevice, &imageInfo, nullptr, &image))
+		throw new std::runtime_error("Failed to create resident texture image!");
+
+	VkMemoryRequirements memRequirements;
+	vkGetImageMemoryRequirements(logicalDevice, image, &memRequirements);
+
+	VkMemoryAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.allocationSize = memRequirements.size;
+	allocInfo.memoryTypeIndex = this->app->FindMemoryType(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+	if (VK_SUCCESS != this->app->memoryTracker->Allocate(allocInfo, "resident texture", imageMemory))
+		throw new std::runtime_error("Failed to allocate resident texture memory!");
+
+	vkBindImageMemory(logicalDevice, image, imageMemory, 0);
+
+	VkImageViewCreateInfo viewInfo{};
+	viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+	viewInfo.image = image;
+	viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+	viewInfo.format = RESIDENCY_FORMAT;
+	viewInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, mipLevels, 0, 1 };
+
+	if (VK_SUCCESS != vkCreateImageView(logicalDevice, &viewInfo, nullptr, &imageView))
+		throw new std::runtime_error("Failed to create resident texture image view!");
+}
+
+uint32_t TextureResidency::ComputeBaseMip(const Texture& texture, VkDeviceSize budgetBytes) const
+{
+	// The highest mip that fits alongside everything else, but never below the minimum size; going over budget here
+	// just means somebody less recently used loses out to the trimming.
+	VkDeviceSize otherBytes = this->residentBytes - texture.residentBytes;
+	uint32_t baseMip = 0;
+	while (baseMip + 1 < texture.mipLevels && otherBytes + this->ComputeBytes(texture, baseMip) > budgetBytes && std::max(texture.width >> (baseMip + 1), texture.height >> (baseMip + 1)) >= RESIDENCY_MIN_SIZE)
+		baseMip++;
+
+	return baseMip;
+}
+
+VkDeviceSize TextureResidency::ComputeBytes(const Texture& texture, uint32_t baseMip) const
+{
+	VkDeviceSize bytes = 0;
+	for (uint32_t mip = baseMip; mip < texture.mipLevels; mip++)
+		bytes += MipBytes(texture.width, texture.height, mip);
+
+	return bytes;
+}
+
+VkDeviceSize TextureResidency::ComputeBudget() const
+{
+	if (this->fixedBudgetBytes > 0)
+		return this->fixedBudgetBytes;
+
+	// Whatever the rest of the process is using comes off the top; we get a fraction of what's left.  Without the
+	// budget extension the "budget" is the heap's whole size and the usage is just our own allocations, so this is
+	// generous, but it's the best we can know.
+	MemoryTracker::HeapStatistics stats = this->app->memoryTracker->GetHeapStatistics(this->deviceLocalHeap);
+	VkDeviceSize processUsage = std::max(stats.driverUsage, stats.usage);
+	VkDeviceSize otherUsage = processUsage - std::min(processUsage, this->residentBytes);
+	VkDeviceSize available = stats.budget - std::min(stats.budget, otherUsage);
+	return VkDeviceSize(double(available) * RESIDENCY_BUDGET_FRACTION);
+}
+
+VkCommandBuffer TextureResidency::BeginSubmission()
+{
+	VkCommandBufferAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	allocInfo.commandPool = this->commandPool;
+	allocInfo.commandBufferCount = 1;
+
+	VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+	if (VK_SUCCESS != vkAllocateCommandBuffers(this->app->logicalDevice, &allocInfo, &commandBuffer))
+		throw new std::runtime_error("Failed to allocate residency command buffer!");
+
+	VkCommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	vkBeginCommandBuffer(commandBuffer, &beginInfo);
+
+	return commandBuffer;
+}
+
+void TextureResidency::EndSubmission(VkCommandBuffer commandBuffer, VkBuffer stagingBuffer, VkDeviceMemory stagingBufferMemory)
+{
+	vkEndCommandBuffer(commandBuffer);
+
+	VkFenceCreateInfo fenceInfo{};
+	fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+	Submission submission;
+	submission.commandBuffer = commandBuffer;
+	submission.stagingBuffer = stagingBuffer;
+	submission.stagingBufferMemory = stagingBufferMemory;
+	if (VK_SUCCESS != vkCreateFence(this->app->logicalDevice, &fenceInfo, nullptr, &submission.fence))
+		throw new std::runtime_error("Failed to create residency fence!");
+
+	// Same queue as the frames, and submitted before this frame's commands, so the barriers at the end of the
+	// command buffer are all the frame needs to see the results; the fence is only for freeing things afterwards.
+	VkSubmitInfo submitInfo{};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &commandBuffer;
+
+	if (VK_SUCCESS != vkQueueSubmit(this->app->graphicsQueue, 1, &submitInfo, submission.fence))
+		throw new std::runtime_error("Failed to submit residency command buffer!");
+
+	this->submissionsArray.push_back(submission);
+}
+
+void TextureResidency::CollectSubmissions(bool wait)
+{
+	VkDevice logicalDevice = this->app->logicalDevice;
+
+	for (size_t j = 0; j < this->submissionsArray.size();)
+	{
+		Submission& submission = this->submissionsArray[j];
+
+		if (wait)
+			vkWaitForFences(logicalDevice, 1, &submission.fence, VK_TRUE, UINT64_MAX);
+		else if (VK_SUCCESS != vkGetFenceStatus(logicalDevice, submission.fence))
+		{
+			j++;
+			continue;
+		}
+
+		vkDestroyFence(logicalDevice, submission.fence, nullptr);
+		vkFreeCommandBuffers(logicalDevice, this->commandPool, 1, &submission.commandBuffer);
+		vkDestroyBuffer(logicalDevice, submission.stagingBuffer, nullptr);
+		this->app->memoryTracker->Free(submission.stagingBufferMemory);
+
+		submission = this->submissionsArray.back();
+		this->submissionsArray.pop_back();
+	}
+}
+
+void TextureResidency::RequestLoad(uint32_t textureId)
+{
+	Texture& texture = this->texturesArray[textureId];
+	texture.loadPending = true;
+	this->pendingLoadCount++;
+
+	Loader loader = texture.loader;
+	this->app->threadPool->Submit([this, textureId, loader]()
+	{
+		LoadResult result;
+		result.textureId = textureId;
+		result.width = 0;
+		result.height = 0;
+		result.mipLevels = 0;
+
+		// A failed load comes back empty, and the texture stays as it is from then on.
+		try
+		{
+			loader(result.width, result.height, result.pixels);
+			GenerateMips(result);
+		}
+		catch (std::exception* e)
+		{
+			std::cerr << "Resident texture " << textureId << ": " << e->what() << std::endl;
+			delete e;
+			result.pixels.clear();
+		}
+
+		std::lock_guard<std::mutex> lock(this->completedLoadsMutex);
+		this->completedLoadsArray.push_back(std::move(result));
+	});
+}
+
+void TextureResidency::Upload(LoadResult& result, VkDeviceSize budgetBytes)
+{
+	Texture& texture = this->texturesArray[result.textureId];
+	if (result.pixels.empty())
+		return;
+
+	texture.width = result.width;
+	texture.height = result.height;
+	texture.mipLevels = result.mipLevels;
+
+	// Never less than what the texture already has.
+	uint32_t currentBaseMip = (texture.image != VK_NULL_HANDLE) ? texture.baseMip : texture.mipLevels;
+	uint32_t baseMip = this->ComputeBaseMip(texture, budgetBytes);
+	if (baseMip >= currentBaseMip)
+		return;
+
+	uint32_t mipLevels = texture.mipLevels - baseMip;
+	uint32_t width = std::max(texture.width >> baseMip, 1u);
+	uint32_t height = std::max(texture.height >> baseMip, 1u);
+
+	VkDeviceSize skippedBytes = 0;
+	for (uint32_t mip = 0; mip < baseMip; mip++)
+		skippedBytes += MipBytes(texture.width, texture.height, mip);
+
+	VkDeviceSize uploadBytes = VkDeviceSize(result.pixels.size()) - skippedBytes;
+
+	VkBuffer stagingBuffer = VK_NULL_HANDLE;
+	VkDeviceMemory stagingBufferMemory = nullptr;
+	this->app->CreateBuffer(uploadBytes, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+
+	void* data = nullptr;
+	vkMapMemory(this->app->logicalDevice, stagingBufferMemory, 0, uploadBytes, 0, &data);
+	::memcpy(data, result.pixels.data() + skippedBytes, (size_t)uploadBytes);
+	vkUnmapMemory(this->app->logicalDevice, stagingBufferMemory);
+
+	VkImage image = VK_NULL_HANDLE;
+	VkDeviceMemory imageMemory = nullptr;
+	VkImageView imageView = VK_NULL_HANDLE;
+	this->CreateImage(width, height, mipLevels, image, imageMemory, imageView);
+
+	std::vector<VkBufferImageCopy> regionsArray(mipLevels);
+	VkDeviceSize offset = 0;
+	for (uint32_t level = 0; level < mipLevels; level++)
+	{
+		VkBufferImageCopy& region = regionsArray[level];
+		region = VkBufferImageCopy{};
+		region.bufferOffset = offset;
+		region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1 };
+		region.imageExtent = { std::max(width >> level, 1u), std::max(height >> level, 1u), 1 };
+		offset += MipBytes(width, height, level);
+	}
+
+	VkCommandBuffer commandBuffer = this->BeginSubmission();
+
+	VkImageMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = image;
+	barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, mipLevels, 0, 1 };
+	barrier.srcAccessMask = 0;
+	barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+	vkCmdCopyBufferToImage(commandBuffer, stagingBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, (uint32_t)regionsArray.size(), regionsArray.data());
+
+	barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+	this->EndSubmission(commandBuffer, stagingBuffer, stagingBufferMemory);
+
+	this->Retire(texture);
+	texture.image = image;
+	texture.imageMemory = imageMemory;
+	texture.imageView = imageView;
+	texture.baseMip = baseMip;
+	texture.residentBytes = this->ComputeBytes(texture, baseMip);
+	this->residentBytes += texture.residentBytes;
+	this->statistics.loads++;
+}
+
+void TextureResidency::Trim(uint32_t textureId)
+{
+	// Drop the top mip by copying the rest into an image half the size.  The old image goes back to being shader
+	// readable afterwards, since the other frame slot's descriptor set may still point at it until its next Update.
+	Texture& texture = this->texturesArray[textureId];
+	uint32_t baseMip = texture.baseMip + 1;
+	uint32_t mipLevels = texture.mipLevels - baseMip;
+	uint32_t width = std::max(texture.width >> baseMip, 1u);
+	uint32_t height = std::max(texture.height >> baseMip, 1u);
+
+	VkImage image = VK_NULL_HANDLE;
+	VkDeviceMemory imageMemory = nullptr;
+	VkImageView imageView = VK_NULL_HANDLE;
+	this->CreateImage(width, height, mipLevels, image, imageMemory, imageView);
+
+	VkCommandBuffer commandBuffer = this->BeginSubmission();
+
+	VkImageMemoryBarrier barriers[2]{};
+	barriers[0].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barriers[0].oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	barriers[0].newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+	barriers[0].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barriers[0].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barriers[0].image = texture.image;
+	barriers[0].subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 1, mipLevels, 0, 1 };
+	barriers[0].srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	barriers[0].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+	barriers[1].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barriers[1].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	barriers[1].newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barriers[1].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barriers[1].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barriers[1].image = image;
+	barriers[1].subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, mipLevels, 0, 1 };
+	barriers[1].srcAccessMask = 0;
+	barriers[1].dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 2, barriers);
+
+	std::vector<VkImageCopy> regionsArray(mipLevels);
+	for (uint32_t level = 0; level < mipLevels; level++)
+	{
+		VkImageCopy& region = regionsArray[level];
+		region = VkImageCopy{};
+		region.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level + 1, 0, 1 };
+		region.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1 };
+		region.extent = { std::max(width >> level, 1u), std::max(height >> level, 1u), 1 };
+	}
+
+	vkCmdCopyImage(commandBuffer, texture.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, (uint32_t)regionsArray.size(), regionsArray.data());
+
+	barriers[0].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+	barriers[0].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	barriers[0].srcAccessMask = 0;
+	barriers[0].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+	barriers[1].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barriers[1].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	barriers[1].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barriers[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 2, barriers);
+
+	this->EndSubmission(commandBuffer, VK_NULL_HANDLE, nullptr);
+
+	this->Retire(texture);
+	texture.image = image;
+	texture.imageMemory = imageMemory;
+	texture.imageView = imageView;
+	texture.baseMip = baseMip;
+	texture.residentBytes = this->ComputeBytes(texture, baseMip);
+	this->residentBytes += texture.residentBytes;
+	this->statistics.trims++;
+}
+
+void TextureResidency::Evict(uint32_t textureId)
+{
+	this->Retire(this->texturesArray[textureId]);
+	this->statistics.evictions++;
+}
+
+void TextureResidency::Retire(Texture& texture)
+{
+	if (texture.image == VK_NULL_HANDLE)
+		return;
+
+	Retiree retiree;
+	retiree.image = texture.image;
+	retiree.imageMemory = texture.imageMemory;
+	retiree.imageView = texture.imageView;
+	retiree.frame = this->app->frameCount;
+	this->retireesArray.push_back(retiree);
+
+	this->residentBytes -= texture.residentBytes;
+	texture.image = VK_NULL_HANDLE;
+	texture.imageMemory = nullptr;
+	texture.imageView = VK_NULL_HANDLE;
+	texture.residentBytes = 0;
+}
+
+void TextureResidency::DestroyRetirees(bool all)
+{
+	// Each slot's descriptor sets are rewritten in Update before its frame is recorded, so no frame after the one being
+	// built when the image was retired can use it; once the GPU has finished that one, nothing is using it.
+	VkDevice logicalDevice = this->app->logicalDevice;
+	uint64_t completedFrame = all ? 0 : this->app->GetCompletedFrame();
+
+	for (size_t j = 0; j < this->retireesArray.size();)
+	{
+		Retiree& retiree = this->retireesArray[j];
+		if (!all && retiree.frame > completedFrame)
+		{
+			j++;
+			continue;
+		}
+
+		vkDestroyImageView(logicalDevice, retiree.imageView, nullptr);
+		vkDestroyImage(logicalDevice, retiree.image, nullptr);
+		this->app->memoryTracker->Free(retiree.imageMemory);
+
+		retiree = this->retireesArray.back();
+		this->retireesArray.pop_back();
+	}
+}
+
+/*static*/ void TextureResidency::GenerateMips(LoadResult& result)
+{
+	// The loader filled in mip 0; append the rest of the chain, down to 1x1, with a 2x2 box filter in linear space.
+	float decodeTable[256];
+	for (int j = 0; j < 256; j++)
+		decodeTable[j] = SrgbToLinear((uint8_t)j);
+
+	result.mipLevels = 1;
+	while (std::max(result.width, result.height) >> result.mipLevels)
+		result.mipLevels++;
+
+	size_t totalBytes = 0;
+	for (uint32_t mip = 0; mip < result.mipLevels; mip++)
+		totalBytes += (size_t)MipBytes(result.width, result.height, mip);
+
+	result.pixels.resize(totalBytes);
+
+	size_t sourceOffset = 0;
+	for (uint32_t mip = 1; mip < result.mipLevels; mip++)
+	{
+		uint32_t sourceWidth = std::max(result.width >> (mip - 1), 1u);
+		uint32_t sourceHeight = std::max(result.height >> (mip - 1), 1u);
+		uint32_t targetWidth = std::max(result.width >> mip, 1u);
+		uint32_t targetHeight = std::max(result.height >> mip, 1u);
+		size_t targetOffset = sourceOffset + 4 * size_t(sourceWidth) * sourceHeight;
+
+		for (uint32_t y = 0; y < targetHeight; y++)
+		{
+			uint32_t y0 = std::min(2 * y, sourceHeight - 1);
+			uint32_t y1 = std::min(2 * y + 1, sourceHeight - 1);
+
+			for (uint32_t x = 0; x < targetWidth; x++)
+			{
+				uint32_t x0 = std::min(2 * x, sourceWidth - 1);
+				uint32_t x1 = std::min(2 * x + 1, sourceWidth - 1);
+
+				const uint8_t* s00 = &result.pixels[sourceOffset + 4 * (size_t(y0) * sourceWidth + x0)];
+				const uint8_t* s01 = &result.pixels[sourceOffset + 4 * (size_t(y0) * sourceWidth + x1)];
+				const uint8_t* s10 = &result.pixels[sourceOffset + 4 * (size_t(y1) * sourceWidth + x0)];
+				const uint8_t* s11 = &result.pixels[sourceOffset + 4 * (size_t(y1) * sourceWidth + x1)];
+				uint8_t* target = &result.pixels[targetOffset + 4 * (size_t(y) * targetWidth + x)];
+
+				for (int k = 0; k < 3; k++)
+					target[k] = LinearToSrgb(0.25f * (decodeTable[s00[k]] + decodeTable[s01[k]] + decodeTable[s10[k]] + decodeTable[s11[k]]));
+
+				target[3] = (uint8_t)((uint32_t(s00[3]) + s01[3] + s10[3] + s11[3] + 2) / 4);
+			}
+		}
+
+		sourceOffset = targetOffset;
+	}
+}
@@ -0,0 +1,142 @@
+#pragma once
+
+#include "Application.h"
+#include <functional>
+#include <mutex>
+
+// Keeps only as much texture data in device-local memory as the budget allows, for content that doesn't all fit.
+// Textures are registered with a loader (a file, or anything that can produce RGBA pixels) and nothing is loaded
+// until a texture is first used.  Every use stamps the texture with the frame number, and once a frame, if the
+// textures are over budget, the least recently used ones give memory back: those not used for a while are evicted
+// outright, and the others lose their top mip (copied down on the GPU, no reload needed).  A texture that's used
+// again after losing mips or being evicted gets reloaded in the background: decoded and mipped on the thread pool,
+// then uploaded at the highest mip the budget allows.  Until then it's drawn with whatever mips it has left, or with a
+// plain gray placeholder if it has none.
+//
+// Anything drawing with these textures binds the descriptor set GetDescriptorSet gives it for the frame slot it's
+// recording.  Each texture has a set per slot, and a slot's sets are only rewritten in Update for that slot, after its
+// fence, so swapping a texture's image never touches a set the GPU might still be reading.
+class TextureResidency
+{
+public:
+	// Fills in the full-size image as RGBA8 (sRGB) pixels.  Called on a worker thread, every time the texture is reloaded.
+	typedef std::function<void(uint32_t& width, uint32_t& height, std::vector<uint8_t>& pixels)> Loader;
+
+	struct Statistics
+	{
+		uint32_t textureCount;
+		uint32_t residentCount;
+		VkDeviceSize residentBytes;
+		VkDeviceSize budgetBytes;
+		uint32_t loads;
+		uint32_t evictions;
+		uint32_t trims;
+	};
+
+	// A budget of zero means working it out each frame from the device-local heap's budget and whatever else is using it.
+	TextureResidency(Application* app, VkDeviceSize budgetBytes);
+	virtual ~TextureResidency();
+
+	// The layout must have a single combined image sampler at binding 0.
+	void Create(VkDescriptorSetLayout descriptorSetLayout, uint32_t maxTextures);
+	void Destroy();
+
+	uint32_t AddTexture(Loader loader);
+	uint32_t AddTextureFile(const std::string& filePath);
+
+	// Marks the texture as used this frame.
+	void Touch(uint32_t textureId);
+	VkDescriptorSet GetDescriptorSet(uint32_t textureId, uint32_t i) const { return this->texturesArray[textureId].descriptorSets[i]; }
+
+	// Call once a frame, after waiting on frame slot i's fence.
+	void Update(uint32_t i);
+
+	const Statistics& GetStatistics() const { return this->statistics; }
+
+private:
+	struct Texture
+	{
+		Loader loader;
+		uint32_t width;				// Of mip 0, once known from the first load.
+		uint32_t height;
+		uint32_t mipLevels;
+		VkImage image;				// Holds mips baseMip and down, or is null if none are resident.
+		VkDeviceMemory imageMemory;
+		VkImageView imageView;
+		uint32_t baseMip;
+		VkDeviceSize residentBytes;
+		uint64_t lastUsedFrame;
+		bool loadPending;
+		bool loadFailed;			// Then it keeps whatever it has, the placeholder at worst, rather than failing again every frame.
+		VkDescriptorSet descriptorSets[MAX_FRAMES_IN_FLIGHT];
+		VkImageView boundViews[MAX_FRAMES_IN_FLIGHT];
+	};
+
+	// What a worker thread hands back: the whole mip chain, one level after another.
+	struct LoadResult
+	{
+		uint32_t textureId;
+		uint32_t width;
+		uint32_t height;
+		uint32_t mipLevels;
+		std::vector<uint8_t> pixels;
+	};
+
+	// Copies and uploads in flight.  Their staging buffers (if any) are freed once the fence says they're done.
+	struct Submission
+	{
+		VkCommandBuffer commandBuffer;
+		VkFence fence;
+		VkBuffer stagingBuffer;
+		VkDeviceMemory stagingBufferMemory;
+	};
+
+	// Images that were swapped out, kept until no frame in flight can still be using them.
+	struct Retiree
+	{
+		VkImage image;
+		VkDeviceMemory imageMemory;
+		VkImageView imageView;
+		uint64_t frame;			// The application's frame number when it was retired.
+	};
+
+	void CreatePlaceholder();
+	void CreateImage(uint32_t width, uint32_t height, uint32_t mipLevels, VkImage& image, VkDeviceMemory& imageMemory, VkImageView& imageView);
+	uint32_t ComputeBaseMip(const Texture& texture, VkDeviceSize budgetBytes) const;
+	VkDeviceSize ComputeBytes(const Texture& texture, uint32_t baseMip) const;
+	VkDeviceSize ComputeBudget() const;
+	VkCommandBuffer BeginSubmission();
+	void EndSubmission(VkCommandBuffer commandBuffer, VkBuffer stagingBuffer, VkDeviceMemory stagingBufferMemory);
+	void CollectSubmissions(bool wait);
+	void RequestLoad(uint32_t textureId);
+	void Upload(LoadResult& result, VkDeviceSize budgetBytes);
+	void Trim(uint32_t textureId);
+	void Evict(uint32_t textureId);
+	void Retire(Texture& texture);
+	void DestroyRetirees(bool all);
+
+	static void GenerateMips(LoadResult& result);
+
+	Application* app;
+	VkDeviceSize fixedBudgetBytes;
+	uint32_t deviceLocalHeap;
+	VkCommandPool commandPool;
+	VkDescriptorPool descriptorPool;
+	VkDescriptorSetLayout descriptorSetLayout;
+	VkSampler sampler;
+	VkImage placeholderImage;
+	VkDeviceMemory placeholderImageMemory;
+	VkImageView placeholderImageView;
+	uint32_t maxTextures;
+	uint64_t frameNumber;
+	std::vector<Texture> texturesArray;
+	std::vector<Submission> submissionsArray;
+	std::vector<Retiree> retireesArray;
+	std::vector<LoadResult> completedLoadsArray;		// Filled by the workers, under the mutex.
+	std::vector<LoadResult> waitingLoadsArray;			// Finished, but past the frame's operation limit.
+	std::mutex completedLoadsMutex;
+	uint32_t pendingLoadCount;
+	VkDeviceSize residentBytes;
+	Statistics statistics;
+	uint32_t reportFrameCount;
+};
@@ -0,0 +1,126 @@
+#include "ThreadPool.h"
+#include <atomic>
+#include <exception>
+#include <algorithm>
+
+ThreadPool::ThreadPool(uint32_t threadCount)
+{
+	this->shuttingDown = false;
+
+	for (uint32_t i = 0; i < threadCount; i++)
+		this->threadsArray.push_back(std::thread(&ThreadPool::WorkerMain, this));
+}
+
+/*virtual*/ ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		this->shuttingDown = true;
+	}
+
+	this->condition.notify_all();
+
+	for (std::thread& thread : this->threadsArray)
+		thread.join();
+}
+
+/*static*/ uint32_t ThreadPool::DefaultThreadCount()
+{
+	// Leave one hardware thread for the main thread, which always participates in the work it hands out.
+	uint32_t hardwareThreads = std::thread::hardware_concurrency();
+	return hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+}
+
+void ThreadPool::Submit(std::function<void()> job)
+{
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		this->jobQueue.push_back(std::move(job));
+	}
+
+	this->condition.notify_one();
+}
+
+void ThreadPool::WorkerMain()
+{
+	while (true)
+	{
+		std::function<void()> job;
+
+		{
+			std::unique_lock<std::mutex> lock(this->mutex);
+			this->condition.wait(lock, [this]() { return this->shuttingDown || !this->jobQueue.empty(); });
+
+			if (this->jobQueue.empty())
+				return;		// Only get here when shutting down.
+
+			job = std::move(this->jobQueue.front());
+			this->jobQueue.pop_front();
+		}
+
+		job();
+	}
+}
+
+void ThreadPool::ParallelFor(size_t count, size_t minimumBatchSize, const std::function<void(size_t begin, size_t end)>& function)
+{
+	if (count == 0)
+		return;
+
+	minimumBatchSize = std::max<size_t>(minimumBatchSize, 1);
+
+	size_t batchCount = std::min<size_t>(this->threadsArray.size() + 1, (count + minimumBatchSize - 1) / minimumBatchSize);
+	if (batchCount <= 1)
+	{
+		function(0, count);
+		return;
+	}
+
+	size_t batchSize = (count + batchCount - 1) / batchCount;
+
+	std::atomic<size_t> remainingBatches(batchCount - 1);
+	std::mutex doneMutex;
+	std::condition_variable doneCondition;
+	std::exception_ptr firstException;
+
+	auto runBatch = [&](size_t batch)
+	{
+		size_t begin = batch * batchSize;
+		size_t end = std::min(begin + batchSize, count);
+
+		try
+		{
+			if (begin < end)
+				function(begin, end);
+		}
+		catch (...)
+		{
+			std::lock_guard<std::mutex> lock(doneMutex);
+			if (!firstException)
+				firstException = std::current_exception();
+		}
+	};
+
+	for (size_t batch = 1; batch < batchCount; batch++)
+	{
+		this->Submit([&, batch]()
+		{
+			runBatch(batch);
+
+			// Take the lock so the waiting thread can't miss the notification and then return (destroying these locals) early.
+			std::lock_guard<std::mutex> lock(doneMutex);
+			if (--remainingBatches == 0)
+				doneCondition.notify_one();
+		});
+	}
+
+	runBatch(0);
+
+	{
+		std::unique_lock<std::mutex> lock(doneMutex);
+		doneCondition.wait(lock, [&]() { return remainingBatches == 0; });
+	}
+
+	if (firstException)
+		std::rethrow_exception(firstException);
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <cstdint>
+
+// A plain fixed-size pool of worker threads with a single shared job queue.  Nothing fancy (no work stealing);
+// the jobs we give it are coarse enough that contention on the queue doesn't matter.
+class ThreadPool
+{
+public:
+	ThreadPool(uint32_t threadCount);
+	virtual ~ThreadPool();
+
+	void Submit(std::function<void()> job);
+
+	// Splits [0, count) into batches of at least minimumBatchSize items and runs them across the pool, with the calling
+	// thread taking a share too.  Returns once every batch is done.  If a batch throws, the first exception is rethrown here.
+	void ParallelFor(size_t count, size_t minimumBatchSize, const std::function<void(size_t begin, size_t end)>& function);
+
+	uint32_t GetThreadCount() const { return (uint32_t)this->threadsArray.size(); }
+
+	static uint32_t DefaultThreadCount();
+
+private:
+	void WorkerMain();
+
+	std::vector<std::thread> threadsArray;
+	std::deque<std::function<void()>> jobQueue;
+	std::mutex mutex;
+	std::condition_variable condition;
+	bool shuttingDown;
+};
@@ -0,0 +1,365 @@
+#include "TransformStore.h"
+#include <algorithm>
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define TRANSFORM_STORE_X86
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define TRANSFORM_STORE_AVX2_TARGET
+#else
+#include <immintrin.h>
+#include <cpuid.h>
+#define TRANSFORM_STORE_AVX2_TARGET __attribute__((target("avx2,fma")))
+#endif
+#endif
+
+const size_t TRANSFORM_MIN_BATCH_SIZE = 8 * 1024;		// Objects per thread pool batch; less isn't worth the hand-off.
+
+TransformStore::TransformStore()
+{
+	this->count = 0;
+	this->simdPath = BestSupportedSimdPath();
+}
+
+/*virtual*/ TransformStore::~TransformStore()
+{
+}
+
+uint32_t TransformStore::Add(const float position[3], const float rotation[4], const float scale[3])
+{
+	uint32_t i = this->count;
+	this->Resize(this->count + 1);
+	this->SetPosition(i, position[0], position[1], position[2]);
+	this->SetRotation(i, rotation[0], rotation[1], rotation[2], rotation[3]);
+	this->SetScale(i, scale[0], scale[1], scale[2]);
+	return i;
+}
+
+void TransformStore::Resize(uint32_t count)
+{
+	// New objects start out as identity transforms.
+	this->positionX.resize(count, 0.0f);
+	this->positionY.resize(count, 0.0f);
+	this->positionZ.resize(count, 0.0f);
+	this->rotationX.resize(count, 0.0f);
+	this->rotationY.resize(count, 0.0f);
+	this->rotationZ.resize(count, 0.0f);
+	this->rotationW.resize(count, 1.0f);
+	this->scaleX.resize(count, 1.0f);
+	this->scaleY.resize(count, 1.0f);
+	this->scaleZ.resize(count, 1.0f);
+	this->count = count;
+}
+
+void TransformStore::SetPosition(uint32_t i, float x, float y, float z)
+{
+	this->positionX[i] = x;
+	this->positionY[i] = y;
+	this->positionZ[i] = z;
+}
+
+void TransformStore::SetRotation(uint32_t i, float x, float y, float z, float w)
+{
+	this->rotationX[i] = x;
+	this->rotationY[i] = y;
+	this->rotationZ[i] = z;
+	this->rotationW[i] = w;
+}
+
+void TransformStore::SetScale(uint32_t i, float x, float y, float z)
+{
+	this->scaleX[i] = x;
+	this->scaleY[i] = y;
+	this->scaleZ[i] = z;
+}
+
+void TransformStore::SetSimdPath(SimdPath simdPath)
+{
+	this->simdPath = std::min(simdPath, BestSupportedSimdPath());
+}
+
+/*static*/ TransformStore::SimdPath TransformStore::BestSupportedSimdPath()
+{
+#if defined(TRANSFORM_STORE_X86)
+	// SSE2 is part of x64 itself.  AVX2 needs the CPU to have it and FMA, and the OS to save the YMM registers.
+#if defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] >= 7)
+	{
+		__cpuid(info, 1);
+		bool fma = 0 != (info[2] & (1 << 12));
+		bool osxsave = 0 != (info[2] & (1 << 27));
+		bool avx = 0 != (info[2] & (1 << 28));
+		__cpuidex(info, 7, 0);
+		bool avx2 = 0 != (info[1] & (1 << 5));
+		if (fma && osxsave && avx && avx2 && (_xgetbv(0) & 6) == 6)
+			return SIMD_AVX2;
+	}
+#else
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+		return SIMD_AVX2;
+#endif
+	return SIMD_SSE;
+#else
+	return SIMD_SCALAR;
+#endif
+}
+
+/*static*/ const char* TransformStore::SimdPathName(SimdPath simdPath)
+{
+	switch (simdPath)
+	{
+	case SIMD_SCALAR:
+		return "scalar";
+	case SIMD_SSE:
+		return "SSE";
+	case SIMD_AVX2:
+		return "AVX2";
+	}
+
+	return "?";
+}
+
+void TransformStore::ComputeMatrices(const float* viewProjection, float* worldMatrices, float* mvpMatrices, ThreadPool* threadPool) const
+{
+	if (threadPool)
+		threadPool->ParallelFor(this->count, TRANSFORM_MIN_BATCH_SIZE, [this, viewProjection, worldMatrices, mvpMatrices](size_t begin, size_t end) { this->ComputeMatrices((uint32_t)begin, (uint32_t)end, viewProjection, worldMatrices, mvpMatrices); });
+	else
+		this->ComputeMatrices(0, this->count, viewProjection, worldMatrices, mvpMatrices);
+}
+
+void TransformStore::ComputeMatrices(uint32_t begin, uint32_t end, const float* viewProjection, float* worldMatrices, float* mvpMatrices) const
+{
+	switch (this->simdPath)
+	{
+	case SIMD_AVX2:
+		this->ComputeAVX2(begin, end, viewProjection, worldMatrices, mvpMatrices);
+		break;
+	case SIMD_SSE:
+		this->ComputeSSE(begin, end, viewProjection, worldMatrices, mvpMatrices);
+		break;
+	default:
+		this->ComputeScalar(begin, end, viewProjection, worldMatrices, mvpMatrices);
+		break;
+	}
+}
+
+// The vectorized paths do the same arithmetic as this, just on several objects at once.  This also mops up whatever
+// doesn't fill a whole batch at the end of their range.
+void TransformStore::ComputeScalar(uint32_t begin, uint32_t end, const float* viewProjection, float* worldMatrices, float* mvpMatrices) const
+{
+	for (uint32_t i = begin; i < end; i++)
+	{
+		float x = this->rotationX[i], y = this->rotationY[i], z = this->rotationZ[i], w = this->rotationW[i];
+		float sx = this->scaleX[i], sy = this->scaleY[i], sz = this->scaleZ[i];
+
+		// world[column][row], with the rotation built from the quaternion and each column scaled.
+		float world[4][4];
+		world[0][0] = (1.0f - 2.0f * (y * y + z * z)) * sx;
+		world[0][1] = (2.0f * (x * y + w * z)) * sx;
+		world[0][2] = (2.0f * (x * z - w * y)) * sx;
+		world[0][3] = 0.0f;
+		world[1][0] = (2.0f * (x * y - w * z)) * sy;
+		world[1][1] = (1.0f - 2.0f * (x * x + z * z)) * sy;
+		world[1][2] = (2.0f * (y * z + w * x)) * sy;
+		world[1][3] = 0.0f;
+		world[2][0] = (2.0f * (x * z + w * y)) * sz;
+		world[2][1] = (2.0f * (y * z - w * x)) * sz;
+		world[2][2] = (1.0f - 2.0f * (x * x + y * y)) * sz;
+		world[2][3] = 0.0f;
+		world[3][0] = this->positionX[i];
+		world[3][1] = this->positionY[i];
+		world[3][2] = this->positionZ[i];
+		world[3][3] = 1.0f;
+
+		if (worldMatrices)
+		{
+			float* output = worldMatrices + 16 * (size_t)i;
+			for (int column = 0; column < 4; column++)
+				for (int row = 0; row < 4; row++)
+					output[column * 4 + row] = world[column][row];
+		}
+
+		if (mvpMatrices && viewProjection)
+		{
+			float* output = mvpMatrices + 16 * (size_t)i;
+			for (int column = 0; column < 4; column++)
+				for (int row = 0; row < 4; row++)
+					output[column * 4 + row] =
+						viewProjection[0 * 4 + row] * world[column][0] +
+						viewProjection[1 * 4 + row] * world[column][1] +
+						viewProjection[2 * 4 + row] * world[column][2] +
+						viewProjection[3 * 4 + row] * world[column][3];
+		}
+	}
+}
+
+#if defined(TRANSFORM_STORE_X86)
+
+// Takes one column of four objects' matrices, as four row vectors with one object per lane, and writes it into each
+// object's matrix.
+static inline void StoreColumnSSE(float* output, int column, __m128 row0, __m128 row1, __m128 row2, __m128 row3)
+{
+	_MM_TRANSPOSE4_PS(row0, row1, row2, row3);
+	_mm_storeu_ps(output + 0 * 16 + column * 4, row0);
+	_mm_storeu_ps(output + 1 * 16 + column * 4, row1);
+	_mm_storeu_ps(output + 2 * 16 + column * 4, row2);
+	_mm_storeu_ps(output + 3 * 16 + column * 4, row3);
+}
+
+void TransformStore::ComputeSSE(uint32_t begin, uint32_t end, const float* viewProjection, float* worldMatrices, float* mvpMatrices) const
+{
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 two = _mm_set1_ps(2.0f);
+	const __m128 zero = _mm_setzero_ps();
+
+	uint32_t i = begin;
+	for (; i + 4 <= end; i += 4)
+	{
+		__m128 x = _mm_loadu_ps(&this->rotationX[i]);
+		__m128 y = _mm_loadu_ps(&this->rotationY[i]);
+		__m128 z = _mm_loadu_ps(&this->rotationZ[i]);
+		__m128 w = _mm_loadu_ps(&this->rotationW[i]);
+		__m128 sx = _mm_loadu_ps(&this->scaleX[i]);
+		__m128 sy = _mm_loadu_ps(&this->scaleY[i]);
+		__m128 sz = _mm_loadu_ps(&this->scaleZ[i]);
+
+		__m128 xx = _mm_mul_ps(x, x), yy = _mm_mul_ps(y, y), zz = _mm_mul_ps(z, z);
+		__m128 xy = _mm_mul_ps(x, y), xz = _mm_mul_ps(x, z), yz = _mm_mul_ps(y, z);
+		__m128 wx = _mm_mul_ps(w, x), wy = _mm_mul_ps(w, y), wz = _mm_mul_ps(w, z);
+
+		// world[column][row], one object per lane.
+		__m128 world[4][3];
+		world[0][0] = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))), sx);
+		world[0][1] = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xy, wz)), sx);
+		world[0][2] = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xz, wy)), sx);
+		world[1][0] = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xy, wz)), sy);
+		world[1][1] = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))), sy);
+		world[1][2] = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(yz, wx)), sy);
+		world[2][0] = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xz, wy)), sz);
+		world[2][1] = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(yz, wx)), sz);
+		world[2][2] = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))), sz);
+		world[3][0] = _mm_loadu_ps(&this->positionX[i]);
+		world[3][1] = _mm_loadu_ps(&this->positionY[i]);
+		world[3][2] = _mm_loadu_ps(&this->positionZ[i]);
+
+		if (worldMatrices)
+		{
+			float* output = worldMatrices + 16 * (size_t)i;
+			StoreColumnSSE(output, 0, world[0][0], world[0][1], world[0][2], zero);
+			StoreColumnSSE(output, 1, world[1][0], world[1][1], world[1][2], zero);
+			StoreColumnSSE(output, 2, world[2][0], world[2][1], world[2][2], zero);
+			StoreColumnSSE(output, 3, world[3][0], world[3][1], world[3][2], one);
+		}
+
+		if (mvpMatrices && viewProjection)
+		{
+			float* output = mvpMatrices + 16 * (size_t)i;
+			for (int column = 0; column < 4; column++)
+			{
+				__m128 rows[4];
+				for (int row = 0; row < 4; row++)
+				{
+					__m128 sum = _mm_add_ps(
+						_mm_add_ps(_mm_mul_ps(_mm_set1_ps(viewProjection[0 * 4 + row]), world[column][0]), _mm_mul_ps(_mm_set1_ps(viewProjection[1 * 4 + row]), world[column][1])),
+						_mm_mul_ps(_mm_set1_ps(viewProjection[2 * 4 + row]), world[column][2]));
+
+					// Only the translation column has a 1 in its last row; the others have 0.
+					rows[row] = (column == 3) ? _mm_add_ps(sum, _mm_set1_ps(viewProjection[3 * 4 + row])) : sum;
+				}
+
+				StoreColumnSSE(output, column, rows[0], rows[1], rows[2], rows[3]);
+			}
+		}
+	}
+
+	this->ComputeScalar(i, end, viewProjection, worldMatrices, mvpMatrices);
+}
+
+TRANSFORM_STORE_AVX2_TARGET void TransformStore::ComputeAVX2(uint32_t begin, uint32_t end, const float* viewProjection, float* worldMatrices, float* mvpMatrices) const
+{
+	const __m256 one = _mm256_set1_ps(1.0f);
+	const __m256 two = _mm256_set1_ps(2.0f);
+	const __m128 zero128 = _mm_setzero_ps();
+	const __m128 one128 = _mm_set1_ps(1.0f);
+
+	uint32_t i = begin;
+	for (; i + 8 <= end; i += 8)
+	{
+		__m256 x = _mm256_loadu_ps(&this->rotationX[i]);
+		__m256 y = _mm256_loadu_ps(&this->rotationY[i]);
+		__m256 z = _mm256_loadu_ps(&this->rotationZ[i]);
+		__m256 w = _mm256_loadu_ps(&this->rotationW[i]);
+		__m256 sx = _mm256_loadu_ps(&this->scaleX[i]);
+		__m256 sy = _mm256_loadu_ps(&this->scaleY[i]);
+		__m256 sz = _mm256_loadu_ps(&this->scaleZ[i]);
+
+		__m256 xx = _mm256_mul_ps(x, x), yy = _mm256_mul_ps(y, y), zz = _mm256_mul_ps(z, z);
+		__m256 xy = _mm256_mul_ps(x, y), xz = _mm256_mul_ps(x, z), yz = _mm256_mul_ps(y, z);
+		__m256 wx = _mm256_mul_ps(w, x), wy = _mm256_mul_ps(w, y), wz = _mm256_mul_ps(w, z);
+
+		__m256 world[4][3];
+		world[0][0] = _mm256_mul_ps(_mm256_fnmadd_ps(two, _mm256_add_ps(yy, zz), one), sx);
+		world[0][1] = _mm256_mul_ps(_mm256_mul_ps(two, _mm256_add_ps(xy, wz)), sx);
+		world[0][2] = _mm256_mul_ps(_mm256_mul_ps(two, _mm256_sub_ps(xz, wy)), sx);
+		world[1][0] = _mm256_mul_ps(_mm256_mul_ps(two, _mm256_sub_ps(xy, wz)), sy);
+		world[1][1] = _mm256_mul_ps(_mm256_fnmadd_ps(two, _mm256_add_ps(xx, zz), one), sy);
+		world[1][2] = _mm256_mul_ps(_mm256_mul_ps(two, _mm256_add_ps(yz, wx)), sy);
+		world[2][0] = _mm256_mul_ps(_mm256_mul_ps(two, _mm256_add_ps(xz, wy)), sz);
+		world[2][1] = _mm256_mul_ps(_mm256_mul_ps(two, _mm256_sub_ps(yz, wx)), sz);
+		world[2][2] = _mm256_mul_ps(_mm256_fnmadd_ps(two, _mm256_add_ps(xx, yy), one), sz);
+		world[3][0] = _mm256_loadu_ps(&this->positionX[i]);
+		world[3][1] = _mm256_loadu_ps(&this->positionY[i]);
+		world[3][2] = _mm256_loadu_ps(&this->positionZ[i]);
+
+		// The transposes into per-object matrices are done 4x4 at a time, on each half of the batch.
+		if (worldMatrices)
+		{
+			float* output = worldMatrices + 16 * (size_t)i;
+			for (int column = 0; column < 4; column++)
+			{
+				__m128 last = (column == 3) ? one128 : zero128;
+				StoreColumnSSE(output, column, _mm256_castps256_ps128(world[column][0]), _mm256_castps256_ps128(world[column][1]), _mm256_castps256_ps128(world[column][2]), last);
+				StoreColumnSSE(output + 4 * 16, column, _mm256_extractf128_ps(world[column][0], 1), _mm256_extractf128_ps(world[column][1], 1), _mm256_extractf128_ps(world[column][2], 1), last);
+			}
+		}
+
+		if (mvpMatrices && viewProjection)
+		{
+			float* output = mvpMatrices + 16 * (size_t)i;
+			for (int column = 0; column < 4; column++)
+			{
+				__m256 rows[4];
+				for (int row = 0; row < 4; row++)
+				{
+					__m256 sum = (column == 3) ? _mm256_set1_ps(viewProjection[3 * 4 + row]) : _mm256_setzero_ps();
+					sum = _mm256_fmadd_ps(_mm256_set1_ps(viewProjection[0 * 4 + row]), world[column][0], sum);
+					sum = _mm256_fmadd_ps(_mm256_set1_ps(viewProjection[1 * 4 + row]), world[column][1], sum);
+					rows[row] = _mm256_fmadd_ps(_mm256_set1_ps(viewProjection[2 * 4 + row]), world[column][2], sum);
+				}
+
+				StoreColumnSSE(output, column, _mm256_castps256_ps128(rows[0]), _mm256_castps256_ps128(rows[1]), _mm256_castps256_ps128(rows[2]), _mm256_castps256_ps128(rows[3]));
+				StoreColumnSSE(output + 4 * 16, column, _mm256_extractf128_ps(rows[0], 1), _mm256_extractf128_ps(rows[1], 1), _mm256_extractf128_ps(rows[2], 1), _mm256_extractf128_ps(rows[3], 1));
+			}
+		}
+	}
+
+	this->ComputeScalar(i, end, viewProjection, worldMatrices, mvpMatrices);
+}
+
+#else
+
+// Not an x86 build, so BestSupportedSimdPath never picks these.
+void TransformStore::ComputeSSE(uint32_t begin, uint32_t end, const float* viewProjection, float* worldMatrices, float* mvpMatrices) const
+{
+	this->ComputeScalar(begin, end, viewProjection, worldMatrices, mvpMatrices);
+}
+
+void TransformStore::ComputeAVX2(uint32_t begin, uint32_t end, const float* viewProjection, float* worldMatrices, float* mvpMatrices) const
+{
+	this->ComputeScalar(begin, end, viewProjection, worldMatrices, mvpMatrices);
+}
+
+#endif
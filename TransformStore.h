@@ -0,0 +1,71 @@
+#pragma once
+
+#include "ThreadPool.h"
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// Positions, rotations (unit quaternions) and scales for a large number of objects, kept as structure-of-arrays so that
+// whole batches of objects can be turned into matrices a SIMD register at a time.  Matrices are written out as plain
+// column-major float[16], the same layout as glm::mat4 and GLSL's mat4 in a std430 buffer, so the destination can be
+// mapped GPU memory.  Nothing in here depends on Vulkan or glm.
+class TransformStore
+{
+public:
+	enum SimdPath
+	{
+		SIMD_SCALAR,
+		SIMD_SSE,
+		SIMD_AVX2
+	};
+
+	TransformStore();
+	virtual ~TransformStore();
+
+	uint32_t Add(const float position[3], const float rotation[4], const float scale[3]);
+	void Resize(uint32_t count);
+	uint32_t GetCount() const { return this->count; }
+
+	void SetPosition(uint32_t i, float x, float y, float z);
+	void SetRotation(uint32_t i, float x, float y, float z, float w);
+	void SetScale(uint32_t i, float x, float y, float z);
+
+	// Direct access to the component streams, for systems that animate many objects at once.  Each holds GetCount() floats.
+	float* GetPositionX() { return this->positionX.data(); }
+	float* GetPositionY() { return this->positionY.data(); }
+	float* GetPositionZ() { return this->positionZ.data(); }
+	float* GetRotationX() { return this->rotationX.data(); }
+	float* GetRotationY() { return this->rotationY.data(); }
+	float* GetRotationZ() { return this->rotationZ.data(); }
+	float* GetRotationW() { return this->rotationW.data(); }
+	float* GetScaleX() { return this->scaleX.data(); }
+	float* GetScaleY() { return this->scaleY.data(); }
+	float* GetScaleZ() { return this->scaleZ.data(); }
+
+	// Computes world = T * R * S for objects [begin, end) and, if viewProjection is given, mvp = viewProjection * world.
+	// Either output may be null.  Matrix i is written at output + 16 * i, so the outputs are indexed the same as the store.
+	void ComputeMatrices(uint32_t begin, uint32_t end, const float* viewProjection, float* worldMatrices, float* mvpMatrices) const;
+
+	// Same, for every object, split across the pool when there are enough of them to be worth it.
+	void ComputeMatrices(const float* viewProjection, float* worldMatrices, float* mvpMatrices, ThreadPool* threadPool) const;
+
+	// The best path this CPU supports is picked at construction.  Forcing another is mainly for benchmarking; asking for
+	// one the CPU (or the build) doesn't support falls back to the best one that is.
+	void SetSimdPath(SimdPath simdPath);
+	SimdPath GetSimdPath() const { return this->simdPath; }
+
+	static SimdPath BestSupportedSimdPath();
+	static const char* SimdPathName(SimdPath simdPath);
+
+private:
+	void ComputeScalar(uint32_t begin, uint32_t end, const float* viewProjection, float* worldMatrices, float* mvpMatrices) const;
+	void ComputeSSE(uint32_t begin, uint32_t end, const float* viewProjection, float* worldMatrices, float* mvpMatrices) const;
+	void ComputeAVX2(uint32_t begin, uint32_t end, const float* viewProjection, float* worldMatrices, float* mvpMatrices) const;
+
+	uint32_t count;
+	SimdPath simdPath;
+
+	std::vector<float> positionX, positionY, positionZ;
+	std::vector<float> rotationX, rotationY, rotationZ, rotationW;
+	std::vector<float> scaleX, scaleY, scaleZ;
+};
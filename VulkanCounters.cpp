@@ -0,0 +1,95 @@
+#include "VulkanCounters.h"
+#include <algorithm>
+#include <iomanip>
+
+const uint32_t VULKAN_COUNTERS_REPORT_INTERVAL = 240;
+
+std::atomic<bool> VulkanCounters::enabled(false);
+std::atomic<uint32_t> VulkanCounters::liveCounts[COUNTER_COUNT];
+uint32_t VulkanCounters::frameCounts[COUNTER_COUNT];
+uint64_t VulkanCounters::totalCounts[COUNTER_COUNT];
+uint32_t VulkanCounters::peakCounts[COUNTER_COUNT];
+uint32_t VulkanCounters::reportFrameCount = 0;
+
+/*static*/ void VulkanCounters::EndStartup(std::ostream& stream)
+{
+	if (!IsEnabled())
+		return;
+
+	stream << "Vulkan calls during startup:";
+	for (uint32_t counter = 0; counter < COUNTER_COUNT; counter++)
+		stream << ' ' << GetCounterName((Counter)counter) << ' ' << liveCounts[counter].exchange(0, std::memory_order_relaxed) << ((counter + 1 < COUNTER_COUNT) ? "," : "");
+
+	stream << std::endl;
+}
+
+/*static*/ void VulkanCounters::EndFrame()
+{
+	if (!IsEnabled())
+		return;
+
+	// Whatever was counted since the last call, on any thread, belongs to this frame.  Uploads and such that happen
+	// between frames get lumped in with the next one, which is where their cost is felt anyway.
+	for (uint32_t counter = 0; counter < COUNTER_COUNT; counter++)
+	{
+		frameCounts[counter] = liveCounts[counter].exchange(0, std::memory_order_relaxed);
+		totalCounts[counter] += frameCounts[counter];
+		peakCounts[counter] = std::max(peakCounts[counter], frameCounts[counter]);
+	}
+
+	if (++reportFrameCount == VULKAN_COUNTERS_REPORT_INTERVAL)
+	{
+		Report(std::cout);
+
+		reportFrameCount = 0;
+		for (uint32_t counter = 0; counter < COUNTER_COUNT; counter++)
+		{
+			totalCounts[counter] = 0;
+			peakCounts[counter] = 0;
+		}
+	}
+}
+
+/*static*/ uint32_t VulkanCounters::GetFrameCount(Counter counter)
+{
+	return frameCounts[counter];
+}
+
+/*static*/ const char* VulkanCounters::GetCounterName(Counter counter)
+{
+	switch (counter)
+	{
+	case QUEUE_SUBMIT: return "vkQueueSubmit";
+	case MAP_MEMORY: return "vkMapMemory";
+	case UNMAP_MEMORY: return "vkUnmapMemory";
+	case ALLOCATE_MEMORY: return "vkAllocateMemory";
+	case ALLOCATE_COMMAND_BUFFERS: return "vkAllocateCommandBuffers";
+	case BIND_PIPELINE: return "pipeline binds";
+	case BIND_DESCRIPTOR_SETS: return "descriptor binds";
+	case DRAW: return "draws";
+	case TRIANGLES: return "triangles";
+	case DISPATCH: return "dispatches";
+	case PIPELINE_BARRIER: return "barriers";
+	default: return "unknown";
+	}
+}
+
+/*static*/ void VulkanCounters::Report(std::ostream& stream)
+{
+	// Per frame over the report interval: the last frame's count, the average and the peak.
+	uint32_t frameCount = std::max(reportFrameCount, 1u);
+	std::ios_base::fmtflags flags = stream.flags();
+	std::streamsize precision = stream.precision();
+
+	stream << "Vulkan calls per frame (last/average/peak):";
+	for (uint32_t counter = 0; counter < COUNTER_COUNT; counter++)
+	{
+		stream << ' ' << GetCounterName((Counter)counter) << ' ' << frameCounts[counter] << '/'
+			<< std::fixed << std::setprecision(1) << double(totalCounts[counter]) / double(frameCount) << '/'
+			<< peakCounts[counter] << ((counter + 1 < COUNTER_COUNT) ? "," : "");
+	}
+
+	stream << std::endl;
+	stream.flags(flags);
+	stream.precision(precision);
+}
@@ -0,0 +1,163 @@
+#pragma once
+
+// Counts of the Vulkan calls that tend to matter for CPU cost, per frame.  This header is included by Application.h,
+// right after the Vulkan headers, and routes the calls below through small inline wrappers that bump a counter before
+// calling the real thing, so every call anywhere in the program is counted without the call sites knowing about it.
+// Counting is off unless turned on with VULKAN_TUTORIAL_CALL_COUNTERS=1, in which case EndFrame, called once a frame,
+// keeps the counts for the frame just finished and logs a summary every so often.
+
+#include <vulkan/vulkan.h>
+#include <atomic>
+#include <iostream>
+#include <cstdint>
+
+class VulkanCounters
+{
+public:
+	enum Counter : uint32_t
+	{
+		QUEUE_SUBMIT,
+		MAP_MEMORY,
+		UNMAP_MEMORY,
+		ALLOCATE_MEMORY,
+		ALLOCATE_COMMAND_BUFFERS,
+		BIND_PIPELINE,
+		BIND_DESCRIPTOR_SETS,
+		DRAW,
+		TRIANGLES,			// Assuming triangle lists, and not counting indirect draws, whose counts the CPU never sees.
+		DISPATCH,
+		PIPELINE_BARRIER,
+		COUNTER_COUNT
+	};
+
+	static void SetEnabled(bool enabled) { VulkanCounters::enabled.store(enabled, std::memory_order_relaxed); }
+	static bool IsEnabled() { return VulkanCounters::enabled.load(std::memory_order_relaxed); }
+
+	static void Count(Counter counter, uint32_t count = 1)
+	{
+		if (IsEnabled())
+			VulkanCounters::liveCounts[counter].fetch_add(count, std::memory_order_relaxed);
+	}
+
+	// Logs what was counted before the first frame, and starts counting frames from zero.
+	static void EndStartup(std::ostream& stream);
+
+	// Call once a frame, at the end of it.
+	static void EndFrame();
+
+	// The counts of the last frame to end.
+	static uint32_t GetFrameCount(Counter counter);
+	static const char* GetCounterName(Counter counter);
+
+	static void Report(std::ostream& stream);
+
+private:
+	static std::atomic<bool> enabled;
+	static std::atomic<uint32_t> liveCounts[COUNTER_COUNT];		// Counted from any thread.
+	static uint32_t frameCounts[COUNTER_COUNT];
+	static uint64_t totalCounts[COUNTER_COUNT];
+	static uint32_t peakCounts[COUNTER_COUNT];
+	static uint32_t reportFrameCount;
+};
+
+inline VkResult CountedQueueSubmit(VkQueue queue, uint32_t submitCount, const VkSubmitInfo* pSubmits, VkFence fence)
+{
+	VulkanCounters::Count(VulkanCounters::QUEUE_SUBMIT);
+	return vkQueueSubmit(queue, submitCount, pSubmits, fence);
+}
+
+inline VkResult CountedMapMemory(VkDevice device, VkDeviceMemory memory, VkDeviceSize offset, VkDeviceSize size, VkMemoryMapFlags flags, void** ppData)
+{
+	VulkanCounters::Count(VulkanCounters::MAP_MEMORY);
+	return vkMapMemory(device, memory, offset, size, flags, ppData);
+}
+
+inline void CountedUnmapMemory(VkDevice device, VkDeviceMemory memory)
+{
+	VulkanCounters::Count(VulkanCounters::UNMAP_MEMORY);
+	vkUnmapMemory(device, memory);
+}
+
+inline VkResult CountedAllocateMemory(VkDevice device, const VkMemoryAllocateInfo* pAllocateInfo, const VkAllocationCallbacks* pAllocator, VkDeviceMemory* pMemory)
+{
+	VulkanCounters::Count(VulkanCounters::ALLOCATE_MEMORY);
+	return vkAllocateMemory(device, pAllocateInfo, pAllocator, pMemory);
+}
+
+inline VkResult CountedAllocateCommandBuffers(VkDevice device, const VkCommandBufferAllocateInfo* pAllocateInfo, VkCommandBuffer* pCommandBuffers)
+{
+	VulkanCounters::Count(VulkanCounters::ALLOCATE_COMMAND_BUFFERS, pAllocateInfo->commandBufferCount);
+	return vkAllocateCommandBuffers(device, pAllocateInfo, pCommandBuffers);
+}
+
+inline void CountedCmdBindPipeline(VkCommandBuffer commandBuffer, VkPipelineBindPoint pipelineBindPoint, VkPipeline pipeline)
+{
+	VulkanCounters::Count(VulkanCounters::BIND_PIPELINE);
+	vkCmdBindPipeline(commandBuffer, pipelineBindPoint, pipeline);
+}
+
+inline void CountedCmdBindDescriptorSets(VkCommandBuffer commandBuffer, VkPipelineBindPoint pipelineBindPoint, VkPipelineLayout layout, uint32_t firstSet, uint32_t descriptorSetCount, const VkDescriptorSet* pDescriptorSets, uint32_t dynamicOffsetCount, const uint32_t* pDynamicOffsets)
+{
+	VulkanCounters::Count(VulkanCounters::BIND_DESCRIPTOR_SETS);
+	vkCmdBindDescriptorSets(commandBuffer, pipelineBindPoint, layout, firstSet, descriptorSetCount, pDescriptorSets, dynamicOffsetCount, pDynamicOffsets);
+}
+
+inline void CountedCmdDraw(VkCommandBuffer commandBuffer, uint32_t vertexCount, uint32_t instanceCount, uint32_t firstVertex, uint32_t firstInstance)
+{
+	VulkanCounters::Count(VulkanCounters::DRAW);
+	VulkanCounters::Count(VulkanCounters::TRIANGLES, (vertexCount / 3) * instanceCount);
+	vkCmdDraw(commandBuffer, vertexCount, instanceCount, firstVertex, firstInstance);
+}
+
+inline void CountedCmdDrawIndexed(VkCommandBuffer commandBuffer, uint32_t indexCount, uint32_t instanceCount, uint32_t firstIndex, int32_t vertexOffset, uint32_t firstInstance)
+{
+	VulkanCounters::Count(VulkanCounters::DRAW);
+	VulkanCounters::Count(VulkanCounters::TRIANGLES, (indexCount / 3) * instanceCount);
+	vkCmdDrawIndexed(commandBuffer, indexCount, instanceCount, firstIndex, vertexOffset, firstInstance);
+}
+
+inline void CountedCmdDrawIndirect(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize offset, uint32_t drawCount, uint32_t stride)
+{
+	VulkanCounters::Count(VulkanCounters::DRAW);
+	vkCmdDrawIndirect(commandBuffer, buffer, offset, drawCount, stride);
+}
+
+inline void CountedCmdDrawIndexedIndirect(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize offset, uint32_t drawCount, uint32_t stride)
+{
+	VulkanCounters::Count(VulkanCounters::DRAW);
+	vkCmdDrawIndexedIndirect(commandBuffer, buffer, offset, drawCount, stride);
+}
+
+// Extension commands are called through pointers, which a macro can't catch, so the call site calls this instead.
+inline void CountedCmdDrawMeshTasks(PFN_vkCmdDrawMeshTasksNV pfnCmdDrawMeshTasks, VkCommandBuffer commandBuffer, uint32_t taskCount, uint32_t firstTask)
+{
+	VulkanCounters::Count(VulkanCounters::DRAW);
+	pfnCmdDrawMeshTasks(commandBuffer, taskCount, firstTask);
+}
+
+inline void CountedCmdDispatch(VkCommandBuffer commandBuffer, uint32_t groupCountX, uint32_t groupCountY, uint32_t groupCountZ)
+{
+	VulkanCounters::Count(VulkanCounters::DISPATCH);
+	vkCmdDispatch(commandBuffer, groupCountX, groupCountY, groupCountZ);
+}
+
+inline void CountedCmdPipelineBarrier(VkCommandBuffer commandBuffer, VkPipelineStageFlags srcStageMask, VkPipelineStageFlags dstStageMask, VkDependencyFlags dependencyFlags, uint32_t memoryBarrierCount, const VkMemoryBarrier* pMemoryBarriers, uint32_t bufferMemoryBarrierCount, const VkBufferMemoryBarrier* pBufferMemoryBarriers, uint32_t imageMemoryBarrierCount, const VkImageMemoryBarrier* pImageMemoryBarriers)
+{
+	VulkanCounters::Count(VulkanCounters::PIPELINE_BARRIER);
+	vkCmdPipelineBarrier(commandBuffer, srcStageMask, dstStageMask, dependencyFlags, memoryBarrierCount, pMemoryBarriers, bufferMemoryBarrierCount, pBufferMemoryBarriers, imageMemoryBarrierCount, pImageMemoryBarriers);
+}
+
+// Function-like macros only replace a name when it's called, so taking the address of one of these still gets the real one.
+#define vkQueueSubmit(...) CountedQueueSubmit(__VA_ARGS__)
+#define vkMapMemory(...) CountedMapMemory(__VA_ARGS__)
+#define vkUnmapMemory(...) CountedUnmapMemory(__VA_ARGS__)
+#define vkAllocateMemory(...) CountedAllocateMemory(__VA_ARGS__)
+#define vkAllocateCommandBuffers(...) CountedAllocateCommandBuffers(__VA_ARGS__)
+#define vkCmdBindPipeline(...) CountedCmdBindPipeline(__VA_ARGS__)
+#define vkCmdBindDescriptorSets(...) CountedCmdBindDescriptorSets(__VA_ARGS__)
+#define vkCmdDraw(...) CountedCmdDraw(__VA_ARGS__)
+#define vkCmdDrawIndexed(...) CountedCmdDrawIndexed(__VA_ARGS__)
+#define vkCmdDrawIndirect(...) CountedCmdDrawIndirect(__VA_ARGS__)
+#define vkCmdDrawIndexedIndirect(...) CountedCmdDrawIndexedIndirect(__VA_ARGS__)
+#define vkCmdDispatch(...) CountedCmdDispatch(__VA_ARGS__)
+#define vkCmdPipelineBarrier(...) CountedCmdPipelineBarrier(__VA_ARGS__)
@@ -0,0 +1,25 @@
+#version 450
+
+// One entry per instance, sorted by level of detail on the CPU: position in xyz, uniform scale in w.
+layout(std430, binding = 0) readonly buffer Instances {
+    vec4 instance[];
+} instances;
+
+layout(push_constant) uniform LodParams {
+    mat4 viewProjection;
+} params;
+
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec3 inNormal;
+
+layout(location = 0) out vec3 fragColor;
+
+void main()
+{
+    vec4 instance = instances.instance[gl_InstanceIndex];
+    gl_Position = params.viewProjection * vec4(instance.xyz + inPosition * instance.w, 1.0);
+
+    // Uniform scale only, so the normal needs no special treatment.
+    float light = max(dot(inNormal, normalize(vec3(0.4, 0.3, 0.85))), 0.0);
+    fragColor = vec3(0.15, 0.15, 0.2) + vec3(0.85, 0.8, 0.7) * light;
+}
@@ -0,0 +1,36 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+
+#include "meshlet_common.glsl"
+
+layout(std430, binding = 8) readonly buffer Visible {
+    uint cluster[];
+} visible;
+
+layout(location = 0) out vec3 fragColor;
+
+// One instance per visible cluster, each with room for MeshletBuilder::MAX_TRIANGLES triangles.  Those past the
+// cluster's own triangle count all land on the same point, and so draw nothing.
+void main()
+{
+    uint clusterCount = params.objectCount * params.meshletCount;
+    uint cluster = visible.cluster[params.slot * clusterCount + gl_InstanceIndex];
+    Meshlet meshlet = meshlets.meshlet[cluster % params.meshletCount];
+
+    uint triangle = gl_VertexIndex / 3;
+    if (triangle >= meshlet.triangleCount)
+    {
+        gl_Position = vec4(0.0, 0.0, 0.0, 1.0);
+        fragColor = vec3(0.0);
+        return;
+    }
+
+    uint localIndex = (triangles.packed[meshlet.triangleOffset + triangle] >> (8 * (gl_VertexIndex % 3))) & 0xFF;
+    uint vertexIndex = vertexIndices.index[meshlet.vertexOffset + localIndex];
+
+    vec4 position;
+    vec3 color;
+    FetchVertex(vertexIndex, objects.object[cluster / params.meshletCount], position, color);
+    gl_Position = position;
+    fragColor = color;
+}
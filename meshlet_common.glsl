@@ -0,0 +1,104 @@
+// Shared by the meshlet shaders: the buffers they all read, the push constants, the cluster test and the vertex fetch.
+// Must match MeshletRenderer and MeshletBuilder.
+
+struct CullParams
+{
+    mat4 viewProjection;
+    vec4 planes[6];         // Pointing inward, with unit normals.
+    vec4 cameraPosition;
+};
+
+struct Meshlet
+{
+    uint vertexOffset;
+    uint triangleOffset;
+    uint vertexCount;
+    uint triangleCount;
+};
+
+struct MeshletBounds
+{
+    vec4 sphere;            // Center in xyz, radius in w.
+    vec4 cone;              // Axis in xyz, cutoff in w.
+};
+
+layout(std430, binding = 0) readonly buffer CullParamsBuffer {
+    CullParams slot[];
+} cullParams;
+
+// Position in xyz, uniform scale in w.
+layout(std430, binding = 1) readonly buffer Objects {
+    vec4 object[];
+} objects;
+
+layout(std430, binding = 2) readonly buffer Meshlets {
+    Meshlet meshlet[];
+} meshlets;
+
+layout(std430, binding = 3) readonly buffer Bounds {
+    MeshletBounds bounds[];
+} bounds;
+
+layout(std430, binding = 4) readonly buffer VertexIndices {
+    uint index[];
+} vertexIndices;
+
+// Three meshlet-local vertex indices per triangle, 8 bits apiece.
+layout(std430, binding = 5) readonly buffer Triangles {
+    uint packed[];
+} triangles;
+
+// The whole geometry pool, as floats; ours are position then normal, six floats to a vertex, from params.vertexBase on.
+layout(std430, binding = 6) readonly buffer Vertices {
+    float data[];
+} vertices;
+
+layout(push_constant) uniform MeshletParams {
+    uint slot;
+    uint meshletCount;
+    uint objectCount;
+    uint vertexBase;
+    uint cullingEnabled;
+} params;
+
+// A cluster is the meshlet and object indices rolled into one: object * meshletCount + meshlet.
+bool IsClusterVisible(uint cluster)
+{
+    if (params.cullingEnabled == 0)
+        return true;
+
+    CullParams view = cullParams.slot[params.slot];
+    vec4 object = objects.object[cluster / params.meshletCount];
+    MeshletBounds meshletBounds = bounds.bounds[cluster % params.meshletCount];
+
+    // The copies are only moved and uniformly scaled, so the sphere goes along and the cone axis stays as it is.
+    vec3 center = object.xyz + meshletBounds.sphere.xyz * object.w;
+    float radius = meshletBounds.sphere.w * object.w;
+
+    for (int j = 0; j < 6; j++)
+    {
+        if (dot(view.planes[j].xyz, center) + view.planes[j].w < -radius)
+            return false;
+    }
+
+    // Every triangle faces away if every direction from the eye into the sphere is within 90 degrees of every normal in
+    // the cone.  See MeshletBuilder::Bounds.
+    vec3 offset = center - view.cameraPosition.xyz;
+    if (dot(offset, meshletBounds.cone.xyz) >= meshletBounds.cone.w * (length(offset) + radius) + radius)
+        return false;
+
+    return true;
+}
+
+// Lit the same way as lod.vert, so lod.frag serves for both.
+void FetchVertex(uint vertexIndex, vec4 object, out vec4 position, out vec3 color)
+{
+    uint base = params.vertexBase + 6 * vertexIndex;
+    vec3 inPosition = vec3(vertices.data[base], vertices.data[base + 1], vertices.data[base + 2]);
+    vec3 inNormal = vec3(vertices.data[base + 3], vertices.data[base + 4], vertices.data[base + 5]);
+
+    position = cullParams.slot[params.slot].viewProjection * vec4(object.xyz + inPosition * object.w, 1.0);
+
+    float light = max(dot(inNormal, normalize(vec3(0.4, 0.3, 0.85))), 0.0);
+    color = vec3(0.15, 0.15, 0.2) + vec3(0.85, 0.8, 0.7) * light;
+}
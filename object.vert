@@ -0,0 +1,20 @@
+#version 450
+
+// One MVP matrix per instance, computed on the CPU by the transform store.
+layout(std430, binding = 0) readonly buffer ObjectMatrices {
+    mat4 mvp[];
+} objects;
+
+layout(location = 0) in vec2 inPosition;
+layout(location = 1) in vec3 inColor;
+layout(location = 2) in vec2 inTexCoord;
+
+layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec2 fragTexCoord;
+
+void main()
+{
+    gl_Position = objects.mvp[gl_InstanceIndex] * vec4(inPosition, 0.0, 1.0);
+    fragColor = inColor;
+    fragTexCoord = inTexCoord;
+}
@@ -0,0 +1,23 @@
+#version 450
+
+// Per-instance attributes, straight out of the particle storage buffer.
+layout(location = 0) in vec2 inPosition;
+layout(location = 1) in vec4 inColor;
+
+layout(push_constant) uniform Params {
+    vec2 halfSize;
+} params;
+
+layout(location = 0) out vec4 fragColor;
+
+const vec2 corners[6] = vec2[](
+    vec2(-1.0, -1.0), vec2(1.0, -1.0), vec2(1.0, 1.0),
+    vec2(1.0, 1.0), vec2(-1.0, 1.0), vec2(-1.0, -1.0)
+);
+
+void main()
+{
+    vec2 corner = corners[gl_VertexIndex];
+    gl_Position = vec4(inPosition + corner * params.halfSize, 0.0, 1.0);
+    fragColor = inColor;
+}
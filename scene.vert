@@ -0,0 +1,29 @@
+#version 450
+
+// World matrices for every scene graph node, kept on the GPU and only partially rewritten each frame.
+layout(std430, binding = 0) readonly buffer WorldMatrices {
+    mat4 world[];
+} worlds;
+
+// Which nodes survived frustum culling this frame, as indices into the above.
+layout(std430, binding = 2) readonly buffer VisibleNodes {
+    uint index[];
+} visible;
+
+layout(push_constant) uniform SceneParams {
+    mat4 viewProjection;
+} params;
+
+layout(location = 0) in vec2 inPosition;
+layout(location = 1) in vec3 inColor;
+layout(location = 2) in vec2 inTexCoord;
+
+layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec2 fragTexCoord;
+
+void main()
+{
+    gl_Position = params.viewProjection * worlds.world[visible.index[gl_InstanceIndex]] * vec4(inPosition, 0.0, 1.0);
+    fragColor = inColor;
+    fragTexCoord = inTexCoord;
+}
@@ -7,8 +7,24 @@ layout(location = 1) in vec2 fragTexCoord;
 
 layout(binding = 1) uniform sampler2D texSampler;
 
+// Feature toggles, set per pipeline (see MainShaderVariant), so the paths that are off get compiled out.
+layout(constant_id = 0) const bool USE_TEXTURE = true;
+layout(constant_id = 1) const bool USE_VERTEX_COLOR = false;
+layout(constant_id = 2) const bool ALPHA_TEST = false;
+layout(constant_id = 3) const float ALPHA_CUTOFF = 0.5;
+
 void main()
 {
-    //outColor = vec4(fragColor, 1.0);
-    outColor = texture(texSampler, fragTexCoord);
+    vec4 color = vec4(1.0);
+
+    if (USE_TEXTURE)
+        color *= texture(texSampler, fragTexCoord);
+
+    if (USE_VERTEX_COLOR)
+        color.rgb *= fragColor;
+
+    if (ALPHA_TEST && color.a < ALPHA_CUTOFF)
+        discard;
+
+    outColor = color;
 }
\ No newline at end of file
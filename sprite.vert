@@ -0,0 +1,20 @@
+#version 450
+
+// Quad corners come in already rotated and placed, in pixels from the top-left of the window.
+layout(location = 0) in vec2 inPosition;
+layout(location = 1) in vec2 inTexCoord;
+layout(location = 2) in vec4 inColor;
+
+layout(push_constant) uniform Params {
+    vec2 pixelToClip;
+} params;
+
+layout(location = 0) out vec4 fragColor;
+layout(location = 1) out vec2 fragTexCoord;
+
+void main()
+{
+    gl_Position = vec4(inPosition * params.pixelToClip - vec2(1.0, 1.0), 0.0, 1.0);
+    fragColor = inColor;
+    fragTexCoord = inTexCoord;
+}
@@ -0,0 +1,16 @@
+#version 450
+
+layout(push_constant) uniform Params {
+    vec2 uvScale;
+    vec2 uvClamp;
+} params;
+
+layout(location = 0) in vec2 fragTexCoord;
+layout(location = 0) out vec4 outColor;
+
+layout(binding = 0) uniform sampler2D sceneSampler;
+
+void main()
+{
+    outColor = texture(sceneSampler, min(fragTexCoord, params.uvClamp));
+}
@@ -0,0 +1,16 @@
+#version 450
+
+// One triangle big enough to cover the screen, with no vertex buffer: the corners come from the vertex index.
+layout(push_constant) uniform Params {
+    vec2 uvScale;       // The part of the scene image that was rendered to, this frame.
+    vec2 uvClamp;       // Half a texel in from its far edges, so filtering never reads past them.
+} params;
+
+layout(location = 0) out vec2 fragTexCoord;
+
+void main()
+{
+    vec2 corner = vec2((gl_VertexIndex << 1) & 2, gl_VertexIndex & 2);
+    gl_Position = vec4(corner * 2.0 - 1.0, 0.0, 1.0);
+    fragTexCoord = corner * params.uvScale;
+}